@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""Compare two benchmark runs and report regressions.
+
+Usage: python3 compare.py baseline.jsonl results.jsonl [--threshold 0.10]
+
+Both files are the {"bench": ...} lines printed by the benchmark (other lines are ignored).
+Exits with status 1 if any result's us_per_op got worse by more than the threshold.
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith('{"bench"'):
+                continue
+            r = json.loads(line)
+            if "us_per_op" not in r:
+                continue
+            results[(r["bench"], r["variant"], r["size"])] = r
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    parser.add_argument("--threshold", type=float, default=0.10, help="allowed slowdown as a fraction (default 0.10)")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    results = load(args.results)
+    regressions = 0
+    for key in sorted(results):
+        new = results[key]["us_per_op"]
+        if key not in baseline:
+            print("NEW   %-18s %-22s %6s  %12.4f us" % (key[0], key[1], key[2], new))
+            continue
+        old = baseline[key]["us_per_op"]
+        change = (new - old) / old if old > 0 else 0.0
+        status = "OK"
+        if change > args.threshold:
+            status = "SLOW"
+            regressions += 1
+        print("%-5s %-18s %-22s %6s  %12.4f -> %12.4f us  (%+.1f%%)" % (status, key[0], key[1], key[2], old, new, change * 100.0))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
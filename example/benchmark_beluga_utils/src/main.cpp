@@ -0,0 +1,1109 @@
+#include <Arduino.h>
+#include <string>
+#include <sstream>
+#include <vector>
+#include "SPIFFS.h"
+#include "beluga_debug.h"
+#include "beluga_ini_reader.h"
+#include "beluga_heap_stats.h"
+#include "beluga_scheduler.h"
+#include "beluga_storage_backend.h"
+#include "beluga_microsd.h"
+#include "beluga_microsd_pipeline.h"
+#include "beluga_log_file.h"
+#include "beluga_ini_blob.h"
+#include "beluga_ini_schema.h"
+#if defined(BELUGA_NATIVE)
+#include <atomic>
+#include <thread>
+#endif
+
+/*
+Benchmark suite for beluga_arduino_utils.
+Each result is one line of JSON:
+{"bench":"parse","variant":"arena","size":10000,"iterations":20,"us_per_op":1234.5,"mb_per_s":12.3,...}
+Compare two runs with compare.py to spot regressions.
+*/
+
+#if defined(BELUGA_NATIVE)
+static FILE * null_output = nullptr;
+#endif
+
+/*!
+\brief Stop the library's own Serial chatter from landing in (and slowing) the measured region.
+\details On the host Serial is pointed at /dev/null; on the device Serial is the UART so we can only disable debug_print.
+*/
+static void quiet(bool enable)
+{
+  beluga_utils::set_debug_print_enable(!enable);
+#if defined(BELUGA_NATIVE)
+  if(null_output == nullptr)
+  {
+    null_output = fopen("/dev/null", "w");
+  }
+  Serial.set_output(enable ? null_output : nullptr);
+#endif
+}
+
+static void emit_result(const char * bench, const char * variant, unsigned long size, unsigned long iterations, unsigned long elapsed_us, size_t bytes_per_op, const char * extra = "")
+{
+  double us_per_op = (double) elapsed_us / (double) iterations;
+  double mb_per_s = (bytes_per_op > 0 && elapsed_us > 0) ? ((double) bytes_per_op * iterations) / (double) elapsed_us : 0.0;
+  Serial.printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"size\":%lu,\"iterations\":%lu,\"us_per_op\":%.4f,\"ns_per_op\":%.1f,\"mb_per_s\":%.3f%s}\n",
+    bench, variant, size, iterations, us_per_op, us_per_op * 1000.0, mb_per_s, extra);
+}
+
+static std::string config_path(unsigned long n_keys)
+{
+  std::stringstream ss;
+  ss << "/bench_" << n_keys << ".ini";
+  return ss.str();
+}
+
+/*!
+\brief Write a config with n_keys keys, 100 per section, plus a [lists] section used by the list benchmark.
+\return The file size in bytes.
+*/
+static size_t generate_config(unsigned long n_keys)
+{
+  File f = SPIFFS.open(config_path(n_keys).c_str(), FILE_WRITE);
+  size_t n_bytes = 0;
+  for(unsigned long i = 0; i < n_keys; i++)
+  {
+    char line[64];
+    int n;
+    if(i % 100 == 0)
+    {
+      n = snprintf(line, sizeof(line), "[device_%lu]\n", i / 100);
+      n_bytes += f.write((const uint8_t *) line, (size_t) n);
+    }
+    n = snprintf(line, sizeof(line), "key_%lu = %lu\n", i % 100, i);
+    n_bytes += f.write((const uint8_t *) line, (size_t) n);
+  }
+  const char * lists = "[lists]\nchannels = ch0,ch1,ch2,ch3,ch4,ch5,ch6,ch7,ch8,ch9,ch10,ch11,ch12,ch13,ch14,ch15\n"
+    "pins = 4, 5, 12, 13, 14, 15, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27\n";
+  n_bytes += f.write((const uint8_t *) lists, strlen(lists));
+  f.close();
+  return n_bytes;
+}
+
+static const char * mode_name(beluga_utils::ini_storage_mode mode)
+{
+  switch(mode)
+  {
+    case beluga_utils::ini_storage_mode::nested_map:
+      return "nested_map";
+    case beluga_utils::ini_storage_mode::arena:
+      return "arena";
+    case beluga_utils::ini_storage_mode::lazy:
+      return "lazy";
+  }
+  return "unknown";
+}
+
+static void bench_parse(unsigned long n_keys, size_t file_size, beluga_utils::ini_storage_mode mode)
+{
+  unsigned long iterations = n_keys >= 10000 ? 10 : (n_keys >= 100 ? 100 : 500);
+  beluga_utils::ini_load_stats stats = {0, 0};
+  quiet(true);
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    beluga_utils::ini_reader ini(config_path(n_keys), mode);
+    ini.initialise(false);
+    stats = ini.get_load_stats();
+  }
+  unsigned long elapsed_us = micros() - t0;
+  quiet(false);
+  char extra[96];
+  snprintf(extra, sizeof(extra), ",\"load_bytes\":%lu,\"load_allocations\":%lu", (unsigned long) stats.bytes_used, (unsigned long) stats.allocation_count);
+  emit_result("parse", mode_name(mode), n_keys, iterations, elapsed_us, file_size, extra);
+}
+
+static void bench_lookup(unsigned long n_keys, beluga_utils::ini_storage_mode mode)
+{
+  const unsigned long iterations = 20000;
+  beluga_utils::ini_reader ini(config_path(n_keys), mode);
+  quiet(true);
+  ini.initialise(false);
+
+  //Precompute the names so string building is not measured
+  std::vector<std::string> sections;
+  std::vector<std::string> keys;
+  for(unsigned long i = 0; i < 256; i++)
+  {
+    unsigned long k = (i * 7919) % n_keys;
+    sections.push_back("device_" + std::to_string(k / 100));
+    keys.push_back("key_" + std::to_string(k % 100));
+  }
+  std::vector<beluga_utils::ini_handle> handles;
+  for(size_t i = 0; i < sections.size(); i++)
+  {
+    handles.push_back(ini.get_config_handle(sections[i], keys[i]));
+  }
+
+  std::string value;
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    ini.get_config_value(sections[i & 255], keys[i & 255], &value, false);
+  }
+  unsigned long string_us = micros() - t0;
+
+  beluga_utils::ini_view view;
+  size_t checksum = 0;
+  t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    ini.get_config_value(handles[i & 255], &view);
+    checksum += view.length;
+  }
+  unsigned long handle_us = micros() - t0;
+
+  int32_t n;
+  t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    ini.get_config_int(handles[i & 255], &n);
+    checksum += (size_t) n;
+  }
+  unsigned long typed_us = micros() - t0;
+
+  std::string miss_section("no_such_device");
+  t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    ini.get_config_value(miss_section, keys[i & 255], &value, false);
+  }
+  unsigned long miss_us = micros() - t0;
+  quiet(false);
+
+  std::string variant = mode_name(mode);
+  emit_result("lookup_string", variant.c_str(), n_keys, iterations, string_us, 0);
+  emit_result("lookup_handle", variant.c_str(), n_keys, iterations, handle_us, 0);
+  emit_result("lookup_typed_int", variant.c_str(), n_keys, iterations, typed_us, 0);
+  emit_result("lookup_miss", variant.c_str(), n_keys, iterations, miss_us, 0);
+  if(checksum == 1)
+  {
+    Serial.println(""); //Keep the reads from being optimised away
+  }
+}
+
+static void bench_list_split(unsigned long n_keys)
+{
+  const unsigned long iterations = 5000;
+  beluga_utils::ini_reader ini(config_path(n_keys), beluga_utils::ini_storage_mode::arena);
+  quiet(true);
+  ini.initialise(false);
+  std::vector<std::string> channels;
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    ini.get_config_list_field("lists", "channels", channels);
+  }
+  unsigned long vector_us = micros() - t0;
+
+  //Split at load time: the getter only looks the key up and returns the range
+  beluga_utils::ini_list_view channel_list;
+  size_t total_length = 0;
+  t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    ini.get_config_list("lists", "channels", &channel_list);
+    for(const beluga_utils::ini_view & channel : channel_list)
+    {
+      total_length += channel.length;
+    }
+  }
+  unsigned long view_us = micros() - t0;
+
+  beluga_utils::ini_handle h = ini.get_config_handle("lists", "channels");
+  t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    ini.get_config_list(h, &channel_list);
+    total_length += channel_list[channel_list.size() - 1].length;
+  }
+  unsigned long view_handle_us = micros() - t0;
+
+  beluga_utils::ini_int_list_view pins;
+  int32_t pin_sum = 0;
+  t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    if(ini.get_config_int_list("lists", "pins", &pins) == beluga_utils::ini_error::ok)
+    {
+      for(int32_t pin : pins)
+      {
+        pin_sum += pin;
+      }
+    }
+  }
+  unsigned long int_view_us = micros() - t0;
+  quiet(false);
+  emit_result("list_split", "vector", channels.size(), iterations, vector_us, 0);
+  emit_result("list_split", "view", channel_list.size(), iterations, view_us, 0);
+  emit_result("list_split", "view_handle", channel_list.size(), iterations, view_handle_us, 0);
+  std::stringstream extra;
+  extra << ",\"checksum\":" << (total_length + pin_sum);
+  emit_result("list_split", "int_view", pins.size(), iterations, int_view_us, 0, extra.str().c_str());
+}
+
+/*!
+\brief Boot-time config access: parsing the text config against opening a compiled blob (ini_blob_reader).
+\details open is everything before the first read. On the host the blob is mmap()ed from a file; on the device it is
+opened from RAM, since the benchmark's partition table has no config partition, so only the checks and lookups
+are timed there; open_blob_verify_crc adds the CRC of the whole blob. heap_bytes is what the config keeps allocated after opening.
+*/
+static void bench_blob(unsigned long n_keys)
+{
+  const unsigned long parse_iterations = 10;
+  const unsigned long open_iterations = 200;
+  const unsigned long lookup_iterations = 20000;
+  beluga_utils::ini_load_stats stats = {0, 0};
+  std::vector<uint8_t> blob;
+  quiet(true);
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < parse_iterations; i++)
+  {
+    beluga_utils::ini_reader parsed(config_path(n_keys), beluga_utils::ini_storage_mode::arena);
+    parsed.initialise(false);
+    stats = parsed.get_load_stats();
+  }
+  unsigned long parse_us = micros() - t0;
+  beluga_utils::ini_reader ini(config_path(n_keys), beluga_utils::ini_storage_mode::arena);
+  ini.initialise(false);
+  ini.compile_blob(&blob);
+
+  beluga_utils::ini_blob_reader config;
+#if defined(BELUGA_NATIVE)
+  const char * blob_path = "data/bench_blob.bin";
+  FILE * blob_file = fopen(blob_path, "wb");
+  fwrite(blob.data(), 1, blob.size(), blob_file);
+  fclose(blob_file);
+#endif
+  bool verify_crc[2] = {false, true};
+  unsigned long open_us[2];
+  for(int v = 0; v < 2; v++)
+  {
+    t0 = micros();
+    for(unsigned long i = 0; i < open_iterations; i++)
+    {
+#if defined(BELUGA_NATIVE)
+      config.open_file(blob_path, verify_crc[v]);
+#else
+      config.open_memory(blob.data(), blob.size(), verify_crc[v]);
+#endif
+    }
+    open_us[v] = micros() - t0;
+  }
+
+  std::vector<std::string> sections;
+  std::vector<std::string> keys;
+  for(unsigned long i = 0; i < 256; i++)
+  {
+    unsigned long k = (i * 7919) % n_keys;
+    sections.push_back("device_" + std::to_string(k / 100));
+    keys.push_back("key_" + std::to_string(k % 100));
+  }
+  int32_t n = 0;
+  size_t checksum = 0;
+  t0 = micros();
+  for(unsigned long i = 0; i < lookup_iterations; i++)
+  {
+    ini.get_config_int(sections[i & 255], keys[i & 255], &n);
+    checksum += (size_t) n;
+  }
+  unsigned long text_lookup_us = micros() - t0;
+  t0 = micros();
+  for(unsigned long i = 0; i < lookup_iterations; i++)
+  {
+    config.get_config_int(sections[i & 255].c_str(), keys[i & 255].c_str(), &n);
+    checksum -= (size_t) n;
+  }
+  unsigned long blob_lookup_us = micros() - t0;
+  config.close();
+#if defined(BELUGA_NATIVE)
+  remove(blob_path);
+#endif
+  quiet(false);
+
+  char extra[96];
+  snprintf(extra, sizeof(extra), ",\"heap_bytes\":%lu", (unsigned long) stats.bytes_used);
+  emit_result("config_boot", "parse_text", n_keys, parse_iterations, parse_us, 0, extra);
+  snprintf(extra, sizeof(extra), ",\"heap_bytes\":0,\"blob_bytes\":%lu", (unsigned long) blob.size());
+  emit_result("config_boot", "open_blob", n_keys, open_iterations, open_us[0], 0, extra);
+  emit_result("config_boot", "open_blob_verify_crc", n_keys, open_iterations, open_us[1], 0, extra);
+  snprintf(extra, sizeof(extra), ",\"mismatch\":%lu", (unsigned long) checksum);
+  emit_result("lookup_typed_int_by_name", "text_arena", n_keys, lookup_iterations, text_lookup_us, 0);
+  emit_result("lookup_typed_int_by_name", "blob", n_keys, lookup_iterations, blob_lookup_us, 0, extra);
+}
+
+struct bench_device_config
+{
+  int32_t key_0;
+  int32_t key_1;
+  int32_t key_2;
+  int32_t key_3;
+  float key_4;
+  uint32_t key_5;
+  int32_t key_6;
+};
+
+static constexpr auto bench_device_schema = beluga_utils::make_ini_schema<bench_device_config>("device_0",
+  beluga_utils::ini_int_field(&bench_device_config::key_0, "key_0", 0, beluga_utils::ini_presence::required),
+  beluga_utils::ini_int_field(&bench_device_config::key_1, "key_1"),
+  beluga_utils::ini_int_field(&bench_device_config::key_2, "key_2"),
+  beluga_utils::ini_int_field(&bench_device_config::key_3, "key_3"),
+  beluga_utils::ini_float_field(&bench_device_config::key_4, "key_4"),
+  beluga_utils::ini_duration_field(&bench_device_config::key_5, "key_5"),
+  beluga_utils::ini_int_field(&bench_device_config::key_6, "key_6"));
+
+/*!
+\brief Binding a 7-field section with ini_schema, then reading a field from the struct against reading it by name.
+\details The other 93 keys of [device_0] are not in the schema, so bind also logs (quietly) 93 unknown keys.
+*/
+static void bench_schema(unsigned long n_keys)
+{
+  const unsigned long bind_iterations = 1000;
+  const unsigned long read_iterations = 20000;
+  beluga_utils::ini_reader ini(config_path(n_keys), beluga_utils::ini_storage_mode::arena);
+  quiet(true);
+  ini.initialise(false);
+  bench_device_config config;
+  beluga_utils::ini_schema_result result = {0, 0, 0, 0, 0};
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < bind_iterations; i++)
+  {
+    result = bench_device_schema.bind(ini, &config);
+  }
+  unsigned long bind_us = micros() - t0;
+
+  volatile int32_t sink = 0;
+  int32_t n = 0;
+  t0 = micros();
+  for(unsigned long i = 0; i < read_iterations; i++)
+  {
+    ini.get_config_int("device_0", "key_3", &n);
+    sink = sink + n;
+  }
+  unsigned long by_name_us = micros() - t0;
+  t0 = micros();
+  for(unsigned long i = 0; i < read_iterations; i++)
+  {
+    sink = sink + config.key_3;
+  }
+  unsigned long struct_us = micros() - t0;
+  quiet(false);
+  char extra[96];
+  snprintf(extra, sizeof(extra), ",\"fields\":%lu,\"ok\":%s,\"unknown_keys\":%lu", (unsigned long) result.fields,
+    result.ok() ? "true" : "false", (unsigned long) result.unknown_keys);
+  emit_result("schema", "bind", n_keys, bind_iterations, bind_us, 0, extra);
+  emit_result("schema", "read_by_name", n_keys, read_iterations, by_name_us, 0);
+  emit_result("schema", "read_struct", n_keys, read_iterations, struct_us, 0);
+}
+
+static void bench_log()
+{
+  const unsigned long iterations = 2000;
+  const std::string message("beluga benchmark log line: sensor=42 state=RUNNING dt_ms=1000 ok");
+  quiet(true);
+  beluga_utils::set_debug_print_enable(true);
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    beluga_utils::debug_print(message);
+  }
+  Serial.flush();
+  unsigned long enabled_us = micros() - t0;
+
+  beluga_utils::set_debug_print_enable(false);
+  t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    beluga_utils::debug_print(message);
+  }
+  unsigned long disabled_us = micros() - t0;
+
+  //Async: time spent in the caller only; the ring is large enough that nothing is dropped
+  beluga_utils::set_debug_print_enable(true);
+  beluga_utils::debug_print_async_begin(iterations, beluga_utils::debug_print_full_policy::drop);
+  t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    beluga_utils::debug_print(message);
+  }
+  unsigned long async_us = micros() - t0;
+  beluga_utils::debug_print_flush();
+  unsigned long dropped = beluga_utils::debug_print_dropped_count();
+  beluga_utils::debug_print_async_end();
+  quiet(false);
+  char extra[32];
+  snprintf(extra, sizeof(extra), ",\"dropped\":%lu", dropped);
+  emit_result("log", "debug_print", message.size(), iterations, enabled_us, message.size() + 2);
+  emit_result("log", "debug_print_disabled", message.size(), iterations, disabled_us, 0);
+  emit_result("log", "debug_print_async", message.size(), iterations, async_us, message.size() + 2, extra);
+}
+
+static void write_file(const char * path, const std::string & contents)
+{
+  File f = SPIFFS.open(path, FILE_WRITE);
+  f.write((const uint8_t *) contents.data(), contents.size());
+  f.close();
+}
+
+/*!
+\brief Cost of reload() when one value in an n_keys file changes. Compare with the parse result for the same size.
+\details The value alternates between two values, in the last section. Only reload() is timed.
+*/
+static void bench_reload(unsigned long n_keys, beluga_utils::ini_storage_mode mode)
+{
+  const unsigned long iterations = 20;
+  const char * path = "/bench_reload.ini";
+  std::string base;
+  File f = SPIFFS.open(config_path(n_keys).c_str(), "r");
+  base.resize(f.size());
+  f.read((uint8_t *) &base[0], base.size());
+  f.close();
+  write_file(path, base + "[reload]\nvalue = 1\n");
+  beluga_utils::ini_reader ini(path, mode);
+  quiet(true);
+  ini.initialise(false);
+  std::string v;
+  ini.get_config_value("reload", "value", &v, false); //Loads the section in lazy mode, so it is diffed
+  unsigned long elapsed_us = 0;
+  beluga_utils::ini_reload_stats stats = {false, 0, 0, 0, 0};
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    write_file(path, base + ((i % 2 == 0) ? "[reload]\nvalue = 22\n" : "[reload]\nvalue = 1\n"));
+    unsigned long t0 = micros();
+    ini.reload(&stats);
+    elapsed_us += micros() - t0;
+  }
+  quiet(false);
+  SPIFFS.remove(path);
+  char extra[96];
+  snprintf(extra, sizeof(extra), ",\"sections_changed\":%lu,\"entries_modified\":%lu", (unsigned long) stats.sections_changed, (unsigned long) stats.entries_modified);
+  emit_result("reload", mode_name(mode), n_keys, iterations, elapsed_us, base.size(), extra);
+}
+
+/*!
+\brief A fleet of n_devices that share 40 settings and each set 2 of their own: every key copied into every
+device section, against [device_i : fleet_base] sections holding only the 2 overrides.
+\details Reports parse time and load_bytes for both layouts, then the cost of a by-name read of an own key and
+of an inherited one (one extra probe, in [fleet_base]).
+*/
+static void bench_inheritance(unsigned long n_devices)
+{
+  const unsigned long n_shared = 40;
+  const unsigned long parse_iterations = 20;
+  const unsigned long read_iterations = 20000;
+  const char * paths[] = {"/bench_fleet_copied.ini", "/bench_fleet_inherited.ini"};
+  const char * layouts[] = {"copied", "inherited"};
+  std::stringstream shared;
+  for(unsigned long k = 0; k < n_shared; k++)
+  {
+    shared << "setting_" << k << " = " << (1000 + k) << "\n";
+  }
+  std::stringstream copied;
+  std::stringstream inherited;
+  inherited << "[fleet_base]\n" << shared.str();
+  for(unsigned long i = 0; i < n_devices; i++)
+  {
+    copied << "[device_" << i << "]\nid = " << i << "\npin = " << (i % 40) << "\n" << shared.str();
+    inherited << "[device_" << i << " : fleet_base]\nid = " << i << "\npin = " << (i % 40) << "\n";
+  }
+  write_file(paths[0], copied.str());
+  write_file(paths[1], inherited.str());
+
+  const beluga_utils::ini_storage_mode modes[] = {beluga_utils::ini_storage_mode::nested_map, beluga_utils::ini_storage_mode::arena};
+  for(beluga_utils::ini_storage_mode mode : modes)
+  {
+    for(int layout = 0; layout < 2; layout++)
+    {
+      beluga_utils::ini_load_stats stats = {0, 0};
+      quiet(true);
+      unsigned long t0 = micros();
+      for(unsigned long i = 0; i < parse_iterations; i++)
+      {
+        beluga_utils::ini_reader ini(paths[layout], mode);
+        ini.initialise(false);
+        stats = ini.get_load_stats();
+      }
+      unsigned long elapsed_us = micros() - t0;
+      quiet(false);
+      char variant[48];
+      snprintf(variant, sizeof(variant), "%s_%s", layouts[layout], mode_name(mode));
+      char extra[96];
+      snprintf(extra, sizeof(extra), ",\"load_bytes\":%lu,\"load_allocations\":%lu", (unsigned long) stats.bytes_used, (unsigned long) stats.allocation_count);
+      emit_result("inheritance", variant, n_devices, parse_iterations, elapsed_us, 0, extra);
+    }
+  }
+
+  beluga_utils::ini_reader ini(paths[1], beluga_utils::ini_storage_mode::arena);
+  quiet(true);
+  ini.initialise(false);
+  volatile int32_t sink = 0;
+  int32_t n = 0;
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < read_iterations; i++)
+  {
+    ini.get_config_int("device_7", "pin", &n);
+    sink = sink + n;
+  }
+  unsigned long own_us = micros() - t0;
+  t0 = micros();
+  for(unsigned long i = 0; i < read_iterations; i++)
+  {
+    ini.get_config_int("device_7", "setting_12", &n);
+    sink = sink + n;
+  }
+  unsigned long inherited_us = micros() - t0;
+  quiet(false);
+  emit_result("inheritance", "lookup_own", n_devices, read_iterations, own_us, 0);
+  emit_result("inheritance", "lookup_inherited", n_devices, read_iterations, inherited_us, 0);
+  SPIFFS.remove(paths[0]);
+  SPIFFS.remove(paths[1]);
+}
+
+/*!
+\brief Persisting one value tuned at runtime in an n_keys file: a journal commit (only the changed key is written)
+against rewriting the file (ini_commit_mode::rewrite), then compacting the journal those commits left.
+\details Reports time and bytes written per commit. set_config_value (re-hashing the index) is timed on its own.
+*/
+static void bench_writeback(unsigned long n_keys)
+{
+  const unsigned long iterations = 20;
+  const char * path = "/bench_writeback.ini";
+  std::string base;
+  File f = SPIFFS.open(config_path(n_keys).c_str(), "r");
+  base.resize(f.size());
+  f.read((uint8_t *) &base[0], base.size());
+  f.close();
+  write_file(path, base);
+  SPIFFS.remove("/bench_writeback.ini.jnl");
+  beluga_utils::ini_reader ini(path, beluga_utils::ini_storage_mode::arena);
+  quiet(true);
+  ini.initialise(false);
+  beluga_utils::ini_commit_stats stats = {0, 0, 0, 0, false};
+  unsigned long set_us = 0;
+  unsigned long journal_us = 0;
+  unsigned long journal_bytes = 0;
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    unsigned long t0 = micros();
+    ini.set_config_value("device_7", "key_42", std::to_string(i));
+    set_us += micros() - t0;
+    t0 = micros();
+    ini.commit(&stats);
+    journal_us += micros() - t0;
+    journal_bytes += stats.bytes_written;
+  }
+  unsigned long t0 = micros();
+  ini.compact(&stats);
+  unsigned long compact_us = micros() - t0;
+  beluga_utils::ini_commit_stats compact_stats = stats;
+  ini.set_commit_mode(beluga_utils::ini_commit_mode::rewrite);
+  unsigned long rewrite_us = 0;
+  unsigned long rewrite_bytes = 0;
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    ini.set_config_value("device_7", "key_42", std::to_string(i));
+    t0 = micros();
+    ini.commit(&stats);
+    rewrite_us += micros() - t0;
+    rewrite_bytes += stats.bytes_written;
+  }
+  quiet(false);
+  SPIFFS.remove(path);
+  char extra[64];
+  emit_result("writeback", "set_value", n_keys, iterations, set_us, 0);
+  snprintf(extra, sizeof(extra), ",\"bytes_written\":%lu", journal_bytes / iterations);
+  emit_result("writeback", "journal_commit", n_keys, iterations, journal_us, 0, extra);
+  snprintf(extra, sizeof(extra), ",\"bytes_written\":%lu", rewrite_bytes / iterations);
+  emit_result("writeback", "rewrite_commit", n_keys, iterations, rewrite_us, 0, extra);
+  snprintf(extra, sizeof(extra), ",\"bytes_written\":%lu", (unsigned long) compact_stats.bytes_written);
+  emit_result("writeback", "compact", n_keys, 1, compact_us, 0, extra);
+}
+
+/*!
+\brief Cost of one guarded snapshot read (claim a slot, look up a key, release).
+*/
+static void bench_snapshot_read(unsigned long n_keys)
+{
+  const unsigned long iterations = 20000;
+  beluga_utils::ini_snapshot_publisher publisher;
+  beluga_utils::ini_reader ini(config_path(n_keys), beluga_utils::ini_storage_mode::arena);
+  quiet(true);
+  ini.initialise(false);
+  ini.set_snapshot_publisher(&publisher);
+  quiet(false);
+  unsigned long found = 0;
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    beluga_utils::ini_snapshot_guard config(publisher);
+    beluga_utils::ini_view v;
+    found += config->get_config_value("device_7", "key_42", &v) ? 1 : 0;
+  }
+  unsigned long elapsed_us = micros() - t0;
+  char extra[32];
+  snprintf(extra, sizeof(extra), ",\"found\":%lu", found);
+  emit_result("snapshot", "guarded_read", n_keys, iterations, elapsed_us, 0, extra);
+}
+
+#if defined(BELUGA_NATIVE)
+/*!
+\brief Readers on several threads while a writer reloads the config and publishes new snapshots.
+\details Each version of the file has a = b, so a reader seeing a != b has read a torn config. Build with
+env:native_tsan to have ThreadSanitizer check the publish/read/reclaim protocol as well.
+*/
+static void bench_snapshot_stress()
+{
+  const unsigned long n_readers = 8;
+  const unsigned long n_publishes = 200;
+  const char * path = "/bench_snapshot.ini";
+  beluga_utils::ini_snapshot_publisher publisher;
+  beluga_utils::ini_reader ini(path);
+  std::atomic<bool> done(false);
+  std::atomic<unsigned long> n_reads(0);
+  std::atomic<unsigned long> n_torn(0);
+  quiet(true);
+  std::stringstream ss;
+  ss << "[snapshot]\na = 0\nb = 0\n";
+  File f = SPIFFS.open(path, FILE_WRITE);
+  f.write((const uint8_t *) ss.str().data(), ss.str().size());
+  f.close();
+  ini.initialise(false);
+  ini.set_snapshot_publisher(&publisher);
+  std::vector<std::thread> readers;
+  for(unsigned long r = 0; r < n_readers; r++)
+  {
+    readers.push_back(std::thread([&]() {
+      unsigned long reads = 0;
+      while(!done.load(std::memory_order_relaxed))
+      {
+        beluga_utils::ini_snapshot_guard config(publisher);
+        int32_t a = -1;
+        int32_t b = -2;
+        config->get_config_int("snapshot", "a", &a);
+        config->get_config_int("snapshot", "b", &b);
+        if(a != b)
+        {
+          n_torn.fetch_add(1, std::memory_order_relaxed);
+        }
+        reads++;
+      }
+      n_reads.fetch_add(reads, std::memory_order_relaxed);
+    }));
+  }
+  unsigned long t0 = micros();
+  for(unsigned long i = 1; i <= n_publishes; i++)
+  {
+    std::stringstream contents;
+    contents << "[snapshot]\na = " << i << "\nb = " << i << "\n";
+    f = SPIFFS.open(path, FILE_WRITE);
+    f.write((const uint8_t *) contents.str().data(), contents.str().size());
+    f.close();
+    ini.reload();
+  }
+  done.store(true);
+  for(size_t r = 0; r < readers.size(); r++)
+  {
+    readers[r].join();
+  }
+  unsigned long elapsed_us = micros() - t0;
+  publisher.reclaim();
+  quiet(false);
+  SPIFFS.remove(path);
+  char extra[128];
+  snprintf(extra, sizeof(extra), ",\"readers\":%lu,\"reads\":%lu,\"torn\":%lu,\"version\":%lu,\"retired\":%lu", n_readers,
+    n_reads.load(), n_torn.load(), (unsigned long) publisher.current_version(), (unsigned long) publisher.retired_count());
+  emit_result("snapshot", "publish_under_readers", n_readers, n_publishes, elapsed_us, 0, extra);
+}
+#endif
+
+/*!
+\brief Mount time, open latency and sequential read throughput of one storage backend.
+\details A 64 KiB file is written through the backend, opened and closed 50 times, then read end to end in 4 KiB
+blocks 5 times. mount_us is an unmount/mount cycle. Prints "mounted":false if the backend cannot mount (no SD card).
+*/
+static void bench_storage(beluga_utils::storage_backend & backend)
+{
+  const char * path = "/bench_storage.bin";
+  const size_t file_size = 64 * 1024;
+  const unsigned long n_opens = 50;
+  const unsigned long n_reads = 5;
+  backend.end();
+  unsigned long t0 = micros();
+  bool mounted = backend.begin();
+  unsigned long mount_us = micros() - t0;
+  if(!mounted)
+  {
+    Serial.printf("{\"bench\":\"storage\",\"variant\":\"%s\",\"mounted\":false}\n", backend.name());
+    return;
+  }
+  std::vector<uint8_t> block(4096);
+  for(size_t i = 0; i < block.size(); i++)
+  {
+    block[i] = (uint8_t) ('a' + i % 26);
+  }
+  File f = backend.open(path, FILE_WRITE);
+  for(size_t n = 0; n < file_size; n += block.size())
+  {
+    f.write(block.data(), block.size());
+  }
+  f.close();
+
+  t0 = micros();
+  for(unsigned long i = 0; i < n_opens; i++)
+  {
+    f = backend.open(path, FILE_READ);
+    f.close();
+  }
+  unsigned long open_us = (micros() - t0) / n_opens;
+
+  size_t n_bytes = 0;
+  t0 = micros();
+  for(unsigned long i = 0; i < n_reads; i++)
+  {
+    f = backend.open(path, FILE_READ);
+    size_t n;
+    while((n = f.read(block.data(), block.size())) > 0)
+    {
+      n_bytes += n;
+    }
+    f.close();
+  }
+  unsigned long elapsed_us = micros() - t0;
+  backend.filesystem().remove(path);
+  char extra[96];
+  snprintf(extra, sizeof(extra), ",\"mounted\":true,\"mount_us\":%lu,\"open_us\":%lu,\"bytes_read\":%lu", mount_us, open_us, (unsigned long) n_bytes);
+  emit_result("storage", backend.name(), file_size, n_reads, elapsed_us, file_size, extra);
+}
+
+/*!
+\brief Run bench_storage over every backend.
+\details On the device LittleFS formats the data partition that SPIFFS was using, so it runs last among the flash
+backends (the next boot's SPIFFS.begin(true) formats it back). POSIX reads the SPIFFS mount point directly.
+On the host all four read the same directory, so the differences are the wrappers' overhead only.
+*/
+static void bench_storage_backends()
+{
+  beluga_utils::spiffs_backend spiffs(true);
+#if defined(BELUGA_NATIVE)
+  beluga_utils::posix_backend posix("data");
+#else
+  beluga_utils::posix_backend posix("/spiffs");
+#endif
+  beluga_utils::littlefs_backend littlefs(true);
+  beluga_utils::sd_mmc_backend sd_card;
+  bench_storage(spiffs);
+  bench_storage(posix);
+  spiffs.end();
+  bench_storage(littlefs);
+  littlefs.end();
+  bench_storage(sd_card);
+  sd_card.end();
+}
+
+/*!
+\brief Saving 200 camera-sized frames (40 KB) to the SD card: one file per frame with a single write each (the old
+save_esp32_cam_image_to_microsd) against one preallocated microsd_writer stream.
+\details us_per_op is per frame; max_write_us is the worst single write/close stall a capture loop would see.
+*/
+static void bench_microsd()
+{
+  const unsigned long n_frames = 200;
+  const size_t frame_size = 40000;
+  beluga_utils::sd_mmc_backend sd_card;
+  if(!sd_card.begin())
+  {
+    Serial.println("{\"bench\":\"microsd\",\"variant\":\"writer\",\"mounted\":false}");
+    return;
+  }
+  std::vector<uint8_t> frame(frame_size);
+  for(size_t i = 0; i < frame.size(); i++)
+  {
+    frame[i] = (uint8_t) (i * 31);
+  }
+  unsigned long max_write_us = 0;
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < n_frames; i++)
+  {
+    char path[32];
+    snprintf(path, sizeof(path), "/bench_frame_%03lu.jpg", i);
+    unsigned long t1 = micros();
+    File f = sd_card.open(path, FILE_WRITE);
+    f.write(frame.data(), frame.size());
+    f.close();
+    unsigned long dt = micros() - t1;
+    max_write_us = (dt > max_write_us) ? dt : max_write_us;
+  }
+  unsigned long elapsed_us = micros() - t0;
+  for(unsigned long i = 0; i < n_frames; i++)
+  {
+    char path[32];
+    snprintf(path, sizeof(path), "/bench_frame_%03lu.jpg", i);
+    sd_card.filesystem().remove(path);
+  }
+  char extra[96];
+  snprintf(extra, sizeof(extra), ",\"max_write_us\":%lu", max_write_us);
+  emit_result("microsd", "file_per_frame", frame_size, n_frames, elapsed_us, frame_size, extra);
+
+  beluga_utils::microsd_writer writer;
+  quiet(true);
+  t0 = micros();
+  bool ok = writer.begin(sd_card, "/bench_frames.bin", n_frames * (frame_size + 16) + 16);
+  for(unsigned long i = 0; ok && i < n_frames; i++)
+  {
+    ok = writer.write_record(frame.data(), frame.size(), millis());
+  }
+  ok = writer.close() && ok;
+  elapsed_us = micros() - t0;
+  quiet(false);
+  sd_card.filesystem().remove("/bench_frames.bin");
+  const beluga_utils::microsd_write_stats & stats = writer.get_stats();
+  snprintf(extra, sizeof(extra), ",\"ok\":%s,\"max_write_us\":%lu,\"p99_write_us\":%lu,\"chunk_writes\":%lu", ok ? "true" : "false",
+    (unsigned long) stats.write_latency.max(), (unsigned long) stats.write_latency.percentile(0.99f), (unsigned long) stats.chunk_writes);
+  emit_result("microsd", "writer", frame_size, n_frames, elapsed_us, frame_size, extra);
+}
+
+/*!
+\brief Stand-in for per-frame processing (e.g. an overlay or re-encode) that takes 12 ms.
+*/
+static bool slow_process(void * context, beluga_utils::frame_buffer * frame)
+{
+  delay(12);
+  return true;
+}
+
+/*!
+\brief One second of synthetic 40 KB frames at 100 fps with 12 ms of processing each, saved to the SD card.
+\details serial captures, processes and writes in turn on one task (the old save_esp32_cam_image_to_microsd
+loop). The pipeline variants run the stages as separate tasks: block throttles capture to the slowest stage,
+drop_oldest keeps capturing and drops the stalest queued frames.
+*/
+static void bench_pipeline_variant(beluga_utils::storage_backend & sd_card, const char * variant, bool use_pipeline, beluga_utils::pipeline_full_policy policy)
+{
+  const size_t frame_size = 40000;
+  const unsigned long run_ms = 1000;
+  beluga_utils::synthetic_frame_source source(frame_size, 100.0f);
+  beluga_utils::microsd_writer writer;
+  quiet(true);
+  writer.begin(sd_card, "/bench_pipeline.bin", 200UL * (frame_size + 16));
+  unsigned long frames = 0;
+  unsigned long dropped = 0;
+  unsigned long p99_us = 0;
+  unsigned long t0 = micros();
+  if(use_pipeline)
+  {
+    beluga_utils::capture_pipeline pipeline;
+    beluga_utils::capture_pipeline_config config;
+    config.frame_bytes = frame_size;
+    config.policy = policy;
+    pipeline.begin(config, source, writer, slow_process);
+    delay(run_ms);
+    pipeline.end();
+    const beluga_utils::capture_pipeline_stats & stats = pipeline.get_stats();
+    frames = stats.storage.frames;
+    dropped = stats.capture.dropped + stats.storage.dropped;
+    p99_us = stats.end_to_end.percentile(0.99f);
+  }else{
+    std::vector<uint8_t> memory(frame_size);
+    beluga_utils::frame_buffer frame = {memory.data(), memory.size(), 0, 0, 0, 0};
+    beluga_utils::latency_histogram latency;
+    while(micros() - t0 < run_ms * 1000)
+    {
+      source.capture(&frame);
+      uint64_t capture_us = beluga_utils::monotonic_time_us();
+      slow_process(nullptr, &frame);
+      writer.write_record(frame.data, frame.length, frame.timestamp_ms);
+      latency.record(beluga_utils::monotonic_time_us() - capture_us);
+      frames++;
+    }
+    p99_us = latency.percentile(0.99f);
+  }
+  unsigned long elapsed_us = micros() - t0;
+  writer.close();
+  quiet(false);
+  sd_card.filesystem().remove("/bench_pipeline.bin");
+  char extra[128];
+  snprintf(extra, sizeof(extra), ",\"fps\":%.1f,\"dropped\":%lu,\"p99_latency_us\":%lu", elapsed_us ? frames * 1e6 / elapsed_us : 0.0, dropped, p99_us);
+  emit_result("pipeline", variant, frame_size, frames ? frames : 1, elapsed_us, frame_size, extra);
+}
+
+static void bench_pipeline()
+{
+  beluga_utils::sd_mmc_backend sd_card;
+  if(!sd_card.begin())
+  {
+    Serial.println("{\"bench\":\"pipeline\",\"variant\":\"serial\",\"mounted\":false}");
+    return;
+  }
+  bench_pipeline_variant(sd_card, "serial", false, beluga_utils::pipeline_full_policy::block);
+  bench_pipeline_variant(sd_card, "block", true, beluga_utils::pipeline_full_policy::block);
+  bench_pipeline_variant(sd_card, "drop_oldest", true, beluga_utils::pipeline_full_policy::drop_oldest);
+}
+
+/*!
+\brief 20000 log lines (~60 bytes) to the SD card: appended and flushed one by one, against log_file_sink.
+\details sectors_written is the flash-wear figure: a flushed append reprograms every sector it touches, so
+per-message flushes rewrite the same partly filled sector again and again. us_per_op is per line, as seen by the
+logging task (for the sink: the copy into RAM, with the commit task writing in the background).
+*/
+static void bench_log_file()
+{
+  const unsigned long n_lines = 20000;
+  beluga_utils::sd_mmc_backend sd_card;
+  if(!sd_card.begin())
+  {
+    Serial.println("{\"bench\":\"log_file\",\"variant\":\"sink\",\"mounted\":false}");
+    return;
+  }
+  char line[96];
+  size_t payload_bytes = 0;
+  unsigned long sectors_written = 0;
+  File f = sd_card.open("/bench_log.txt", FILE_WRITE);
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < n_lines; i++)
+  {
+    int n = snprintf(line, sizeof(line), "[I] sensor %lu: temperature 21.5 C, humidity 40 %%, ok\n", i);
+    size_t offset = payload_bytes;
+    f.write((const uint8_t *) line, n);
+    f.flush();
+    payload_bytes += n;
+    sectors_written += (payload_bytes - 1) / 512 - offset / 512 + 1;
+  }
+  unsigned long elapsed_us = micros() - t0;
+  f.close();
+  sd_card.filesystem().remove("/bench_log.txt");
+  char extra[160];
+  snprintf(extra, sizeof(extra), ",\"sectors_written\":%lu,\"write_amplification\":%.2f", sectors_written, (double) sectors_written * 512.0 / (double) payload_bytes);
+  emit_result("log_file", "flush_per_line", payload_bytes / n_lines, n_lines, elapsed_us, payload_bytes / n_lines, extra);
+
+  beluga_utils::log_file_sink sink;
+  beluga_utils::log_file_config config;
+  config.segment_bytes = 256 * 1024;
+  config.n_segments = 8;
+  config.block_when_full = true; //A burst this fast would otherwise outrun the commit task
+  quiet(true);
+  bool ok = sink.begin(sd_card, "/bench_log", config);
+  quiet(false);
+  t0 = micros();
+  for(unsigned long i = 0; ok && i < n_lines; i++)
+  {
+    int n = snprintf(line, sizeof(line), "[I] sensor %lu: temperature 21.5 C, humidity 40 %%, ok", i);
+    sink.append((const uint8_t *) line, n);
+  }
+  elapsed_us = micros() - t0;
+  unsigned long t1 = micros();
+  sink.commit();
+  unsigned long commit_us = micros() - t1;
+  sink.end();
+  beluga_utils::log_file_stats stats = sink.get_stats();
+  uint32_t last_sequence = 0;
+  size_t n_found = beluga_utils::log_file_scan(sd_card, "/bench_log", config.n_segments, nullptr, nullptr, &last_sequence);
+  for(size_t i = 0; i < config.n_segments; i++)
+  {
+    char path[32];
+    snprintf(path, sizeof(path), "/bench_log_%03u.log", (unsigned) i);
+    sd_card.filesystem().remove(path);
+  }
+  snprintf(extra, sizeof(extra), ",\"sectors_written\":%llu,\"write_amplification\":%.2f,\"commits\":%lu,\"dropped\":%lu,\"final_commit_us\":%lu,\"scanned\":%lu",
+    (unsigned long long) stats.sectors_written, stats.write_amplification(), (unsigned long) stats.commits, (unsigned long) stats.dropped, commit_us, (unsigned long) n_found);
+  emit_result("log_file", "sink", stats.payload_bytes / n_lines, n_lines, elapsed_us, stats.payload_bytes / n_lines, extra);
+}
+
+static void noop_task(void * context)
+{
+}
+
+/*!
+\brief Cost of filing and cancelling timers in a scheduler that already holds 500 of them.
+*/
+static void bench_scheduler()
+{
+  const unsigned long n_timers = 500;
+  const unsigned long iterations = 20000;
+  beluga_utils::scheduler sched(n_timers + 1);
+  for(unsigned long i = 0; i < n_timers; i++)
+  {
+    sched.add_periodic("bench", 1 + (i * 7919) % 600000, noop_task);
+  }
+  unsigned long t0 = micros();
+  for(unsigned long i = 0; i < iterations; i++)
+  {
+    int id = sched.add_one_shot("bench", 1 + (i * 104729) % 3600000, noop_task);
+    sched.cancel(id);
+  }
+  unsigned long elapsed_us = micros() - t0;
+  emit_result("scheduler", "add_cancel", n_timers, iterations, elapsed_us, 0);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  SPIFFS.begin(true);
+  const unsigned long sizes[] = {1, 100, 10000};
+  const beluga_utils::ini_storage_mode modes[] = {
+    beluga_utils::ini_storage_mode::nested_map,
+    beluga_utils::ini_storage_mode::arena,
+    beluga_utils::ini_storage_mode::lazy
+  };
+  for(unsigned long n_keys : sizes)
+  {
+    size_t file_size = generate_config(n_keys);
+    for(beluga_utils::ini_storage_mode mode : modes)
+    {
+      bench_parse(n_keys, file_size, mode);
+    }
+  }
+  for(beluga_utils::ini_storage_mode mode : modes)
+  {
+    bench_lookup(10000, mode);
+  }
+  for(beluga_utils::ini_storage_mode mode : modes)
+  {
+    bench_reload(10000, mode);
+  }
+  bench_snapshot_read(10000);
+#if defined(BELUGA_NATIVE)
+  bench_snapshot_stress();
+#endif
+  bench_list_split(100);
+  bench_blob(10000);
+  bench_schema(100);
+  bench_inheritance(100);
+  bench_writeback(10000);
+  bench_log();
+  bench_scheduler();
+  bench_storage_backends();
+  bench_microsd();
+  bench_pipeline();
+  bench_log_file();
+#if defined(BELUGA_HEAP_STATS)
+  beluga_utils::print_heap_stats_to_serial();
+#endif
+  Serial.println("{\"bench\":\"done\"}");
+}
+
+void loop()
+{
+#if defined(BELUGA_NATIVE)
+  exit(0);
+#else
+  delay(1000);
+#endif
+}
+
+#if defined(BELUGA_NATIVE)
+int main()
+{
+  setup();
+  while(true)
+  {
+    loop();
+  }
+}
+#endif
@@ -0,0 +1,80 @@
+#include <Arduino.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "beluga_debug.h"
+#include "beluga_ini_reader.h"
+#include "beluga_ini_blob.h"
+#include "beluga_storage_backend.h"
+
+/*
+ini_compile: parse a .ini config with ini_reader (the same grammar the device uses) and write it out as a
+binary blob for ini_blob_reader, with the hash table built, lists split and values converted.
+Usage: ini_compile config.ini [config.bin]
+The output defaults to the input path with .ini replaced by .bin. Exits non-zero on any error.
+*/
+
+static std::string default_output_path(const std::string & input_path)
+{
+  size_t dot = input_path.rfind('.');
+  size_t slash = input_path.rfind('/');
+  if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+  {
+    return input_path + ".bin";
+  }
+  return input_path.substr(0, dot) + ".bin";
+}
+
+int main(int argc, char ** argv)
+{
+  if(argc < 2 || argc > 3)
+  {
+    fprintf(stderr, "Usage: %s config.ini [config.bin]\n", argv[0]);
+    return 2;
+  }
+  std::string input_path(argv[1]);
+  std::string output_path = (argc == 3) ? std::string(argv[2]) : default_output_path(input_path);
+
+  //ini_reader reads through a storage backend: make one rooted at the input's directory
+  size_t slash = input_path.rfind('/');
+  std::string directory = (slash == std::string::npos) ? std::string(".") : input_path.substr(0, slash);
+  std::string file_name = (slash == std::string::npos) ? input_path : input_path.substr(slash + 1);
+  if(directory.empty())
+  {
+    directory = "/";
+  }
+  beluga_utils::posix_backend input_directory(directory.c_str());
+  beluga_utils::ini_reader ini("/" + file_name, beluga_utils::ini_storage_mode::arena);
+  ini.set_storage_backend(&input_directory);
+  beluga_utils::set_debug_print_enable(false);
+  bool ini_ok = ini.initialise(false);
+  beluga_utils::set_debug_print_enable(true);
+  if(!ini_ok)
+  {
+    fprintf(stderr, "ini_compile: could not read %s\n", input_path.c_str());
+    return 1;
+  }
+
+  std::vector<uint8_t> blob;
+  if(!ini.compile_blob(&blob))
+  {
+    fprintf(stderr, "ini_compile: could not compile %s\n", input_path.c_str());
+    return 1;
+  }
+  FILE * output = fopen(output_path.c_str(), "wb");
+  if(output == nullptr || fwrite(blob.data(), 1, blob.size(), output) != blob.size() || fclose(output) != 0)
+  {
+    fprintf(stderr, "ini_compile: could not write %s\n", output_path.c_str());
+    return 1;
+  }
+
+  //Read it back the way the device will, checking every byte once
+  beluga_utils::ini_blob_reader check;
+  if(!check.open_file(output_path.c_str(), true))
+  {
+    fprintf(stderr, "ini_compile: %s does not read back\n", output_path.c_str());
+    return 1;
+  }
+  printf("%s: %lu keys -> %s, %lu bytes\n", input_path.c_str(), (unsigned long) check.size(), output_path.c_str(), (unsigned long) check.blob_bytes());
+  return 0;
+}
@@ -9,11 +9,35 @@ std::string config_file_path = "/test.ini";
 std::stringstream ss;
 #include "beluga_debug.h"
 #include "beluga_ini_reader.h"
+#include "beluga_ini_schema.h"
+#include "beluga_scheduler.h"
 
 beluga_utils::ini_reader this_ini(config_file_path);
+beluga_utils::scheduler this_scheduler;
+
+//[demo_device] as a struct, filled once in setup()
+struct demo_device_config
+{
+  bool placeholder;
+  int32_t another_placeholder;
+};
+
+static constexpr auto demo_device_schema = beluga_utils::make_ini_schema<demo_device_config>("demo_device",
+  beluga_utils::ini_bool_field(&demo_device_config::placeholder, "placeholder", false, beluga_utils::ini_presence::required),
+  beluga_utils::ini_int_field(&demo_device_config::another_placeholder, "another_placeholder", 1));
+
+demo_device_config demo_config;
 
 int iter = 0;
 
+void print_iteration(void * context)
+{
+  ss.str("");
+  ss << "Iteration " << iter << " time " << (int) (millis() / 1000) << "s";
+  beluga_utils::debug_print(ss.str().c_str());
+  iter++;
+}
+
 void setup() {
   Serial.begin(115200);
   for(int i = 0; i < 5; i++)
@@ -37,17 +61,21 @@ void setup() {
     beluga_utils::debug_print(ss.str());
   }
 
+  //a_list is not in the schema, so bind() logs it as an unknown key
+  if(!demo_device_schema.bind(this_ini, &demo_config).ok())
+  {
+    beluga_utils::debug_print("demo_device config is invalid");
+  }
+
   this_ini.clear();
 
+  this_scheduler.add_periodic("print_iteration", 1000, print_iteration);
 
 }
 
 void loop() {
   //bool b = this_device.run();
   //assert(b == false);
-  ss.str("");
-  ss << "Iteration " << iter << " time " << (int) (millis() / 1000) << "s";
-  beluga_utils::debug_print(ss.str().c_str());
-  iter++;
-  delay(1000);
+  //Runs whatever is due, then sleeps until the next deadline
+  this_scheduler.run_once();
 }
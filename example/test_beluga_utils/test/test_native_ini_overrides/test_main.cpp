@@ -0,0 +1,85 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include "beluga_ini_reader.h"
+
+//Host tests for values set at runtime: pio test -e native -f test_native_ini_overrides
+
+static const char * config_path = "/test_overrides.ini";
+static beluga_utils::posix_backend * backend = nullptr;
+
+static void write_config(const char * text)
+{
+    File file = backend->open(config_path, "w");
+    TEST_ASSERT_TRUE((bool) file);
+    file.write((const uint8_t *) text, strlen(text));
+    file.close();
+}
+
+void setUp(void)
+{
+    write_config("[s]\nk = 1\nother = 2\n");
+}
+
+void tearDown(void)
+{
+    backend->filesystem().remove(config_path);
+    backend->filesystem().remove((std::string(config_path) + ".jnl").c_str());
+}
+
+static std::string read_handle(beluga_utils::ini_reader & ini, beluga_utils::ini_handle handle)
+{
+    beluga_utils::ini_view value;
+    TEST_ASSERT_TRUE(ini.get_config_value(handle, &value));
+    return std::string(value.data, value.length);
+}
+
+/*!
+\brief Lazy mode: a handle to an overridden key, taken before its section is loaded, keeps reading the value set
+after the load. The load must not index the override (or the file's value) a second time.
+*/
+void test_lazy_handle_survives_section_load(void)
+{
+    beluga_utils::ini_reader ini(config_path, beluga_utils::ini_storage_mode::lazy);
+    ini.set_storage_backend(backend);
+    TEST_ASSERT_TRUE(ini.initialise(false));
+    std::string first(64, 'a');     //Longer than any small-string buffer, so each value has its own allocation
+    std::string second(200, 'b');
+    TEST_ASSERT_TRUE(ini.set_config_value("s", "k", first));
+    beluga_utils::ini_handle handle = ini.get_config_handle("s", "k"); //Found in the overrides: [s] is not loaded
+    TEST_ASSERT_TRUE(handle.is_valid());
+    TEST_ASSERT_TRUE(ini.get_config_handle("s", "other").is_valid()); //Loads [s]
+    TEST_ASSERT_TRUE(ini.set_config_value("s", "k", second));
+    TEST_ASSERT_EQUAL_STRING(second.c_str(), read_handle(ini, handle).c_str());
+    TEST_ASSERT_EQUAL(handle.entry, ini.get_config_handle("s", "k").entry);
+    std::string value;
+    TEST_ASSERT_TRUE(ini.get_config_value("s", "other", &value, false));
+    TEST_ASSERT_EQUAL_STRING("2", value.c_str());
+}
+
+/*!
+\brief The same in arena mode, where the section is indexed from the start.
+*/
+void test_arena_handle_reads_new_value(void)
+{
+    beluga_utils::ini_reader ini(config_path, beluga_utils::ini_storage_mode::arena);
+    ini.set_storage_backend(backend);
+    TEST_ASSERT_TRUE(ini.initialise(false));
+    beluga_utils::ini_handle handle = ini.get_config_handle("s", "k");
+    TEST_ASSERT_TRUE(ini.set_config_value("s", "k", std::string(64, 'a')));
+    TEST_ASSERT_TRUE(ini.set_config_value("s", "k", std::string(200, 'b')));
+    TEST_ASSERT_EQUAL_STRING(std::string(200, 'b').c_str(), read_handle(ini, handle).c_str());
+}
+
+int main(int argc, char ** argv)
+{
+    beluga_utils::posix_backend posix(".");
+    posix.begin();
+    backend = &posix;
+    UNITY_BEGIN();
+    RUN_TEST(test_lazy_handle_survives_section_load);
+    RUN_TEST(test_arena_handle_reads_new_value);
+    return UNITY_END();
+}
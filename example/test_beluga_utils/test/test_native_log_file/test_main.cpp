@@ -0,0 +1,141 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include "beluga_log_file.h"
+
+//Host tests for log_file_sink: pio test -e native -f test_native_log_file
+
+static const char * prefix = "/test_log";
+static beluga_utils::posix_backend * backend = nullptr;
+static beluga_utils::log_file_config config;
+static char last_record[64];
+
+static void remove_segments()
+{
+    for(size_t i = 0; i < config.n_segments; i++)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), "%s_%03u.log", prefix, (unsigned) i);
+        backend->filesystem().remove(path);
+    }
+}
+
+void setUp(void)
+{
+    config = beluga_utils::log_file_config();
+    config.segment_bytes = 16 * 1024;
+    config.n_segments = 4;
+    config.commit_interval_ms = 60000; //Only explicit commits
+    last_record[0] = '\0';
+    remove_segments();
+}
+
+void tearDown(void)
+{
+    remove_segments();
+}
+
+static void keep_last(void * context, uint32_t sequence, const uint8_t * data, size_t length)
+{
+    length = std::min(length, sizeof(last_record) - 1);
+    memcpy(last_record, data, length);
+    last_record[length] = '\0';
+}
+
+static void append_records(beluga_utils::log_file_sink & sink, int first, int n, size_t length)
+{
+    char record[400];
+    for(int i = first; i < first + n; i++)
+    {
+        memset(record, '.', length);
+        int n_printed = snprintf(record, length, "record %d", i);
+        record[n_printed] = '.';
+        sink.append((const uint8_t *) record, length);
+    }
+    TEST_ASSERT_TRUE(sink.commit());
+}
+
+/*!
+\brief Overwrite part of a segment, as a power cut partway through a commit leaves it.
+*/
+static void tear(size_t segment, size_t offset, size_t length)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "%s_%03u.log", prefix, (unsigned) segment);
+    File file = backend->open(path, "r+");
+    TEST_ASSERT_TRUE((bool) file);
+    TEST_ASSERT_TRUE(file.seek(offset));
+    for(size_t i = 0; i < length; i++)
+    {
+        file.write((uint8_t) (0x5A ^ i));
+    }
+    file.close();
+}
+
+/*!
+\brief A multi-sector commit is torn after its first records. The next boot must keep its new records readable
+behind the records that survived, rather than writing them after the torn bytes where the scan never reaches.
+*/
+void test_torn_commit_keeps_later_records(void)
+{
+    beluga_utils::log_file_sink sink;
+    TEST_ASSERT_TRUE(sink.begin(*backend, prefix, config));
+    append_records(sink, 1, 9, 40);             //Sector 1
+    append_records(sink, 10, 4, 300);           //Sectors 2-4: records at 1024, 1336, 1648, 1960
+    sink.end();
+    TEST_ASSERT_EQUAL(13, (int) beluga_utils::log_file_scan(*backend, prefix, config.n_segments, nullptr, nullptr));
+
+    tear(0, 1336 + 20, 1000);                   //Cuts records 11-13, from the middle of sector 2
+    uint32_t last_sequence = 0;
+    TEST_ASSERT_EQUAL(10, (int) beluga_utils::log_file_scan(*backend, prefix, config.n_segments, nullptr, nullptr, &last_sequence));
+    TEST_ASSERT_EQUAL(10, (int) last_sequence);
+
+    TEST_ASSERT_TRUE(sink.begin(*backend, prefix, config));
+    TEST_ASSERT_EQUAL(11, (int) sink.next_sequence());
+    append_records(sink, 11, 5, 40);
+    sink.end();
+    TEST_ASSERT_EQUAL(15, (int) beluga_utils::log_file_scan(*backend, prefix, config.n_segments, keep_last, nullptr, &last_sequence));
+    TEST_ASSERT_EQUAL(15, (int) last_sequence);
+    TEST_ASSERT_EQUAL_STRING_LEN("record 15.", last_record, 10);
+
+    //A third boot finds a clean tail and carries on in the same segment
+    TEST_ASSERT_TRUE(sink.begin(*backend, prefix, config));
+    append_records(sink, 16, 3, 40);
+    beluga_utils::log_file_stats stats = sink.get_stats();
+    sink.end();
+    TEST_ASSERT_EQUAL(0, (int) stats.rotations);
+    TEST_ASSERT_EQUAL(18, (int) beluga_utils::log_file_scan(*backend, prefix, config.n_segments, keep_last, nullptr, &last_sequence));
+    TEST_ASSERT_EQUAL(18, (int) last_sequence);
+}
+
+/*!
+\brief A commit that ends cleanly on a sector boundary is not treated as torn.
+*/
+void test_clean_restart_stays_in_segment(void)
+{
+    beluga_utils::log_file_sink sink;
+    TEST_ASSERT_TRUE(sink.begin(*backend, prefix, config));
+    append_records(sink, 1, 12, 40);         //Ends mid-sector, padded by the commit
+    sink.end();
+    TEST_ASSERT_TRUE(sink.begin(*backend, prefix, config));
+    append_records(sink, 13, 8, 40);
+    beluga_utils::log_file_stats stats = sink.get_stats();
+    sink.end();
+    TEST_ASSERT_EQUAL(0, (int) stats.rotations);
+    uint32_t last_sequence = 0;
+    TEST_ASSERT_EQUAL(20, (int) beluga_utils::log_file_scan(*backend, prefix, config.n_segments, nullptr, nullptr, &last_sequence));
+    TEST_ASSERT_EQUAL(20, (int) last_sequence);
+}
+
+int main(int argc, char ** argv)
+{
+    beluga_utils::posix_backend posix(".");
+    posix.begin();
+    backend = &posix;
+    UNITY_BEGIN();
+    RUN_TEST(test_torn_commit_keeps_later_records);
+    RUN_TEST(test_clean_restart_stays_in_segment);
+    return UNITY_END();
+}
@@ -0,0 +1,120 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "beluga_scheduler.h"
+
+//Host tests for beluga_scheduler: pio test -e native -f test_native_scheduler
+
+static beluga_utils::scheduler * sched = nullptr;
+static int id_a = -1;
+static int id_b = -1;
+static int id_c = -1;
+static int id_p = -1;
+static int runs_b = 0;
+static int runs_c = 0;
+
+void setUp(void)
+{
+    runs_b = 0;
+    runs_c = 0;
+    id_a = id_b = id_c = id_p = -1;
+}
+
+void tearDown(void)
+{
+}
+
+static void count_b(void * context) { runs_b++; }
+static void count_c(void * context) { runs_c++; }
+
+static void cancel_b_then_add_c(void * context)
+{
+    sched->cancel(id_b);
+    id_c = sched->add_one_shot("C", 500, count_c);
+}
+
+static void cancel_self_then_add_c(void * context)
+{
+    sched->cancel(id_p);
+    id_c = sched->add_one_shot("C", 500, count_c);
+}
+
+/*!
+\brief A callback cancels a task queued after it in the same run, then adds a task: the new task must not take the
+cancelled slot while that slot is still queued, or it would run at once and be linked into the wheel twice.
+*/
+void test_cancel_queued_then_add(void)
+{
+    beluga_utils::scheduler s(2);
+    sched = &s;
+    id_a = s.add_one_shot("A", 5, cancel_b_then_add_c, nullptr, 2);
+    id_b = s.add_one_shot("B", 5, count_b, nullptr, 1);
+    delay(20);
+    TEST_ASSERT_EQUAL(1, (int) s.run_pending());
+    TEST_ASSERT_EQUAL(0, runs_b);
+    TEST_ASSERT_EQUAL(-1, id_c);    //Both slots are held until run_pending returns
+    TEST_ASSERT_EQUAL(0, (int) s.task_count());
+
+    //Once run_pending has returned, the slots are free again
+    id_c = s.add_one_shot("C", 500, count_c);
+    TEST_ASSERT_TRUE(id_c >= 0);
+    TEST_ASSERT_EQUAL(1, (int) s.task_count());
+    TEST_ASSERT_TRUE(s.time_to_next_deadline_us() > 100000);
+    delay(20);
+    TEST_ASSERT_EQUAL(0, (int) s.run_pending());
+    TEST_ASSERT_EQUAL(0, runs_c);
+    TEST_ASSERT_TRUE(s.cancel(id_c));
+    TEST_ASSERT_EQUAL(0, (int) s.task_count());
+    TEST_ASSERT_TRUE(s.time_to_next_deadline_us() == UINT64_MAX);
+}
+
+/*!
+\brief As above with room to spare: the new task gets a fresh slot and waits for its own deadline.
+*/
+void test_cancel_queued_then_add_with_room(void)
+{
+    beluga_utils::scheduler s(8);
+    sched = &s;
+    id_a = s.add_one_shot("A", 5, cancel_b_then_add_c, nullptr, 2);
+    id_b = s.add_one_shot("B", 5, count_b, nullptr, 1);
+    delay(20);
+    TEST_ASSERT_EQUAL(1, (int) s.run_pending());
+    TEST_ASSERT_EQUAL(0, runs_b);
+    TEST_ASSERT_TRUE(id_c >= 0 && id_c != id_a && id_c != id_b);
+    TEST_ASSERT_EQUAL(0, runs_c);
+    TEST_ASSERT_EQUAL(1, (int) s.task_count());
+    TEST_ASSERT_EQUAL_STRING("C", s.get_task_name(id_c));
+    TEST_ASSERT_TRUE(s.time_to_next_deadline_us() > 100000);
+    delay(20);
+    TEST_ASSERT_EQUAL(0, (int) s.run_pending());
+    TEST_ASSERT_TRUE(s.cancel(id_c));
+    TEST_ASSERT_EQUAL(0, (int) s.task_count());
+}
+
+/*!
+\brief A periodic task cancels itself and adds a task from its own callback.
+*/
+void test_cancel_self_then_add(void)
+{
+    beluga_utils::scheduler s(8);
+    sched = &s;
+    id_p = s.add_periodic("P", 5, cancel_self_then_add_c);
+    delay(20);
+    TEST_ASSERT_EQUAL(1, (int) s.run_pending());
+    TEST_ASSERT_TRUE(id_c >= 0 && id_c != id_p);
+    TEST_ASSERT_TRUE(s.get_task_name(id_p) == nullptr);
+    TEST_ASSERT_EQUAL(1, (int) s.task_count());
+    delay(20);
+    TEST_ASSERT_EQUAL(0, (int) s.run_pending());
+    TEST_ASSERT_EQUAL(0, runs_c);
+    TEST_ASSERT_TRUE(s.cancel(id_c));
+    TEST_ASSERT_EQUAL(0, (int) s.task_count());
+}
+
+int main(int argc, char ** argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cancel_queued_then_add);
+    RUN_TEST(test_cancel_queued_then_add_with_room);
+    RUN_TEST(test_cancel_self_then_add);
+    return UNITY_END();
+}
@@ -0,0 +1,66 @@
+#pragma once
+/*
+Host (Linux) stand-in for the parts of the Arduino-ESP32 core used by beluga_arduino_utils.
+Only built for the PlatformIO native platform; see native/README.md.
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#ifndef BELUGA_NATIVE
+#define BELUGA_NATIVE 1
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/*!
+\brief Serial stand-in that writes to stdout (or any FILE * given to set_output).
+*/
+class HardwareSerial
+{
+    public:
+        HardwareSerial(){};
+        void begin(unsigned long baud) {}
+        void end() {}
+        void set_output(FILE * output) { _output = output; }
+        size_t write(uint8_t c) { return fputc(c, out()) == EOF ? 0 : 1; }
+        size_t write(const uint8_t * buffer, size_t size) { return fwrite(buffer, 1, size, out()); }
+        size_t print(const char * s) { return fputs(s, out()) == EOF ? 0 : strlen(s); }
+        size_t print(char c) { return write((uint8_t) c); }
+        size_t print(int n) { return (size_t) fprintf(out(), "%d", n); }
+        size_t print(unsigned int n) { return (size_t) fprintf(out(), "%u", n); }
+        size_t print(long n) { return (size_t) fprintf(out(), "%ld", n); }
+        size_t print(unsigned long n) { return (size_t) fprintf(out(), "%lu", n); }
+        size_t print(long long n) { return (size_t) fprintf(out(), "%lld", n); }
+        size_t print(unsigned long long n) { return (size_t) fprintf(out(), "%llu", n); }
+        size_t print(double n, int digits = 2) { return (size_t) fprintf(out(), "%.*f", digits, n); }
+        size_t println() { return print("\n"); } //Device prints \r\n; plain \n keeps host logs tidy
+        template<typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+        size_t printf(const char * format, ...) __attribute__((format(printf, 2, 3)))
+        {
+            va_list args;
+            va_start(args, format);
+            int n = vfprintf(out(), format, args);
+            va_end(args);
+            return n < 0 ? 0 : (size_t) n;
+        }
+        int available() { return 0; }
+        int read() { return -1; }
+        void flush() { fflush(out()); }
+        operator bool() const { return true; }
+
+    protected:
+        FILE * out() { return _output ? _output : stdout; }
+        FILE * _output = nullptr;
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,87 @@
+#pragma once
+/*
+Host (Linux) stand-in for the Arduino-ESP32 FS.h: fs::File and fs::FS backed by POSIX files under a root directory.
+*/
+#include "Arduino.h"
+#include <memory>
+#include <time.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+    enum SeekMode
+    {
+        SeekSet = 0,
+        SeekCur = 1,
+        SeekEnd = 2
+    };
+
+    /*!
+    \brief Shared handle to an open file. Like the device File, copies refer to the same open file and the
+    file is closed when the last copy goes away (or close() is called).
+    */
+    class File
+    {
+        public:
+            File(){};
+            File(FILE * f, const std::string & path);
+            operator bool() const { return _impl && _impl->f != nullptr; }
+            size_t write(uint8_t c) { return write(&c, 1); }
+            size_t write(const uint8_t * buf, size_t size);
+            size_t print(const char * s) { return write((const uint8_t *) s, strlen(s)); }
+            size_t println(const char * s) { return print(s) + print("\n"); }
+            int available();
+            int read();
+            int peek();
+            size_t read(uint8_t * buf, size_t size);
+            size_t readBytes(char * buffer, size_t length) { return read((uint8_t *) buffer, length); }
+            size_t readBytesUntil(char terminator, char * buffer, size_t length);
+            void flush();
+            bool seek(uint32_t pos, SeekMode mode = SeekSet);
+            size_t position() const;
+            size_t size() const;
+            time_t getLastWrite();
+            void close();
+            const char * path() const { return _impl ? _impl->path.c_str() : ""; }
+            const char * name() const;
+            int fd() const; //Native only: the underlying POSIX descriptor, or -1
+
+        protected:
+            struct file_impl
+            {
+                FILE * f;
+                std::string path;
+                ~file_impl() { if(f) { fclose(f); } }
+            };
+            std::shared_ptr<file_impl> _impl;
+    };
+
+    /*!
+    \brief A filesystem rooted at a host directory. Paths like "/config.ini" resolve to <root>/config.ini.
+    */
+    class FS
+    {
+        public:
+            FS(){};
+            File open(const char * path, const char * mode = FILE_READ, const bool create = false);
+            File open(const std::string & path, const char * mode = FILE_READ, const bool create = false) { return open(path.c_str(), mode, create); }
+            bool exists(const char * path);
+            bool exists(const std::string & path) { return exists(path.c_str()); }
+            bool remove(const char * path);
+            bool rename(const char * path_from, const char * path_to);
+            bool mkdir(const char * path);
+            bool rmdir(const char * path);
+            void set_root(const char * root) { _root = root; } //Native only
+            std::string host_path(const char * path) const;   //Native only: the host path a device path maps to
+
+        protected:
+            std::string root() const;
+            std::string _root;
+    };
+}
+
+using fs::File;
+using fs::FS;
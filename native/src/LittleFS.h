@@ -0,0 +1,21 @@
+#pragma once
+/*
+Host (Linux) stand-in for the Arduino-ESP32 LittleFS.h. Shares the host directory with SPIFFS; see FS.h.
+*/
+#include "FS.h"
+
+namespace fs
+{
+    class LittleFSFS : public FS
+    {
+        public:
+            LittleFSFS(){};
+            bool begin(bool formatOnFail = false, const char * basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char * partitionLabel = "spiffs") { return true; }
+            bool format() { return false; }
+            size_t totalBytes() { return 0; }
+            size_t usedBytes() { return 0; }
+            void end() {}
+    };
+}
+
+extern fs::LittleFSFS LittleFS;
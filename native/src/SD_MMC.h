@@ -0,0 +1,34 @@
+#pragma once
+/*
+Host (Linux) stand-in for the Arduino-ESP32 SD_MMC.h. The "card" is the same host directory as SPIFFS (see FS.h),
+or another one set with SD_MMC.set_root().
+*/
+#include "FS.h"
+
+#define BOARD_MAX_SDMMC_FREQ 40000
+
+typedef enum
+{
+    CARD_NONE,
+    CARD_MMC,
+    CARD_SD,
+    CARD_SDHC,
+    CARD_UNKNOWN
+} sdcard_type_t;
+
+namespace fs
+{
+    class SDMMCFS : public FS
+    {
+        public:
+            SDMMCFS(){};
+            bool begin(const char * mountpoint = "/sdcard", bool mode1bit = false, bool format_if_mount_failed = false, int sdmmc_frequency = BOARD_MAX_SDMMC_FREQ, uint8_t maxOpenFiles = 5) { return true; }
+            void end() {}
+            sdcard_type_t cardType() { return CARD_SDHC; }
+            uint64_t cardSize() { return 0; }
+            uint64_t totalBytes() { return 0; }
+            uint64_t usedBytes() { return 0; }
+    };
+}
+
+extern fs::SDMMCFS SD_MMC;
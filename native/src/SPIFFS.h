@@ -0,0 +1,21 @@
+#pragma once
+/*
+Host (Linux) stand-in for the Arduino-ESP32 SPIFFS.h. The "partition" is a host directory; see FS.h.
+*/
+#include "FS.h"
+
+namespace fs
+{
+    class SPIFFSFS : public FS
+    {
+        public:
+            SPIFFSFS(){};
+            bool begin(bool formatOnFail = false, const char * basePath = "/spiffs", uint8_t maxOpenFiles = 10, const char * partitionLabel = nullptr) { return true; }
+            bool format() { return false; }
+            size_t totalBytes() { return 0; }
+            size_t usedBytes() { return 0; }
+            void end() {}
+    };
+}
+
+extern fs::SPIFFSFS SPIFFS;
@@ -0,0 +1,226 @@
+#include "Arduino.h"
+#include "FS.h"
+#include "SPIFFS.h"
+#include "LittleFS.h"
+#include "SD_MMC.h"
+#include <chrono>
+#include <thread>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+fs::SPIFFSFS SPIFFS;
+fs::LittleFSFS LittleFS;
+fs::SDMMCFS SD_MMC;
+
+static std::chrono::steady_clock::time_point boot_time()
+{
+  static const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  return t0;
+}
+
+unsigned long millis()
+{
+  return (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - boot_time()).count();
+}
+
+unsigned long micros()
+{
+  return (unsigned long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot_time()).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+namespace fs
+{
+  File::File(FILE * f, const std::string & path)
+  {
+    if(f)
+    {
+      _impl = std::make_shared<file_impl>();
+      _impl->f = f;
+      _impl->path = path;
+    }
+  }
+
+  size_t File::write(const uint8_t * buf, size_t size)
+  {
+    return *this ? fwrite(buf, 1, size, _impl->f) : 0;
+  }
+
+  int File::available()
+  {
+    if(!*this)
+    {
+      return 0;
+    }
+    long remaining = (long) size() - (long) position();
+    return remaining > 0 ? (int) remaining : 0;
+  }
+
+  int File::read()
+  {
+    return *this ? fgetc(_impl->f) : -1;
+  }
+
+  int File::peek()
+  {
+    if(!*this)
+    {
+      return -1;
+    }
+    int c = fgetc(_impl->f);
+    if(c != EOF)
+    {
+      ungetc(c, _impl->f);
+    }
+    return c;
+  }
+
+  size_t File::read(uint8_t * buf, size_t size)
+  {
+    return *this ? fread(buf, 1, size, _impl->f) : 0;
+  }
+
+  /*!
+  \brief Byte-at-a-time, like Stream::readBytesUntil on the device.
+  */
+  size_t File::readBytesUntil(char terminator, char * buffer, size_t length)
+  {
+    size_t n = 0;
+    while(n < length)
+    {
+      int c = read();
+      if(c < 0 || c == terminator)
+      {
+        break;
+      }
+      buffer[n++] = (char) c;
+    }
+    return n;
+  }
+
+  void File::flush()
+  {
+    if(*this)
+    {
+      fflush(_impl->f);
+    }
+  }
+
+  bool File::seek(uint32_t pos, SeekMode mode)
+  {
+    return *this && fseek(_impl->f, (long) pos, (int) mode) == 0;
+  }
+
+  size_t File::position() const
+  {
+    return *this ? (size_t) ftell(_impl->f) : 0;
+  }
+
+  size_t File::size() const
+  {
+    struct stat st;
+    if(!*this)
+    {
+      return 0;
+    }
+    fflush(_impl->f); //Include buffered writes, as the device does
+    return fstat(fileno(_impl->f), &st) == 0 ? (size_t) st.st_size : 0;
+  }
+
+  time_t File::getLastWrite()
+  {
+    struct stat st;
+    if(!*this || fstat(fileno(_impl->f), &st) != 0)
+    {
+      return 0;
+    }
+    return st.st_mtime;
+  }
+
+  void File::close()
+  {
+    _impl.reset();
+  }
+
+  const char * File::name() const
+  {
+    const char * p = path();
+    const char * slash = strrchr(p, '/');
+    return slash ? slash + 1 : p;
+  }
+
+  int File::fd() const
+  {
+    return *this ? fileno(_impl->f) : -1;
+  }
+
+  std::string FS::root() const
+  {
+    if(!_root.empty())
+    {
+      return _root;
+    }
+    const char * env_root = getenv("BELUGA_FS_ROOT");
+    return env_root ? std::string(env_root) : std::string("data");
+  }
+
+  std::string FS::host_path(const char * path) const
+  {
+    std::string p = root();
+    if(path[0] != '/')
+    {
+      p += "/";
+    }
+    return p + path;
+  }
+
+  File FS::open(const char * path, const char * mode, const bool create)
+  {
+    std::string host_mode = mode;
+    host_mode += "b";
+    std::string full_path = host_path(path);
+    struct stat st;
+    if(stat(full_path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+    {
+      return File();
+    }
+    return File(fopen(full_path.c_str(), host_mode.c_str()), path);
+  }
+
+  bool FS::exists(const char * path)
+  {
+    struct stat st;
+    return stat(host_path(path).c_str(), &st) == 0;
+  }
+
+  bool FS::remove(const char * path)
+  {
+    return ::remove(host_path(path).c_str()) == 0;
+  }
+
+  bool FS::rename(const char * path_from, const char * path_to)
+  {
+    return ::rename(host_path(path_from).c_str(), host_path(path_to).c_str()) == 0;
+  }
+
+  bool FS::mkdir(const char * path)
+  {
+    return ::mkdir(host_path(path).c_str(), 0755) == 0;
+  }
+
+  bool FS::rmdir(const char * path)
+  {
+    return ::rmdir(host_path(path).c_str()) == 0;
+  }
+}
@@ -1,9 +1,18 @@
 #include "beluga_arduino_time.h"
 #include <Arduino.h>
-#include <climits> //Needed for ULLONG_MAX
+#if !defined(BELUGA_NATIVE)
+#include "esp_timer.h"
+#endif
 
 namespace beluga_utils
 {
+    /*!
+    \brief Milliseconds elapsed between two millis() readings
+    \details Unsigned subtraction is modulo 2^32 (the width of unsigned long on the ESP32), so this is also correct
+    across the millis() rollover every ~49.7 days, as long as the interval itself is shorter than that.
+    @param time_now_ms 0 means "now".
+    Usage: unsigned long dt_ms = beluga_utils::calculate_time_dt_ms(last_ms);
+    */
     unsigned long calculate_time_dt_ms(unsigned long time_prev_ms, unsigned long time_now_ms)
     {
         unsigned long t2_ms = time_now_ms;
@@ -11,16 +20,36 @@ namespace beluga_utils
         {
             t2_ms = millis();
         }
-        unsigned long t1_ms = time_prev_ms;
-        unsigned long dt_ms;
-        bool overflowed = t1_ms > t2_ms;
-        if(overflowed) 
+        return t2_ms - time_prev_ms;
+    }
+
+    /*!
+    \brief Microseconds since boot from a 64-bit clock that does not wrap (for ~584,000 years)
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details esp_timer_get_time() on the ESP32 (micros() is only 32 bits and wraps every ~71 minutes);
+    micros() on the host build, where unsigned long is 64 bits.
+    Usage: uint64_t t0_us = beluga_utils::monotonic_time_us();
+    */
+    uint64_t monotonic_time_us()
+    {
+#if defined(BELUGA_NATIVE)
+        return (uint64_t) micros();
+#else
+        return (uint64_t) esp_timer_get_time();
+#endif
+    }
+
+    /*!
+    \brief Microseconds elapsed since a monotonic_time_us() reading.
+    @param time_now_us 0 means "now".
+    */
+    uint64_t calculate_time_dt_us(uint64_t time_prev_us, uint64_t time_now_us)
+    {
+        if(time_now_us == 0)
         {
-            //Wraparound for overflow.
-            dt_ms = ULLONG_MAX - t2_ms + t1_ms;
-        }else{
-            dt_ms = t2_ms - t1_ms;
+            time_now_us = monotonic_time_us();
         }
-        return dt_ms;
+        return (time_now_us > time_prev_us) ? (time_now_us - time_prev_us) : 0;
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,9 @@
 #pragma once
+#include <stdint.h>
 
 namespace beluga_utils
 {
     unsigned long calculate_time_dt_ms(unsigned long time_prev_ms, unsigned long time_now_ms = 0);
-}
\ No newline at end of file
+    uint64_t monotonic_time_us();
+    uint64_t calculate_time_dt_us(uint64_t time_prev_us, uint64_t time_now_us = 0);
+}
@@ -1,8 +1,41 @@
 #include <Arduino.h>
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
 #include "beluga_constants.h"
+#include "beluga_debug.h"
+#include "beluga_heap_stats.h"
+#include "beluga_log_ring.h"
+#include "beluga_log_file.h"
+#if defined(BELUGA_NATIVE)
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
 namespace beluga_utils
 {
     bool debug_print_enable = true;
+    log_level debug_log_level = log_level::debug;
+
+    static log_ring async_ring;
+    static debug_print_full_policy async_policy = debug_print_full_policy::drop;
+    static std::atomic<bool> async_running(false);
+    static std::atomic<bool> async_stop(false);
+    static std::atomic<uint32_t> async_dropped(0);
+    static std::atomic<log_file_sink *> file_sink(nullptr);
+#if defined(BELUGA_NATIVE)
+    static std::thread drain_thread;
+    static std::mutex drain_mutex;
+    static std::condition_variable drain_wake;
+#else
+    static TaskHandle_t drain_task = nullptr;
+    static std::atomic<bool> drain_stopped(true);
+    const uint32_t drain_task_stack_size = 3072;
+#endif
 
 
     /*!
@@ -17,27 +50,338 @@ namespace beluga_utils
         beluga_utils::debug_print_enable = enable;
         return debug_print_enable;
     }
+    static void wake_drain()
+    {
+#if defined(BELUGA_NATIVE)
+        drain_wake.notify_one();
+#else
+        if(drain_task != nullptr)
+        {
+            xTaskNotifyGive(drain_task);
+        }
+#endif
+    }
+
+    /*!
+    \brief Write every queued message to Serial. Only the drain task (or debug_print_async_end) calls this.
+    */
+    static void drain_ring()
+    {
+        const log_ring_slot * slot;
+        while((slot = async_ring.front()) != nullptr)
+        {
+            Serial.write((const uint8_t *) slot->text, slot->length);
+            if(slot->flags & log_ring_flag_newline)
+            {
+                Serial.println();
+            }
+            async_ring.pop_front();
+        }
+    }
+
+#if defined(BELUGA_NATIVE)
+    static void drain_task_main()
+    {
+        while(!async_stop.load(std::memory_order_acquire))
+        {
+            drain_ring();
+            std::unique_lock<std::mutex> lock(drain_mutex);
+            if(async_ring.front() == nullptr)
+            {
+                drain_wake.wait_for(lock, std::chrono::milliseconds(5)); //Timeout covers a wake sent just before the wait
+            }
+        }
+        drain_ring();
+    }
+#else
+    static void drain_task_main(void * parameters)
+    {
+        while(!async_stop.load(std::memory_order_acquire))
+        {
+            drain_ring();
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+        }
+        drain_ring();
+        drain_stopped.store(true, std::memory_order_release);
+        vTaskDelete(nullptr);
+    }
+#endif
+
+    static void debug_print_async_push(const char * text, size_t length, bool add_newline)
+    {
+        bool pushed = async_ring.try_push(text, length, add_newline);
+        while(!pushed && async_policy == debug_print_full_policy::block && async_running.load(std::memory_order_acquire))
+        {
+            wake_drain();
+            delay(1);
+            pushed = async_ring.try_push(text, length, add_newline);
+        }
+        if(pushed)
+        {
+            wake_drain();
+        }else{
+            async_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /*!
+    \brief Switch debug_print to asynchronous mode
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details debug_print copies the message into a preallocated lock-free ring buffer and returns; a background
+    task (a std::thread on the host build) writes the ring to Serial. At 115200 baud an 80 character line takes ~7 ms
+    to go out, which the caller no longer waits for.
+    @param n_slots ring size, rounded up to a power of two. Each slot holds log_ring_text_size bytes; longer
+    messages take several slots.
+    @param policy what debug_print does when the ring is full: drop the message (counted by
+    debug_print_dropped_count) or block until the drain task makes room.
+    @param task_priority FreeRTOS priority of the drain task (ignored on the host).
+    \return False if the ring or task could not be created; debug_print stays synchronous.
+    Call debug_print_flush before a reset so queued messages are not lost.
+    Usage:
+    beluga_utils::debug_print_async_begin(64, beluga_utils::debug_print_full_policy::drop);
+    beluga_utils::debug_print("Returns in microseconds");
+    beluga_utils::debug_print_flush();
+    ESP.restart();
+    */
+    bool debug_print_async_begin(size_t n_slots, debug_print_full_policy policy, unsigned int task_priority)
+    {
+        debug_print_async_end();
+        if(!async_ring.begin(n_slots))
+        {
+            return false;
+        }
+        async_policy = policy;
+        async_dropped.store(0, std::memory_order_relaxed);
+        async_stop.store(false, std::memory_order_release);
+#if defined(BELUGA_NATIVE)
+        drain_thread = std::thread(drain_task_main);
+#else
+        drain_stopped.store(false, std::memory_order_release);
+        if(xTaskCreate(drain_task_main, "debug_print", drain_task_stack_size, nullptr, task_priority, &drain_task) != pdPASS)
+        {
+            drain_task = nullptr;
+            drain_stopped.store(true, std::memory_order_release);
+            return false;
+        }
+#endif
+        async_running.store(true, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+    \brief Drain the ring, stop the drain task and return debug_print to synchronous mode.
+    \details The ring's memory is kept (and reused by the next debug_print_async_begin) so a debug_print racing
+    with this call from another task never writes to freed memory.
+    */
+    void debug_print_async_end()
+    {
+        if(!async_running.exchange(false, std::memory_order_acq_rel))
+        {
+            return;
+        }
+        async_stop.store(true, std::memory_order_release);
+        wake_drain();
+#if defined(BELUGA_NATIVE)
+        drain_thread.join();
+#else
+        while(!drain_stopped.load(std::memory_order_acquire))
+        {
+            wake_drain();
+            delay(1);
+        }
+        drain_task = nullptr;
+#endif
+        Serial.flush();
+    }
+
+    bool debug_print_is_async()
+    {
+        return async_running.load(std::memory_order_acquire);
+    }
+
+    /*!
+    \brief Wait until every message queued before this call has been written to Serial (and committed to the file
+    sink, if one is set).
+    \return False if that did not happen within timeout_ms.
+    Usage: beluga_utils::debug_print_flush(); ESP.restart();
+    */
+    bool debug_print_flush(unsigned long timeout_ms)
+    {
+        if(async_running.load(std::memory_order_acquire))
+        {
+            uint32_t target = async_ring.enqueue_position();
+            unsigned long start_ms = millis();
+            while((int32_t) (async_ring.dequeue_position() - target) < 0)
+            {
+                if(millis() - start_ms >= timeout_ms)
+                {
+                    return false;
+                }
+                wake_drain();
+                delay(1);
+            }
+        }
+        log_file_sink * sink = file_sink.load(std::memory_order_acquire);
+        if(sink != nullptr)
+        {
+            sink->commit();
+        }
+        Serial.flush();
+        return true;
+    }
+
+    /*!
+    \brief Number of messages discarded because the ring was full (drop policy), since debug_print_async_begin.
+    */
+    uint32_t debug_print_dropped_count()
+    {
+        return async_dropped.load(std::memory_order_relaxed);
+    }
+
+    /*!
+    \brief Also send everything printed to a log file (one record per message, without the newline)
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details The sink only copies each message into RAM; its own task writes them to the card in batches.
+    debug_print_flush() commits it. Pass nullptr to stop. The sink must stay alive while it is set.
+    \return The previous sink.
+    Usage: beluga_utils::debug_print_set_file_sink(&log_file);
+    */
+    log_file_sink * debug_print_set_file_sink(log_file_sink * sink)
+    {
+        return file_sink.exchange(sink, std::memory_order_acq_rel);
+    }
+
+    /*!
+    \brief Send text to Serial, directly or through the async ring, and to the file sink if there is one.
+    */
+    static void debug_write(const char * text, size_t length, bool add_newline)
+    {
+        log_file_sink * sink = file_sink.load(std::memory_order_acquire);
+        if(sink != nullptr)
+        {
+            sink->append((const uint8_t *) text, length);
+        }
+        if(async_running.load(std::memory_order_acquire))
+        {
+            debug_print_async_push(text, length, add_newline);
+            return;
+        }
+        Serial.write((const uint8_t *) text, length);
+        if(add_newline)
+        {
+            Serial.println();
+        }
+    }
+
     /*!
     \brief Print to serial
     \author Bryan Clarke
     \date 27/10/2024
-    \details Print to serial, with a few flags for blocking/newlines/etc
-    \todo Re-implement with multiple print functions and debug log levels supported e.g.: https://stackoverflow.com/questions/37837904/multilevel-debug-with-printf-in-embedded-c
+    \details Print to serial, with a few flags for blocking/newlines/etc. Unlevelled: printed whenever
+    debug_print_enable is true (or force_print is), whatever the log level. New code should prefer BELUGA_LOG_*,
+    which skips the formatting work when the message would not be printed.
     Usage: beluga_utils::debug_print("This message will be printed if debug_print_enable is true");
-    beluga_utils::debug_print("This message will always be printed", force_print = true);
+    beluga_utils::debug_print("This message will always be printed", true, true); //add_newline, force_print
+    */
+    void debug_print(const std::string & s, bool add_newline , bool force_print)
+    {
+        BELUGA_HEAP_SCOPE(debug_print);
+        if(! beluga_utils::debug_print_enable && ! force_print)
+        {
+            return;
+        }
+        debug_write(s.data(), s.size(), add_newline);
+    }
+
+    /*!
+    \brief Send raw bytes (e.g. binary log records) to Serial, through the async ring if it is running.
+    \details Printed whenever debug_print_enable is true. No newline is added.
     */
-    void debug_print(std::string s, bool add_newline , bool force_print)
+    void debug_print_bytes(const uint8_t * data, size_t length)
     {
         if(! beluga_utils::debug_print_enable)
         {
             return;
         }
-        if(add_newline)
+        debug_write((const char *) data, length, false);
+    }
+
+    /*!
+    \brief Set the runtime log level
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details BELUGA_LOG_* calls above this level return after one comparison, before formatting. Levels above
+    BELUGA_LOG_COMPILE_LEVEL are not compiled in at all, so raising the runtime level cannot bring them back.
+    \return The previous level.
+    Usage: beluga_utils::set_log_level(beluga_utils::log_level::warn);
+    */
+    log_level set_log_level(log_level level)
+    {
+        log_level previous = debug_log_level;
+        debug_log_level = level;
+        return previous;
+    }
+
+    log_level get_log_level()
+    {
+        return debug_log_level;
+    }
+
+    const char * log_level_to_string(log_level level)
+    {
+        switch(level)
         {
-            Serial.println(s.c_str());
-        }else{
-            Serial.print(s.c_str());
+            case log_level::none:
+                return "none";
+            case log_level::error:
+                return "error";
+            case log_level::warn:
+                return "warn";
+            case log_level::info:
+                return "info";
+            case log_level::debug:
+                return "debug";
+            case log_level::trace:
+                return "trace";
+        }
+        return "unknown";
+    }
+
+    /*!
+    \brief printf-style levelled print, normally reached through the BELUGA_LOG_* macros
+    \details Formats into a stack buffer (no heap) with a one-letter level prefix, e.g. "[W] ...". Output longer
+    than log_line_max_size is cut.
+    Usage: BELUGA_LOG_WARN("ini_reader: no key %s in section %s", key, section);
+    */
+    void log_printf(log_level level, const char * format, ...)
+    {
+        if(!log_level_enabled(level) || level == log_level::none)
+        {
+            return;
+        }
+        static const char level_letters[] = "-EWIDT";
+        char line[log_line_max_size];
+        line[0] = '[';
+        line[1] = level_letters[(uint8_t) level];
+        line[2] = ']';
+        line[3] = ' ';
+        const size_t prefix_length = 4;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(line + prefix_length, sizeof(line) - prefix_length, format, args);
+        va_end(args);
+        if(n < 0)
+        {
+            return;
+        }
+        size_t length = prefix_length + (size_t) n;
+        if(length > sizeof(line) - 1)
+        {
+            length = sizeof(line) - 1;
         }
+        debug_write(line, length, true);
     }
 
     /*!
@@ -51,6 +395,9 @@ namespace beluga_utils
     */
     void debug_print_loop_forever(std::string s, int period_s )
     {
+        //Get queued messages out, then print synchronously: the drain task may not survive whatever went wrong
+        debug_print_flush();
+        debug_print_async_end();
         while(1)
         {
             bool newlines = true;
@@ -1,9 +1,104 @@
 #pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+/*
+Log levels. Calls to BELUGA_LOG_<LEVEL> above BELUGA_LOG_COMPILE_LEVEL are removed by the preprocessor: their
+arguments are never evaluated and their format strings are not in the binary. For a release build:
+platformio.ini: build_flags = -DBELUGA_LOG_COMPILE_LEVEL=BELUGA_LOG_LEVEL_WARN
+*/
+#define BELUGA_LOG_LEVEL_NONE 0
+#define BELUGA_LOG_LEVEL_ERROR 1
+#define BELUGA_LOG_LEVEL_WARN 2
+#define BELUGA_LOG_LEVEL_INFO 3
+#define BELUGA_LOG_LEVEL_DEBUG 4
+#define BELUGA_LOG_LEVEL_TRACE 5
+
+#ifndef BELUGA_LOG_COMPILE_LEVEL
+#define BELUGA_LOG_COMPILE_LEVEL BELUGA_LOG_LEVEL_DEBUG
+#endif
+
 namespace beluga_utils
 {
+    class log_file_sink;
+    const size_t log_line_max_size = 256; //Longest BELUGA_LOG_* line, including its "[W] " prefix
+
+    enum class log_level : uint8_t
+    {
+        none = BELUGA_LOG_LEVEL_NONE,
+        error = BELUGA_LOG_LEVEL_ERROR,
+        warn = BELUGA_LOG_LEVEL_WARN,
+        info = BELUGA_LOG_LEVEL_INFO,
+        debug = BELUGA_LOG_LEVEL_DEBUG,
+        trace = BELUGA_LOG_LEVEL_TRACE
+    };
+
+    enum class debug_print_full_policy
+    {
+        drop = 0, //Discard the message and count it (see debug_print_dropped_count)
+        block     //Wait for the drain task to make room
+    };
+
     extern bool debug_print_enable;
+    extern log_level debug_log_level;
     bool set_debug_print_enable(bool enable);
-    void debug_print(std::string s, bool add_newline  = true, bool force_print = false);
+    void debug_print(const std::string & s, bool add_newline  = true, bool force_print = false);
     void debug_print_loop_forever(std::string s, int period_s = 1 );
+
+    bool debug_print_async_begin(size_t n_slots = 64, debug_print_full_policy policy = debug_print_full_policy::drop, unsigned int task_priority = 1);
+    void debug_print_async_end();
+    bool debug_print_is_async();
+    bool debug_print_flush(unsigned long timeout_ms = 1000);
+    uint32_t debug_print_dropped_count();
+    log_file_sink * debug_print_set_file_sink(log_file_sink * sink);
+
+    log_level set_log_level(log_level level);
+    log_level get_log_level();
+    const char * log_level_to_string(log_level level);
+    void log_printf(log_level level, const char * format, ...) __attribute__((format(printf, 2, 3)));
+    void debug_print_bytes(const uint8_t * data, size_t length);
+
+    /*!
+    \brief Runtime check made by the BELUGA_LOG_* macros before any formatting.
+    */
+    inline bool log_level_enabled(log_level level)
+    {
+        return debug_print_enable && (uint8_t) level <= (uint8_t) debug_log_level;
+    }
    
-}
\ No newline at end of file
+}
+
+#if defined(BELUGA_LOG_BINARY)
+//Binary records instead of text: see beluga_log_binary.h
+#include "beluga_log_binary.h"
+#define BELUGA_LOG_AT(level, ...) BELUGA_LOG_BINARY_AT(level, __VA_ARGS__)
+#else
+#define BELUGA_LOG_AT(level, ...) do { if(beluga_utils::log_level_enabled(level)) { beluga_utils::log_printf(level, __VA_ARGS__); } } while(0)
+#endif
+
+#if BELUGA_LOG_COMPILE_LEVEL >= BELUGA_LOG_LEVEL_ERROR
+#define BELUGA_LOG_ERROR(...) BELUGA_LOG_AT(beluga_utils::log_level::error, __VA_ARGS__)
+#else
+#define BELUGA_LOG_ERROR(...) do {} while(0)
+#endif
+#if BELUGA_LOG_COMPILE_LEVEL >= BELUGA_LOG_LEVEL_WARN
+#define BELUGA_LOG_WARN(...) BELUGA_LOG_AT(beluga_utils::log_level::warn, __VA_ARGS__)
+#else
+#define BELUGA_LOG_WARN(...) do {} while(0)
+#endif
+#if BELUGA_LOG_COMPILE_LEVEL >= BELUGA_LOG_LEVEL_INFO
+#define BELUGA_LOG_INFO(...) BELUGA_LOG_AT(beluga_utils::log_level::info, __VA_ARGS__)
+#else
+#define BELUGA_LOG_INFO(...) do {} while(0)
+#endif
+#if BELUGA_LOG_COMPILE_LEVEL >= BELUGA_LOG_LEVEL_DEBUG
+#define BELUGA_LOG_DEBUG(...) BELUGA_LOG_AT(beluga_utils::log_level::debug, __VA_ARGS__)
+#else
+#define BELUGA_LOG_DEBUG(...) do {} while(0)
+#endif
+#if BELUGA_LOG_COMPILE_LEVEL >= BELUGA_LOG_LEVEL_TRACE
+#define BELUGA_LOG_TRACE(...) BELUGA_LOG_AT(beluga_utils::log_level::trace, __VA_ARGS__)
+#else
+#define BELUGA_LOG_TRACE(...) do {} while(0)
+#endif
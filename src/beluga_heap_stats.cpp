@@ -0,0 +1,243 @@
+#include "beluga_heap_stats.h"
+
+#if defined(BELUGA_HEAP_STATS)
+#include <Arduino.h>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#if !defined(BELUGA_NATIVE)
+#include "esp_heap_caps.h"
+#endif
+
+namespace beluga_utils
+{
+  static std::atomic<uint32_t> heap_allocations(0);
+  static std::atomic<uint64_t> heap_bytes_allocated(0);
+  static std::atomic<int64_t> heap_live_bytes(0);
+  static std::atomic<int64_t> heap_peak_live_bytes(0);
+  static heap_stats entry_stats[(size_t) heap_stats_entry::n_entries];
+
+  /*!
+  \brief Record an allocation. Called from the host operator new or the ESP-IDF alloc hook.
+  */
+  static void count_allocation(size_t size)
+  {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    heap_bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+    int64_t live = heap_live_bytes.fetch_add((int64_t) size, std::memory_order_relaxed) + (int64_t) size;
+    int64_t peak = heap_peak_live_bytes.load(std::memory_order_relaxed);
+    while(live > peak && !heap_peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  static void count_free(size_t size)
+  {
+    heap_live_bytes.fetch_sub((int64_t) size, std::memory_order_relaxed);
+  }
+
+  static size_t free_heap_bytes()
+  {
+#if defined(BELUGA_NATIVE)
+    return 0;
+#else
+    return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+#endif
+  }
+
+  static size_t min_free_heap_bytes()
+  {
+#if defined(BELUGA_NATIVE)
+    return 0;
+#else
+    return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+#endif
+  }
+
+  /*!
+  \brief Start measuring a call.
+  \details The global peak is reset to the current live bytes so that this scope sees only its own peak;
+  the previous peak is restored (as a maximum) when the scope ends, so enclosing scopes still see theirs.
+  */
+  heap_stats_scope::heap_stats_scope(heap_stats_entry entry)
+  {
+    _entry = entry;
+    _start_allocations = heap_allocations.load(std::memory_order_relaxed);
+    _start_bytes_allocated = heap_bytes_allocated.load(std::memory_order_relaxed);
+    _start_live_bytes = heap_live_bytes.load(std::memory_order_relaxed);
+    _saved_peak_live_bytes = heap_peak_live_bytes.exchange(_start_live_bytes, std::memory_order_relaxed);
+    _start_free_bytes = free_heap_bytes();
+    _start_min_free_bytes = min_free_heap_bytes();
+  }
+
+  heap_stats_scope::~heap_stats_scope()
+  {
+    heap_stats & stats = entry_stats[(size_t) _entry];
+    uint32_t allocations = heap_allocations.load(std::memory_order_relaxed) - _start_allocations;
+    int64_t live = heap_live_bytes.load(std::memory_order_relaxed);
+    int64_t peak_live = heap_peak_live_bytes.load(std::memory_order_relaxed);
+    stats.calls++;
+    stats.allocations += allocations;
+    stats.bytes_allocated += heap_bytes_allocated.load(std::memory_order_relaxed) - _start_bytes_allocated;
+
+    int64_t net_bytes = live - _start_live_bytes;
+    int64_t peak_bytes = peak_live - _start_live_bytes;
+#if !defined(BELUGA_NATIVE)
+    if(allocations == 0)
+    {
+      //No allocation hooks: fall back to heap_caps free sizes
+      net_bytes = (int64_t) _start_free_bytes - (int64_t) free_heap_bytes();
+      size_t min_free = min_free_heap_bytes();
+      peak_bytes = (min_free < _start_min_free_bytes) ? (int64_t) (_start_free_bytes - min_free) : net_bytes;
+    }
+#endif
+    stats.net_bytes += net_bytes;
+    if(peak_bytes > 0 && (size_t) peak_bytes > stats.peak_bytes)
+    {
+      stats.peak_bytes = (size_t) peak_bytes;
+    }
+
+    int64_t restored_peak = (_saved_peak_live_bytes > peak_live) ? _saved_peak_live_bytes : peak_live;
+    heap_peak_live_bytes.store(restored_peak, std::memory_order_relaxed);
+  }
+
+  const heap_stats & get_heap_stats(heap_stats_entry entry)
+  {
+    return entry_stats[(size_t) entry];
+  }
+
+  const char * heap_stats_entry_name(heap_stats_entry entry)
+  {
+    switch(entry)
+    {
+      case heap_stats_entry::ini_initialise:
+        return "ini_reader::initialise";
+      case heap_stats_entry::ini_get_config_value:
+        return "ini_reader::get_config_value";
+      case heap_stats_entry::ini_get_config_list_field:
+        return "ini_reader::get_config_list_field";
+      case heap_stats_entry::debug_print:
+        return "debug_print";
+      case heap_stats_entry::n_entries:
+        break;
+    }
+    return "unknown";
+  }
+
+  void reset_heap_stats()
+  {
+    for(size_t i = 0; i < (size_t) heap_stats_entry::n_entries; i++)
+    {
+      entry_stats[i] = heap_stats();
+    }
+  }
+
+  /*!
+  \brief Print one line per entry point: calls, allocations, bytes allocated, net bytes kept, peak bytes.
+  */
+  void print_heap_stats_to_serial()
+  {
+    Serial.println("Heap stats: entry, calls, allocations, bytes allocated, net bytes, peak bytes");
+    for(size_t i = 0; i < (size_t) heap_stats_entry::n_entries; i++)
+    {
+      const heap_stats & stats = entry_stats[i];
+      Serial.printf("%s, %lu, %lu, %llu, %lld, %lu\n", heap_stats_entry_name((heap_stats_entry) i),
+        (unsigned long) stats.calls, (unsigned long) stats.allocations, (unsigned long long) stats.bytes_allocated,
+        (long long) stats.net_bytes, (unsigned long) stats.peak_bytes);
+    }
+#if !defined(BELUGA_NATIVE)
+    Serial.printf("Free heap %lu, minimum ever %lu\n", (unsigned long) free_heap_bytes(), (unsigned long) min_free_heap_bytes());
+#endif
+  }
+}
+
+#if defined(BELUGA_NATIVE)
+/*
+Host allocator hook: replace the global operator new/delete with versions that record the size in a small header.
+*/
+static const size_t heap_stats_header_size = 16; //Keeps the returned pointer aligned to max_align_t
+
+static void * counted_malloc(size_t size)
+{
+  unsigned char * block = (unsigned char *) malloc(size + heap_stats_header_size);
+  if(block == nullptr)
+  {
+    return nullptr;
+  }
+  *(size_t *) block = size;
+  beluga_utils::count_allocation(size);
+  return block + heap_stats_header_size;
+}
+
+static void counted_free(void * ptr)
+{
+  if(ptr == nullptr)
+  {
+    return;
+  }
+  unsigned char * block = (unsigned char *) ptr - heap_stats_header_size;
+  beluga_utils::count_free(*(size_t *) block);
+  free(block);
+}
+
+void * operator new(size_t size)
+{
+  void * ptr = counted_malloc(size);
+  if(ptr == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void * operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_malloc(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_malloc(size);
+}
+
+void operator delete(void * ptr) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void * ptr) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void * ptr, size_t) noexcept
+{
+  counted_free(ptr);
+}
+
+#elif defined(CONFIG_HEAP_USE_HOOKS)
+/*
+ESP-IDF heap hooks (IDF 5.1+, CONFIG_HEAP_USE_HOOKS=y). These see every heap_caps allocation, including malloc.
+*/
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void * ptr, size_t size, uint32_t caps)
+{
+  beluga_utils::count_allocation(size);
+}
+
+extern "C" void IRAM_ATTR esp_heap_trace_free_hook(void * ptr)
+{
+  beluga_utils::count_free(heap_caps_get_allocated_size(ptr));
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/*!
+\brief Opt-in heap instrumentation for library entry points
+\author Bryan Clarke
+\date 17/10/2026
+\details Build with -DBELUGA_HEAP_STATS to count, per entry point (ini_reader::initialise, get_config_value,
+get_config_list_field, debug_print): calls, allocations, bytes allocated, net bytes kept and peak bytes in use
+during the call. Without the flag BELUGA_HEAP_SCOPE expands to nothing and beluga_heap_stats.cpp compiles to an
+empty object.
+Where the numbers come from:
+- Host (BELUGA_NATIVE): global operator new/delete are replaced with counting versions.
+- ESP32 with CONFIG_HEAP_USE_HOOKS: the ESP-IDF heap alloc/free hooks count every allocation.
+- ESP32 without hooks: heap_caps free-size before/after gives the net bytes, and the drop in the minimum-ever free
+  size gives the peak (only when the call sets a new low-water mark). Allocation counts read 0.
+Counters are global, so allocations made by other tasks during a call are included. Scopes may nest; each
+reports inclusive figures.
+Usage:
+platformio.ini: build_flags = -DBELUGA_HEAP_STATS
+...after some work...
+beluga_utils::print_heap_stats_to_serial();
+*/
+namespace beluga_utils
+{
+    enum class heap_stats_entry : uint8_t
+    {
+        ini_initialise = 0,
+        ini_get_config_value,
+        ini_get_config_list_field,
+        debug_print,
+        n_entries
+    };
+
+    struct heap_stats
+    {
+        uint32_t calls;
+        uint32_t allocations;
+        uint64_t bytes_allocated;
+        int64_t net_bytes;  //Bytes still allocated after the calls returned, summed over calls
+        size_t peak_bytes;  //Largest heap growth seen during any single call
+    };
+
+#if defined(BELUGA_HEAP_STATS)
+    class heap_stats_scope
+    {
+        public:
+            heap_stats_scope(heap_stats_entry entry);
+            ~heap_stats_scope();
+
+        protected:
+            heap_stats_entry _entry;
+            uint32_t _start_allocations;
+            uint64_t _start_bytes_allocated;
+            int64_t _start_live_bytes;
+            int64_t _saved_peak_live_bytes;
+            size_t _start_free_bytes;
+            size_t _start_min_free_bytes;
+    };
+
+    const heap_stats & get_heap_stats(heap_stats_entry entry);
+    const char * heap_stats_entry_name(heap_stats_entry entry);
+    void reset_heap_stats();
+    void print_heap_stats_to_serial();
+#endif
+}
+
+#if defined(BELUGA_HEAP_STATS)
+#define BELUGA_HEAP_SCOPE(entry) beluga_utils::heap_stats_scope beluga_heap_scope(beluga_utils::heap_stats_entry::entry)
+#else
+#define BELUGA_HEAP_SCOPE(entry) do {} while(0)
+#endif
@@ -0,0 +1,193 @@
+#include "beluga_ini_arena.h"
+#include "beluga_ini_visitor.h"
+#include <string.h>
+
+namespace beluga_utils
+{
+  static ini_span make_span(size_t start, size_t end)
+  {
+    ini_span s;
+    s.offset = (uint32_t) start;
+    s.length = (uint32_t) (end - start);
+    return s;
+  }
+
+  /*!
+  \brief Read a whole .ini file into the arena and index it.
+  @param this_file an open, readable file. It is read from its current position to the end.
+  @param size_hint optional; an arena loaded from (most likely) the same file, e.g. the one a reload replaces.
+  Its table sizes are reserved and the counting scan is skipped. A table grows if the file now holds more.
+  \return True if the file was read completely. False if the file is not open or the read came up short.
+  \details Any previously loaded data is released first. Without a hint the buffer is scanned twice: once to
+  count sections and entries so the tables can be reserved exactly, and once to fill them.
+  */
+  bool ini_arena::load(File & this_file, const ini_arena * size_hint)
+  {
+    clear();
+    if(!this_file)
+    {
+      return false;
+    }
+    size_t file_size = this_file.size() - this_file.position();
+    _buffer.resize(file_size + 1); //+1 so every span, including one ending at EOF, has room for its '\0'
+    size_t n_bytes_read = this_file.read((uint8_t *) _buffer.data(), file_size);
+    if(n_bytes_read != file_size)
+    {
+      clear();
+      return false;
+    }
+    _buffer[file_size] = '\0';
+
+    size_t n_sections = 0;
+    size_t n_entries = 0;
+    if(size_hint != nullptr)
+    {
+      n_sections = size_hint->section_count();
+      n_entries = size_hint->entry_count();
+    }else{
+      parse_buffer(true, &n_sections, &n_entries);
+    }
+    _sections.reserve(n_sections);
+    _entries.reserve(n_entries);
+    parse_buffer(false, &n_sections, &n_entries);
+
+    _load_stats.allocation_count = 1 + (n_sections > 0 ? 1 : 0) + (n_entries > 0 ? 1 : 0);
+    _load_stats.bytes_used = _buffer.capacity()
+      + _sections.capacity() * sizeof(ini_arena_section)
+      + _entries.capacity() * sizeof(ini_arena_entry);
+    return true;
+  }
+
+  /*!
+  \brief Walk the buffer line by line, recognising section headings and key = value pairs.
+  @param count_only if True, only count sections and entries. If False, also fill the tables and write the
+  '\0' terminators into the buffer.
+  \details Each line goes through classify_ini_line, the same grammar ini_reader::visit uses.
+  Key/value pairs that appear before the first heading go into a section with an empty name.
+  */
+  void ini_arena::parse_buffer(bool count_only, size_t * n_sections, size_t * n_entries)
+  {
+    char * buf = _buffer.data();
+    const size_t text_len = _buffer.size() - 1;
+    bool have_section = false;
+    *n_sections = 0;
+    *n_entries = 0;
+
+    size_t line_start = 0;
+    while(line_start < text_len)
+    {
+      const char * newline = (const char *) memchr(buf + line_start, '\n', text_len - line_start);
+      size_t line_end = newline ? (size_t) (newline - buf) : text_len;
+      ini_line this_line = classify_ini_line(buf + line_start, line_end - line_start);
+      line_start = line_end + 1;
+
+      if(this_line.type == ini_line_type::section)
+      {
+        if(!count_only)
+        {
+          size_t name_start = (size_t) (this_line.name - buf);
+          ini_arena_section this_section;
+          this_section.name = make_span(name_start, name_start + this_line.name_length);
+          this_section.parent = make_span(text_len, text_len);
+          if(this_line.parent != nullptr)
+          {
+            size_t parent_start = (size_t) (this_line.parent - buf);
+            buf[parent_start + this_line.parent_length] = '\0'; //Overwrites the ']' or a space before it
+            this_section.parent = make_span(parent_start, parent_start + this_line.parent_length);
+          }
+          buf[name_start + this_line.name_length] = '\0'; //Overwrites the ']', the ':' or a space before it
+          this_section.first_entry = (uint32_t) _entries.size();
+          this_section.entry_count = 0;
+          _sections.push_back(this_section);
+        }
+        (*n_sections)++;
+        have_section = true;
+        continue;
+      }
+      if(this_line.type != ini_line_type::key_value)
+      {
+        continue;
+      }
+
+      if(!have_section)
+      {
+        //Keys before any heading belong to the unnamed section. Point its name at the final '\0'.
+        if(!count_only)
+        {
+          ini_arena_section this_section;
+          this_section.name = make_span(text_len, text_len);
+          this_section.parent = make_span(text_len, text_len);
+          this_section.first_entry = (uint32_t) _entries.size();
+          this_section.entry_count = 0;
+          _sections.push_back(this_section);
+        }
+        (*n_sections)++;
+        have_section = true;
+      }
+
+      if(!count_only)
+      {
+        size_t key_start = (size_t) (this_line.name - buf);
+        size_t value_start = (size_t) (this_line.value - buf);
+        buf[key_start + this_line.name_length] = '\0';
+        buf[value_start + this_line.value_length] = '\0';
+        ini_arena_entry this_entry;
+        this_entry.key = make_span(key_start, key_start + this_line.name_length);
+        this_entry.value = make_span(value_start, value_start + this_line.value_length);
+        _entries.push_back(this_entry);
+        _sections.back().entry_count++;
+      }
+      (*n_entries)++;
+    }
+  }
+
+  bool ini_arena::span_equals(ini_span s, const char * str, size_t str_len) const
+  {
+    return (s.length == str_len) && (memcmp(span_c_str(s), str, str_len) == 0);
+  }
+
+  /*!
+  \brief Find the value for a section-key pair.
+  @param section_name the section, without [square braces]
+  @param key_name the key within that section
+  @param return_value set to the span of the value if found. Untouched otherwise.
+  \return True if the section-key pair is present.
+  \details If a section or key appears more than once, the last one in the file wins, matching the
+  nested_map storage where later assignments overwrite earlier ones.
+  */
+  bool ini_arena::find_value(const char * section_name, const char * key_name, ini_span * return_value) const
+  {
+    size_t section_len = strlen(section_name);
+    size_t key_len = strlen(key_name);
+    for(size_t i = _sections.size(); i > 0; i--)
+    {
+      const ini_arena_section & this_section = _sections[i - 1];
+      if(!span_equals(this_section.name, section_name, section_len))
+      {
+        continue;
+      }
+      for(size_t j = this_section.entry_count; j > 0; j--)
+      {
+        const ini_arena_entry & this_entry = _entries[this_section.first_entry + j - 1];
+        if(span_equals(this_entry.key, key_name, key_len))
+        {
+          *return_value = this_entry.value;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /*!
+  \brief Release the buffer and tables.
+  */
+  void ini_arena::clear()
+  {
+    std::vector<char>().swap(_buffer);
+    std::vector<ini_arena_section>().swap(_sections);
+    std::vector<ini_arena_entry>().swap(_entries);
+    _load_stats.bytes_used = 0;
+    _load_stats.allocation_count = 0;
+  }
+}
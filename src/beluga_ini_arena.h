@@ -0,0 +1,91 @@
+#pragma once
+#include "FS.h"
+#include "beluga_ini_index.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace beluga_utils
+{
+    /*!
+    \brief Offset/length record pointing into an ini_arena buffer.
+    \details The bytes at [offset, offset + length) are the text; the byte at offset + length is always '\0',
+    so span data can be used directly as a C string.
+    */
+    struct ini_span
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    /*!
+    \brief A key = value pair, stored as two spans into the arena buffer.
+    */
+    struct ini_arena_entry
+    {
+        ini_span key;
+        ini_span value;
+    };
+
+    /*!
+    \brief A [section] and the contiguous run of entries that belong to it.
+    */
+    struct ini_arena_section
+    {
+        ini_span name;
+        ini_span parent;    //[name : parent]; zero length if the heading names no parent
+        uint32_t first_entry;
+        uint32_t entry_count;
+    };
+
+    /*!
+    \brief Memory used by one load of an .ini file.
+    \details bytes_used is the heap held by the loaded config, allocation_count is the number of heap allocations
+    the load made. For the nested_map storage mode these are estimates; for arena storage they are exact.
+    */
+    struct ini_load_stats
+    {
+        size_t bytes_used;
+        size_t allocation_count;
+    };
+
+    /*!
+    \brief Contiguous, zero-copy storage for an .ini file
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details The whole file is read into one buffer. Lines are parsed in place: sections and key/value pairs
+    become offset/length records into that buffer, and the trailing whitespace / '=' / ']' after each
+    field is overwritten with '\0'. A load makes exactly three heap allocations (buffer, section table,
+    entry table) however many keys the file holds (more if a size_hint holds fewer than the file).
+    Usage:
+    ini_arena arena;
+    File f = SPIFFS.open("/config.ini", "r");
+    arena.load(f);
+    ini_span val;
+    if(arena.find_value("my_device", "pin", &val)) { Serial.println(arena.span_c_str(val)); }
+    */
+    class ini_arena
+    {
+        public:
+            ini_arena(){};
+            bool load(File & this_file, const ini_arena * size_hint = nullptr);
+            void clear();
+            bool find_value(const char * section_name, const char * key_name, ini_span * return_value) const;
+            const char * span_c_str(ini_span s) const { return _buffer.data() + s.offset; }
+            std::string span_to_string(ini_span s) const { return std::string(span_c_str(s), s.length); }
+            ini_view span_view(ini_span s) const { ini_view v = {span_c_str(s), s.length}; return v; }
+            size_t section_count() const { return _sections.size(); }
+            size_t entry_count() const { return _entries.size(); }
+            const ini_arena_section & get_section(size_t i) const { return _sections[i]; }
+            const ini_arena_entry & get_entry(size_t i) const { return _entries[i]; }
+            ini_load_stats get_load_stats() const { return _load_stats; }
+
+        protected:
+            void parse_buffer(bool count_only, size_t * n_sections, size_t * n_entries);
+            bool span_equals(ini_span s, const char * str, size_t str_len) const;
+            std::vector<char> _buffer;
+            std::vector<ini_arena_section> _sections;
+            std::vector<ini_arena_entry> _entries;
+            ini_load_stats _load_stats = {0, 0};
+    };
+}
@@ -0,0 +1,846 @@
+#include "beluga_ini_blob.h"
+#include "beluga_debug.h"
+#include "beluga_log_file.h" //log_file_crc32
+#include <Arduino.h>
+#include <string.h>
+#include <map>
+#include <string>
+#if defined(BELUGA_NATIVE)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include "esp_partition.h"
+#include "esp_idf_version.h"
+#endif
+
+namespace beluga_utils
+{
+  static_assert(sizeof(ini_blob_header) == 64, "ini_blob_header layout changed: bump ini_blob_version");
+  static_assert(sizeof(ini_blob_entry) == 32, "ini_blob_entry layout changed: bump ini_blob_version");
+  static_assert(sizeof(ini_blob_token) == 8, "ini_blob_token layout changed: bump ini_blob_version");
+  static_assert(sizeof(ini_blob_list) == 12, "ini_blob_list layout changed: bump ini_blob_version");
+
+  static size_t align4(size_t n)
+  {
+    return (n + 3) & ~(size_t) 3;
+  }
+
+  /*!
+  \brief Strings of the blob being compiled, each stored once and '\0'-terminated.
+  */
+  class blob_string_table
+  {
+    public:
+      uint32_t add(const char * data, size_t length)
+      {
+        std::string this_string(data, length);
+        auto iter = _offsets.find(this_string);
+        if(iter != _offsets.end())
+        {
+          return iter->second;
+        }
+        uint32_t offset = (uint32_t) _text.size();
+        _text.insert(_text.end(), data, data + length);
+        _text.push_back('\0');
+        _offsets[this_string] = offset;
+        return offset;
+      }
+      const std::vector<char> & text() const { return _text; }
+
+    protected:
+      std::vector<char> _text;
+      std::map<std::string, uint32_t> _offsets;
+  };
+
+  /*!
+  \brief Store the first conversion of a value that succeeds in scalar, and mark each typed getter whose result
+  follows from it exactly. The reader parses the value for the rest.
+  */
+  static void convert_scalar(const char * first, const char * last, ini_blob_entry * blob_entry)
+  {
+    bool bool_value = false;
+    int32_t int_value = 0;
+    float float_value = 0.0f;
+    uint32_t duration_ms = 0;
+    ini_ipv4 ipv4 = {{0, 0, 0, 0}};
+    bool bool_ok = parse_bool(first, last, &bool_value) == ini_error::ok;
+    bool int_ok = parse_int(first, last, &int_value) == ini_error::ok;
+    bool float_ok = parse_float(first, last, &float_value) == ini_error::ok;
+    bool duration_ok = parse_duration_ms(first, last, &duration_ms) == ini_error::ok;
+    bool ipv4_ok = parse_ipv4(first, last, &ipv4) == ini_error::ok;
+    ini_value_type scalar_type = ini_value_type::none;
+    uint8_t served = 0;
+    if(int_ok)
+    {
+      scalar_type = ini_value_type::integer;
+      blob_entry->scalar.as_int = int_value;
+      float as_float = (float) int_value;
+      served = ini_blob_serves_int;
+      served |= (float_ok && memcmp(&as_float, &float_value, sizeof(float)) == 0) ? ini_blob_serves_float : 0;
+      served |= (duration_ok && int_value >= 0 && (uint32_t) int_value == duration_ms) ? ini_blob_serves_duration : 0;
+      served |= (bool_ok && (int_value != 0) == bool_value) ? ini_blob_serves_bool : 0;
+    }else if(float_ok){
+      scalar_type = ini_value_type::floating;
+      blob_entry->scalar.as_float = float_value;
+      served = ini_blob_serves_float;
+    }else if(duration_ok){
+      scalar_type = ini_value_type::duration_ms;
+      blob_entry->scalar.as_duration_ms = duration_ms;
+      served = ini_blob_serves_duration;
+    }else if(ipv4_ok){
+      scalar_type = ini_value_type::ipv4;
+      memcpy(blob_entry->scalar.as_ipv4, ipv4.octets, sizeof(ipv4.octets));
+      served = ini_blob_serves_ipv4;
+    }else if(bool_ok){
+      scalar_type = ini_value_type::boolean;
+      blob_entry->scalar.as_bool = bool_value ? 1 : 0;
+      served = ini_blob_serves_bool;
+    }
+    blob_entry->scalar_type = (uint8_t) scalar_type;
+    blob_entry->served = served;
+  }
+
+  /*!
+  \brief Convert one index entry to a blob entry under section (its own, or a section inheriting it) and append it.
+  */
+  static bool add_blob_entry(const ini_index & source, ini_handle handle, ini_view section, blob_string_table * strings,
+    std::vector<ini_blob_entry> * entries, std::vector<ini_blob_list> * lists, std::vector<ini_blob_token> * tokens, std::vector<int32_t> * ints)
+  {
+    const ini_index_entry & this_entry = source.get_entry(handle);
+    if(section.length > 0xFFFF || this_entry.key.length > 0xFFFF)
+    {
+      BELUGA_LOG_ERROR("ini_blob_compile: section or key too long in [%.*s]", (int) std::min(section.length, (size_t) 64), section.data);
+      return false;
+    }
+    ini_blob_entry blob_entry;
+    memset(&blob_entry, 0, sizeof(blob_entry));
+    blob_entry.hash = ini_index::hash_pair(section.data, section.length, this_entry.key.data, this_entry.key.length);
+    blob_entry.section = strings->add(section.data, section.length);
+    blob_entry.section_length = (uint16_t) section.length;
+    blob_entry.key = strings->add(this_entry.key.data, this_entry.key.length);
+    blob_entry.key_length = (uint16_t) this_entry.key.length;
+    blob_entry.value.offset = strings->add(this_entry.value.data, this_entry.value.length);
+    blob_entry.value.length = (uint32_t) this_entry.value.length;
+
+    ini_list_view list;
+    source.get_list(handle, &list);
+    bool list_is_value = list.size() == 0 || (list.size() == 1 && list[0].data == this_entry.value.data && list[0].length == this_entry.value.length);
+    if(list_is_value)
+    {
+      convert_scalar(this_entry.value.data, this_entry.value.data + this_entry.value.length, &blob_entry);
+    }else{
+      //A real list: its tokens go in the list table. The scalar getters parse the value, and (with a delimiter
+      //in it) fail.
+      ini_blob_list blob_list;
+      memset(&blob_list, 0, sizeof(blob_list));
+      blob_list.first = (uint32_t) tokens->size();
+      blob_list.count = (uint32_t) list.size();
+      blob_list.list_int_error = (uint8_t) ini_error::ok;
+      for(const ini_view & token : list)
+      {
+        ini_blob_token blob_token = {strings->add(token.data, token.length), (uint32_t) token.length};
+        tokens->push_back(blob_token);
+        int32_t int_value = 0;
+        ini_error err = parse_int(token.data, token.data + token.length, &int_value);
+        if(err != ini_error::ok && blob_list.list_int_error == (uint8_t) ini_error::ok)
+        {
+          blob_list.list_int_error = (uint8_t) err;
+        }
+        ints->push_back(int_value);
+      }
+      blob_entry.scalar.list_index = (uint32_t) lists->size();
+      blob_entry.scalar_type = (uint8_t) ini_value_type::none;
+      blob_entry.served = ini_blob_list_entry;
+      lists->push_back(blob_list);
+    }
+    entries->push_back(blob_entry);
+    return true;
+  }
+
+  /*!
+  \brief Handles of the keys a section inherits (and does not override), gathered through ini_index::for_each_key.
+  */
+  struct inherited_keys
+  {
+    const ini_index * source;
+    ini_view section;
+    std::vector<ini_handle> handles;
+  };
+
+  static void collect_inherited_key(void * context, ini_view key, ini_view)
+  {
+    inherited_keys * inherited = (inherited_keys *) context;
+    ini_handle handle = inherited->source->find(inherited->section.data, inherited->section.length, key.data, key.length);
+    const ini_view & owner = inherited->source->get_entry(handle).section;
+    if(owner.length != inherited->section.length || memcmp(owner.data, inherited->section.data, owner.length) != 0)
+    {
+      inherited->handles.push_back(handle);
+    }
+  }
+
+  /*!
+  \brief Compile the section-key pairs of an index into a blob that ini_blob_reader can read in place.
+  \details Where a pair is repeated only the value a lookup returns is kept. Each value is converted once, here,
+  to the first of int, float, duration, IPv4 and bool it parses as, and the entry records which getters that one
+  conversion answers; the reader parses the value for any other. List values are split as ini_index splits them,
+  and only those with more than one token (or a token that is not the whole value) get a list table entry.
+  Inheritance ([child : parent]) is flattened: the child gets an entry of its own for each key it inherits, so
+  the reader needs no chain to follow. Strings are stored once, so this costs one entry (32 bytes of flash) per
+  inherited key, and no RAM.
+  Meant to run on the host (see example/ini_compile), but works anywhere there is the RAM.
+  \return False if a section or key is longer than 65535 characters or the blob would pass 4 GB.
+  Usage:
+  std::vector<uint8_t> blob;
+  ini_blob_compile(index, &blob);
+  */
+  bool ini_blob_compile(const ini_index & source, std::vector<uint8_t> * blob)
+  {
+    blob_string_table strings;
+    std::vector<ini_blob_entry> entries;
+    std::vector<ini_blob_list> lists;
+    std::vector<ini_blob_token> tokens;
+    std::vector<int32_t> ints;
+    for(uint32_t i = 0; i < source.size(); i++)
+    {
+      ini_handle handle = {i};
+      const ini_index_entry & this_entry = source.get_entry(handle);
+      if(source.find_own(this_entry.section.data, this_entry.section.length, this_entry.key.data, this_entry.key.length).entry != i)
+      {
+        continue; //A later duplicate wins
+      }
+      if(!add_blob_entry(source, handle, this_entry.section, &strings, &entries, &lists, &tokens, &ints))
+      {
+        return false;
+      }
+    }
+    for(size_t i = 0; i < source.parent_count(); i++)
+    {
+      inherited_keys inherited;
+      inherited.source = &source;
+      inherited.section = source.get_parent(i).section;
+      source.for_each_key(inherited.section.data, inherited.section.length, collect_inherited_key, &inherited);
+      for(size_t j = 0; j < inherited.handles.size(); j++)
+      {
+        if(!add_blob_entry(source, inherited.handles[j], inherited.section, &strings, &entries, &lists, &tokens, &ints))
+        {
+          return false;
+        }
+      }
+    }
+
+    //The same table ini_index builds: linear probing, at most half full
+    size_t n_slots = 1;
+    while(n_slots < 2 * entries.size())
+    {
+      n_slots <<= 1;
+    }
+    std::vector<uint32_t> slots(n_slots, ini_handle::invalid_entry);
+    for(uint32_t i = 0; i < entries.size(); i++)
+    {
+      uint32_t slot = entries[i].hash & (uint32_t) (n_slots - 1);
+      while(slots[slot] != ini_handle::invalid_entry)
+      {
+        slot = (slot + 1) & (uint32_t) (n_slots - 1);
+      }
+      slots[slot] = i;
+    }
+    //Two bytes a slot, unless an entry number could collide with the empty marker
+    size_t slot_bytes = entries.size() < ini_blob_empty_slot16 ? 2 : 4;
+
+    ini_blob_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ini_blob_magic;
+    header.version = ini_blob_version;
+    header.header_bytes = (uint16_t) sizeof(ini_blob_header);
+    header.n_entries = (uint32_t) entries.size();
+    header.n_slots = (uint32_t) n_slots;
+    header.slot_bytes = (uint32_t) slot_bytes;
+    header.n_lists = (uint32_t) lists.size();
+    header.n_tokens = (uint32_t) tokens.size();
+    uint64_t offset = align4(sizeof(ini_blob_header));
+    header.entries_offset = (uint32_t) offset;
+    offset += entries.size() * sizeof(ini_blob_entry);
+    header.slots_offset = (uint32_t) offset;
+    offset = align4((size_t) (offset + n_slots * slot_bytes));
+    header.lists_offset = (uint32_t) offset;
+    offset += lists.size() * sizeof(ini_blob_list);
+    header.tokens_offset = (uint32_t) offset;
+    offset += tokens.size() * sizeof(ini_blob_token);
+    header.ints_offset = (uint32_t) offset;
+    offset += ints.size() * sizeof(int32_t);
+    header.strings_offset = (uint32_t) offset;
+    offset = align4((size_t) (offset + strings.text().size()));
+    if(offset > 0xFFFFFFFFull)
+    {
+      BELUGA_LOG_ERROR("ini_blob_compile: config too large for a blob");
+      return false;
+    }
+    header.total_bytes = (uint32_t) offset;
+
+    blob->assign(header.total_bytes, 0);
+    uint8_t * p = blob->data();
+    if(!entries.empty())
+    {
+      memcpy(p + header.entries_offset, entries.data(), entries.size() * sizeof(ini_blob_entry));
+    }
+    for(size_t i = 0; i < n_slots; i++)
+    {
+      if(slot_bytes == 2)
+      {
+        uint16_t slot = slots[i] == ini_handle::invalid_entry ? ini_blob_empty_slot16 : (uint16_t) slots[i];
+        memcpy(p + header.slots_offset + i * 2, &slot, 2);
+      }else{
+        memcpy(p + header.slots_offset + i * 4, &slots[i], 4);
+      }
+    }
+    if(!lists.empty())
+    {
+      memcpy(p + header.lists_offset, lists.data(), lists.size() * sizeof(ini_blob_list));
+    }
+    if(!tokens.empty())
+    {
+      memcpy(p + header.tokens_offset, tokens.data(), tokens.size() * sizeof(ini_blob_token));
+      memcpy(p + header.ints_offset, ints.data(), ints.size() * sizeof(int32_t));
+    }
+    if(!strings.text().empty())
+    {
+      memcpy(p + header.strings_offset, strings.text().data(), strings.text().size());
+    }
+    header.crc32 = log_file_crc32(0, p + header.header_bytes, header.total_bytes - header.header_bytes);
+    header.header_crc32 = log_file_crc32(0, (const uint8_t *) &header, sizeof(header));
+    memcpy(p, &header, sizeof(header));
+    return true;
+  }
+
+  ini_blob_reader::~ini_blob_reader()
+  {
+    close();
+  }
+
+  /*!
+  \brief True if a table of count items of item_size bytes at offset is 4-byte aligned and inside the blob.
+  */
+  static bool table_fits(uint32_t offset, uint32_t count, size_t item_size, uint32_t total_bytes)
+  {
+    return (offset % 4 == 0) && ((uint64_t) offset + (uint64_t) count * item_size <= total_bytes);
+  }
+
+  /*!
+  \brief Use a blob that is already in memory (or mapped into the address space). Nothing is copied, so data must
+  stay put until close().
+  @param data 4-byte aligned.
+  \details The header's CRC and the table bounds are always checked, which costs next to nothing.
+  @param verify_crc also check the CRC of every byte of the blob. This reads all of it, and costs more than
+  parsing the .ini would; do it where the blob may have been damaged (e.g. once after writing a partition), as
+  the offsets inside entries are not otherwise checked.
+  \return False if data is not a blob of this version.
+  */
+  bool ini_blob_reader::open_memory(const void * data, size_t length, bool verify_crc)
+  {
+    close();
+    if(data == nullptr || length < sizeof(ini_blob_header) || ((uintptr_t) data % 4) != 0)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: no blob, or blob not 4-byte aligned");
+      return false;
+    }
+    const ini_blob_header * header = (const ini_blob_header *) data;
+    if(header->magic != ini_blob_magic || header->version != ini_blob_version || header->header_bytes != sizeof(ini_blob_header))
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: not a config blob of this version; recompile it");
+      return false;
+    }
+    ini_blob_header header_copy = *header;
+    header_copy.header_crc32 = 0;
+    if(log_file_crc32(0, (const uint8_t *) &header_copy, sizeof(header_copy)) != header->header_crc32)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: blob header CRC mismatch");
+      return false;
+    }
+    if(header->total_bytes > length || header->total_bytes < header->header_bytes
+      || header->n_slots == 0 || (header->n_slots & (header->n_slots - 1)) != 0 || header->n_slots < header->n_entries
+      || !table_fits(header->entries_offset, header->n_entries, sizeof(ini_blob_entry), header->total_bytes)
+      || (header->slot_bytes != 2 && header->slot_bytes != 4)
+      || (header->slot_bytes == 2 && header->n_entries >= ini_blob_empty_slot16)
+      || !table_fits(header->slots_offset, header->n_slots, header->slot_bytes, header->total_bytes)
+      || !table_fits(header->lists_offset, header->n_lists, sizeof(ini_blob_list), header->total_bytes)
+      || !table_fits(header->tokens_offset, header->n_tokens, sizeof(ini_blob_token), header->total_bytes)
+      || !table_fits(header->ints_offset, header->n_tokens, sizeof(int32_t), header->total_bytes)
+      || header->strings_offset > header->total_bytes)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: blob truncated or damaged");
+      return false;
+    }
+    const uint8_t * base = (const uint8_t *) data;
+    if(verify_crc && log_file_crc32(0, base + header->header_bytes, header->total_bytes - header->header_bytes) != header->crc32)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: blob CRC mismatch");
+      return false;
+    }
+    _header = header;
+    _entries = (const ini_blob_entry *) (base + header->entries_offset);
+    _slots = base + header->slots_offset;
+    _lists = (const ini_blob_list *) (base + header->lists_offset);
+    _tokens = (const ini_blob_token *) (base + header->tokens_offset);
+    _ints = (const int32_t *) (base + header->ints_offset);
+    _strings = (const char *) (base + header->strings_offset);
+    return true;
+  }
+
+#if defined(BELUGA_NATIVE)
+  /*!
+  \brief mmap() a blob file read-only. The page cache is shared with any other process mapping it; nothing is
+  read until a page is touched.
+  @param path a host path (not under the SPIFFS stand-in's root).
+  */
+  bool ini_blob_reader::open_file(const char * path, bool verify_crc)
+  {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: could not open %s", path);
+      return false;
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+    {
+      ::close(fd);
+      return false;
+    }
+    size_t length = (size_t) file_stat.st_size;
+    void * mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); //The mapping keeps the file
+    if(mapping == MAP_FAILED)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: could not map %s", path);
+      return false;
+    }
+    if(!open_memory(mapping, length, verify_crc))
+    {
+      munmap(mapping, length);
+      return false;
+    }
+    _mapping = mapping;
+    _mapping_bytes = length;
+    return true;
+  }
+#else
+  /*!
+  \brief Map a data partition holding a blob into the flash cache. Reads then come from flash through the cache;
+  the only RAM used is the MMU pages' worth of cache the reads touch.
+  \details The partition needs a line in the partition table, e.g. "config, data, 0x40, , 64K", and is written
+  with parttool.py write_partition --partition-name config --input config.bin (or esptool.py write_flash at its
+  offset). Only the blob's own length is mapped, in 64 KB MMU pages.
+  */
+  bool ini_blob_reader::open_partition(const char * partition_label, bool verify_crc)
+  {
+    close();
+    const esp_partition_t * partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+    if(partition == nullptr)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: no data partition labelled %s", partition_label);
+      return false;
+    }
+    ini_blob_header header;
+    if(esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK || header.magic != ini_blob_magic
+      || header.total_bytes < sizeof(header) || header.total_bytes > partition->size)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: no config blob in partition %s", partition_label);
+      return false;
+    }
+    const void * mapping = nullptr;
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, header.total_bytes, ESP_PARTITION_MMAP_DATA, &mapping, &handle);
+#else
+    spi_flash_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, header.total_bytes, SPI_FLASH_MMAP_DATA, &mapping, &handle);
+#endif
+    if(err != ESP_OK)
+    {
+      BELUGA_LOG_ERROR("ini_blob_reader: could not map partition %s", partition_label);
+      return false;
+    }
+    if(!open_memory(mapping, header.total_bytes, verify_crc))
+    {
+#if ESP_IDF_VERSION_MAJOR >= 5
+      esp_partition_munmap(handle);
+#else
+      spi_flash_munmap(handle);
+#endif
+      return false;
+    }
+    _mapping_handle = (uint32_t) handle;
+    _mapped = true;
+    return true;
+  }
+#endif
+
+  /*!
+  \brief Stop using the blob and unmap it if this reader mapped it. Views and handles from it are then invalid.
+  */
+  void ini_blob_reader::close()
+  {
+#if defined(BELUGA_NATIVE)
+    if(_mapping != nullptr)
+    {
+      munmap(_mapping, _mapping_bytes);
+    }
+#else
+    if(_mapped)
+    {
+#if ESP_IDF_VERSION_MAJOR >= 5
+      esp_partition_munmap((esp_partition_mmap_handle_t) _mapping_handle);
+#else
+      spi_flash_munmap((spi_flash_mmap_handle_t) _mapping_handle);
+#endif
+    }
+#endif
+    _mapping = nullptr;
+    _mapping_bytes = 0;
+    _mapping_handle = 0;
+    _mapped = false;
+    _header = nullptr;
+    _entries = nullptr;
+    _slots = nullptr;
+    _lists = nullptr;
+    _tokens = nullptr;
+    _ints = nullptr;
+    _strings = nullptr;
+  }
+
+  /*!
+  \brief Look up a section-key pair, as ini_index::find does, in the blob's own table.
+  \return A valid handle if present, otherwise a handle with is_valid() == false.
+  */
+  ini_handle ini_blob_reader::get_config_handle(const char * section_name, const char * key_name) const
+  {
+    ini_handle handle;
+    handle.entry = ini_handle::invalid_entry;
+    if(_header == nullptr)
+    {
+      return handle;
+    }
+    size_t section_len = strlen(section_name);
+    size_t key_len = strlen(key_name);
+    uint32_t hash = ini_index::hash_pair(section_name, section_len, key_name, key_len);
+    uint32_t slot_mask = _header->n_slots - 1;
+    uint32_t slot = hash & slot_mask;
+    uint32_t entry = slot_entry(slot);
+    for(uint32_t probes = 0; probes < _header->n_slots && entry != ini_handle::invalid_entry; probes++)
+    {
+      const ini_blob_entry & this_entry = _entries[entry];
+      if(this_entry.hash == hash && this_entry.section_length == section_len && this_entry.key_length == key_len
+        && memcmp(_strings + this_entry.section, section_name, section_len) == 0
+        && memcmp(_strings + this_entry.key, key_name, key_len) == 0)
+      {
+        handle.entry = entry;
+        return handle;
+      }
+      slot = (slot + 1) & slot_mask;
+      entry = slot_entry(slot);
+    }
+    return handle;
+  }
+
+  /*!
+  \brief The entry number in a hash slot, or ini_handle::invalid_entry if it is empty.
+  */
+  uint32_t ini_blob_reader::slot_entry(uint32_t slot) const
+  {
+    if(_header->slot_bytes == 2)
+    {
+      uint16_t entry;
+      memcpy(&entry, _slots + slot * 2, 2);
+      return entry == ini_blob_empty_slot16 ? ini_handle::invalid_entry : entry;
+    }
+    uint32_t entry;
+    memcpy(&entry, _slots + slot * 4, 4);
+    return entry;
+  }
+
+  ini_view ini_blob_reader::value_of(const ini_blob_entry * this_entry) const
+  {
+    ini_view value = {_strings + this_entry->value.offset, this_entry->value.length};
+    return value;
+  }
+
+  const ini_blob_entry * ini_blob_reader::find_entry(ini_handle handle) const
+  {
+    if(_header == nullptr || !handle.is_valid() || handle.entry >= _header->n_entries)
+    {
+      return nullptr;
+    }
+    return &_entries[handle.entry];
+  }
+
+  bool ini_blob_reader::get_config_value(ini_handle handle, ini_view * return_config_value) const
+  {
+    const ini_blob_entry * this_entry = find_entry(handle);
+    if(this_entry == nullptr)
+    {
+      return false;
+    }
+    *return_config_value = value_of(this_entry);
+    return true;
+  }
+
+  /*!
+  \brief Look up a section-key pair.
+  @param return_config_value set to a view into the blob, valid until close().
+  \return True if the pair is present.
+  */
+  bool ini_blob_reader::get_config_value(const char * section_name, const char * key_name, ini_view * return_config_value) const
+  {
+    return get_config_value(get_config_handle(section_name, key_name), return_config_value);
+  }
+
+  /*!
+  \brief Typed reads, as for ini_reader. Where the compiler's conversion of the value answers the getter (see
+  ini_blob_entry) it is a lookup and a load, otherwise the value is parsed where it lies.
+  */
+  ini_error ini_blob_reader::get_config_bool(ini_handle handle, bool * return_value) const
+  {
+    const ini_blob_entry * this_entry = find_entry(handle);
+    if(this_entry == nullptr)
+    {
+      return ini_error::not_found;
+    }
+    if(this_entry->served & ini_blob_serves_bool)
+    {
+      if(this_entry->scalar_type == (uint8_t) ini_value_type::integer)
+      {
+        *return_value = this_entry->scalar.as_int != 0;
+      }else{
+        *return_value = this_entry->scalar.as_bool != 0;
+      }
+      return ini_error::ok;
+    }
+    ini_view value = value_of(this_entry);
+    return parse_bool(value.data, value.data + value.length, return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_int(ini_handle handle, int32_t * return_value) const
+  {
+    const ini_blob_entry * this_entry = find_entry(handle);
+    if(this_entry == nullptr)
+    {
+      return ini_error::not_found;
+    }
+    if(this_entry->served & ini_blob_serves_int)
+    {
+      *return_value = this_entry->scalar.as_int;
+      return ini_error::ok;
+    }
+    ini_view value = value_of(this_entry);
+    return parse_int(value.data, value.data + value.length, return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_float(ini_handle handle, float * return_value) const
+  {
+    const ini_blob_entry * this_entry = find_entry(handle);
+    if(this_entry == nullptr)
+    {
+      return ini_error::not_found;
+    }
+    if(this_entry->served & ini_blob_serves_float)
+    {
+      if(this_entry->scalar_type == (uint8_t) ini_value_type::integer)
+      {
+        *return_value = (float) this_entry->scalar.as_int;
+      }else{
+        *return_value = this_entry->scalar.as_float;
+      }
+      return ini_error::ok;
+    }
+    ini_view value = value_of(this_entry);
+    return parse_float(value.data, value.data + value.length, return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_ipv4(ini_handle handle, ini_ipv4 * return_value) const
+  {
+    const ini_blob_entry * this_entry = find_entry(handle);
+    if(this_entry == nullptr)
+    {
+      return ini_error::not_found;
+    }
+    if(this_entry->served & ini_blob_serves_ipv4)
+    {
+      memcpy(return_value->octets, this_entry->scalar.as_ipv4, sizeof(return_value->octets));
+      return ini_error::ok;
+    }
+    ini_view value = value_of(this_entry);
+    return parse_ipv4(value.data, value.data + value.length, return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_duration_ms(ini_handle handle, uint32_t * return_value) const
+  {
+    const ini_blob_entry * this_entry = find_entry(handle);
+    if(this_entry == nullptr)
+    {
+      return ini_error::not_found;
+    }
+    if(this_entry->served & ini_blob_serves_duration)
+    {
+      if(this_entry->scalar_type == (uint8_t) ini_value_type::integer)
+      {
+        *return_value = (uint32_t) this_entry->scalar.as_int;
+      }else{
+        *return_value = this_entry->scalar.as_duration_ms;
+      }
+      return ini_error::ok;
+    }
+    ini_view value = value_of(this_entry);
+    return parse_duration_ms(value.data, value.data + value.length, return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_bool(const char * section_name, const char * key_name, bool * return_value) const
+  {
+    return get_config_bool(get_config_handle(section_name, key_name), return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_int(const char * section_name, const char * key_name, int32_t * return_value) const
+  {
+    return get_config_int(get_config_handle(section_name, key_name), return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_float(const char * section_name, const char * key_name, float * return_value) const
+  {
+    return get_config_float(get_config_handle(section_name, key_name), return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_ipv4(const char * section_name, const char * key_name, ini_ipv4 * return_value) const
+  {
+    return get_config_ipv4(get_config_handle(section_name, key_name), return_value);
+  }
+
+  ini_error ini_blob_reader::get_config_duration_ms(const char * section_name, const char * key_name, uint32_t * return_value) const
+  {
+    return get_config_duration_ms(get_config_handle(section_name, key_name), return_value);
+  }
+
+  /*!
+  \brief Lists, as for ini_reader. The tokens were split (and ints parsed) by the compiler; a value of one token
+  is its own list.
+  */
+  bool ini_blob_reader::get_config_list(ini_handle handle, ini_blob_list_view * return_list) const
+  {
+    const ini_blob_entry * this_entry = find_entry(handle);
+    if(this_entry == nullptr)
+    {
+      return false;
+    }
+    return_list->strings = _strings;
+    if(this_entry->served & ini_blob_list_entry)
+    {
+      const ini_blob_list & list = _lists[this_entry->scalar.list_index];
+      return_list->tokens = _tokens + list.first;
+      return_list->count = list.count;
+    }else{
+      return_list->tokens = &this_entry->value;
+      return_list->count = this_entry->value.length > 0 ? 1 : 0;
+    }
+    return true;
+  }
+
+  bool ini_blob_reader::get_config_list(const char * section_name, const char * key_name, ini_blob_list_view * return_list) const
+  {
+    return get_config_list(get_config_handle(section_name, key_name), return_list);
+  }
+
+  ini_error ini_blob_reader::get_config_int_list(ini_handle handle, ini_int_list_view * return_list) const
+  {
+    const ini_blob_entry * this_entry = find_entry(handle);
+    if(this_entry == nullptr)
+    {
+      return ini_error::not_found;
+    }
+    if(this_entry->served & ini_blob_list_entry)
+    {
+      const ini_blob_list & list = _lists[this_entry->scalar.list_index];
+      if(list.list_int_error != (uint8_t) ini_error::ok)
+      {
+        return (ini_error) list.list_int_error;
+      }
+      return_list->values = _ints + list.first;
+      return_list->count = list.count;
+      return ini_error::ok;
+    }
+    if(this_entry->value.length == 0)
+    {
+      return_list->values = nullptr;
+      return_list->count = 0;
+      return ini_error::ok;
+    }
+    if(!(this_entry->served & ini_blob_serves_int))
+    {
+      int32_t int_value;
+      ini_view value = value_of(this_entry);
+      return parse_int(value.data, value.data + value.length, &int_value);
+    }
+    return_list->values = &this_entry->scalar.as_int;
+    return_list->count = 1;
+    return ini_error::ok;
+  }
+
+  ini_error ini_blob_reader::get_config_int_list(const char * section_name, const char * key_name, ini_int_list_view * return_list) const
+  {
+    return get_config_int_list(get_config_handle(section_name, key_name), return_list);
+  }
+
+  /*!
+  \brief Call callback once for every key of a section, as ini_reader::for_each_key.
+  \return The number of keys.
+  */
+  size_t ini_blob_reader::for_each_key(const char * section_name, ini_key_callback callback, void * context) const
+  {
+    if(_header == nullptr)
+    {
+      return 0;
+    }
+    size_t section_len = strlen(section_name);
+    size_t n_keys = 0;
+    for(uint32_t i = 0; i < _header->n_entries; i++)
+    {
+      const ini_blob_entry & this_entry = _entries[i];
+      if(this_entry.section_length != section_len || memcmp(_strings + this_entry.section, section_name, section_len) != 0)
+      {
+        continue;
+      }
+      ini_view key = {_strings + this_entry.key, this_entry.key_length};
+      ini_view value = value_of(&this_entry);
+      callback(context, key, value);
+      n_keys++;
+    }
+    return n_keys;
+  }
+
+  /*!
+  \brief Print every section-key pair, in the order the compiler stored them (a section's keys together).
+  */
+  void ini_blob_reader::print_config_to_serial() const
+  {
+    if(_header == nullptr)
+    {
+      Serial.println("ini_blob_reader.print_config_to_serial: Cannot print, no blob open!");
+      return;
+    }
+    Serial.println("Printing config...");
+    uint32_t last_section = 0xFFFFFFFF;
+    for(uint32_t i = 0; i < _header->n_entries; i++)
+    {
+      const ini_blob_entry & this_entry = _entries[i];
+      if(this_entry.section != last_section)
+      {
+        Serial.println(_strings + this_entry.section);
+        last_section = this_entry.section;
+      }
+      Serial.print("\t");
+      Serial.print(_strings + this_entry.key);
+      Serial.print(" : ");
+      Serial.println(_strings + this_entry.value.offset);
+    }
+  }
+}
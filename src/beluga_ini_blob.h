@@ -0,0 +1,203 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "beluga_ini_index.h"
+#include "beluga_ini_parse.h"
+
+namespace beluga_utils
+{
+    const uint32_t ini_blob_magic = 0x494E4942;    //"BINI" little-endian
+    const uint16_t ini_blob_version = 2;
+    const uint16_t ini_blob_empty_slot16 = 0xFFFF;  //An empty slot, where slot_bytes is 2
+
+    /*!
+    \brief The first bytes of a compiled config blob.
+    \details All offsets are from the start of the blob, so the blob can be used wherever it is mapped. Every
+    table starts on a 4-byte boundary. Multi-byte fields are little-endian (the ESP32 and x86/ARM hosts alike).
+    */
+    struct ini_blob_header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t header_bytes;      //sizeof(ini_blob_header) of the compiler
+        uint32_t total_bytes;
+        uint32_t crc32;             //Of bytes [header_bytes, total_bytes)
+        uint32_t header_crc32;      //Of the header, with this field zero
+        uint32_t n_entries;
+        uint32_t n_slots;           //Hash slots: a power of two at least twice n_entries
+        uint32_t slot_bytes;        //2 (0xFFFF when empty) if n_entries < 0xFFFF, otherwise 4
+        uint32_t n_lists;           //Values of more than one token (or one that is not the whole value)
+        uint32_t n_tokens;          //Tokens of those lists
+        uint32_t entries_offset;    //n_entries ini_blob_entry
+        uint32_t slots_offset;      //n_slots entry numbers, slot_bytes each
+        uint32_t lists_offset;      //n_lists ini_blob_list
+        uint32_t tokens_offset;     //n_tokens ini_blob_token
+        uint32_t ints_offset;       //n_tokens int32_t, the tokens parsed as integers
+        uint32_t strings_offset;    //'\0'-terminated strings, each stored once
+    };
+
+    /*!
+    \brief A string in the string table.
+    */
+    struct ini_blob_token
+    {
+        uint32_t offset;            //Into the string table
+        uint32_t length;
+    };
+
+    //ini_blob_entry::served bits: the typed getters answered from scalar rather than by parsing the value
+    const uint8_t ini_blob_serves_bool = 0x01;
+    const uint8_t ini_blob_serves_int = 0x02;
+    const uint8_t ini_blob_serves_float = 0x04;
+    const uint8_t ini_blob_serves_duration = 0x08;
+    const uint8_t ini_blob_serves_ipv4 = 0x10;
+    const uint8_t ini_blob_list_entry = 0x80;      //scalar.list_index is the value's entry in the list table
+
+    union ini_blob_scalar
+    {
+        int32_t as_int;
+        float as_float;
+        uint32_t as_duration_ms;
+        uint8_t as_ipv4[4];
+        uint32_t as_bool;
+        uint32_t list_index;
+    };
+
+    /*!
+    \brief One section-key pair, with its value converted once by the compiler.
+    \details scalar holds the value's first successful conversion (int, then float, duration, IPv4, bool). The
+    compiler sets a served bit for each typed getter whose result follows from it exactly (e.g. "10" serves int,
+    float and duration), and the reader parses the value for the others, so the result is always that of parsing,
+    and a value that is no number costs no space for one. A list of one token that is the whole value is the value
+    itself; only other lists have a list table entry. String fields are offsets into the string table.
+    */
+    struct ini_blob_entry
+    {
+        uint32_t hash;              //ini_index::hash_pair of section and key
+        uint32_t section;
+        uint32_t key;
+        ini_blob_token value;
+        ini_blob_scalar scalar;
+        uint16_t section_length;
+        uint16_t key_length;
+        uint8_t scalar_type;        //ini_value_type of scalar (none for a list, or a value nothing converts)
+        uint8_t served;             //ini_blob_serves_* bits
+        uint16_t reserved;
+    };
+
+    /*!
+    \brief A list value's tokens, and their int32_t values where list_int_error is ok.
+    */
+    struct ini_blob_list
+    {
+        uint32_t first;             //First token in the token table (and int in the int table)
+        uint32_t count;
+        uint8_t list_int_error;     //ok if every token parsed as an int32_t
+        uint8_t reserved[3];
+    };
+
+    /*!
+    \brief Non-owning range over the tokens of a list value in a blob. Iterating yields ini_views.
+    Usage: for(beluga_utils::ini_view name : list) { ... }
+    */
+    struct ini_blob_list_view
+    {
+        struct iterator
+        {
+            const ini_blob_list_view * list;
+            size_t i;
+            ini_view operator*() const { return (*list)[i]; }
+            iterator & operator++() { i++; return *this; }
+            bool operator!=(const iterator & other) const { return i != other.i; }
+        };
+        const char * strings;
+        const ini_blob_token * tokens;
+        size_t count;
+        iterator begin() const { iterator it = {this, 0}; return it; }
+        iterator end() const { iterator it = {this, count}; return it; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        ini_view operator[](size_t i) const { ini_view token = {strings + tokens[i].offset, tokens[i].length}; return token; }
+    };
+
+    bool ini_blob_compile(const ini_index & source, std::vector<uint8_t> * blob);
+
+    /*!
+    \brief Reads a compiled config blob where it lies, without parsing or copying it
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details A blob is made on the host by ini_blob_compile (see example/ini_compile, or ini_reader::compile_blob):
+    the config's section-key pairs (with inherited keys copied into each [child : parent]), an open-addressing hash
+    table over them (the same as ini_index), list values already split and each value converted once (see
+    ini_blob_entry). Opening one checks the header's own CRC and that the tables lie inside the blob; pass verify_crc
+    to also check the CRC of every byte (e.g. once after flashing it). A lookup hashes the names and reads the
+    table, and a typed read is a load, or a parse for a type the value's stored conversion does not give.
+    Nothing is allocated, so the config costs almost no RAM wherever the blob lives:
+    - on the ESP32, a data partition memory-mapped into the flash cache by open_partition()
+    - on the host, a file mmap()ed by open_file()
+    - anywhere, a buffer passed to open_memory() (e.g. a const array compiled into the firmware)
+    The getters are those of ini_snapshot (const, and so safe from any task once opened). Views point into the
+    blob and stay valid until close().
+    Usage:
+    beluga_utils::ini_blob_reader config;
+    if(config.open_partition("config"))
+    {
+        int32_t pin;
+        config.get_config_int("my_device", "pin", &pin);
+    }
+    */
+    class ini_blob_reader
+    {
+        public:
+            ini_blob_reader(){};
+            ~ini_blob_reader();
+            bool open_memory(const void * data, size_t length, bool verify_crc = false);
+#if defined(BELUGA_NATIVE)
+            bool open_file(const char * path, bool verify_crc = false);
+#else
+            bool open_partition(const char * partition_label, bool verify_crc = false);
+#endif
+            void close();
+            bool is_open() const { return _header != nullptr; }
+            ini_handle get_config_handle(const char * section_name, const char * key_name) const;
+            bool get_config_value(const char * section_name, const char * key_name, ini_view * return_config_value) const;
+            bool get_config_value(ini_handle handle, ini_view * return_config_value) const;
+            ini_error get_config_bool(const char * section_name, const char * key_name, bool * return_value) const;
+            ini_error get_config_int(const char * section_name, const char * key_name, int32_t * return_value) const;
+            ini_error get_config_float(const char * section_name, const char * key_name, float * return_value) const;
+            ini_error get_config_ipv4(const char * section_name, const char * key_name, ini_ipv4 * return_value) const;
+            ini_error get_config_duration_ms(const char * section_name, const char * key_name, uint32_t * return_value) const;
+            ini_error get_config_bool(ini_handle handle, bool * return_value) const;
+            ini_error get_config_int(ini_handle handle, int32_t * return_value) const;
+            ini_error get_config_float(ini_handle handle, float * return_value) const;
+            ini_error get_config_ipv4(ini_handle handle, ini_ipv4 * return_value) const;
+            ini_error get_config_duration_ms(ini_handle handle, uint32_t * return_value) const;
+            bool get_config_list(const char * section_name, const char * key_name, ini_blob_list_view * return_list) const;
+            bool get_config_list(ini_handle handle, ini_blob_list_view * return_list) const;
+            ini_error get_config_int_list(const char * section_name, const char * key_name, ini_int_list_view * return_list) const;
+            ini_error get_config_int_list(ini_handle handle, ini_int_list_view * return_list) const;
+            size_t for_each_key(const char * section_name, ini_key_callback callback, void * context) const;
+            void print_config_to_serial() const;
+            size_t size() const { return _header ? _header->n_entries : 0; }
+            size_t blob_bytes() const { return _header ? _header->total_bytes : 0; }
+
+        protected:
+            ini_blob_reader(const ini_blob_reader &);
+            ini_blob_reader & operator=(const ini_blob_reader &);
+            const ini_blob_entry * find_entry(ini_handle handle) const;
+            uint32_t slot_entry(uint32_t slot) const;
+            ini_view value_of(const ini_blob_entry * this_entry) const;
+            const ini_blob_header * _header = nullptr;
+            const ini_blob_entry * _entries = nullptr;
+            const uint8_t * _slots = nullptr;
+            const ini_blob_list * _lists = nullptr;
+            const ini_blob_token * _tokens = nullptr;
+            const int32_t * _ints = nullptr;
+            const char * _strings = nullptr;
+            void * _mapping = nullptr;      //Host: the mmap()ed file, unmapped by close()
+            size_t _mapping_bytes = 0;
+            uint32_t _mapping_handle = 0;   //Device: the esp_partition_mmap handle, valid if _mapped
+            bool _mapped = false;
+    };
+}
@@ -0,0 +1,573 @@
+#include "beluga_ini_index.h"
+#include "beluga_debug.h"
+#include <string.h>
+#include <algorithm>
+
+namespace beluga_utils
+{
+  const uint32_t ini_handle::invalid_entry;
+
+  /*!
+  \brief 32-bit FNV-1a over section, a '\0' separator, then key.
+  \details The separator keeps ("ab", "c") and ("a", "bc") apart.
+  */
+  uint32_t ini_index::hash_pair(const char * section_name, size_t section_len, const char * key_name, size_t key_len)
+  {
+    const uint32_t fnv_prime = 16777619u;
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < section_len; i++)
+    {
+      hash = (hash ^ (uint8_t) section_name[i]) * fnv_prime;
+    }
+    hash = (hash ^ 0u) * fnv_prime;
+    for(size_t i = 0; i < key_len; i++)
+    {
+      hash = (hash ^ (uint8_t) key_name[i]) * fnv_prime;
+    }
+    return hash;
+  }
+
+  void ini_index::add_entry(ini_view section, ini_view key, ini_view value)
+  {
+    ini_index_entry this_entry;
+    this_entry.section = section;
+    this_entry.key = key;
+    this_entry.value = value;
+    this_entry.hash = hash_pair(section.data, section.length, key.data, key.length);
+    this_entry.cache_type = ini_value_type::none;
+    this_entry.cache_error = ini_error::ok;
+    this_entry.list_tokens = nullptr;
+    this_entry.list_count = 0;
+    this_entry.list_int_error = ini_error::ok;
+    _entries.push_back(this_entry);
+  }
+
+  /*!
+  \brief Record that section inherits parent's keys. Takes effect at the next build().
+  \details If a section is given a parent more than once, the last call wins. Both views must outlive the index.
+  */
+  void ini_index::add_parent(ini_view section, ini_view parent)
+  {
+    ini_section_parent this_parent;
+    this_parent.section = section;
+    this_parent.parent = parent;
+    this_parent.section_hash = hash_pair(section.data, section.length, "", 0);
+    this_parent.ancestors_first = 0;
+    this_parent.ancestors_count = 0;
+    _parents.push_back(this_parent);
+  }
+
+  static bool views_equal(const ini_view & a, const char * b, size_t b_len)
+  {
+    return (a.length == b_len) && (memcmp(a.data, b, b_len) == 0);
+  }
+
+  static int compare_views(const ini_view & a, const ini_view & b)
+  {
+    int result = memcmp(a.data, b.data, std::min(a.length, b.length));
+    if(result != 0)
+    {
+      return result;
+    }
+    return (a.length < b.length) ? -1 : ((a.length > b.length) ? 1 : 0);
+  }
+
+  static bool parent_less(const ini_section_parent & a, const ini_section_parent & b)
+  {
+    if(a.section_hash != b.section_hash)
+    {
+      return a.section_hash < b.section_hash;
+    }
+    return compare_views(a.section, b.section) < 0;
+  }
+
+  /*!
+  \brief Sort the parent records for binary search, keep the last of any repeat, and flatten each chain of ancestors.
+  */
+  void ini_index::resolve_parents()
+  {
+    _ancestors.clear();
+    if(_parents.empty())
+    {
+      return;
+    }
+    std::stable_sort(_parents.begin(), _parents.end(), parent_less);
+    size_t n_unique = 0;
+    for(size_t i = 0; i < _parents.size(); i++)
+    {
+      if(n_unique > 0 && !parent_less(_parents[n_unique - 1], _parents[i]))
+      {
+        _parents[n_unique - 1] = _parents[i]; //The same section again: the later heading wins
+      }else{
+        _parents[n_unique++] = _parents[i];
+      }
+    }
+    _parents.resize(n_unique);
+
+    for(size_t i = 0; i < _parents.size(); i++)
+    {
+      ini_section_parent & this_parent = _parents[i];
+      this_parent.ancestors_first = (uint32_t) _ancestors.size();
+      this_parent.ancestors_count = 0;
+      ini_view ancestor = this_parent.parent;
+      while(ancestor.length > 0)
+      {
+        if(in_chain(ancestor, this_parent.section.data, this_parent.section.length, &this_parent))
+        {
+          BELUGA_LOG_WARN("ini_index: [%s] inherits from itself through [%s]; the chain is cut there", this_parent.section.data, ancestor.data);
+          break;
+        }
+        if(this_parent.ancestors_count == ini_max_inheritance_depth)
+        {
+          BELUGA_LOG_WARN("ini_index: [%s] has more than %u ancestors; the rest are ignored", this_parent.section.data, (unsigned) ini_max_inheritance_depth);
+          break;
+        }
+        _ancestors.push_back(ancestor);
+        this_parent.ancestors_count++;
+        const ini_section_parent * next = find_parent(ancestor.data, ancestor.length);
+        if(next == nullptr)
+        {
+          break;
+        }
+        ancestor = next->parent;
+      }
+    }
+  }
+
+  /*!
+  \brief The parent record of a section, or nullptr if it inherits from nothing. Binary search on the name's hash.
+  */
+  const ini_section_parent * ini_index::find_parent(const char * section_name, size_t section_len) const
+  {
+    ini_section_parent key;
+    key.section.data = section_name;
+    key.section.length = section_len;
+    key.section_hash = hash_pair(section_name, section_len, "", 0);
+    auto iter = std::lower_bound(_parents.begin(), _parents.end(), key, parent_less);
+    if(iter == _parents.end() || iter->section_hash != key.section_hash || !views_equal(iter->section, section_name, section_len))
+    {
+      return nullptr;
+    }
+    return &(*iter);
+  }
+
+  /*!
+  \brief True if section is section_name itself or one of the ancestors resolved so far in record.
+  */
+  bool ini_index::in_chain(const ini_view & section, const char * section_name, size_t section_len, const ini_section_parent * record) const
+  {
+    if(views_equal(section, section_name, section_len))
+    {
+      return true;
+    }
+    if(record == nullptr)
+    {
+      return false;
+    }
+    for(uint32_t i = 0; i < record->ancestors_count; i++)
+    {
+      const ini_view & ancestor = _ancestors[record->ancestors_first + i];
+      if(views_equal(ancestor, section.data, section.length))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ini_index::entry_matches(const ini_index_entry & this_entry, uint32_t hash, const char * section_name, size_t section_len, const char * key_name, size_t key_len) const
+  {
+    return (this_entry.hash == hash)
+      && (this_entry.section.length == section_len)
+      && (this_entry.key.length == key_len)
+      && (memcmp(this_entry.section.data, section_name, section_len) == 0)
+      && (memcmp(this_entry.key.data, key_name, key_len) == 0);
+  }
+
+  /*!
+  \brief Build the slot table from the entries added so far.
+  \details Safe to call again after more add_entry calls; the table is rebuilt from scratch. Lists already split
+  are kept.
+  */
+  void ini_index::build()
+  {
+    size_t n_slots = 1;
+    while(n_slots < 2 * _entries.size())
+    {
+      n_slots <<= 1;
+    }
+    _slots.assign(n_slots, ini_handle::invalid_entry);
+    _slot_mask = (uint32_t) (n_slots - 1);
+
+    for(uint32_t i = 0; i < _entries.size(); i++)
+    {
+      place_entry(i);
+    }
+    resolve_parents();
+  }
+
+  /*!
+  \brief Put entry i in its slot, replacing an earlier entry of the same pair.
+  */
+  void ini_index::place_entry(uint32_t i)
+  {
+    const ini_index_entry & this_entry = _entries[i];
+    uint32_t slot = this_entry.hash & _slot_mask;
+    while(_slots[slot] != ini_handle::invalid_entry)
+    {
+      if(entry_matches(_entries[_slots[slot]], this_entry.hash, this_entry.section.data, this_entry.section.length, this_entry.key.data, this_entry.key.length))
+      {
+        break; //Duplicate pair: the later entry replaces the earlier one
+      }
+      slot = (slot + 1) & _slot_mask;
+    }
+    _slots[slot] = i;
+  }
+
+  /*!
+  \brief add_entry to a built index, and make it findable at once.
+  \details Only probes for the new entry's slot, unless that would fill the slot table past half, when the index
+  is built again. Parents are unchanged.
+  \return The new entry's handle.
+  */
+  ini_handle ini_index::insert_entry(ini_view section, ini_view key, ini_view value)
+  {
+    add_entry(section, key, value);
+    ini_handle handle = {(uint32_t) (_entries.size() - 1)};
+    if(_slots.size() < 2 * _entries.size())
+    {
+      build();
+    }else{
+      place_entry(handle.entry);
+    }
+    return handle;
+  }
+
+  /*!
+  \brief Call f(first, last) for each ini_list_delimiter-separated token of value, spaces/tabs trimmed.
+  An empty value has no tokens.
+  */
+  template<typename F>
+  static void for_each_token(const ini_view & value, F f)
+  {
+    if(value.length == 0)
+    {
+      return;
+    }
+    const char * p = value.data;
+    const char * end = value.data + value.length;
+    while(true)
+    {
+      const char * delimiter = (const char *) memchr(p, ini_list_delimiter, (size_t) (end - p));
+      const char * first = p;
+      const char * last = (delimiter != nullptr) ? delimiter : end;
+      while(first < last && (*first == ' ' || *first == '\t'))
+      {
+        first++;
+      }
+      while(last > first && (last[-1] == ' ' || last[-1] == '\t'))
+      {
+        last--;
+      }
+      f(first, last);
+      if(delimiter == nullptr)
+      {
+        return;
+      }
+      p = delimiter + 1;
+    }
+  }
+
+  static const ini_view empty_list_token = {"", 0}; //list_tokens of an empty value: split, with no tokens
+  const size_t ini_list_block_size = 1024;            //Bytes per block of split lists (a longer list gets its own)
+
+  /*!
+  \brief Split an entry's value into its list, if that has not been done since it was added or changed.
+  \details One run of a block holds the tokens, then their int32_t values, then copies of the tokens that are only
+  part of the value. Blocks are only ever appended, so runs never move. Splitting is a cache fill, so it is done
+  from the const readers, as the typed-value cache is.
+  \return The entry, or nullptr if the handle is not valid.
+  */
+  const ini_index_entry * ini_index::split_list(ini_handle handle) const
+  {
+    if(!handle.is_valid() || handle.entry >= _entries.size())
+    {
+      return nullptr;
+    }
+    ini_index_entry & this_entry = const_cast<ini_index_entry &>(_entries[handle.entry]);
+    if(this_entry.list_tokens != nullptr)
+    {
+      return &this_entry;
+    }
+    const ini_view & value = this_entry.value;
+    size_t n_tokens = 0;
+    size_t n_text = 0;
+    for_each_token(value, [&](const char * first, const char * last) {
+      n_tokens++;
+      if(first != value.data || last != value.data + value.length)
+      {
+        n_text += (size_t) (last - first) + 1;
+      }
+    });
+    this_entry.list_count = (uint32_t) n_tokens;
+    this_entry.list_int_error = ini_error::ok;
+    if(n_tokens == 0)
+    {
+      this_entry.list_tokens = &empty_list_token;
+      return &this_entry;
+    }
+    size_t run_bytes = n_tokens * (sizeof(ini_view) + sizeof(int32_t)) + n_text;
+    run_bytes = (run_bytes + sizeof(void *) - 1) & ~(sizeof(void *) - 1); //Keep the next run's tokens aligned
+    if(_list_blocks.empty() || _list_block_used + run_bytes > _list_blocks.back().size())
+    {
+      _list_blocks.push_back(std::vector<char>(std::max(run_bytes, ini_list_block_size)));
+      _list_block_used = 0;
+    }
+    char * run = _list_blocks.back().data() + _list_block_used;
+    _list_block_used += run_bytes;
+    ini_view * tokens = (ini_view *) run;
+    int32_t * ints = (int32_t *) (tokens + n_tokens);
+    char * text = (char *) (ints + n_tokens);
+    size_t i = 0;
+    for_each_token(value, [&](const char * first, const char * last) {
+      ini_view token = value;
+      if(first != value.data || last != value.data + value.length)
+      {
+        token.data = text;
+        token.length = (size_t) (last - first);
+        memcpy(text, first, token.length);
+        text[token.length] = '\0';
+        text += token.length + 1;
+      }
+      tokens[i] = token;
+      ints[i] = 0;
+      ini_error err = parse_int(first, last, &ints[i]);
+      if(err != ini_error::ok && this_entry.list_int_error == ini_error::ok)
+      {
+        this_entry.list_int_error = err;
+      }
+      i++;
+    });
+    this_entry.list_tokens = tokens;
+    return &this_entry;
+  }
+
+  /*!
+  \brief Split every value into its list now, so later list reads only read the index (see the class notes).
+  */
+  void ini_index::split_all_lists()
+  {
+    for(uint32_t i = 0; i < _entries.size(); i++)
+    {
+      ini_handle handle = {i};
+      split_list(handle);
+    }
+  }
+
+  /*!
+  \brief Forget the typed conversion and list split of an entry whose value view was pointed at a new string.
+  \details Lists already returned for the old value stay readable until clear().
+  */
+  void ini_index::value_changed(ini_handle handle)
+  {
+    if(!handle.is_valid() || handle.entry >= _entries.size())
+    {
+      return;
+    }
+    ini_index_entry & this_entry = _entries[handle.entry];
+    this_entry.cache_type = ini_value_type::none;
+    this_entry.list_tokens = nullptr;
+  }
+
+  /*!
+  \brief Point an entry at other copies of its strings, e.g. in a reloaded arena, keeping its handle and slot.
+  \details section and key must read as before. If value does too, the cached conversion is kept and a split
+  list follows it; otherwise they are forgotten, as by value_changed.
+  */
+  void ini_index::move_entry(ini_handle handle, ini_view section, ini_view key, ini_view value)
+  {
+    if(!handle.is_valid() || handle.entry >= _entries.size())
+    {
+      return;
+    }
+    ini_index_entry & this_entry = _entries[handle.entry];
+    bool same_value = views_equal(this_entry.value, value.data, value.length);
+    if(same_value && this_entry.list_tokens != nullptr && this_entry.list_tokens != &empty_list_token)
+    {
+      //Only a token that is the whole value views it; the others were copied into the list block
+      ini_view * tokens = const_cast<ini_view *>(this_entry.list_tokens);
+      for(uint32_t i = 0; i < this_entry.list_count; i++)
+      {
+        if(tokens[i].data == this_entry.value.data)
+        {
+          tokens[i].data = value.data;
+        }
+      }
+    }
+    this_entry.section = section;
+    this_entry.key = key;
+    this_entry.value = value;
+    if(!same_value)
+    {
+      value_changed(handle);
+    }
+  }
+
+  /*!
+  \brief Forget every add_parent(), e.g. before adding them again from moved storage. Lookups ignore inheritance
+  until build_parents().
+  */
+  void ini_index::clear_parents()
+  {
+    _parents.clear();
+    _ancestors.clear();
+  }
+
+  /*!
+  \brief The value of a section-key pair as a list of tokens. Split on the first call; no parsing, copying or
+  allocation after that.
+  \return False if the handle is not valid.
+  */
+  bool ini_index::get_list(ini_handle handle, ini_list_view * return_list) const
+  {
+    const ini_index_entry * this_entry = split_list(handle);
+    if(this_entry == nullptr)
+    {
+      return false;
+    }
+    return_list->tokens = this_entry->list_tokens;
+    return_list->count = this_entry->list_count;
+    return true;
+  }
+
+  /*!
+  \brief The value of a section-key pair as a list of int32_t, parsed when the value was first split.
+  \return not_found for an invalid handle, or the error of the first token that is not an int32_t
+  (return_list is then left alone).
+  */
+  ini_error ini_index::get_int_list(ini_handle handle, ini_int_list_view * return_list) const
+  {
+    const ini_index_entry * this_entry = split_list(handle);
+    if(this_entry == nullptr)
+    {
+      return ini_error::not_found;
+    }
+    if(this_entry->list_int_error != ini_error::ok)
+    {
+      return this_entry->list_int_error;
+    }
+    return_list->values = (const int32_t *) (this_entry->list_tokens + this_entry->list_count);
+    return_list->count = this_entry->list_count;
+    return ini_error::ok;
+  }
+
+  /*!
+  \brief Look up a section-key pair, falling back along the section's chain of ancestors.
+  \return A valid handle if the section or one of its ancestors has the key (the nearest wins), otherwise a handle
+  with is_valid() == false.
+  */
+  ini_handle ini_index::find(const char * section_name, size_t section_len, const char * key_name, size_t key_len) const
+  {
+    ini_handle handle = find_own(section_name, section_len, key_name, key_len);
+    if(handle.is_valid() || _parents.empty())
+    {
+      return handle;
+    }
+    const ini_section_parent * record = find_parent(section_name, section_len);
+    if(record == nullptr)
+    {
+      return handle;
+    }
+    for(uint32_t i = 0; i < record->ancestors_count && !handle.is_valid(); i++)
+    {
+      const ini_view & ancestor = _ancestors[record->ancestors_first + i];
+      handle = find_own(ancestor.data, ancestor.length, key_name, key_len);
+    }
+    return handle;
+  }
+
+  /*!
+  \brief Look up a section-key pair as written in the file, ignoring inheritance.
+  */
+  ini_handle ini_index::find_own(const char * section_name, size_t section_len, const char * key_name, size_t key_len) const
+  {
+    ini_handle handle;
+    handle.entry = ini_handle::invalid_entry;
+    if(_slots.empty())
+    {
+      return handle;
+    }
+    uint32_t hash = hash_pair(section_name, section_len, key_name, key_len);
+    uint32_t slot = hash & _slot_mask;
+    while(_slots[slot] != ini_handle::invalid_entry)
+    {
+      if(entry_matches(_entries[_slots[slot]], hash, section_name, section_len, key_name, key_len))
+      {
+        handle.entry = _slots[slot];
+        return handle;
+      }
+      slot = (slot + 1) & _slot_mask;
+    }
+    return handle;
+  }
+
+  /*!
+  \brief Call callback once for every key a lookup in the section finds: its own keys, then those it inherits
+  and does not override, each with the value find() returns.
+  \details Walks the whole index, so it is for boot-time checks, not hot code.
+  \return The number of keys.
+  */
+  size_t ini_index::for_each_key(const char * section_name, size_t section_len, ini_key_callback callback, void * context) const
+  {
+    const ini_section_parent * record = _parents.empty() ? nullptr : find_parent(section_name, section_len);
+    size_t n_keys = 0;
+    for(uint32_t i = 0; i < _entries.size(); i++)
+    {
+      const ini_index_entry & this_entry = _entries[i];
+      if(!in_chain(this_entry.section, section_name, section_len, record)
+        || find(section_name, section_len, this_entry.key.data, this_entry.key.length).entry != i)
+      {
+        continue;
+      }
+      callback(context, this_entry.key, this_entry.value);
+      n_keys++;
+    }
+    return n_keys;
+  }
+
+  /*!
+  \brief Heap held by the lists split so far.
+  */
+  size_t ini_index::list_heap_bytes() const
+  {
+    size_t n_bytes = _list_blocks.capacity() * sizeof(std::vector<char>);
+    for(size_t i = 0; i < _list_blocks.size(); i++)
+    {
+      n_bytes += _list_blocks[i].capacity();
+    }
+    return n_bytes;
+  }
+
+  size_t ini_index::heap_bytes() const
+  {
+    return _entries.capacity() * sizeof(ini_index_entry) + _slots.capacity() * sizeof(uint32_t)
+      + list_heap_bytes() + _parents.capacity() * sizeof(ini_section_parent) + _ancestors.capacity() * sizeof(ini_view);
+  }
+
+  size_t ini_index::allocation_count() const
+  {
+    return (_entries.capacity() > 0 ? 1 : 0) + (_slots.capacity() > 0 ? 1 : 0)
+      + _list_blocks.size() + (_list_blocks.capacity() > 0 ? 1 : 0) + (_parents.capacity() > 0 ? 1 : 0) + (_ancestors.capacity() > 0 ? 1 : 0);
+  }
+
+  void ini_index::clear()
+  {
+    std::vector<ini_index_entry>().swap(_entries);
+    std::vector<uint32_t>().swap(_slots);
+    std::vector< std::vector<char> >().swap(_list_blocks);
+    _list_block_used = 0;
+    std::vector<ini_section_parent>().swap(_parents);
+    std::vector<ini_view>().swap(_ancestors);
+    _slot_mask = 0;
+  }
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "beluga_ini_parse.h"
+
+namespace beluga_utils
+{
+    /*!
+    \brief Non-owning view of a string held by ini_reader's storage.
+    \details data is always '\0'-terminated at data[length], so it can be passed straight to Serial.print etc.
+    A view stays valid until the ini_reader that produced it is cleared or re-initialised.
+    */
+    struct ini_view
+    {
+        const char * data;
+        size_t length;
+    };
+
+    const char ini_list_delimiter = ',';
+
+    /*!
+    \brief Non-owning range over the tokens of a comma-separated value, e.g. "dev1, dev2, dev3".
+    \details Each token is an ini_view with surrounding spaces/tabs removed (and so '\0'-terminated like any other
+    view). An empty value is an empty list. Valid until the index is cleared (clear(), initialise(), reload()).
+    Usage: for(const ini_view & name : list) { ... }
+    */
+    struct ini_list_view
+    {
+        const ini_view * tokens;
+        size_t count;
+        const ini_view * begin() const { return tokens; }
+        const ini_view * end() const { return tokens + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const ini_view & operator[](size_t i) const { return tokens[i]; }
+    };
+
+    /*!
+    \brief Non-owning range over a list value parsed as int32_t, e.g. "1, 2, 0x10". Valid as ini_list_view.
+    */
+    struct ini_int_list_view
+    {
+        const int32_t * values;
+        size_t count;
+        const int32_t * begin() const { return values; }
+        const int32_t * end() const { return values + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        int32_t operator[](size_t i) const { return values[i]; }
+    };
+
+    /*!
+    \brief A resolved section-key pair.
+    \details Returned by ini_reader::get_config_handle. Reading through a handle is an array access:
+    no hashing, string building or allocation. Handles are invalidated by clear() and initialise().
+    */
+    struct ini_handle
+    {
+        static const uint32_t invalid_entry = 0xFFFFFFFF;
+        uint32_t entry;
+        bool is_valid() const { return entry != invalid_entry; }
+    };
+
+    /*!
+    \brief Callback for for_each_key: one key of a section and its value. The views are those of the reader.
+    */
+    typedef void (*ini_key_callback)(void * context, ini_view key, ini_view value);
+
+    /*!
+    \brief One section-key pair in the index.
+    \details The cache_* fields hold the last typed conversion of value, so repeated typed reads of the same
+    key skip parsing. A failed conversion is cached too.
+    The list_* fields hold the value split into tokens, filled on the first list read (see ini_index::get_list).
+    */
+    struct ini_index_entry
+    {
+        ini_view section;
+        ini_view key;
+        ini_view value;
+        const ini_view * list_tokens;   //nullptr until the value is first read as a list; then list_count tokens,
+                                        //followed by their list_count int32_t values
+        uint32_t hash;
+        uint32_t list_count;
+        ini_cached_value cache;
+        ini_value_type cache_type;      //The one-byte fields last, so the entry packs without padding
+        ini_error cache_error;
+        ini_error list_int_error;       //ok if every token parsed as an int32_t
+    };
+
+    const size_t ini_max_inheritance_depth = 8; //Ancestors followed per section; a longer chain is cut
+
+    /*!
+    \brief A section that inherits from another ([section : parent]), and its resolved chain of ancestors.
+    \details ancestors_first/ancestors_count locate parent, grandparent, ... in the index's ancestor table.
+    */
+    struct ini_section_parent
+    {
+        ini_view section;
+        ini_view parent;
+        uint32_t section_hash;      //ini_index::hash_pair of section and an empty key
+        uint32_t ancestors_first;
+        uint32_t ancestors_count;
+    };
+
+    /*!
+    \brief Open-addressing hash index over section-key pairs
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Entries are views into storage owned elsewhere (the nested map or the arena), so the index holds
+    no copies of any string. Call add_entry for every pair, then build() once. The slot table is a power of two
+    at least twice the entry count and is probed linearly, so lookups touch one or two slots on average.
+    If the same section-key pair is added twice the later one wins.
+    The first get_list or get_int_list of an entry splits its value at ini_list_delimiter, parsing each token as an
+    int32_t in the same pass; later reads are an array access. Tokens that are not a whole value are copied, to keep
+    them '\0'-terminated. The splits are kept in blocks that never move, so a list stays valid while others are split.
+    Values never read as lists cost nothing. Splitting writes to the index, so a const index shared between tasks
+    must call split_all_lists() before it is shared (as ini_snapshot does).
+    Sections may inherit: add_parent(child, parent) before build(), and a key not in child is looked up in parent,
+    then its parent, and so on. build() flattens each chain into one array (a cycle or a chain deeper than
+    ini_max_inheritance_depth is cut, with a warning), so a miss costs one probe per ancestor and no string work.
+    The handle found is the ancestor's entry, so every child reading an inherited key shares its cached conversion.
+    find_own ignores inheritance. The parents of a built index can be replaced: clear_parents(), add_parent() for
+    each, then build_parents().
+    */
+    class ini_index
+    {
+        public:
+            ini_index(){};
+            void clear();
+            void reserve(size_t n_entries) { _entries.reserve(n_entries); }
+            void add_entry(ini_view section, ini_view key, ini_view value);
+            void add_parent(ini_view section, ini_view parent);
+            void build();
+            ini_handle insert_entry(ini_view section, ini_view key, ini_view value);
+            ini_handle find(const char * section_name, size_t section_len, const char * key_name, size_t key_len) const;
+            ini_handle find_own(const char * section_name, size_t section_len, const char * key_name, size_t key_len) const;
+            size_t for_each_key(const char * section_name, size_t section_len, ini_key_callback callback, void * context) const;
+            size_t parent_count() const { return _parents.size(); }
+            const ini_section_parent & get_parent(size_t i) const { return _parents[i]; }
+            const ini_index_entry & get_entry(ini_handle handle) const { return _entries[handle.entry]; }
+            bool get_list(ini_handle handle, ini_list_view * return_list) const;
+            ini_error get_int_list(ini_handle handle, ini_int_list_view * return_list) const;
+            void split_all_lists();
+            void value_changed(ini_handle handle);
+            void move_entry(ini_handle handle, ini_view section, ini_view key, ini_view value);
+            void clear_parents();
+            void build_parents() { resolve_parents(); }
+            ini_index_entry & get_entry(ini_handle handle) { return _entries[handle.entry]; }
+            size_t size() const { return _entries.size(); }
+            size_t heap_bytes() const;
+            size_t list_heap_bytes() const;
+            size_t allocation_count() const;
+            static uint32_t hash_pair(const char * section_name, size_t section_len, const char * key_name, size_t key_len);
+
+        protected:
+            bool entry_matches(const ini_index_entry & this_entry, uint32_t hash, const char * section_name, size_t section_len, const char * key_name, size_t key_len) const;
+            void place_entry(uint32_t i);
+            const ini_index_entry * split_list(ini_handle handle) const;
+            void resolve_parents();
+            const ini_section_parent * find_parent(const char * section_name, size_t section_len) const;
+            bool in_chain(const ini_view & section, const char * section_name, size_t section_len, const ini_section_parent * record) const;
+            std::vector<ini_index_entry> _entries;
+            std::vector<uint32_t> _slots; //Entry number, or ini_handle::invalid_entry for an empty slot
+            uint32_t _slot_mask = 0;
+            mutable std::vector< std::vector<char> > _list_blocks;  //Split lists: tokens, their ints, then copied text
+            mutable size_t _list_block_used = 0;                    //Bytes used of the last block
+            std::vector<ini_section_parent> _parents;   //Sorted by section_hash, then name, by build()
+            std::vector<ini_view> _ancestors;           //Every section's chain, flattened
+    };
+}
@@ -0,0 +1,94 @@
+#include "beluga_ini_line_reader.h"
+#include <string.h>
+
+namespace beluga_utils
+{
+  /*!
+  \brief Prepare to read lines from the current position of an open file.
+  \details The block buffer is allocated here, once.
+  */
+  ini_line_reader::ini_line_reader(File & this_file) : _file(this_file)
+  {
+    _block.resize(ini_read_block_size);
+    _file_offset = this_file ? this_file.position() : 0;
+    _eof = !this_file;
+  }
+
+  bool ini_line_reader::fill_block()
+  {
+    _file_offset += _block_len;
+    _block_pos = 0;
+    _block_len = _eof ? 0 : _file.read((uint8_t *) _block.data(), ini_read_block_size);
+    if(_block_len == 0)
+    {
+      _eof = true;
+    }
+    return _block_len > 0;
+  }
+
+  /*!
+  \brief Get the next line.
+  @param line set to the line's text, without '\n' or a trailing '\r', and '\0'-terminated. The buffer is owned by
+  the reader and may be modified in place; it is valid until the next call.
+  @param length set to the number of bytes in line.
+  \return False once the file is exhausted.
+  */
+  bool ini_line_reader::next_line(char ** line, size_t * length)
+  {
+    _carry.clear();
+    bool have_carry = false;
+    while(true)
+    {
+      if(_block_pos >= _block_len && !fill_block())
+      {
+        if(!have_carry)
+        {
+          return false;
+        }
+        //Last line of the file, with no trailing newline
+        _carry.push_back('\0');
+        *line = _carry.data();
+        *length = _carry.size() - 1;
+        break;
+      }
+
+      char * start = _block.data() + _block_pos;
+      size_t available = _block_len - _block_pos;
+      char * newline = (char *) memchr(start, '\n', available);
+      if(!have_carry)
+      {
+        _line_offset = _file_offset + _block_pos;
+      }
+      if(newline == nullptr)
+      {
+        //Line continues into the next block
+        _carry.insert(_carry.end(), start, start + available);
+        have_carry = true;
+        _block_pos = _block_len;
+        continue;
+      }
+
+      size_t n = (size_t) (newline - start);
+      _block_pos += n + 1;
+      if(have_carry)
+      {
+        _carry.insert(_carry.end(), start, start + n);
+        _carry.push_back('\0');
+        *line = _carry.data();
+        *length = _carry.size() - 1;
+      }else{
+        *newline = '\0';
+        *line = start;
+        *length = n;
+      }
+      break;
+    }
+
+    if(*length > 0 && (*line)[*length - 1] == '\r')
+    {
+      (*length)--;
+      (*line)[*length] = '\0';
+    }
+    return true;
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "FS.h"
+#include <stddef.h>
+#include <vector>
+
+namespace beluga_utils
+{
+    const size_t ini_read_block_size = 4096; //Bytes pulled from the filesystem per read() call
+
+    /*!
+    \brief Block-buffered line splitter for .ini files
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Reads the file in ini_read_block_size blocks and splits lines in memory, instead of going through
+    Stream::readBytesUntil one byte at a time. Handles:
+    - lines of any length (a line that spans blocks is gathered into a carry buffer that grows as needed)
+    - a last line with no trailing newline
+    - CRLF endings (the '\r' is dropped)
+    Usage:
+    ini_line_reader reader(this_file);
+    char * line;
+    size_t length;
+    while(reader.next_line(&line, &length)) { ... }
+    */
+    class ini_line_reader
+    {
+        public:
+            ini_line_reader(File & this_file);
+            bool next_line(char ** line, size_t * length);
+            size_t line_offset() const { return _line_offset; } //Byte offset in the file of the last line returned
+
+        protected:
+            bool fill_block();
+            File & _file;
+            std::vector<char> _block;
+            size_t _block_pos = 0;
+            size_t _block_len = 0;
+            std::vector<char> _carry; //Holds the start of a line that runs past the end of a block
+            size_t _file_offset = 0;  //File offset of _block[0]
+            size_t _line_offset = 0;
+            bool _eof = false;
+    };
+}
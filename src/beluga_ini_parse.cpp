@@ -0,0 +1,345 @@
+#include "beluga_ini_parse.h"
+
+namespace beluga_utils
+{
+  const char * ini_error_to_string(ini_error err)
+  {
+    switch(err)
+    {
+      case ini_error::ok:
+        return "ok";
+      case ini_error::not_found:
+        return "not found";
+      case ini_error::invalid_format:
+        return "invalid format";
+      case ini_error::out_of_range:
+        return "out of range";
+    }
+    return "unknown";
+  }
+
+  static bool is_blank(char c)
+  {
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+  }
+
+  static void trim_range(const char ** first, const char ** last)
+  {
+    while(*first < *last && is_blank(**first))
+    {
+      (*first)++;
+    }
+    while(*last > *first && is_blank(*(*last - 1)))
+    {
+      (*last)--;
+    }
+  }
+
+  static char to_lower(char c)
+  {
+    return (c >= 'A' && c <= 'Z') ? (char) (c - 'A' + 'a') : c;
+  }
+
+  /*!
+  \brief Case-insensitive compare of [first, last) against a lower-case literal.
+  */
+  static bool equals_lower(const char * first, const char * last, const char * lower_literal)
+  {
+    while(first < last && *lower_literal != '\0')
+    {
+      if(to_lower(*first) != *lower_literal)
+      {
+        return false;
+      }
+      first++;
+      lower_literal++;
+    }
+    return (first == last) && (*lower_literal == '\0');
+  }
+
+  /*!
+  \brief Parse an unsigned decimal integer prefix.
+  \return Pointer to the first unconsumed character. *n_digits is 0 if nothing was parsed.
+  */
+  static const char * scan_unsigned(const char * p, const char * last, uint64_t limit, uint64_t * value, size_t * n_digits, bool * overflow)
+  {
+    uint64_t acc = 0;
+    *n_digits = 0;
+    *overflow = false;
+    while(p < last && *p >= '0' && *p <= '9')
+    {
+      acc = acc * 10 + (uint64_t) (*p - '0');
+      if(acc > limit)
+      {
+        *overflow = true;
+        acc = limit;
+      }
+      (*n_digits)++;
+      p++;
+    }
+    *value = acc;
+    return p;
+  }
+
+  /*!
+  \brief Parse a decimal floating point prefix: [sign] digits [. digits] [e [sign] digits].
+  \return Pointer to the first unconsumed character, or nullptr if there were no digits.
+  \details Digits are accumulated in a 64-bit integer (up to 19 significant digits, more are dropped) and scaled
+  by powers of ten, which is ample for float and needs no heap, unlike newlib's strtod.
+  */
+  static const char * scan_decimal(const char * p, const char * last, double * value)
+  {
+    bool negative = false;
+    if(p < last && (*p == '+' || *p == '-'))
+    {
+      negative = (*p == '-');
+      p++;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    size_t n_digits = 0;
+    while(p < last && *p >= '0' && *p <= '9')
+    {
+      if(mantissa < 1000000000000000000ULL)
+      {
+        mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+      }else{
+        exponent++;
+      }
+      n_digits++;
+      p++;
+    }
+    if(p < last && *p == '.')
+    {
+      p++;
+      while(p < last && *p >= '0' && *p <= '9')
+      {
+        if(mantissa < 1000000000000000000ULL)
+        {
+          mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+          exponent--;
+        }
+        n_digits++;
+        p++;
+      }
+    }
+    if(n_digits == 0)
+    {
+      return nullptr;
+    }
+    if(p < last && (*p == 'e' || *p == 'E'))
+    {
+      const char * exponent_start = p;
+      p++;
+      bool exponent_negative = false;
+      if(p < last && (*p == '+' || *p == '-'))
+      {
+        exponent_negative = (*p == '-');
+        p++;
+      }
+      uint64_t exponent_value = 0;
+      size_t n_exponent_digits = 0;
+      bool overflow = false;
+      p = scan_unsigned(p, last, 9999, &exponent_value, &n_exponent_digits, &overflow);
+      if(n_exponent_digits == 0)
+      {
+        p = exponent_start; //Not an exponent after all; leave the 'e' for the caller to reject
+      }else{
+        exponent += exponent_negative ? -(int) exponent_value : (int) exponent_value;
+      }
+    }
+
+    double result = (double) mantissa;
+    if(mantissa == 0)
+    {
+      *value = 0.0;
+      return p;
+    }
+    double scale = 10.0;
+    int abs_exponent = exponent < 0 ? -exponent : exponent;
+    double factor = 1.0;
+    while(abs_exponent > 0)
+    {
+      if(abs_exponent & 1)
+      {
+        factor *= scale;
+      }
+      scale *= scale;
+      abs_exponent >>= 1;
+    }
+    result = (exponent < 0) ? (result / factor) : (result * factor);
+    *value = negative ? -result : result;
+    return p;
+  }
+
+  ini_error parse_bool(const char * first, const char * last, bool * return_value)
+  {
+    trim_range(&first, &last);
+    if(equals_lower(first, last, "true") || equals_lower(first, last, "1") || equals_lower(first, last, "yes") || equals_lower(first, last, "on"))
+    {
+      *return_value = true;
+      return ini_error::ok;
+    }
+    if(equals_lower(first, last, "false") || equals_lower(first, last, "0") || equals_lower(first, last, "no") || equals_lower(first, last, "off"))
+    {
+      *return_value = false;
+      return ini_error::ok;
+    }
+    return ini_error::invalid_format;
+  }
+
+  ini_error parse_int(const char * first, const char * last, int32_t * return_value)
+  {
+    trim_range(&first, &last);
+    const char * p = first;
+    bool negative = false;
+    if(p < last && (*p == '+' || *p == '-'))
+    {
+      negative = (*p == '-');
+      p++;
+    }
+    const uint64_t limit = negative ? 2147483648ULL : 2147483647ULL;
+    uint64_t magnitude = 0;
+    bool overflow = false;
+    if((last - p) > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    {
+      p += 2;
+      size_t n_digits = 0;
+      while(p < last)
+      {
+        char c = to_lower(*p);
+        int digit;
+        if(c >= '0' && c <= '9')
+        {
+          digit = c - '0';
+        }else if(c >= 'a' && c <= 'f'){
+          digit = c - 'a' + 10;
+        }else{
+          break;
+        }
+        magnitude = magnitude * 16 + (uint64_t) digit;
+        if(magnitude > limit)
+        {
+          overflow = true;
+          magnitude = limit;
+        }
+        n_digits++;
+        p++;
+      }
+      if(n_digits == 0)
+      {
+        return ini_error::invalid_format;
+      }
+    }else{
+      size_t n_digits = 0;
+      p = scan_unsigned(p, last, limit, &magnitude, &n_digits, &overflow);
+      if(n_digits == 0)
+      {
+        return ini_error::invalid_format;
+      }
+    }
+    if(p != last)
+    {
+      return ini_error::invalid_format;
+    }
+    if(overflow)
+    {
+      return ini_error::out_of_range;
+    }
+    *return_value = negative ? (int32_t) (0 - magnitude) : (int32_t) magnitude;
+    return ini_error::ok;
+  }
+
+  ini_error parse_float(const char * first, const char * last, float * return_value)
+  {
+    trim_range(&first, &last);
+    double value;
+    const char * p = scan_decimal(first, last, &value);
+    if(p == nullptr || p != last)
+    {
+      return ini_error::invalid_format;
+    }
+    const double float_max = 3.402823466e38;
+    if(value > float_max || value < -float_max)
+    {
+      return ini_error::out_of_range;
+    }
+    *return_value = (float) value;
+    return ini_error::ok;
+  }
+
+  ini_error parse_ipv4(const char * first, const char * last, ini_ipv4 * return_value)
+  {
+    trim_range(&first, &last);
+    ini_ipv4 result;
+    const char * p = first;
+    for(int i = 0; i < 4; i++)
+    {
+      if(i > 0)
+      {
+        if(p >= last || *p != '.')
+        {
+          return ini_error::invalid_format;
+        }
+        p++;
+      }
+      uint64_t octet = 0;
+      size_t n_digits = 0;
+      bool overflow = false;
+      p = scan_unsigned(p, last, 255, &octet, &n_digits, &overflow);
+      if(n_digits == 0 || n_digits > 3)
+      {
+        return ini_error::invalid_format;
+      }
+      if(overflow)
+      {
+        return ini_error::out_of_range;
+      }
+      result.octets[i] = (uint8_t) octet;
+    }
+    if(p != last)
+    {
+      return ini_error::invalid_format;
+    }
+    *return_value = result;
+    return ini_error::ok;
+  }
+
+  ini_error parse_duration_ms(const char * first, const char * last, uint32_t * return_value)
+  {
+    trim_range(&first, &last);
+    double value;
+    const char * p = scan_decimal(first, last, &value);
+    if(p == nullptr)
+    {
+      return ini_error::invalid_format;
+    }
+    const char * unit_start = p;
+    while(unit_start < last && is_blank(*unit_start))
+    {
+      unit_start++;
+    }
+    double ms_per_unit;
+    if(unit_start == last || equals_lower(unit_start, last, "ms"))
+    {
+      ms_per_unit = 1.0;
+    }else if(equals_lower(unit_start, last, "us")){
+      ms_per_unit = 0.001;
+    }else if(equals_lower(unit_start, last, "s")){
+      ms_per_unit = 1000.0;
+    }else if(equals_lower(unit_start, last, "m") || equals_lower(unit_start, last, "min")){
+      ms_per_unit = 60000.0;
+    }else if(equals_lower(unit_start, last, "h")){
+      ms_per_unit = 3600000.0;
+    }else{
+      return ini_error::invalid_format;
+    }
+    double ms = value * ms_per_unit + 0.5;
+    if(value < 0.0 || ms >= 4294967296.0)
+    {
+      return ini_error::out_of_range;
+    }
+    *return_value = (uint32_t) ms;
+    return ini_error::ok;
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace beluga_utils
+{
+    /*!
+    \brief Result of a typed config read.
+    \details The typed getters return one of these instead of throwing. ok is 0 so "if(err == ini_error::ok)" reads naturally.
+    */
+    enum class ini_error : uint8_t
+    {
+        ok = 0,
+        not_found,      //No such section-key pair
+        invalid_format, //The text is not a value of the requested type
+        out_of_range    //The text is well-formed but does not fit the requested type
+    };
+
+    const char * ini_error_to_string(ini_error err);
+
+    struct ini_ipv4
+    {
+        uint8_t octets[4];
+    };
+
+    /*!
+    \brief Value type held in an ini_index_entry's parse cache.
+    */
+    enum class ini_value_type : uint8_t
+    {
+        none = 0,
+        boolean,
+        integer,
+        floating,
+        ipv4,
+        duration_ms
+    };
+
+    union ini_cached_value
+    {
+        bool as_bool;
+        int32_t as_int;
+        float as_float;
+        ini_ipv4 as_ipv4;
+        uint32_t as_duration_ms;
+    };
+
+    /*
+    Allocation-free text to value conversions, in the style of std::from_chars: they parse [first, last) and
+    write to *return_value only on success. Leading and trailing spaces/tabs are ignored; anything else left
+    over is invalid_format.
+    - bool: true/false, 1/0, yes/no, on/off (any case)
+    - int: optional sign, decimal or 0x-prefixed hex
+    - float: optional sign, digits, optional fraction and e/E exponent
+    - ipv4: dotted quad, e.g. 192.168.1.1
+    - duration: a number with an optional unit of us, ms, s, m or h; no unit means ms. e.g. 250ms, 1.5s, 2m
+    */
+    ini_error parse_bool(const char * first, const char * last, bool * return_value);
+    ini_error parse_int(const char * first, const char * last, int32_t * return_value);
+    ini_error parse_float(const char * first, const char * last, float * return_value);
+    ini_error parse_ipv4(const char * first, const char * last, ini_ipv4 * return_value);
+    ini_error parse_duration_ms(const char * first, const char * last, uint32_t * return_value);
+}
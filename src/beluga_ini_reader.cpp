@@ -1,27 +1,56 @@
 #include "beluga_ini_reader.h"
 #include "beluga_debug.h"
+#include "beluga_heap_stats.h"
+#include "beluga_profile.h"
+#include "beluga_trace.h"
 
 #include <sstream>
 #include <algorithm>
+#include <string.h>
+#include <stdlib.h>
 
 #include "beluga_string.h"
 
 namespace beluga_utils
 {
+  /*!
+  \brief Heap bytes held by a std::string outside of the string object itself.
+  */
+  static size_t string_heap_bytes(const std::string & s)
+  {
+    static const size_t small_string_capacity = std::string().capacity();
+    return (s.capacity() > small_string_capacity) ? (s.capacity() + 1) : 0;
+  }
+
   /*!
   \brief Creates a ini file 
-  @param config_file_path is the path to the .ini file that SPIFFS will use e.g. ./config.ini
+  @param config_file_path is the path to the .ini file on the storage backend (SPIFFS by default) e.g. ./config.ini
+  @param storage_mode nested_map (default) or arena. See ini_storage_mode.
   */
-  ini_reader::ini_reader(std::string config_file_path)
+  ini_reader::ini_reader(std::string config_file_path, ini_storage_mode storage_mode)
   {
       _config_file_path = config_file_path;
+      _storage_mode = storage_mode;
+      _storage_backend = &default_storage_backend();
+  }
+
+  /*!
+  \brief Read the config from another filesystem. Call before initialise(). The backend must outlive this reader.
+  Usage:
+  beluga_utils::sd_mmc_backend sd_card;
+  ini.set_storage_backend(&sd_card);
+  */
+  void ini_reader::set_storage_backend(storage_backend * backend)
+  {
+    _storage_backend = (backend != nullptr) ? backend : &default_storage_backend();
   }
 
   /*!
   \brief Add a new section to the data map
   \details Check if the section name is already present, and if not add a new section map
   @param this_section_name the name of the new section
-  \return True if the new section name is not present already, False if it is already present.
+  \return True if the new section name is not present already, False if it is already present (a repeated
+  [section], whose keys the caller merges into the existing one).
   */
   bool ini_reader::add_new_section_name(std::string this_section_name)
   {
@@ -29,19 +58,18 @@ namespace beluga_utils
 
       if(std::find(_section_names.begin(), _section_names.end(), this_section_name) != _section_names.end()) {
           /* v contains x */
-          Serial.print("Section name ");
-          Serial.print(this_section_name.c_str());
-          Serial.println(" already present in list. Cannot duplicate section names! Section name list: ");
-          for(auto iter = _section_names.begin(); iter != _section_names.end(); iter++)
+          BELUGA_LOG_DEBUG("Section name %s already present, merging repeated section", this_section_name.c_str());
+          if(log_level_enabled(log_level::trace))
           {
-            Serial.println(iter->c_str());
+            for(auto iter = _section_names.begin(); iter != _section_names.end(); iter++)
+            {
+              BELUGA_LOG_TRACE("Section name list: %s", iter->c_str());
+            }
           }
-          Serial.println("----end section name list----");
           return false;
       } else {
           /* v does not contain x */
-          Serial.print("Adding config section name ");
-          Serial.println(this_section_name.c_str());
+          BELUGA_LOG_DEBUG("Adding config section name %s", this_section_name.c_str());
           _section_names.push_back(this_section_name);
           std::map<std::string, std::string> this_map;
           _data[this_section_name] = this_map;
@@ -49,6 +77,29 @@ namespace beluga_utils
       }
   }
 
+  /*!
+  \brief Print the values set at runtime, after the file's, in the same layout.
+  */
+  static void print_overrides(const ini_edit_map & overrides)
+  {
+    if(overrides.empty())
+    {
+      return;
+    }
+    Serial.println("Set at runtime (overrides the above):");
+    for(auto iter1 = overrides.begin(); iter1 != overrides.end(); iter1++)
+    {
+      Serial.println(iter1->first.c_str());
+      for(auto iter2 = iter1->second.begin(); iter2 != iter1->second.end(); iter2++)
+      {
+        Serial.print("\t");
+        Serial.print(iter2->first.c_str());
+        Serial.print(" : ");
+        Serial.println(iter2->second.c_str());
+      }
+    }
+  }
+
   /*!
   \brief Return this when initialisation fails.
   */
@@ -59,7 +110,7 @@ namespace beluga_utils
       beluga_utils::debug_print_loop_forever(error_message);
       assert(false);//Should not reach this line
     }else{
-      beluga_utils::debug_print(error_message);
+      BELUGA_LOG_ERROR("%s", error_message.c_str());
     }
     return false;
 
@@ -77,10 +128,48 @@ namespace beluga_utils
         return;
       }
       Serial.println("Printing config...");
+      if(_storage_mode == ini_storage_mode::arena)
+      {
+        for(size_t i = 0; i < _arena.section_count(); i++)
+        {
+          const ini_arena_section & this_section = _arena.get_section(i);
+          Serial.print(_arena.span_c_str(this_section.name));
+          if(this_section.parent.length > 0)
+          {
+            Serial.print(" : ");
+            Serial.print(_arena.span_c_str(this_section.parent));
+          }
+          Serial.println("");
+          for(size_t j = 0; j < this_section.entry_count; j++)
+          {
+            const ini_arena_entry & this_entry = _arena.get_entry(this_section.first_entry + j);
+            Serial.print("\t");
+            Serial.print(_arena.span_c_str(this_entry.key));
+            Serial.print(" : ");
+            Serial.println(_arena.span_c_str(this_entry.value));
+          }
+        }
+        print_overrides(_overrides);
+        return;
+      }
+      for(auto iter = _section_offsets.begin(); iter != _section_offsets.end(); iter++)
+      {
+        if(!iter->loaded)
+        {
+          Serial.print(iter->name.c_str());
+          Serial.println(" (not loaded)");
+        }
+      }
       for(auto iter1 = _data.begin(); iter1 != _data.end(); iter1++)
       {
-
-        Serial.println(iter1->first.c_str());
+        Serial.print(iter1->first.c_str());
+        auto parent_iter = _section_parents.find(iter1->first);
+        if(parent_iter != _section_parents.end())
+        {
+          Serial.print(" : ");
+          Serial.print(parent_iter->second.c_str());
+        }
+        Serial.println("");
         for(auto iter2 = iter1->second.begin(); iter2 != iter1->second.end(); iter2++)
         {
           Serial.print("\t");
@@ -89,125 +178,481 @@ namespace beluga_utils
           Serial.println(iter2->second.c_str());
         }
       }
+      print_overrides(_overrides);
+    }
+
+
+  /*!
+  \brief Visitor that fills ini_reader::_data, used by initialise() in nested_map mode.
+  */
+  class ini_reader::nested_map_builder : public ini_visitor
+  {
+    public:
+      nested_map_builder(ini_reader * reader, ini_section_hasher * hasher) : _reader(reader), _hasher(hasher) {};
+      bool on_section(ini_view section_name)
+      {
+        ini_view parent = section_parent();
+        _hasher->start_section(section_name.data, section_name.length, parent);
+        std::string this_heading(section_name.data, section_name.length);
+        //A section may be split across the file. That's ok: add_new_section_name returns false for the repeat and
+        //its keys are merged into the existing section (later values win), the same as arena storage.
+        _reader->add_new_section_name(this_heading);
+        if(parent.length > 0)
+        {
+          _reader->_section_parents[this_heading].assign(parent.data, parent.length);
+        }
+        _section_name = this_heading;
+        return true;
+      }
+      bool on_key_value(ini_view section_name, ini_view key, ini_view value)
+      {
+        _hasher->on_key_value(section_name, key, value);
+        _reader->add_new_config_data(_section_name, std::string(key.data, key.length), std::string(value.data, value.length));
+        return true;
+      }
+
+    protected:
+      ini_reader * _reader;
+      ini_section_hasher * _hasher;
+      std::string _section_name;
+  };
+
+  /*!
+  \brief Stream the .ini file through a visitor without loading it.
+  @param visitor receives each section heading and key/value pair. See ini_visitor.
+  @param crash_on_fail as for initialise().
+  \return True if the whole file was read, False if it could not be opened or the visitor stopped early.
+  \details Uses constant memory whatever the file size, and does not touch the loaded data, so it can be
+  used with or without initialise(). The grammar is the same as initialise().
+  Usage:
+  ini_reader ini("/fleet.ini");
+  my_section_picker picker;
+  ini.visit(picker);
+  */
+  bool ini_reader::visit(ini_visitor & visitor, bool crash_on_fail)
+  {
+    bool mount_ok = _storage_backend->begin();
+    if(!mount_ok)
+    {
+      return initialise_return_failure(std::string("beluga_ini_reader: could not mount ") + _storage_backend->name(), crash_on_fail);
+    }
+    File this_file = _storage_backend->open(_config_file_path.c_str(), "r");
+    if(!this_file)
+    {
+      return initialise_return_failure("beluga_ini_reader: could not open " + _config_file_path, crash_on_fail);
+    }
+    bool visit_ok = ini_visit_file(this_file, visitor);
+    this_file.close();
+    return visit_ok;
+  }
+
+  /*!
+  \brief Visitor that records where each [section] heading starts, used by lazy mode.
+  */
+  class ini_reader::section_offset_scanner : public ini_visitor
+  {
+    public:
+      section_offset_scanner(std::vector<ini_section_offset> * offsets, ini_section_hasher * hasher) : _offsets(offsets), _hasher(hasher) {};
+      bool on_section(ini_view section_name)
+      {
+        ini_view parent = section_parent();
+        _hasher->start_section(section_name.data, section_name.length, parent);
+        ini_section_offset this_offset = {std::string(section_name.data, section_name.length), std::string(parent.data, parent.length), (uint32_t) line_offset(), false};
+        _offsets->push_back(this_offset);
+        return true;
+      }
+      bool on_key_value(ini_view section_name, ini_view key, ini_view value)
+      {
+        if(_offsets->empty())
+        {
+          //Keys before the first heading: the unnamed section starts at the top of the file
+          ini_section_offset this_offset = {std::string(), std::string(), 0, false};
+          _offsets->push_back(this_offset);
+        }
+        _hasher->on_key_value(section_name, key, value);
+        return true;
+      }
+
+    protected:
+      std::vector<ini_section_offset> * _offsets;
+      ini_section_hasher * _hasher;
+  };
+
+  /*!
+  \brief Visitor that parses one section from its heading up to the next heading, used by lazy mode.
+  */
+  class ini_reader::section_loader : public ini_visitor
+  {
+    public:
+      section_loader(ini_reader * reader, const std::string & section_name) : _reader(reader), _section_name(section_name), _seen_heading(section_name.empty()) {};
+      bool on_section(ini_view)
+      {
+        if(_seen_heading)
+        {
+          return false; //Reached the next section
+        }
+        _seen_heading = true;
+        return true;
+      }
+      bool on_key_value(ini_view, ini_view key, ini_view value)
+      {
+        _reader->add_new_config_data(_section_name, std::string(key.data, key.length), std::string(value.data, value.length));
+        return true;
+      }
+
+    protected:
+      ini_reader * _reader;
+      const std::string & _section_name;
+      bool _seen_heading;
+  };
+
+  /*!
+  \brief First pass for lazy mode: find the section headings, or read them from the .idx file.
+  */
+  bool ini_reader::initialise_lazy(File & this_file)
+  {
+    if(!this_file)
+    {
+      return false;
+    }
+    _section_offsets.clear();
+    if(_section_index_file_enabled && load_section_index_file(this_file))
+    {
+      _section_hashes.clear();
+      _section_hashes_valid = false;
+    }else{
+      this_file.seek(0);
+      ini_section_hasher hasher(&_section_hashes);
+      section_offset_scanner scanner(&_section_offsets, &hasher);
+      ini_visit_file(this_file, scanner);
+      hasher.finish();
+      _section_hashes_valid = true;
+      if(_section_index_file_enabled)
+      {
+        save_section_index_file(this_file);
+      }
+    }
+    //The parents are known before any section is loaded, so the first lookup in a child loads its ancestors too
+    collect_section_parents(_section_offsets, &_section_parents);
+    _index.clear();
+    add_index_parents();
+    add_override_entries();
+    _index.build();
+    refresh_lazy_load_stats();
+    return true;
+  }
+
+  /*!
+  \brief Read section offsets from <config path>.idx, if it exists and matches the config file.
+  \details The .idx file starts with the config file's size and last-write time; if either differs the .idx
+  is ignored and the file is rescanned. Then one line per heading: its offset, its name and, if it names a
+  parent, ':' and the parent (a section name cannot contain ':'). Filesystems that do not keep modification times (e.g. SPIFFS without
+  CONFIG_SPIFFS_USE_MTIME) only get the size check, so delete the .idx if you edit the config in place without
+  changing its length. Uploading a new filesystem image replaces both files anyway.
+  \return True if the offsets were loaded.
+  */
+  bool ini_reader::load_section_index_file(File & this_file)
+  {
+    std::string index_path = _config_file_path + ".idx";
+    if(!_storage_backend->exists(index_path.c_str()))
+    {
+      return false;
+    }
+    File index_file = _storage_backend->open(index_path.c_str(), "r");
+    if(!index_file)
+    {
+      return false;
+    }
+    ini_line_reader reader(index_file);
+    char * line;
+    size_t line_length;
+    bool header_ok = reader.next_line(&line, &line_length) && (strncmp(line, "BIDX2 ", 6) == 0);
+    if(header_ok)
+    {
+      char * cursor = line + 6;
+      unsigned long file_size = strtoul(cursor, &cursor, 10);
+      unsigned long last_write = strtoul(cursor, &cursor, 10);
+      header_ok = (file_size == (unsigned long) this_file.size()) && (last_write == (unsigned long) this_file.getLastWrite());
+    }
+    if(!header_ok)
+    {
+      index_file.close();
+      return false;
+    }
+    while(reader.next_line(&line, &line_length))
+    {
+      char * name_start = nullptr;
+      unsigned long offset = strtoul(line, &name_start, 10);
+      if(name_start == line || *name_start != ' ')
+      {
+        continue;
+      }
+      const char * parent_start = strchr(name_start + 1, ':');
+      ini_section_offset this_offset = {std::string(name_start + 1), std::string(), (uint32_t) offset, false};
+      if(parent_start != nullptr)
+      {
+        this_offset.name.assign(name_start + 1, (size_t) (parent_start - name_start - 1));
+        this_offset.parent.assign(parent_start + 1);
+      }
+      _section_offsets.push_back(this_offset);
+    }
+    index_file.close();
+    return true;
+  }
+
+  void ini_reader::save_section_index_file(File & this_file)
+  {
+    std::string index_path = _config_file_path + ".idx";
+    File index_file = _storage_backend->open(index_path.c_str(), "w");
+    if(!index_file)
+    {
+      BELUGA_LOG_WARN("ini_reader: could not write section index file %s", index_path.c_str());
+      return;
+    }
+    std::stringstream ss;
+    ss << "BIDX2 " << (unsigned long) this_file.size() << " " << (unsigned long) this_file.getLastWrite() << "\n";
+    for(auto iter = _section_offsets.begin(); iter != _section_offsets.end(); iter++)
+    {
+      ss << iter->offset << " " << iter->name;
+      if(!iter->parent.empty())
+      {
+        ss << ":" << iter->parent;
+      }
+      ss << "\n";
+    }
+    std::string contents = ss.str();
+    index_file.write((const uint8_t *) contents.data(), contents.size());
+    index_file.close();
+  }
+
+  /*!
+  \brief Parse every not-yet-loaded occurrence of a section, and of each section it inherits from, into _data and
+  add them to the index.
+  \return True if anything was loaded (so a repeated index lookup may now succeed).
+  \details Handles already returned stay valid: new entries are appended to the index and only its slot table is rebuilt.
+  */
+  bool ini_reader::load_lazy_section(const char * section_name, size_t section_len)
+  {
+    bool loaded_any = load_lazy_occurrences(section_name, section_len);
+    std::string ancestor(section_name, section_len);
+    for(size_t depth = 0; depth < ini_max_inheritance_depth; depth++)
+    {
+      auto parent_iter = _section_parents.find(ancestor);
+      if(parent_iter == _section_parents.end())
+      {
+        break;
+      }
+      ancestor = parent_iter->second;
+      if(load_lazy_occurrences(ancestor.data(), ancestor.size()))
+      {
+        loaded_any = true;
+      }
+    }
+    if(!loaded_any)
+    {
+      return false;
+    }
+    _index.build();
+    refresh_lazy_load_stats();
+    return true;
+  }
+
+  /*!
+  \brief load_lazy_section for one section: parse its not-yet-loaded occurrences and add its keys to the index,
+  without rebuilding it.
+  */
+  bool ini_reader::load_lazy_occurrences(const char * section_name, size_t section_len)
+  {
+    bool loaded_any = false;
+    File this_file;
+    for(size_t i = 0; i < _section_offsets.size(); i++)
+    {
+      ini_section_offset & this_offset = _section_offsets[i];
+      if(this_offset.loaded || this_offset.name.size() != section_len || memcmp(this_offset.name.data(), section_name, section_len) != 0)
+      {
+        continue;
+      }
+      if(!this_file)
+      {
+        this_file = _storage_backend->open(_config_file_path.c_str(), "r");
+        if(!this_file)
+        {
+          return false;
+        }
+      }
+      this_file.seek(this_offset.offset);
+      BELUGA_TRACE_SCOPE("ini_reader::load_lazy_section");
+      section_loader loader(this, this_offset.name);
+      ini_visit_file(this_file, loader);
+      this_offset.loaded = true;
+      loaded_any = true;
     }
+    if(this_file)
+    {
+      this_file.close();
+    }
+    if(!loaded_any)
+    {
+      return false;
+    }
+
+    std::string this_section(section_name, section_len);
+    auto section_iter = _data.find(this_section);
+    if(section_iter != _data.end())
+    {
+      ini_view section_view = {section_iter->first.c_str(), section_iter->first.size()};
+      for(auto iter2 = section_iter->second.begin(); iter2 != section_iter->second.end(); iter2++)
+      {
+        if(has_override(this_section, iter2->first))
+        {
+          continue; //Values set at runtime were indexed at initialise() or set_config_value(), and stay the only entry
+        }
+        ini_view key_view = {iter2->first.c_str(), iter2->first.size()};
+        ini_view value_view = {iter2->second.c_str(), iter2->second.size()};
+        _index.add_entry(section_view, key_view, value_view);
+      }
+    }
+    return true;
+  }
 
+  void ini_reader::refresh_lazy_load_stats()
+  {
+    _load_stats = estimate_nested_map_load_stats();
+    _load_stats.bytes_used += _section_offsets.capacity() * sizeof(ini_section_offset) + _index.heap_bytes();
+    _load_stats.allocation_count += (_section_offsets.capacity() > 0 ? 1 : 0) + _index.allocation_count();
+    for(auto iter = _section_offsets.begin(); iter != _section_offsets.end(); iter++)
+    {
+      _load_stats.bytes_used += string_heap_bytes(iter->name) + string_heap_bytes(iter->parent);
+      _load_stats.allocation_count += (string_heap_bytes(iter->name) > 0) ? 1 : 0;
+      _load_stats.allocation_count += (string_heap_bytes(iter->parent) > 0) ? 1 : 0;
+    }
+  }
 
   /*!
   \brief Initialises the ini_reader
-  \details Use SPIFFS to open the file, validate that it complies with the .ini format.
-  @param crash_on_fail set to True if you want it to debug_print_loop_forever if something goes wrong on launching SPIFFS, set to False (default) and it will return False if something goes wrong.
+  \details Mount the storage backend (SPIFFS unless set_storage_backend was called), open the file, validate that it complies with the .ini format.
+  @param crash_on_fail set to True if you want it to debug_print_loop_forever if something goes wrong on mounting the filesystem, set to False (default) and it will return False if something goes wrong.
   \return True if the file is found, and is valid .ini. False otherwise if debug_print_loop_forever is False, or hang of debug_print_loop_forever is True
   Usage:
   ini_reader ini("./config.ini");
   bool crash_on_fail = true;
   bool ini_ok = ini.initialise(crash_on_fail);
-  @todo: Replace SPIFFS with LittleFS and have better failure handling e.g. file not found.
+  @todo: Better failure handling e.g. file not found.
   */
   bool ini_reader::initialise(bool crash_on_fail )
   {   
-    Serial.println("INI READER INITIALISING");
-    //_line_buffer_len is the max length of any one line (not the whole file)
-    char buffer[_line_buffer_len];
-    const char *this_filename = _config_file_path.c_str(); 
-    
-
-    Serial.print("Config file path: ");
-    Serial.println(this_filename);
+    BELUGA_HEAP_SCOPE(ini_initialise);
+    BELUGA_PROFILE_SCOPE("ini_reader::initialise");
+    BELUGA_TRACE_SCOPE("ini_reader::initialise");
+    BELUGA_LOG_INFO("INI READER INITIALISING");
+    BELUGA_LOG_INFO("Config file path: %s", _config_file_path.c_str());
     //Start SPIFFS
-    bool spiffs_ok = SPIFFS.begin();
-    if(!spiffs_ok)
+    BELUGA_TRACE_BEGIN("ini_reader::mount");
+    bool mount_ok = _storage_backend->begin();
+    BELUGA_TRACE_END("ini_reader::mount");
+    if(!mount_ok)
     {
       if(crash_on_fail)
       {
-        debug_print_loop_forever("beluga_ini_reader: SPIFFS.begin() failed");
+        debug_print_loop_forever(std::string("beluga_ini_reader: could not mount ") + _storage_backend->name());
       }else{
         return false;
       }
     }
+    recover_rewrite();
+    load_journal();
     File this_file;
-    this_file = SPIFFS.open(_config_file_path.c_str(), "r");
-    std::string this_section_name = "";
-
-    while(this_file.available())
+    BELUGA_TRACE_BEGIN("ini_reader::open");
+    this_file = _storage_backend->open(_config_file_path.c_str(), "r");
+    BELUGA_TRACE_END("ini_reader::open");
+    BELUGA_TRACE_SCOPE("ini_reader::parse");
+    _file_signature = read_file_signature(this_file);
+    if(_storage_mode == ini_storage_mode::lazy)
     {
-      char terminator_char = '\n';
-      char comment_char = ';';
-
-      int n_bytes_read = this_file.readBytesUntil(terminator_char, buffer, sizeof(buffer)); //Terminator character is not returned
-
-      if(n_bytes_read == 0)
+      bool lazy_ok = initialise_lazy(this_file);
+      this_file.close();
+      if(!lazy_ok)
       {
-        //Just a newline (terminator isn't returned)
-        continue;
+        return initialise_return_failure("beluga_ini_reader: could not index the file sections", crash_on_fail);
       }
-      if(n_bytes_read <= 2)
+      _initialised = true;
+      publish_snapshot();
+      BELUGA_LOG_INFO("INI READER DONE INITIALISING");
+      return _initialised;
+    }
+    if(_storage_mode == ini_storage_mode::arena)
+    {
+      //One read of the whole file, parsed in place. No per-line strings.
+      bool arena_ok = _arena.load(this_file);
+      this_file.close();
+      if(!arena_ok)
       {
-        //Minimum length is 3 e.g. x=1 or [x]
-        continue;
-      }
-      //TODO: Last line of file?
-      std::string this_line = std::string(buffer, n_bytes_read);
-      trim(this_line);
-      //this_line = beluga_utils::trim_copy(this_line);
-      bool is_section_heading = (this_line[0] == '[') && (this_line.back() == ']');
-      if(is_section_heading)
-      {
-        std::string this_heading = std::string(buffer, n_bytes_read); //Copy a fixed number of chars. If there are \0 within the string, problems!
-
-        //Remove [ and ]
-        this_heading = this_heading.substr(1, this_heading.size()-2);
-        
-        //debug_print("Read config heading: ", true, false);
-        //debug_print(this_heading);
-        bool new_section_ok = add_new_section_name(this_heading);
-        if(! new_section_ok)
-        {
-          //Due to device inheritance, we may initialsie one section multiple times. That's ok; just continue
-          std::stringstream ss;
-          ss << "Not adding adding config section " << this_heading << ": duplicate section name.";
-          //return initialise_return_failure(ss.str(), crash_on_fail);
-          Serial.println(ss.str().c_str());
-          continue;
-        }
-
-        this_section_name = this_heading;
-        continue; //Get the config
-
-      }else{
-        std::string this_line = std::string(buffer, n_bytes_read); //Copy a fixed number of chars. If there are \0 within the string, problems!
-
-        if(this_line[0] == comment_char)
-        {
-          continue; //Ignore comment
-        }
-        //debug_print("Read config line: ", true, false);
-        //debug_print(this_line);
-        add_new_config_data(this_section_name, this_line);
+        return initialise_return_failure("beluga_ini_reader: could not read the file into the arena", crash_on_fail);
       }
+      _load_stats = _arena.get_load_stats();
+      build_index();
+      hash_arena_sections(_arena, &_section_hashes);
+      _section_hashes_valid = true;
+      _initialised = true;
+      publish_snapshot();
+      BELUGA_LOG_INFO("INI READER DONE INITIALISING");
+      return _initialised;
     }
+    ini_section_hasher hasher(&_section_hashes);
+    nested_map_builder builder(this, &hasher);
+    ini_visit_file(this_file, builder);
+    this_file.close();
+    hasher.finish();
+    _section_hashes_valid = true;
+    _load_stats = estimate_nested_map_load_stats();
+    build_index();
     _initialised = true;
+    publish_snapshot();
 
-        Serial.println("INI READER DONE INITIALISING");
-
+    BELUGA_LOG_INFO("INI READER DONE INITIALISING");
     return _initialised;
 
   }
 
-  bool ini_reader::add_new_config_data(std::string this_section_name, std::string this_data_str)
+  /*!
+  \brief Estimate the heap used by the nested_map storage
+  \details Counts one allocation per map node and one per string too long for the small-string buffer.
+  Map node overhead is taken as four pointer-sized fields (parent, left, right, colour).
+  \return The estimated bytes used and allocation count.
+  */
+  ini_load_stats ini_reader::estimate_nested_map_load_stats()
   {
-    std::string this_delimiter = "=";
-    try
+    const size_t node_overhead = 4 * sizeof(void *);
+    ini_load_stats stats = {0, 0};
+    for(auto iter1 = _data.begin(); iter1 != _data.end(); iter1++)
     {
-    std::vector<std::string> split_data = beluga_utils::split_string(this_data_str, this_delimiter);
-    _data[this_section_name][split_data[0]] = split_data[1];
+      stats.allocation_count++;
+      stats.bytes_used += node_overhead + sizeof(*iter1) + string_heap_bytes(iter1->first);
+      stats.allocation_count += (string_heap_bytes(iter1->first) > 0) ? 1 : 0;
+      for(auto iter2 = iter1->second.begin(); iter2 != iter1->second.end(); iter2++)
+      {
+        stats.allocation_count++;
+        stats.bytes_used += node_overhead + sizeof(*iter2) + string_heap_bytes(iter2->first) + string_heap_bytes(iter2->second);
+        stats.allocation_count += (string_heap_bytes(iter2->first) > 0) ? 1 : 0;
+        stats.allocation_count += (string_heap_bytes(iter2->second) > 0) ? 1 : 0;
+      }
     }
-    catch(const std::exception& e)
+    for(auto iter = _section_parents.begin(); iter != _section_parents.end(); iter++)
     {
-      //std::cerr << e.what() << '\n';
-      return false;
+      stats.allocation_count++;
+      stats.bytes_used += node_overhead + sizeof(*iter) + string_heap_bytes(iter->first) + string_heap_bytes(iter->second);
+      stats.allocation_count += (string_heap_bytes(iter->first) > 0) ? 1 : 0;
+      stats.allocation_count += (string_heap_bytes(iter->second) > 0) ? 1 : 0;
     }
+    return stats;
+  }
 
-
+  /*!
+  \brief Store one key/value pair in the nested map.
+  */
+  bool ini_reader::add_new_config_data(const std::string & this_section_name, const std::string & this_key, const std::string & this_value)
+  {
+    _data[this_section_name][this_key] = this_value;
     return true;
   }
 
@@ -232,92 +677,1339 @@ namespace beluga_utils
   We could have returned either as 
   \return True if the file is found, and is valid .ini. False otherwise.
   */
-  bool ini_reader::get_config_value(std::string section_name, std::string key_name, std::string * return_config_value, bool verbose)
+  bool ini_reader::get_config_value(const std::string & section_name, const std::string & key_name, std::string * return_config_value, bool verbose)
   {
-    try
+    BELUGA_HEAP_SCOPE(ini_get_config_value);
+    ini_handle handle = get_config_handle(section_name, key_name);
+    if(!handle.is_valid())
     {
-      bool config_key_present = _data[section_name].find(key_name) != _data[section_name].end();
-      if(!config_key_present)
-      {
-        if(verbose)
-        {
-          std::stringstream ss;
-          ss << "ini_reader::get_config_value: section name " << section_name << " has no key: " << key_name;
-          debug_print(ss.str());
-        }
-        return false;
-      }
-
-
-      std::string this_value = _data[section_name][key_name];
       if(verbose)
       {
-        std::stringstream ss;
-        ss << "ini_reader::get_config_value: section name " << section_name << " key name " << key_name << " has value: " << this_value;
-        debug_print(ss.str());
+        BELUGA_LOG_WARN("ini_reader::get_config_value: section name %s has no key: %s", section_name.c_str(), key_name.c_str());
       }
-      *return_config_value = this_value;
-      return true;
-    }catch(...)
+      return false;
+    }
+
+    const ini_view & this_value = _index.get_entry(handle).value;
+    return_config_value->assign(this_value.data, this_value.length);
+    if(verbose)
     {
-      //Section-key pair not present.
-      //This should never trigger.
+      BELUGA_LOG_DEBUG("ini_reader::get_config_value: section name %s key name %s has value: %s", section_name.c_str(), key_name.c_str(), return_config_value->c_str());
     }
-    return false;
+    return true;
   }
-    
-  void ini_reader::clear()
+
+  /*!
+  \brief Resolve a section-key pair once, for repeated reads.
+  @param section_name is the section in the .ini to use.
+  @param key_name is the particular key we want data from.
+  \return A handle for use with get_config_value(ini_handle, ini_view *). is_valid() is False if the pair is not present.
+  \details Lookups never modify the loaded data. The handle stays valid until clear() or initialise() is called.
+  Usage:
+  ini_handle pin_handle = ini.get_config_handle("my_device", "pin");
+  ini_view pin_str;
+  if(ini.get_config_value(pin_handle, &pin_str)) { Serial.println(pin_str.data); }
+  */
+  ini_handle ini_reader::get_config_handle(const char * section_name, const char * key_name)
   {
-    _data.clear();
+    return find_handle(section_name, strlen(section_name), key_name, strlen(key_name));
   }
-  
+
+  ini_handle ini_reader::get_config_handle(const std::string & section_name, const std::string & key_name)
+  {
+    return find_handle(section_name.data(), section_name.size(), key_name.data(), key_name.size());
+  }
+
   /*!
-  Some fields are a list of names (of devices or comms channels or whatever)
-  parse_names_config retrieves the list and splits it into a vector
-  If not initialised, return false
-  if the config_file_section is not found, return false
-  If the config_key is not found, return true (it means an empty list, which is valid)
+  \brief Index lookup, loading the section first if in lazy mode and it is not loaded yet.
+  \details A key found in an ancestor is not trusted until the section itself is loaded, as it may override it.
   */
- bool ini_reader::get_config_list_field(std::string config_file_section, std::string config_key, std::vector<std::string> & results_vec, std::string delim)
- {
-    if(! _initialised)
+  ini_handle ini_reader::find_handle(const char * section_name, size_t section_len, const char * key_name, size_t key_len)
+  {
+    ini_handle handle = _index.find(section_name, section_len, key_name, key_len);
+    if(_storage_mode != ini_storage_mode::lazy)
     {
-      return false;
+      return handle;
     }
-
-    bool config_key_present = _data[config_file_section].find(config_key) != _data[config_file_section].end();
-    if(!config_key_present)
+    bool inherited = handle.is_valid() && (_index.get_entry(handle).section.length != section_len
+      || memcmp(_index.get_entry(handle).section.data, section_name, section_len) != 0);
+    if((!handle.is_valid() || inherited) && load_lazy_section(section_name, section_len))
     {
-
-      std::stringstream ss;
-      ss << "ini_reader::get_config_list_field: section name " << config_file_section << " has no key: " << config_key;
-      debug_print(ss.str());
-    
-      return false;
+      handle = _index.find(section_name, section_len, key_name, key_len);
     }
+    return handle;
+  }
 
-    
-    std::map< std::string, std::string > submap;
-    try{
-      submap = _data[config_file_section];
-    }
-    catch(...)
+  /*!
+  \brief Read a value through a handle from get_config_handle.
+  @param handle the resolved section-key pair.
+  @param return_config_value set to a view of the stored value. No copy is made.
+  \return True if the handle is valid.
+  */
+  bool ini_reader::get_config_value(ini_handle handle, ini_view * return_config_value) const
+  {
+    if(!handle.is_valid() || handle.entry >= _index.size())
     {
-      //Assume config_file_section not found
       return false;
     }
-    try{
-      std::string list_of_names_str;
-      list_of_names_str = submap[config_key];
-      results_vec = beluga_utils::split_string(list_of_names_str, delim);
-    }
-    catch(...)
-    {
-      //Assume config_key not found. Leave vector empty.
-    }
+    *return_config_value = _index.get_entry(handle).value;
     return true;
- }
+  }
+
+  /*!
+  \brief Convert an index entry's value through its parse cache.
+  \details Parses only if the cache holds no conversion of this type; otherwise returns the cached result
+  (including a cached failure).
+  */
+  template<typename T>
+  static ini_error read_typed_entry(ini_index_entry & this_entry, ini_value_type value_type, T * cache_field, T * return_value, ini_error (*parse)(const char *, const char *, T *))
+  {
+    if(this_entry.cache_type != value_type)
+    {
+      this_entry.cache_error = parse(this_entry.value.data, this_entry.value.data + this_entry.value.length, cache_field);
+      this_entry.cache_type = value_type;
+    }
+    if(this_entry.cache_error == ini_error::ok)
+    {
+      *return_value = *cache_field;
+    }
+    return this_entry.cache_error;
+  }
+
+  /*!
+  \brief Typed reads of a section-key pair.
+  @param section_name / key_name or handle: the pair to read. See get_config_handle.
+  @param return_value written only if the result is ini_error::ok.
+  \return ok, not_found, invalid_format or out_of_range. Never throws.
+  \details The conversion result is cached in the index, so reading the same key as the same type again costs a lookup only.
+  Usage:
+  bool enabled = false;
+  if(ini.get_config_bool("my_device", "enable_serial_log", &enabled) != ini_error::ok) { ...use default... }
+  */
+  ini_error ini_reader::get_config_bool(ini_handle handle, bool * return_value)
+  {
+    if(!handle.is_valid() || handle.entry >= _index.size())
+    {
+      return ini_error::not_found;
+    }
+    ini_index_entry & this_entry = _index.get_entry(handle);
+    return read_typed_entry(this_entry, ini_value_type::boolean, &this_entry.cache.as_bool, return_value, parse_bool);
+  }
+
+  ini_error ini_reader::get_config_int(ini_handle handle, int32_t * return_value)
+  {
+    if(!handle.is_valid() || handle.entry >= _index.size())
+    {
+      return ini_error::not_found;
+    }
+    ini_index_entry & this_entry = _index.get_entry(handle);
+    return read_typed_entry(this_entry, ini_value_type::integer, &this_entry.cache.as_int, return_value, parse_int);
+  }
+
+  ini_error ini_reader::get_config_float(ini_handle handle, float * return_value)
+  {
+    if(!handle.is_valid() || handle.entry >= _index.size())
+    {
+      return ini_error::not_found;
+    }
+    ini_index_entry & this_entry = _index.get_entry(handle);
+    return read_typed_entry(this_entry, ini_value_type::floating, &this_entry.cache.as_float, return_value, parse_float);
+  }
+
+  ini_error ini_reader::get_config_ipv4(ini_handle handle, ini_ipv4 * return_value)
+  {
+    if(!handle.is_valid() || handle.entry >= _index.size())
+    {
+      return ini_error::not_found;
+    }
+    ini_index_entry & this_entry = _index.get_entry(handle);
+    return read_typed_entry(this_entry, ini_value_type::ipv4, &this_entry.cache.as_ipv4, return_value, parse_ipv4);
+  }
+
+  ini_error ini_reader::get_config_duration_ms(ini_handle handle, uint32_t * return_value)
+  {
+    if(!handle.is_valid() || handle.entry >= _index.size())
+    {
+      return ini_error::not_found;
+    }
+    ini_index_entry & this_entry = _index.get_entry(handle);
+    return read_typed_entry(this_entry, ini_value_type::duration_ms, &this_entry.cache.as_duration_ms, return_value, parse_duration_ms);
+  }
+
+  ini_error ini_reader::get_config_bool(const std::string & section_name, const std::string & key_name, bool * return_value)
+  {
+    return get_config_bool(get_config_handle(section_name, key_name), return_value);
+  }
+
+  ini_error ini_reader::get_config_int(const std::string & section_name, const std::string & key_name, int32_t * return_value)
+  {
+    return get_config_int(get_config_handle(section_name, key_name), return_value);
+  }
+
+  ini_error ini_reader::get_config_float(const std::string & section_name, const std::string & key_name, float * return_value)
+  {
+    return get_config_float(get_config_handle(section_name, key_name), return_value);
+  }
+
+  ini_error ini_reader::get_config_ipv4(const std::string & section_name, const std::string & key_name, ini_ipv4 * return_value)
+  {
+    return get_config_ipv4(get_config_handle(section_name, key_name), return_value);
+  }
+
+  ini_error ini_reader::get_config_duration_ms(const std::string & section_name, const std::string & key_name, uint32_t * return_value)
+  {
+    return get_config_duration_ms(get_config_handle(section_name, key_name), return_value);
+  }
+
+  /*!
+  \brief Hash the sections of a loaded arena, in file order, as ini_section_hasher hashes the file.
+  */
+  void ini_reader::hash_arena_sections(const ini_arena & arena, std::vector<ini_section_hash> * hashes)
+  {
+    ini_section_hasher hasher(hashes);
+    for(size_t i = 0; i < arena.section_count(); i++)
+    {
+      const ini_arena_section & this_section = arena.get_section(i);
+      hasher.start_section(arena.span_c_str(this_section.name), this_section.name.length, arena.span_view(this_section.parent));
+      for(size_t j = 0; j < this_section.entry_count; j++)
+      {
+        const ini_arena_entry & this_entry = arena.get_entry(this_section.first_entry + j);
+        hasher.add_entry(arena.span_c_str(this_entry.key), this_entry.key.length, arena.span_c_str(this_entry.value), this_entry.value.length);
+      }
+    }
+    hasher.finish();
+  }
+
+  /*!
+  \brief Build the hashed section-key index over whichever storage was loaded.
+  \details Called at the end of initialise(). The index holds views into the storage, not copies.
+  */
+  void ini_reader::build_index()
+  {
+    _index.clear();
+    if(_storage_mode == ini_storage_mode::arena)
+    {
+      _index.reserve(_arena.entry_count());
+      for(size_t i = 0; i < _arena.section_count(); i++)
+      {
+        const ini_arena_section & this_section = _arena.get_section(i);
+        for(size_t j = 0; j < this_section.entry_count; j++)
+        {
+          const ini_arena_entry & this_entry = _arena.get_entry(this_section.first_entry + j);
+          _index.add_entry(_arena.span_view(this_section.name), _arena.span_view(this_entry.key), _arena.span_view(this_entry.value));
+        }
+      }
+    }else{
+      size_t n_entries = 0;
+      for(auto iter1 = _data.begin(); iter1 != _data.end(); iter1++)
+      {
+        n_entries += iter1->second.size();
+      }
+      _index.reserve(n_entries);
+      for(auto iter1 = _data.begin(); iter1 != _data.end(); iter1++)
+      {
+        ini_view section_view = {iter1->first.c_str(), iter1->first.size()};
+        for(auto iter2 = iter1->second.begin(); iter2 != iter1->second.end(); iter2++)
+        {
+          ini_view key_view = {iter2->first.c_str(), iter2->first.size()};
+          ini_view value_view = {iter2->second.c_str(), iter2->second.size()};
+          _index.add_entry(section_view, key_view, value_view);
+        }
+      }
+    }
+    add_override_entries();
+    add_index_parents();
+    _index.build();
+    _load_stats.bytes_used += _index.heap_bytes();
+    _load_stats.allocation_count += _index.allocation_count();
+  }
+
+  /*!
+  \brief Tell the index which sections inherit from which ([child : parent]), from whichever storage was loaded.
+  \details The index keeps views of the names, so the child's keys are never copied: memory grows with the
+  keys written in the file, not with keys times the sections inheriting them.
+  */
+  void ini_reader::add_index_parents()
+  {
+    if(_storage_mode == ini_storage_mode::arena)
+    {
+      for(size_t i = 0; i < _arena.section_count(); i++)
+      {
+        const ini_arena_section & this_section = _arena.get_section(i);
+        if(this_section.parent.length > 0)
+        {
+          _index.add_parent(_arena.span_view(this_section.name), _arena.span_view(this_section.parent));
+        }
+      }
+      return;
+    }
+    for(auto iter = _section_parents.begin(); iter != _section_parents.end(); iter++)
+    {
+      ini_view section_view = {iter->first.c_str(), iter->first.size()};
+      ini_view parent_view = {iter->second.c_str(), iter->second.size()};
+      _index.add_parent(section_view, parent_view);
+    }
+  }
+
+  /*!
+  \brief Lazy mode: the parent each section's heading names, from the section offsets. The last heading that
+  names a parent wins, as in the other storage modes.
+  */
+  void ini_reader::collect_section_parents(const std::vector<ini_section_offset> & offsets, std::map< std::string, std::string > * parents)
+  {
+    parents->clear();
+    for(auto iter = offsets.begin(); iter != offsets.end(); iter++)
+    {
+      if(!iter->parent.empty())
+      {
+        (*parents)[iter->name] = iter->parent;
+      }
+    }
+  }
+    
+  void ini_reader::clear()
+  {
+    _index.clear();
+    _data.clear();
+    _section_parents.clear();
+    _section_names.clear();
+    _arena.clear();
+    _section_offsets.clear();
+    _section_hashes.clear();
+    _section_hashes_valid = false;
+    _overrides.clear();
+    _pending_edits.clear();
+    _file_signature.size = 0;
+    _file_signature.last_write = 0;
+    _load_stats.bytes_used = 0;
+    _load_stats.allocation_count = 0;
+  }
+
+  /*!
+  \brief Size and last-write time of an open file, or zeros if it is not open.
+  */
+  ini_file_signature ini_reader::read_file_signature(File & this_file)
+  {
+    ini_file_signature signature = {0, 0};
+    if(this_file)
+    {
+      signature.size = this_file.size();
+      signature.last_write = this_file.getLastWrite();
+    }
+    return signature;
+  }
+
+  static std::string view_to_string(ini_view v)
+  {
+    return std::string(v.data, v.length);
+  }
+
+  /*!
+  \brief Visitor that copies out the sections in a changed list, used by reload().
+  \details Every occurrence of a changed section is collected, so repeated sections merge as in initialise().
+  A changed section with no keys still gets an (empty) map, so it is not mistaken for a removed one.
+  If loaded_only is set, sections missing from it are skipped (lazy mode: sections never read are not diffed).
+  With one_section set it stops at the second heading, to read a single occurrence after a seek to its offset.
+  */
+  class ini_reader::section_collector : public ini_visitor
+  {
+    public:
+      section_collector(const std::vector<uint32_t> & changed_sections, const std::map< std::string, std::map< std::string, std::string > > * loaded_only,
+        std::map< std::string, std::map< std::string, std::string > > * sections, bool one_section = false)
+        : _changed_sections(changed_sections), _loaded_only(loaded_only), _sections(sections), _one_section(one_section) {};
+      bool on_section(ini_view section_name)
+      {
+        if(_one_section && _seen_heading)
+        {
+          return false; //Reached the next section
+        }
+        _seen_heading = true;
+        select_section(section_name);
+        return true;
+      }
+      bool on_key_value(ini_view section_name, ini_view key, ini_view value)
+      {
+        if(!_seen_heading)
+        {
+          _seen_heading = true;
+          select_section(section_name); //Keys before the first heading
+        }
+        if(_current != nullptr)
+        {
+          (*_current)[view_to_string(key)].assign(value.data, value.length);
+        }
+        return true;
+      }
+
+    protected:
+      void select_section(ini_view section_name)
+      {
+        _current = nullptr;
+        if(!std::binary_search(_changed_sections.begin(), _changed_sections.end(), ini_section_name_hash(section_name.data, section_name.length)))
+        {
+          return;
+        }
+        std::string this_section = view_to_string(section_name);
+        if(_loaded_only != nullptr && _loaded_only->find(this_section) == _loaded_only->end())
+        {
+          return;
+        }
+        _current = &(*_sections)[this_section];
+      }
+      const std::vector<uint32_t> & _changed_sections;
+      const std::map< std::string, std::map< std::string, std::string > > * _loaded_only;
+      std::map< std::string, std::map< std::string, std::string > > * _sections;
+      std::map< std::string, std::string > * _current = nullptr;
+      bool _one_section;
+      bool _seen_heading = false;
+  };
+
+  /*!
+  \brief Re-read the config file and apply only what changed
+  \author Bryan Clarke
+  \date 17/10/2026
+  @param stats optional; set to what the reload found.
+  \return True if the loaded config now matches the file (whether or not it changed). False if not initialised or
+  the file could not be read, in which case the loaded config is left as it was.
+  \details
+  - With enable_reload_signature_check(true), if the file's size and last-write time match the last load, nothing
+    is read. It is off by default: last-write times have a resolution of a second (and are 0 where SPIFFS has no
+    CONFIG_SPIFFS_USE_MTIME), so an edit that keeps the size within that second is missed. Turn it on only where
+    the file is written rarely, and reload() is called often.
+  - Otherwise each section's content is hashed (8 bytes per section are kept from the last load). If no hash
+    differs, nothing else changes.
+  - nested_map and lazy: one pass over the file hashes it and finds each heading's offset. The changed sections
+    are then read from their offsets (or the whole file, if most changed) and diffed key by key against the loaded
+    data. Keys of unchanged sections are not touched (their storage, views and cached typed values survive).
+    Handles survive a reload that only modifies values; a reload that adds or removes keys rebuilds the index and
+    invalidates them. In lazy mode only loaded sections are diffed; the others just get their new offsets.
+  - arena: the file is read into a new arena (sized like the loaded one, so it is parsed once) and hashed there. If no section changed the new
+    arena is dropped and nothing is invalidated. If only values changed, the index is pointed at the new arena:
+    handles and the cached conversions of unchanged values survive, but views into the old arena are invalid.
+    A reload that adds, removes or renames keys or sections builds a new index, invalidating handles too.
+  - Subscribers are called after the change is applied, once per added, modified or removed key, so they can
+    read the new values straight away. Callbacks must not call reload().
+  - Changes are reported for keys as written: a changed key of [parent] is reported once, for [parent], not for
+    every [child : parent] that inherits it. Subscribe to the parent's key (or to every section) to follow an
+    inherited value. A reload that changes the parent a heading names rebuilds the index.
+  - Values set with set_config_value keep winning over the file's. A reload that changes the file's value of such
+    a key still reports it, and rebuilds the index.
+  Usage:
+  ini_reload_stats reload_stats;
+  if(ini.reload(&reload_stats) && reload_stats.file_changed) { ... }
+  */
+  bool ini_reader::reload(ini_reload_stats * stats)
+  {
+    BELUGA_PROFILE_SCOPE("ini_reader::reload");
+    BELUGA_TRACE_SCOPE("ini_reader::reload");
+    ini_reload_stats reload_stats = {false, 0, 0, 0, 0};
+    if(stats != nullptr)
+    {
+      *stats = reload_stats;
+    }
+    if(!_initialised)
+    {
+      BELUGA_LOG_WARN("ini_reader::reload: not initialised");
+      return false;
+    }
+    File this_file = _storage_backend->open(_config_file_path.c_str(), "r");
+    if(!this_file)
+    {
+      BELUGA_LOG_WARN("ini_reader::reload: could not open %s", _config_file_path.c_str());
+      return false;
+    }
+    ini_file_signature signature = read_file_signature(this_file);
+    if(_reload_signature_check && signature.last_write != 0 && signature.size == _file_signature.size && signature.last_write == _file_signature.last_write)
+    {
+      this_file.close();
+      return true;
+    }
+
+    bool lazy = (_storage_mode == ini_storage_mode::lazy);
+    std::vector<ini_section_hash> new_hashes;
+    std::vector<ini_section_offset> new_offsets;
+    std::vector<uint32_t> changed_sections;
+    std::vector<ini_pending_change> changes;
+    if(_storage_mode == ini_storage_mode::arena)
+    {
+      if(!reload_arena(this_file, &new_hashes, &changed_sections, &changes))
+      {
+        this_file.close();
+        BELUGA_LOG_WARN("ini_reader::reload: could not read %s", _config_file_path.c_str());
+        return false;
+      }
+    }else{
+      //Pass 1: hash every section and find the headings again (pass 2 reads the changed ones from there, lazy mode
+      //keeps the new offsets, and any mode needs the parents they name)
+      ini_section_hasher hasher(&new_hashes);
+      section_offset_scanner scanner(&new_offsets, &hasher);
+      bool scan_ok = ini_visit_file(this_file, scanner);
+      if(!scan_ok)
+      {
+        this_file.close();
+        BELUGA_LOG_WARN("ini_reader::reload: could not read %s", _config_file_path.c_str());
+        return false;
+      }
+      hasher.finish();
+      find_changed_sections(new_hashes, &changed_sections);
+
+      //Pass 2: diff and apply the changed sections
+      if(!changed_sections.empty())
+      {
+        std::map< std::string, std::string > new_parents;
+        collect_section_parents(new_offsets, &new_parents);
+        if(!reload_nested_map(this_file, new_offsets, changed_sections, &new_parents, &changes))
+        {
+          this_file.close();
+          BELUGA_LOG_WARN("ini_reader::reload: could not read %s", _config_file_path.c_str());
+          return false;
+        }
+      }
+    }
+    if(lazy)
+    {
+      for(auto iter = new_offsets.begin(); iter != new_offsets.end(); iter++)
+      {
+        iter->loaded = (_data.find(iter->name) != _data.end());
+      }
+      _section_offsets.swap(new_offsets);
+      if(_section_index_file_enabled)
+      {
+        save_section_index_file(this_file);
+      }
+      refresh_lazy_load_stats();
+    }
+    this_file.close();
+    _section_hashes.swap(new_hashes);
+    _section_hashes_valid = true;
+    _file_signature = signature;
+
+    reload_stats.file_changed = !changed_sections.empty();
+    reload_stats.sections_changed = changed_sections.size();
+    for(auto iter = changes.begin(); iter != changes.end(); iter++)
+    {
+      switch(iter->type)
+      {
+        case ini_change_type::added: reload_stats.entries_added++; break;
+        case ini_change_type::modified: reload_stats.entries_modified++; break;
+        case ini_change_type::removed: reload_stats.entries_removed++; break;
+      }
+    }
+    if(stats != nullptr)
+    {
+      *stats = reload_stats;
+    }
+    BELUGA_LOG_INFO("ini_reader::reload: %u sections changed, %u keys added, %u modified, %u removed", (unsigned) reload_stats.sections_changed,
+      (unsigned) reload_stats.entries_added, (unsigned) reload_stats.entries_modified, (unsigned) reload_stats.entries_removed);
+    if(reload_stats.file_changed)
+    {
+      publish_snapshot();
+    }
+    notify_subscribers(changes);
+    return true;
+  }
+
+  /*!
+  \brief The name hashes of the sections whose content hash differs between the last load and new_hashes, sorted.
+  */
+  void ini_reader::find_changed_sections(const std::vector<ini_section_hash> & new_hashes, std::vector<uint32_t> * changed_sections) const
+  {
+    if(_section_hashes_valid)
+    {
+      ini_changed_sections(_section_hashes, new_hashes, changed_sections);
+      return;
+    }
+    //Never hashed (sections came from a .idx file): treat every loaded section as changed, the diff finds the real changes
+    ini_changed_sections(std::vector<ini_section_hash>(), new_hashes, changed_sections);
+    for(auto iter = _data.begin(); iter != _data.end(); iter++)
+    {
+      changed_sections->push_back(ini_section_name_hash(iter->first.data(), iter->first.size()));
+    }
+    std::sort(changed_sections->begin(), changed_sections->end());
+    changed_sections->erase(std::unique(changed_sections->begin(), changed_sections->end()), changed_sections->end());
+  }
+
+  /*!
+  \brief reload() for nested_map and lazy storage: diff the changed sections against _data and patch it in place.
+  @param new_offsets every heading in the file, from pass 1. The changed sections are read from there.
+  @param new_parents the parents the file's headings now name; swapped into _section_parents. If any differ the
+  index is rebuilt, as for added or removed keys.
+  */
+  bool ini_reader::reload_nested_map(File & this_file, const std::vector<ini_section_offset> & new_offsets, const std::vector<uint32_t> & changed_sections, std::map< std::string, std::string > * new_parents, std::vector<ini_pending_change> * changes)
+  {
+    bool lazy = (_storage_mode == ini_storage_mode::lazy);
+    std::map< std::string, std::map< std::string, std::string > > fresh;
+    std::vector<uint32_t> changed_offsets;
+    for(auto iter = new_offsets.begin(); iter != new_offsets.end(); iter++)
+    {
+      if(std::binary_search(changed_sections.begin(), changed_sections.end(), ini_section_name_hash(iter->name.data(), iter->name.size()))
+        && (!lazy || _data.find(iter->name) != _data.end()))
+      {
+        changed_offsets.push_back(iter->offset);
+      }
+    }
+    if(2 * changed_offsets.size() > new_offsets.size())
+    {
+      //Most of the file changed: one pass is cheaper than a seek per section
+      this_file.seek(0);
+      section_collector collector(changed_sections, lazy ? &_data : nullptr, &fresh);
+      if(!ini_visit_file(this_file, collector))
+      {
+        return false;
+      }
+    }else{
+      for(size_t i = 0; i < changed_offsets.size(); i++)
+      {
+        this_file.seek(changed_offsets[i]);
+        section_collector collector(changed_sections, lazy ? &_data : nullptr, &fresh, true);
+        ini_visit_file(this_file, collector); //Stops at the next heading
+      }
+    }
+    bool rebuild_index = (*new_parents != _section_parents);
+    _section_parents.swap(*new_parents);
+    for(auto section_iter = _data.begin(); section_iter != _data.end(); )
+    {
+      const std::string & section_name = section_iter->first;
+      if(!std::binary_search(changed_sections.begin(), changed_sections.end(), ini_section_name_hash(section_name.data(), section_name.size())))
+      {
+        section_iter++;
+        continue;
+      }
+      auto fresh_iter = fresh.find(section_name);
+      if(fresh_iter == fresh.end())
+      {
+        //The whole section was removed
+        for(auto iter = section_iter->second.begin(); iter != section_iter->second.end(); iter++)
+        {
+          changes->push_back(ini_pending_change(ini_change_type::removed, section_name, iter->first, iter->second, std::string()));
+        }
+        _section_names.erase(std::remove(_section_names.begin(), _section_names.end(), section_name), _section_names.end());
+        section_iter = _data.erase(section_iter);
+        rebuild_index = true;
+        continue;
+      }
+      //Both maps are sorted by key, so walk them together
+      std::map< std::string, std::string > & loaded = section_iter->second;
+      std::map< std::string, std::string > & latest = fresh_iter->second;
+      auto old_iter = loaded.begin();
+      auto new_iter = latest.begin();
+      while(old_iter != loaded.end() || new_iter != latest.end())
+      {
+        if(new_iter == latest.end() || (old_iter != loaded.end() && old_iter->first < new_iter->first))
+        {
+          changes->push_back(ini_pending_change(ini_change_type::removed, section_name, old_iter->first, old_iter->second, std::string()));
+          old_iter = loaded.erase(old_iter);
+          rebuild_index = true;
+        }else if(old_iter == loaded.end() || new_iter->first < old_iter->first){
+          changes->push_back(ini_pending_change(ini_change_type::added, section_name, new_iter->first, std::string(), new_iter->second));
+          loaded.insert(old_iter, *new_iter);
+          new_iter++;
+          rebuild_index = true;
+        }else{
+          if(old_iter->second != new_iter->second)
+          {
+            changes->push_back(ini_pending_change(ini_change_type::modified, section_name, old_iter->first, old_iter->second, new_iter->second));
+            old_iter->second.swap(new_iter->second);
+            ini_handle handle = {ini_handle::invalid_entry};
+            if(!has_override(section_name, old_iter->first))
+            {
+              handle = _index.find_own(section_name.data(), section_name.size(), old_iter->first.data(), old_iter->first.size());
+            }
+            if(handle.is_valid())
+            {
+              ini_index_entry & this_entry = _index.get_entry(handle);
+              this_entry.value.data = old_iter->second.c_str();
+              this_entry.value.length = old_iter->second.size();
+              _index.value_changed(handle); //Its list, if split, views the string swapped out above
+            }else{
+              //Overridden by set_config_value: the lookup finds that entry, and the file's still views the old string
+              rebuild_index = true;
+            }
+          }
+          old_iter++;
+          new_iter++;
+        }
+      }
+      fresh.erase(fresh_iter);
+      section_iter++;
+    }
+    //Anything left is a new section (never in lazy mode, where only loaded sections are collected)
+    for(auto fresh_iter = fresh.begin(); fresh_iter != fresh.end(); fresh_iter++)
+    {
+      for(auto iter = fresh_iter->second.begin(); iter != fresh_iter->second.end(); iter++)
+      {
+        changes->push_back(ini_pending_change(ini_change_type::added, fresh_iter->first, iter->first, std::string(), iter->second));
+      }
+      _section_names.push_back(fresh_iter->first);
+      _data[fresh_iter->first].swap(fresh_iter->second);
+      rebuild_index = true;
+    }
+    if(rebuild_index && !lazy)
+    {
+      _load_stats = estimate_nested_map_load_stats();
+      build_index();
+    }else if(rebuild_index){
+      build_index(); //Load stats are refreshed by reload() once the offsets are updated
+    }
+    return true;
+  }
+
+  /*!
+  \brief True if two arenas hold the same sections (with the same parents) and keys, in the same order.
+  */
+  static bool same_arena_keys(const ini_arena & a, const ini_arena & b)
+  {
+    if(a.section_count() != b.section_count() || a.entry_count() != b.entry_count())
+    {
+      return false;
+    }
+    for(size_t i = 0; i < a.section_count(); i++)
+    {
+      const ini_arena_section & section_a = a.get_section(i);
+      const ini_arena_section & section_b = b.get_section(i);
+      if(section_a.first_entry != section_b.first_entry || section_a.entry_count != section_b.entry_count
+        || section_a.name.length != section_b.name.length || memcmp(a.span_c_str(section_a.name), b.span_c_str(section_b.name), section_a.name.length) != 0
+        || section_a.parent.length != section_b.parent.length || memcmp(a.span_c_str(section_a.parent), b.span_c_str(section_b.parent), section_a.parent.length) != 0)
+      {
+        return false;
+      }
+    }
+    for(size_t i = 0; i < a.entry_count(); i++)
+    {
+      ini_span key_a = a.get_entry(i).key;
+      ini_span key_b = b.get_entry(i).key;
+      if(key_a.length != key_b.length || memcmp(a.span_c_str(key_a), b.span_c_str(key_b), key_a.length) != 0)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*!
+  \brief reload() for arena storage: load the file into a new arena, hash it there and use it only if it changed.
+  \details If it holds the same keys the index is moved onto it (see move_arena_entries); otherwise the index is
+  rebuilt and the changed sections diffed through the old and new indexes. Where a key is repeated within a
+  section, only the value that wins the lookup is compared. Keys are compared as written in each section, not as
+  inherited.
+  @param new_hashes set to the new arena's section hashes.
+  @param changed_sections set to the name hashes of the sections that changed.
+  */
+  bool ini_reader::reload_arena(File & this_file, std::vector<ini_section_hash> * new_hashes, std::vector<uint32_t> * changed_sections, std::vector<ini_pending_change> * changes)
+  {
+    ini_arena fresh;
+    if(!fresh.load(this_file, &_arena))
+    {
+      return false;
+    }
+    hash_arena_sections(fresh, new_hashes);
+    find_changed_sections(*new_hashes, changed_sections);
+    if(changed_sections->empty())
+    {
+      return true; //The new arena is dropped; the loaded one, its views and the handles into it stay
+    }
+    std::swap(fresh, _arena);
+    const ini_arena & old_arena = fresh; //Kept until the old index is done with
+    if(same_arena_keys(old_arena, _arena))
+    {
+      move_arena_entries(old_arena, *changed_sections, changes);
+      return true;
+    }
+    ini_index old_index;
+    std::swap(old_index, _index);
+    _load_stats = _arena.get_load_stats();
+    build_index();
+
+    //Added and modified keys: walk the new index
+    const char * last_section = nullptr;
+    bool section_changed = false;
+    for(uint32_t i = 0; i < _index.size(); i++)
+    {
+      ini_handle handle = {i};
+      const ini_index_entry & this_entry = _index.get_entry(handle);
+      if(this_entry.section.data != last_section)
+      {
+        last_section = this_entry.section.data;
+        section_changed = std::binary_search(changed_sections->begin(), changed_sections->end(), ini_section_name_hash(this_entry.section.data, this_entry.section.length));
+      }
+      if(!section_changed || _index.find_own(this_entry.section.data, this_entry.section.length, this_entry.key.data, this_entry.key.length).entry != i)
+      {
+        continue;
+      }
+      ini_handle old_handle = old_index.find_own(this_entry.section.data, this_entry.section.length, this_entry.key.data, this_entry.key.length);
+      if(!old_handle.is_valid())
+      {
+        changes->push_back(ini_pending_change(ini_change_type::added, view_to_string(this_entry.section), view_to_string(this_entry.key), std::string(), view_to_string(this_entry.value)));
+        continue;
+      }
+      const ini_view & old_value = old_index.get_entry(old_handle).value;
+      if(old_value.length != this_entry.value.length || memcmp(old_value.data, this_entry.value.data, old_value.length) != 0)
+      {
+        changes->push_back(ini_pending_change(ini_change_type::modified, view_to_string(this_entry.section), view_to_string(this_entry.key), view_to_string(old_value), view_to_string(this_entry.value)));
+      }
+    }
+    //Removed keys: walk the old index
+    last_section = nullptr;
+    for(uint32_t i = 0; i < old_index.size(); i++)
+    {
+      ini_handle old_handle = {i};
+      const ini_index_entry & old_entry = old_index.get_entry(old_handle);
+      if(old_entry.section.data != last_section)
+      {
+        last_section = old_entry.section.data;
+        section_changed = std::binary_search(changed_sections->begin(), changed_sections->end(), ini_section_name_hash(old_entry.section.data, old_entry.section.length));
+      }
+      if(!section_changed || old_index.find_own(old_entry.section.data, old_entry.section.length, old_entry.key.data, old_entry.key.length).entry != i)
+      {
+        continue;
+      }
+      if(!_index.find_own(old_entry.section.data, old_entry.section.length, old_entry.key.data, old_entry.key.length).is_valid())
+      {
+        changes->push_back(ini_pending_change(ini_change_type::removed, view_to_string(old_entry.section), view_to_string(old_entry.key), view_to_string(old_entry.value), std::string()));
+      }
+    }
+    return true;
+  }
+
+  /*!
+  \brief reload_arena() where only values changed: point each index entry built from old_arena at the same entry
+  of _arena, so handles, slots and the conversions of unchanged values are kept, and report the values of changed
+  sections that differ.
+  \details Entries are visited in build_index() order. A value set with set_config_value is not old_arena's, so
+  it keeps its view; a change to the file's value under it is still reported.
+  */
+  void ini_reader::move_arena_entries(const ini_arena & old_arena, const std::vector<uint32_t> & changed_sections, std::vector<ini_pending_change> * changes)
+  {
+    uint32_t i = 0;
+    for(size_t s = 0; s < _arena.section_count(); s++)
+    {
+      const ini_arena_section & this_section = _arena.get_section(s);
+      ini_view section = _arena.span_view(this_section.name);
+      bool section_changed = std::binary_search(changed_sections.begin(), changed_sections.end(), ini_section_name_hash(section.data, section.length));
+      for(size_t j = 0; j < this_section.entry_count; j++, i++)
+      {
+        ini_handle handle = {i};
+        ini_view key = _arena.span_view(_arena.get_entry(this_section.first_entry + j).key);
+        ini_view value = _arena.span_view(_arena.get_entry(this_section.first_entry + j).value);
+        ini_view old_value = old_arena.span_view(old_arena.get_entry(this_section.first_entry + j).value);
+        bool value_changed = old_value.length != value.length || memcmp(old_value.data, value.data, value.length) != 0;
+        if(section_changed && value_changed && _index.find_own(section.data, section.length, key.data, key.length).entry == i)
+        {
+          changes->push_back(ini_pending_change(ini_change_type::modified, view_to_string(section), view_to_string(key), view_to_string(old_value), view_to_string(value)));
+        }
+        const ini_view & indexed_value = _index.get_entry(handle).value;
+        if(indexed_value.data != old_value.data)
+        {
+          value = indexed_value; //Set by set_config_value
+        }
+        _index.move_entry(handle, section, key, value);
+      }
+    }
+    _index.clear_parents();
+    add_index_parents();
+    _index.build_parents();
+    _load_stats = _arena.get_load_stats();
+    _load_stats.bytes_used += _index.heap_bytes();
+    _load_stats.allocation_count += _index.allocation_count();
+  }
+
+  /*!
+  \brief Call every matching subscriber for each change, in file-diff order.
+  */
+  void ini_reader::notify_subscribers(const std::vector<ini_pending_change> & changes)
+  {
+    for(auto iter = changes.begin(); iter != changes.end(); iter++)
+    {
+      ini_change change = {iter->type, {iter->section.c_str(), iter->section.size()}, {iter->key.c_str(), iter->key.size()},
+        {iter->old_value.c_str(), iter->old_value.size()}, {iter->new_value.c_str(), iter->new_value.size()}};
+      for(size_t i = 0; i < _subscriptions.size(); i++)
+      {
+        ini_change_callback callback = _subscriptions[i].callback;
+        void * context = _subscriptions[i].context;
+        if(callback == nullptr
+          || (!_subscriptions[i].section.empty() && _subscriptions[i].section != iter->section)
+          || (!_subscriptions[i].key.empty() && _subscriptions[i].key != iter->key))
+        {
+          continue;
+        }
+        callback(context, change);
+      }
+    }
+  }
+
+  /*!
+  \brief Publish a snapshot of the config to publisher after initialise() and after every reload() that changes it.
+  \details If already initialised, a snapshot is published straight away. Pass nullptr to stop publishing.
+  In lazy mode a snapshot holds only the sections loaded so far; call publish_snapshot() after reading the sections
+  other tasks need.
+  */
+  void ini_reader::set_snapshot_publisher(ini_snapshot_publisher * publisher)
+  {
+    _snapshot_publisher = publisher;
+    if(_initialised)
+    {
+      publish_snapshot();
+    }
+  }
+
+  /*!
+  \brief Copy the loaded config into a new, immutable snapshot. The caller owns it.
+  */
+  ini_snapshot * ini_reader::make_snapshot() const
+  {
+    ini_snapshot * snapshot = new ini_snapshot();
+    snapshot->build(_index);
+    return snapshot;
+  }
+
+  /*!
+  \brief Compile the loaded config into a blob for ini_blob_reader (see ini_blob_compile).
+  \details In lazy mode the blob holds only the sections loaded so far.
+  \return False if not initialised or the config does not fit the blob format.
+  */
+  bool ini_reader::compile_blob(std::vector<uint8_t> * blob) const
+  {
+    if(!_initialised)
+    {
+      return false;
+    }
+    return ini_blob_compile(_index, blob);
+  }
+
+  /*!
+  \brief Build a snapshot and hand it to the publisher set with set_snapshot_publisher().
+  \return False if there is no publisher.
+  */
+  bool ini_reader::publish_snapshot()
+  {
+    if(_snapshot_publisher == nullptr)
+    {
+      return false;
+    }
+    _snapshot_publisher->publish(make_snapshot());
+    return true;
+  }
+
+  /*!
+  \brief Be told by reload() when a key changes.
+  @param section_name the section to watch; empty to watch every section.
+  @param key_name the key to watch; empty to watch every key in the section.
+  @param callback called once per added, modified or removed key, after the change is applied.
+  \return A subscription id for unsubscribe(), or -1 if callback is null.
+  Usage: int id = ini.subscribe("wifi", "", on_wifi_change, &wifi);
+  */
+  int ini_reader::subscribe(const std::string & section_name, const std::string & key_name, ini_change_callback callback, void * context)
+  {
+    if(callback == nullptr)
+    {
+      return -1;
+    }
+    ini_subscription this_subscription = {section_name, key_name, callback, context};
+    for(size_t i = 0; i < _subscriptions.size(); i++)
+    {
+      if(_subscriptions[i].callback == nullptr)
+      {
+        _subscriptions[i] = this_subscription;
+        return (int) i;
+      }
+    }
+    _subscriptions.push_back(this_subscription);
+    return (int) (_subscriptions.size() - 1);
+  }
+
+  /*!
+  \brief Remove a subscription. Its id may be reused by a later subscribe().
+  \return False if the id is not a current subscription.
+  */
+  bool ini_reader::unsubscribe(int subscription_id)
+  {
+    if(subscription_id < 0 || (size_t) subscription_id >= _subscriptions.size() || _subscriptions[subscription_id].callback == nullptr)
+    {
+      return false;
+    }
+    _subscriptions[subscription_id].callback = nullptr;
+    _subscriptions[subscription_id].section.clear();
+    _subscriptions[subscription_id].key.clear();
+    return true;
+  }
+  
+  /*!
+  Some fields are a list of names (of devices or comms channels or whatever)
+  parse_names_config retrieves the list and splits it into a vector
+  If not initialised, return false
+  if the config_file_section is not found, return false
+  If the config_key is not found, return true (it means an empty list, which is valid)
+  Builds a new vector of strings on every call, with tokens untrimmed; for comma-separated lists prefer
+  get_config_list, which returns the tokens split at load time without any copy.
+  */
+ bool ini_reader::get_config_list_field(const std::string & config_file_section, const std::string & config_key, std::vector<std::string> & results_vec, const std::string & delim)
+ {
+    BELUGA_HEAP_SCOPE(ini_get_config_list_field);
+    if(! _initialised)
+    {
+      return false;
+    }
+
+    ini_handle handle = get_config_handle(config_file_section, config_key);
+    if(!handle.is_valid())
+    {
+      BELUGA_LOG_WARN("ini_reader::get_config_list_field: section name %s has no key: %s", config_file_section.c_str(), config_key.c_str());
+      return false;
+    }
+
+    const ini_view & list_of_names = _index.get_entry(handle).value;
+    results_vec = beluga_utils::split_string(std::string(list_of_names.data, list_of_names.length), delim);
+    return true;
+ }
+
+  /*!
+  \brief Call callback once for every key of a section (each key once, with the value a lookup returns), including
+  the keys it inherits and does not override.
+  \details Loads the section (and its ancestors) first in lazy mode. Walks the whole index, so it is for boot-time
+  checks (see ini_schema), not hot code.
+  \return The number of keys.
+  */
+  size_t ini_reader::for_each_key(const char * section_name, ini_key_callback callback, void * context)
+  {
+    size_t section_len = strlen(section_name);
+    if(_storage_mode == ini_storage_mode::lazy)
+    {
+      load_lazy_section(section_name, section_len);
+    }
+    return _index.for_each_key(section_name, section_len, callback, context);
+  }
+
+  /*!
+  \brief A comma-separated value as a list of tokens, split the first time it is read as a list.
+  @param return_list set to a range of ini_views over the tokens (spaces around each removed). No copy or
+  allocation is made. Valid until clear(), initialise(), reload() or, in lazy mode, the loading of another section.
+  \return False if the section-key pair is not present.
+  Usage:
+  ini_list_view subdevices;
+  if(ini.get_config_list("my_device", "subdevice_list", &subdevices))
+  {
+    for(const ini_view & name : subdevices) { add_subdevice(name.data); }
+  }
+  */
+  bool ini_reader::get_config_list(ini_handle handle, ini_list_view * return_list) const
+  {
+    return _index.get_list(handle, return_list);
+  }
+
+  bool ini_reader::get_config_list(const std::string & section_name, const std::string & key_name, ini_list_view * return_list)
+  {
+    return get_config_list(get_config_handle(section_name, key_name), return_list);
+  }
+
+  /*!
+  \brief A comma-separated list of integers (decimal or 0x hex), parsed when the value is first read as a list.
+  \return ok, not_found, or the error of the first token that is not an int32_t. return_list is written only on ok.
+  Usage:
+  ini_int_list_view pins;
+  if(ini.get_config_int_list("my_device", "pins", &pins) == ini_error::ok) { for(int32_t pin : pins) { pinMode(pin, OUTPUT); } }
+  */
+  ini_error ini_reader::get_config_int_list(ini_handle handle, ini_int_list_view * return_list) const
+  {
+    return _index.get_int_list(handle, return_list);
+  }
+
+  ini_error ini_reader::get_config_int_list(const std::string & section_name, const std::string & key_name, ini_int_list_view * return_list)
+  {
+    return get_config_int_list(get_config_handle(section_name, key_name), return_list);
+  }
+
+  /*!
+  \brief If compact() was cut off after removing the config file but before renaming the rewritten one over it,
+  finish the rename. A .tmp left beside an existing config is an unfinished rewrite and is ignored.
+  */
+  void ini_reader::recover_rewrite()
+  {
+    std::string temp_path = _config_file_path + ".tmp";
+    if(!_storage_backend->exists(_config_file_path.c_str()) && _storage_backend->exists(temp_path.c_str()))
+    {
+      BELUGA_LOG_WARN("ini_reader: %s is missing, recovering it from %s", _config_file_path.c_str(), temp_path.c_str());
+      _storage_backend->rename(temp_path.c_str(), _config_file_path.c_str());
+    }
+  }
+
+  /*!
+  \brief Read <config path>.jnl, if there is one, into _overrides. Commits torn by a power cut are skipped.
+  \details A journal without a valid header (e.g. its first commit was cut off before the header reached the
+  card) is ignored, and the next commit() starts it again.
+  */
+  void ini_reader::load_journal()
+  {
+    _overrides.clear();
+    _pending_edits.clear();
+    _journal_valid = false;
+    std::string path = journal_path();
+    if(!_storage_backend->exists(path.c_str()))
+    {
+      return;
+    }
+    File journal_file = _storage_backend->open(path.c_str(), "r");
+    size_t n_records = 0;
+    size_t n_damaged = 0;
+    _journal_valid = ini_journal_replay(journal_file, replay_journal_record, this, &n_records, &n_damaged);
+    if(!_journal_valid)
+    {
+      BELUGA_LOG_WARN("ini_reader: %s is not a config journal, ignored: the next commit replaces it", path.c_str());
+    }else if(n_damaged > 0){
+      BELUGA_LOG_WARN("ini_reader: %s: %u records replayed, %u damaged records skipped", path.c_str(), (unsigned) n_records, (unsigned) n_damaged);
+    }else{
+      BELUGA_LOG_DEBUG("ini_reader: %s: %u records replayed", path.c_str(), (unsigned) n_records);
+    }
+    if(journal_file)
+    {
+      journal_file.close();
+    }
+  }
+
+  void ini_reader::replay_journal_record(void * context, ini_view section, ini_view key, ini_view value)
+  {
+    ini_reader * reader = (ini_reader *) context;
+    std::string section_name(section.data, section.length);
+    std::string key_name(key.data, key.length);
+    std::string this_value(value.data, value.length);
+    if(ini_writable_pair(section_name, key_name, this_value))
+    {
+      reader->_overrides[section_name][key_name].swap(this_value);
+    }
+  }
+
+  /*!
+  \brief Index the values set at runtime. Added after the file's entries, so they win; a section loaded later in
+  lazy mode skips the keys they cover, so each stays one entry.
+  */
+  void ini_reader::add_override_entries()
+  {
+    for(auto section_iter = _overrides.begin(); section_iter != _overrides.end(); section_iter++)
+    {
+      ini_view section_view = {section_iter->first.c_str(), section_iter->first.size()};
+      for(auto key_iter = section_iter->second.begin(); key_iter != section_iter->second.end(); key_iter++)
+      {
+        ini_view key_view = {key_iter->first.c_str(), key_iter->first.size()};
+        ini_view value_view = {key_iter->second.c_str(), key_iter->second.size()};
+        _index.add_entry(section_view, key_view, value_view);
+      }
+    }
+  }
+
+  bool ini_reader::has_override(const std::string & section_name, const std::string & key_name) const
+  {
+    auto section_iter = _overrides.find(section_name);
+    return section_iter != _overrides.end() && section_iter->second.count(key_name) != 0;
+  }
+
+  /*!
+  \brief Set a value at runtime, e.g. a calibration offset or a device ID. Reads see it at once; commit() keeps it
+  across reboots.
+  @param section_name the section, which need not be in the file yet.
+  @param key_name the key, which need not be in the file (or the section) yet.
+  @param value the new value, as it would be written in the file.
+  \return False if not initialised, or if the pair cannot be written to an .ini file and read back unchanged
+  (see ini_writable_pair: no newlines, no whitespace at either end, no '=' in the key, no '[', ']' or ':' in the section).
+  \details The value wins over the file's (and over an inherited one) from now on, including after a reload() of an
+  edited file, until compact() folds it into the file. Handles to a key the section already had stay valid and read
+  the new value; a key new to its section gets a new handle, so look it up again. Typed caches of the key are
+  dropped, and the key's list is split again when next read. A call is one lookup, plus one insert for a new key
+  (which re-hashes the index only when it has grown to half its slot table). Call publish_snapshot() for snapshot
+  readers to see it.
+  Usage:
+  if(ini.set_config_value("imu", "gyro_offset_x", "-0.0123")) { ini.commit(); }
+  */
+  bool ini_reader::set_config_value(const std::string & section_name, const std::string & key_name, const std::string & value)
+  {
+    if(!_initialised)
+    {
+      BELUGA_LOG_WARN("ini_reader::set_config_value: not initialised");
+      return false;
+    }
+    if(!ini_writable_pair(section_name, key_name, value))
+    {
+      BELUGA_LOG_WARN("ini_reader::set_config_value: [%s] %s = %s cannot be written to an .ini file", section_name.c_str(), key_name.c_str(), value.c_str());
+      return false;
+    }
+    auto section_iter = _overrides.insert(std::make_pair(section_name, std::map<std::string, std::string>())).first;
+    auto key_iter = section_iter->second.insert(std::make_pair(key_name, std::string())).first;
+    key_iter->second = value;
+    _pending_edits.insert(std::make_pair(section_name, key_name));
+
+    //Point the entry lookups find (the file's, or an earlier override's) at the new value, or index a new one
+    ini_handle handle = _index.find_own(section_name.data(), section_name.size(), key_name.data(), key_name.size());
+    if(handle.is_valid())
+    {
+      ini_index_entry & this_entry = _index.get_entry(handle);
+      this_entry.value.data = key_iter->second.c_str();
+      this_entry.value.length = key_iter->second.size();
+      _index.value_changed(handle);
+    }else{
+      ini_view section_view = {section_iter->first.c_str(), section_iter->first.size()};
+      ini_view key_view = {key_iter->first.c_str(), key_iter->first.size()};
+      ini_view value_view = {key_iter->second.c_str(), key_iter->second.size()};
+      _index.insert_entry(section_view, key_view, value_view);
+    }
+    return true;
+  }
 
+  /*!
+  \brief Make the values set since the last commit persistent, as set by set_commit_mode().
+  @param stats set to the records and bytes written and the time taken. May be null.
+  \return False if the journal or the file could not be written. The edits stay pending, so commit() can be retried.
+  \details ini_commit_mode::journal (the default) appends one CRC-checked record per changed key to
+  <config path>.jnl, then a line closing the commit: a few dozen bytes, however large the file, and the config file
+  is not touched. Replay drops a commit whose closing line is missing or whose records are not all intact, so a
+  commit cut off by a power cut is lost whole or kept whole. A journal whose header never reached the card is
+  written again from the start.
+  ini_commit_mode::rewrite calls compact(), rewriting the file.
+  Usage:
+  ini_commit_stats commit_stats;
+  ini.commit(&commit_stats);
+  BELUGA_LOG_INFO("%u bytes in %u us", commit_stats.bytes_written, commit_stats.elapsed_us);
+  */
+  bool ini_reader::commit(ini_commit_stats * stats)
+  {
+    BELUGA_PROFILE_SCOPE("ini_reader::commit");
+    if(_commit_mode == ini_commit_mode::rewrite)
+    {
+      return compact(stats);
+    }
+    uint32_t start_us = (uint32_t) micros();
+    ini_commit_stats commit_stats = {0, 0, 0, 0, false};
+    if(stats != nullptr)
+    {
+      *stats = commit_stats;
+    }
+    if(!_initialised)
+    {
+      BELUGA_LOG_WARN("ini_reader::commit: not initialised");
+      return false;
+    }
+    std::string path = journal_path();
+    bool new_journal = !_journal_valid; //Missing, or its header was cut off: start it again
+    std::string records;
+    if(new_journal)
+    {
+      records = ini_journal_header;
+    }
+    for(auto iter = _pending_edits.begin(); iter != _pending_edits.end(); iter++)
+    {
+      ini_journal_record(&records, iter->first, iter->second, _overrides[iter->first][iter->second]);
+    }
+    ini_journal_end_commit(&records, _pending_edits.size());
+    if(!_pending_edits.empty())
+    {
+      File journal_file = _storage_backend->open(path.c_str(), new_journal ? "w" : "a");
+      if(!journal_file)
+      {
+        BELUGA_LOG_ERROR("ini_reader::commit: could not open %s", path.c_str());
+        return false;
+      }
+      size_t n_written = journal_file.write((const uint8_t *) records.data(), records.size());
+      journal_file.flush();
+      commit_stats.journal_bytes = (uint32_t) journal_file.size();
+      journal_file.close();
+      commit_stats.bytes_written = (uint32_t) n_written;
+      if(n_written != records.size())
+      {
+        BELUGA_LOG_ERROR("ini_reader::commit: short write to %s", path.c_str());
+        return false;
+      }
+      _journal_valid = true;
+      commit_stats.records = (uint32_t) _pending_edits.size();
+      _pending_edits.clear();
+    }else if(!new_journal){
+      File journal_file = _storage_backend->open(path.c_str(), "r");
+      if(journal_file)
+      {
+        commit_stats.journal_bytes = (uint32_t) journal_file.size();
+        journal_file.close();
+      }
+    }
+    commit_stats.elapsed_us = (uint32_t) micros() - start_us;
+    if(stats != nullptr)
+    {
+      *stats = commit_stats;
+    }
+    return true;
+  }
 
+  /*!
+  \brief Fold every value set at runtime (committed or not) into the config file, and delete the journal.
+  @param stats set to the records and bytes written and the time taken. May be null.
+  \return False if the file could not be rewritten. Nothing is lost: the journal and pending edits are kept.
+  \details The file is rewritten by ini_rewrite_file, so only the changed values differ: comments, blank lines
+  and ordering are kept, new keys go at the end of their section and new sections at the end of the file. It is
+  written to <config path>.tmp and renamed over the config, so a power cut leaves the old file or the new one;
+  where the filesystem cannot rename over an existing file (SPIFFS, FAT) the config is removed first, and
+  initialise() finishes the rename if it was cut off in between. The file is then loaded again, so every handle
+  and view is invalidated. Compact when the journal has grown (see ini_commit_stats::journal_bytes), or before
+  handing the file to something that does not read the journal.
+  */
+  bool ini_reader::compact(ini_commit_stats * stats)
+  {
+    BELUGA_PROFILE_SCOPE("ini_reader::compact");
+    uint32_t start_us = (uint32_t) micros();
+    ini_commit_stats commit_stats = {0, 0, 0, 0, false};
+    if(stats != nullptr)
+    {
+      *stats = commit_stats;
+    }
+    if(!_initialised)
+    {
+      BELUGA_LOG_WARN("ini_reader::compact: not initialised");
+      return false;
+    }
+    std::string path = journal_path();
+    if(_overrides.empty() && !_storage_backend->exists(path.c_str()))
+    {
+      return true;
+    }
+    std::string temp_path = _config_file_path + ".tmp";
+    File source = _storage_backend->open(_config_file_path.c_str(), "r");
+    File dest = _storage_backend->open(temp_path.c_str(), "w");
+    size_t n_written = 0;
+    bool rewrite_ok = ini_rewrite_file(source, dest, _overrides, &n_written);
+    if(dest)
+    {
+      dest.flush();
+      dest.close();
+    }
+    if(source)
+    {
+      source.close();
+    }
+    if(!rewrite_ok)
+    {
+      BELUGA_LOG_ERROR("ini_reader::compact: could not rewrite %s to %s", _config_file_path.c_str(), temp_path.c_str());
+      _storage_backend->remove(temp_path.c_str());
+      return false;
+    }
+    if(!_storage_backend->rename(temp_path.c_str(), _config_file_path.c_str()))
+    {
+      _storage_backend->remove(_config_file_path.c_str());
+      if(!_storage_backend->rename(temp_path.c_str(), _config_file_path.c_str()))
+      {
+        BELUGA_LOG_ERROR("ini_reader::compact: could not rename %s to %s", temp_path.c_str(), _config_file_path.c_str());
+        return false;
+      }
+    }
+    _storage_backend->remove(path.c_str());
+    for(auto iter = _overrides.begin(); iter != _overrides.end(); iter++)
+    {
+      commit_stats.records += (uint32_t) iter->second.size();
+    }
+    commit_stats.bytes_written = (uint32_t) n_written;
+    commit_stats.rewritten = true;
 
-}
\ No newline at end of file
+    //The values are in the file now: load it again, so storage, index and file hashes all match it
+    clear();
+    bool load_ok = initialise(false);
+    commit_stats.elapsed_us = (uint32_t) micros() - start_us;
+    if(stats != nullptr)
+    {
+      *stats = commit_stats;
+    }
+    return load_ok;
+  }
+}
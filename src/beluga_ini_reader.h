@@ -3,17 +3,43 @@
 #include <sstream>
 #include "beluga_string.h"
 #include <vector>
+#include <map>
+#include <set>
+#include <utility>
 #include "beluga_debug.h"
 #include "beluga_constants.h"
+#include "beluga_ini_arena.h"
+#include "beluga_ini_index.h"
+#include "beluga_ini_visitor.h"
+#include "beluga_ini_line_reader.h"
+#include "beluga_ini_reload.h"
+#include "beluga_ini_snapshot.h"
+#include "beluga_ini_blob.h"
+#include "beluga_ini_writeback.h"
+#include "beluga_storage_backend.h"
 namespace beluga_utils
 {
+    /*!
+    \brief How ini_reader holds the loaded config
+    \details nested_map: a std::map of std::map of std::string (one heap node and string per section/key/value).
+    arena: the whole file in one contiguous buffer, with sections and key/value pairs stored as offset/length
+    records into it (see ini_arena). Use arena on memory-constrained targets with many keys.
+    lazy: initialise() only records the file offset of each [section] heading. A section's keys are parsed into
+    the nested map the first time they are asked for. Use lazy when a device reads a few sections of a large shared file.
+    */
+    enum class ini_storage_mode
+    {
+        nested_map,
+        arena,
+        lazy
+    };
+
     /*!
     \brief Ini-format file reader
     \author Bryan Clarke
     \date 19/10/2024
-    \todo Test with LittleFS as well as SPIFFS. Possibly replace, possibly add an option to choose between the two.
     \details Configuration data is to be read from a .ini file which is uploaded to the data partition
-    on the microcontroller and managed using SPIFFS. The filename is specified in the source and must start with ./ e.g. "./config.ini". 
+    on the microcontroller and managed using SPIFFS (or another filesystem; see set_storage_backend and beluga_storage_backend.h). The filename is specified in the source and must start with ./ e.g. "./config.ini". 
     This is a fast and dirty ini-file reader. If you want a more full-featured version, one option is
     to use SPIFFSIniFile: https://github.com/yurilopes/SPIFFSIniFile
     NOTE: SPIFFSIniFile uses the GPLv3 license!
@@ -27,8 +53,13 @@ namespace beluga_utils
     enable_serial_log =  true
     -----
     The config section [my_device] is used to identify the device, and MUST be unique.
-    Maximum length of any line is 255 characters. This includes the key, the val, the equals sign and any spaces.
-    (This is defined by the _line_buffer_len variable in beluga_ini_reader.h and you could change it if you really needed to).
+    A section can inherit another's keys and override some of them, e.g. a fleet sharing one base section:
+    [my_device_2 : my_device]
+    enable_serial_log = false
+    A lookup in my_device_2 falls back to my_device (then to its parent, and so on). Inherited keys are stored once,
+    in the parent, so memory grows with the keys written rather than with keys times devices.
+    Lines may be any length. The file is read in ini_read_block_size blocks (see beluga_ini_line_reader.h), and \n and \r\n
+    line endings are both accepted.
     Config fields are returned as strings; it is assumed that you know what the underlying data type really is and
     can manually perform type conversions.
     -----
@@ -39,35 +70,180 @@ namespace beluga_utils
     std::string key_str("key1");
     std::string return_str;
     bool got_config_ok = this_ini.get_config_name(section_name, key_str, &return_str);
-    \todo Implement additional get_config_value functions with different return types and perform the type conversion in here.
+    Typed getters convert the value for you and return an ini_error rather than throwing:
+    int32_t pin;
+    ini_error err = ini.get_config_int("my_device", "pin", &pin);
+    Supported types are bool, int32_t, float, IPv4 (dotted quad) and durations ("250ms", "1.5s"). See beluga_ini_parse.h.
+    The parsed value is cached per key, so repeated reads do not parse again.
 
     NOTE: ALL data from the .ini is loaded into the _data dictionary-of-dictionaries. If your .ini is huge you'll eat all the memory.debug_print
     Call clear() once you are done reading from the .ini.
+    To avoid one heap allocation per section/key/value, construct with ini_storage_mode::arena:
+    ini_reader ini("./config.ini", ini_storage_mode::arena);
+    get_load_stats() reports the bytes used and allocation count of the last load.
+    For values read repeatedly, resolve the section-key pair once and read through the handle:
+    ini_handle h = ini.get_config_handle("my_device", "pin");
+    ini_view pin_str;
+    ini.get_config_value(h, &pin_str);
+    Comma-separated lists are split the first time they are read; get_config_list returns the tokens without copying:
+    ini_list_view subdevices;
+    if(ini.get_config_list("my_device", "subdevice_list", &subdevices)) { for(const ini_view & name : subdevices) { ... } }
+    get_config_int_list does the same for lists of integers, e.g. "pins = 4, 5, 18".
+    To pick a few values out of a large file without loading it, stream it through an ini_visitor with visit() instead,
+    or construct with ini_storage_mode::lazy so only the sections you read are parsed and kept. With
+    enable_section_index_file(true) the section offsets are also saved to <config path>.idx so later boots skip the scan.
+    To pick up edits without a reboot, call reload(). Subscribers are told about each key that was added, modified or removed:
+    void on_pin_change(void * context, const ini_change & change) { ...re-read the pin... }
+    ini.subscribe("my_device", "pin", on_pin_change);
+    ini.reload();
+    ini_reader itself is not thread-safe (typed reads fill a cache, lazy mode loads on a miss). To read config from
+    other tasks or the other core, publish immutable snapshots and read those instead (see ini_snapshot_publisher):
+    ini.set_snapshot_publisher(&config_snapshots);
+    To fill a struct from a section in one checked pass, declare an ini_schema (beluga_ini_schema.h) and bind() it:
+    motor_schema.bind(ini, &motor_left, "motor_left");
+    To skip parsing at boot altogether, compile the config into a binary blob on the host (compile_blob, or the
+    example/ini_compile tool) and read it in place from a flash partition with ini_blob_reader.
+    To keep values tuned at runtime (calibration offsets, IDs), set them and commit. By default commit() appends only
+    the changed keys to <config path>.jnl, which initialise() replays over the file; compact() folds the journal
+    into the file, keeping its comments and ordering:
+    ini.set_config_value("imu", "gyro_offset_x", "-0.0123");
+    ini.commit();
     NOTE: ALL data from the .ini is read as STRINGS. It is assumed that you know what type to convert them to, if necessary. If you
     really care about automated typing, there are JSON libraries that will do what you need.
     */
     class ini_reader
     {
         public:
-            ini_reader(std::string);
+            ini_reader(std::string, ini_storage_mode storage_mode = ini_storage_mode::nested_map);
             bool initialise(bool crash_on_fail = true );
-            bool get_config_value(std::string section_name, std::string key_name, std::string * return_config_value, bool verbose = true);
-            bool get_config_list_field(std::string config_file_section, std::string config_key, std::vector<std::string> & results_vec, std::string delim=",");
+            bool visit(ini_visitor & visitor, bool crash_on_fail = false);
+            bool get_config_value(const std::string & section_name, const std::string & key_name, std::string * return_config_value, bool verbose = true);
+            ini_handle get_config_handle(const char * section_name, const char * key_name);
+            ini_handle get_config_handle(const std::string & section_name, const std::string & key_name);
+            bool get_config_value(ini_handle handle, ini_view * return_config_value) const;
+            ini_error get_config_bool(const std::string & section_name, const std::string & key_name, bool * return_value);
+            ini_error get_config_int(const std::string & section_name, const std::string & key_name, int32_t * return_value);
+            ini_error get_config_float(const std::string & section_name, const std::string & key_name, float * return_value);
+            ini_error get_config_ipv4(const std::string & section_name, const std::string & key_name, ini_ipv4 * return_value);
+            ini_error get_config_duration_ms(const std::string & section_name, const std::string & key_name, uint32_t * return_value);
+            ini_error get_config_bool(ini_handle handle, bool * return_value);
+            ini_error get_config_int(ini_handle handle, int32_t * return_value);
+            ini_error get_config_float(ini_handle handle, float * return_value);
+            ini_error get_config_ipv4(ini_handle handle, ini_ipv4 * return_value);
+            ini_error get_config_duration_ms(ini_handle handle, uint32_t * return_value);
+            bool get_config_list_field(const std::string & config_file_section, const std::string & config_key, std::vector<std::string> & results_vec, const std::string & delim=",");
+            bool get_config_list(const std::string & section_name, const std::string & key_name, ini_list_view * return_list);
+            bool get_config_list(ini_handle handle, ini_list_view * return_list) const;
+            ini_error get_config_int_list(const std::string & section_name, const std::string & key_name, ini_int_list_view * return_list);
+            ini_error get_config_int_list(ini_handle handle, ini_int_list_view * return_list) const;
+            size_t for_each_key(const char * section_name, ini_key_callback callback, void * context);
             void print_config_to_serial();
             void clear();
+            bool reload(ini_reload_stats * stats = nullptr);
+            int subscribe(const std::string & section_name, const std::string & key_name, ini_change_callback callback, void * context = nullptr);
+            bool unsubscribe(int subscription_id);
+            void set_snapshot_publisher(ini_snapshot_publisher * publisher);
+            ini_snapshot * make_snapshot() const;
+            bool publish_snapshot();
+            bool compile_blob(std::vector<uint8_t> * blob) const;
+            bool set_config_value(const std::string & section_name, const std::string & key_name, const std::string & value);
+            bool commit(ini_commit_stats * stats = nullptr);
+            bool compact(ini_commit_stats * stats = nullptr);
+            void set_commit_mode(ini_commit_mode mode){_commit_mode = mode;}
+            size_t pending_edit_count(){return _pending_edits.size();}
             bool is_initialised(){return _initialised;}
+            ini_load_stats get_load_stats(){return _load_stats;}
+            ini_storage_mode get_storage_mode(){return _storage_mode;}
+            void enable_section_index_file(bool enable){_section_index_file_enabled = enable;}
+            void enable_reload_signature_check(bool enable){_reload_signature_check = enable;}
+            void set_storage_backend(storage_backend * backend);
+            storage_backend * get_storage_backend(){return _storage_backend;}
             std::string _config_file_path; //Public for debugging, TODO: move to protected
 
         protected:
           bool initialise_return_failure(std::string error_message, bool crash_on_fail);
-          const size_t _line_buffer_len = beluga_utils::ini_reader_max_line_size;
           bool _file_found = false;
           bool _file_valid = false;
           bool _initialised = false;
           bool add_new_section_name(std::string this_name);
-          bool add_new_config_data(std::string this_section_name, std::string this_data);
+          bool add_new_config_data(const std::string & this_section_name, const std::string & this_key, const std::string & this_value);
+          class nested_map_builder;
+          ini_load_stats estimate_nested_map_load_stats();
+          void build_index();
+          void add_index_parents();
+          static void hash_arena_sections(const ini_arena & arena, std::vector<ini_section_hash> * hashes);
+          ini_handle find_handle(const char * section_name, size_t section_len, const char * key_name, size_t key_len);
+
+          //Lazy storage mode
+          struct ini_section_offset
+          {
+              std::string name;
+              std::string parent; //[name : parent], or empty
+              uint32_t offset; //Byte offset of the [name] heading, or 0 for the unnamed section at the top of the file
+              bool loaded;
+          };
+          class section_offset_scanner;
+          class section_loader;
+          bool initialise_lazy(File & this_file);
+          bool load_section_index_file(File & this_file);
+          void save_section_index_file(File & this_file);
+          bool load_lazy_section(const char * section_name, size_t section_len);
+          bool load_lazy_occurrences(const char * section_name, size_t section_len);
+          static void collect_section_parents(const std::vector<ini_section_offset> & offsets, std::map< std::string, std::string > * parents);
+          void refresh_lazy_load_stats();
+          std::vector<ini_section_offset> _section_offsets;
+          bool _section_index_file_enabled = false;
+          ini_storage_mode _storage_mode;
+          storage_backend * _storage_backend;
+          ini_arena _arena;
+          ini_index _index; //Hashed section-key lookup over _data or _arena, built at the end of initialise()
+          ini_load_stats _load_stats = {0, 0};
           std::map< std::string, std::map< std::string, std::string > > _data; //A nested dictionary: { section1: {key1:val1, key2:val2}, section2: {key1: val1, key2: val2}, ... }
           std::vector<std::string> _section_names;
+          std::map< std::string, std::string > _section_parents; //nested_map and lazy: section -> the parent its heading names
+
+          //Reload
+          struct ini_subscription
+          {
+              std::string section; //Empty matches every section
+              std::string key;     //Empty matches every key in the section
+              ini_change_callback callback;
+              void * context;
+          };
+          struct ini_pending_change
+          {
+              ini_pending_change(ini_change_type t, const std::string & s, const std::string & k, const std::string & o, const std::string & n) : type(t), section(s), key(k), old_value(o), new_value(n) {};
+              ini_change_type type;
+              std::string section;
+              std::string key;
+              std::string old_value;
+              std::string new_value;
+          };
+          class section_collector;
+          static ini_file_signature read_file_signature(File & this_file);
+          void find_changed_sections(const std::vector<ini_section_hash> & new_hashes, std::vector<uint32_t> * changed_sections) const;
+          bool reload_nested_map(File & this_file, const std::vector<ini_section_offset> & new_offsets, const std::vector<uint32_t> & changed_sections, std::map< std::string, std::string > * new_parents, std::vector<ini_pending_change> * changes);
+          bool reload_arena(File & this_file, std::vector<ini_section_hash> * new_hashes, std::vector<uint32_t> * changed_sections, std::vector<ini_pending_change> * changes);
+          void move_arena_entries(const ini_arena & old_arena, const std::vector<uint32_t> & changed_sections, std::vector<ini_pending_change> * changes);
+          void notify_subscribers(const std::vector<ini_pending_change> & changes);
+          ini_file_signature _file_signature = {0, 0};
+          bool _reload_signature_check = false;
+          std::vector<ini_section_hash> _section_hashes; //Per-section content hashes of the loaded config
+          bool _section_hashes_valid = false; //False if the sections were never hashed (lazy mode with a .idx file)
+          std::vector<ini_subscription> _subscriptions;
+          ini_snapshot_publisher * _snapshot_publisher = nullptr;
+
+          //Writeback
+          std::string journal_path() const {return _config_file_path + ".jnl";}
+          void recover_rewrite();
+          void load_journal();
+          static void replay_journal_record(void * context, ini_view section, ini_view key, ini_view value);
+          void add_override_entries();
+          bool has_override(const std::string & section_name, const std::string & key_name) const;
+          ini_edit_map _overrides; //Values set at runtime or replayed from the journal. Indexed after the file's, so they win
+          std::set< std::pair<std::string, std::string> > _pending_edits; //Set since the last commit()
+          ini_commit_mode _commit_mode = ini_commit_mode::journal;
+          bool _journal_valid = false; //The journal exists and starts with ini_journal_header, so commit() appends
     };
 }
 
@@ -0,0 +1,101 @@
+#include "beluga_ini_reload.h"
+#include <algorithm>
+
+namespace beluga_utils
+{
+  static const uint32_t fnv_offset_basis = 2166136261u;
+  static const uint32_t fnv_prime = 16777619u;
+
+  static uint32_t fnv_append(uint32_t hash, const char * data, size_t length)
+  {
+    for(size_t i = 0; i < length; i++)
+    {
+      hash = (hash ^ (uint8_t) data[i]) * fnv_prime;
+    }
+    return (hash ^ 0u) * fnv_prime; //Separator, so ("ab", "c") and ("a", "bc") differ
+  }
+
+  uint32_t ini_section_name_hash(const char * section_name, size_t section_len)
+  {
+    return fnv_append(fnv_offset_basis, section_name, section_len);
+  }
+
+  /*!
+  \brief Start hashing one occurrence of a section. The parent its heading names is part of its content, so a
+  reload that changes it reports the section as changed.
+  \details The parent is hashed as a pair with the key "=", which no key in a file can be.
+  */
+  void ini_section_hasher::start_section(const char * section_name, size_t section_len, ini_view parent)
+  {
+    ini_section_hash this_hash = {ini_section_name_hash(section_name, section_len), fnv_offset_basis};
+    if(parent.length > 0)
+    {
+      this_hash.content_hash = fnv_append(fnv_append(this_hash.content_hash, "=", 1), parent.data, parent.length);
+    }
+    _hashes->push_back(this_hash);
+  }
+
+  void ini_section_hasher::add_entry(const char * key, size_t key_len, const char * value, size_t value_len)
+  {
+    if(_hashes->empty())
+    {
+      start_section("", 0); //Keys before the first heading belong to the unnamed section
+    }
+    uint32_t & content_hash = _hashes->back().content_hash;
+    content_hash = fnv_append(fnv_append(content_hash, key, key_len), value, value_len);
+  }
+
+  static bool name_hash_less(const ini_section_hash & a, const ini_section_hash & b)
+  {
+    return a.name_hash < b.name_hash;
+  }
+
+  /*!
+  \brief Sort by name hash and fold repeated sections (and any name hash collision) into one record.
+  \details stable_sort keeps repeated occurrences in file order, so the folded hash depends on that order.
+  */
+  void ini_section_hasher::finish()
+  {
+    std::stable_sort(_hashes->begin(), _hashes->end(), name_hash_less);
+    size_t n_unique = 0;
+    for(size_t i = 0; i < _hashes->size(); i++)
+    {
+      if(n_unique > 0 && (*_hashes)[n_unique - 1].name_hash == (*_hashes)[i].name_hash)
+      {
+        uint32_t & folded = (*_hashes)[n_unique - 1].content_hash;
+        folded = (folded * fnv_prime) ^ (*_hashes)[i].content_hash;
+      }else{
+        (*_hashes)[n_unique++] = (*_hashes)[i];
+      }
+    }
+    _hashes->resize(n_unique);
+  }
+
+  /*!
+  \brief Name hashes of the sections that were added, removed or whose content differs.
+  @param old_hashes and new_hashes as produced by ini_section_hasher::finish() (sorted, unique).
+  @param changed_name_hashes set to the differing name hashes, sorted, so it can be searched with std::binary_search.
+  */
+  void ini_changed_sections(const std::vector<ini_section_hash> & old_hashes, const std::vector<ini_section_hash> & new_hashes, std::vector<uint32_t> * changed_name_hashes)
+  {
+    changed_name_hashes->clear();
+    size_t i = 0;
+    size_t j = 0;
+    while(i < old_hashes.size() || j < new_hashes.size())
+    {
+      if(j == new_hashes.size() || (i < old_hashes.size() && old_hashes[i].name_hash < new_hashes[j].name_hash))
+      {
+        changed_name_hashes->push_back(old_hashes[i++].name_hash);
+      }else if(i == old_hashes.size() || new_hashes[j].name_hash < old_hashes[i].name_hash){
+        changed_name_hashes->push_back(new_hashes[j++].name_hash);
+      }else{
+        if(old_hashes[i].content_hash != new_hashes[j].content_hash)
+        {
+          changed_name_hashes->push_back(old_hashes[i].name_hash);
+        }
+        i++;
+        j++;
+      }
+    }
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <vector>
+#include "beluga_ini_visitor.h"
+
+namespace beluga_utils
+{
+    enum class ini_change_type
+    {
+        added,
+        modified,
+        removed
+    };
+
+    /*!
+    \brief One key that differs between the loaded config and the file, passed to subscribers by ini_reader::reload().
+    \details The views are only valid for the duration of the callback. old_value is empty for added keys and
+    new_value is empty for removed keys.
+    */
+    struct ini_change
+    {
+        ini_change_type type;
+        ini_view section;
+        ini_view key;
+        ini_view old_value;
+        ini_view new_value;
+    };
+
+    typedef void (*ini_change_callback)(void * context, const ini_change & change);
+
+    /*!
+    \brief What the last ini_reader::reload() did.
+    \details file_changed is False when the content hash of every section matched, or the file was not read because
+    its size and modification time matched (see ini_reader::enable_reload_signature_check).
+    */
+    struct ini_reload_stats
+    {
+        bool file_changed;
+        size_t sections_changed;
+        size_t entries_added;
+        size_t entries_modified;
+        size_t entries_removed;
+    };
+
+    /*!
+    \brief Size and last-write time of the config file, checked before anything is read if
+    ini_reader::enable_reload_signature_check is on.
+    */
+    struct ini_file_signature
+    {
+        size_t size;
+        time_t last_write;
+    };
+
+    /*!
+    \brief Content hash of one section, keyed by a hash of its name.
+    */
+    struct ini_section_hash
+    {
+        uint32_t name_hash;
+        uint32_t content_hash;
+    };
+
+    uint32_t ini_section_name_hash(const char * section_name, size_t section_len);
+
+    /*!
+    \brief Hash every section of a file, so a reload can tell which sections changed without storing a copy
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Each section's hash is FNV-1a over its key '\0' value '\0' pairs in file order, and the parent its
+    heading names ([name : parent]); comments, blank lines and whitespace around keys and values do not count. A
+    section that appears more than once is folded into one hash (occurrences in file order). The result, sorted by
+    name hash, is 8 bytes per section.
+    Use it as a visitor, or feed it section by section from another visitor or the arena.
+    Usage:
+    std::vector<ini_section_hash> hashes;
+    ini_section_hasher hasher(&hashes);
+    ini_visit_file(this_file, hasher);
+    hasher.finish();
+    */
+    class ini_section_hasher : public ini_visitor
+    {
+        public:
+            ini_section_hasher(std::vector<ini_section_hash> * hashes) : _hashes(hashes) { _hashes->clear(); };
+            bool on_section(ini_view section_name) { start_section(section_name.data, section_name.length, section_parent()); return true; }
+            bool on_key_value(ini_view, ini_view key, ini_view value) { add_entry(key.data, key.length, value.data, value.length); return true; }
+            void start_section(const char * section_name, size_t section_len, ini_view parent = ini_view());
+            void add_entry(const char * key, size_t key_len, const char * value, size_t value_len);
+            void finish();
+
+        protected:
+            std::vector<ini_section_hash> * _hashes;
+    };
+
+    void ini_changed_sections(const std::vector<ini_section_hash> & old_hashes, const std::vector<ini_section_hash> & new_hashes, std::vector<uint32_t> * changed_name_hashes);
+}
@@ -0,0 +1,262 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include "beluga_debug.h"
+#include "beluga_ini_index.h"
+#include "beluga_ini_parse.h"
+
+namespace beluga_utils
+{
+    enum class ini_presence : uint8_t
+    {
+        optional = 0,   //Missing: the field gets its default
+        required        //Missing: an error (the field still gets its default)
+    };
+
+    /*!
+    \brief One field of an ini_schema: the struct member it fills, its key, its default and whether it must be present.
+    \details Type picks the typed getter used to read it (ini_value_type::none reads the text). Make fields with
+    ini_bool_field, ini_int_field, ini_float_field, ini_duration_field, ini_ipv4_field or ini_text_field rather
+    than by hand, so Type always matches T.
+    */
+    template<typename S, typename T, ini_value_type Type, typename D = T>
+    struct ini_field
+    {
+        T S::* member;
+        const char * key;
+        D default_value;
+        ini_presence presence;
+    };
+
+    template<typename S>
+    constexpr ini_field<S, bool, ini_value_type::boolean> ini_bool_field(bool S::* member, const char * key, bool default_value = false, ini_presence presence = ini_presence::optional)
+    {
+        return {member, key, default_value, presence};
+    }
+
+    template<typename S>
+    constexpr ini_field<S, int32_t, ini_value_type::integer> ini_int_field(int32_t S::* member, const char * key, int32_t default_value = 0, ini_presence presence = ini_presence::optional)
+    {
+        return {member, key, default_value, presence};
+    }
+
+    template<typename S>
+    constexpr ini_field<S, float, ini_value_type::floating> ini_float_field(float S::* member, const char * key, float default_value = 0.0f, ini_presence presence = ini_presence::optional)
+    {
+        return {member, key, default_value, presence};
+    }
+
+    template<typename S>
+    constexpr ini_field<S, uint32_t, ini_value_type::duration_ms> ini_duration_field(uint32_t S::* member, const char * key, uint32_t default_ms = 0, ini_presence presence = ini_presence::optional)
+    {
+        return {member, key, default_ms, presence};
+    }
+
+    template<typename S>
+    constexpr ini_field<S, ini_ipv4, ini_value_type::ipv4> ini_ipv4_field(ini_ipv4 S::* member, const char * key, ini_ipv4 default_value = ini_ipv4(), ini_presence presence = ini_presence::optional)
+    {
+        return {member, key, default_value, presence};
+    }
+
+    template<typename S>
+    constexpr ini_field<S, std::string, ini_value_type::none, const char *> ini_text_field(std::string S::* member, const char * key, const char * default_value = "", ini_presence presence = ini_presence::optional)
+    {
+        return {member, key, default_value, presence};
+    }
+
+    /*!
+    \brief Outcome of ini_schema::bind. Every field is written either way; ok() says whether all came from the config.
+    */
+    struct ini_schema_result
+    {
+        uint32_t fields;        //Fields in the schema
+        uint32_t defaulted;     //Optional fields not in the config, set to their default
+        uint32_t missing;       //Required fields not in the config
+        uint32_t invalid;       //Fields whose value is not of the field's type, set to their default
+        uint32_t unknown_keys;  //Keys in the section that no field reads: usually a typo in the file
+        bool ok() const { return missing == 0 && invalid == 0; }
+    };
+
+    /*!
+    \brief The typed getter for each ini_value_type, picked at compile time. R is any reader with handle getters
+    (ini_reader, ini_blob_reader).
+    */
+    template<ini_value_type Type> struct ini_field_reader;
+
+    template<> struct ini_field_reader<ini_value_type::boolean>
+    {
+        template<typename R> static ini_error read(R & reader, ini_handle handle, bool * value) { return reader.get_config_bool(handle, value); }
+    };
+
+    template<> struct ini_field_reader<ini_value_type::integer>
+    {
+        template<typename R> static ini_error read(R & reader, ini_handle handle, int32_t * value) { return reader.get_config_int(handle, value); }
+    };
+
+    template<> struct ini_field_reader<ini_value_type::floating>
+    {
+        template<typename R> static ini_error read(R & reader, ini_handle handle, float * value) { return reader.get_config_float(handle, value); }
+    };
+
+    template<> struct ini_field_reader<ini_value_type::duration_ms>
+    {
+        template<typename R> static ini_error read(R & reader, ini_handle handle, uint32_t * value) { return reader.get_config_duration_ms(handle, value); }
+    };
+
+    template<> struct ini_field_reader<ini_value_type::ipv4>
+    {
+        template<typename R> static ini_error read(R & reader, ini_handle handle, ini_ipv4 * value) { return reader.get_config_ipv4(handle, value); }
+    };
+
+    template<> struct ini_field_reader<ini_value_type::none>
+    {
+        template<typename R> static ini_error read(R & reader, ini_handle handle, std::string * value)
+        {
+            ini_view text;
+            if(!reader.get_config_value(handle, &text))
+            {
+                return ini_error::not_found;
+            }
+            value->assign(text.data, text.length);
+            return ini_error::ok;
+        }
+    };
+
+    /*!
+    \brief Look up one field and write it (or its default) into config.
+    */
+    template<typename R, typename S, typename T, ini_value_type Type, typename D>
+    void ini_bind_field(R & reader, const char * section_name, const ini_field<S, T, Type, D> & field, S * config, ini_schema_result * result)
+    {
+        ini_handle handle = reader.get_config_handle(section_name, field.key);
+        if(handle.is_valid())
+        {
+            T value;
+            ini_error err = ini_field_reader<Type>::read(reader, handle, &value);
+            if(err == ini_error::ok)
+            {
+                config->*(field.member) = value;
+                return;
+            }
+            result->invalid++;
+            BELUGA_LOG_ERROR("ini_schema: [%s] %s: %s", section_name, field.key, ini_error_to_string(err));
+        }
+        else if(field.presence == ini_presence::required)
+        {
+            result->missing++;
+            BELUGA_LOG_ERROR("ini_schema: [%s] %s is required", section_name, field.key);
+        }
+        else
+        {
+            result->defaulted++;
+        }
+        config->*(field.member) = field.default_value;
+    }
+
+    /*!
+    \brief The fields of an ini_schema, one per level of nesting, so each field keeps its own type and binding
+    it is a direct call with nothing to dispatch at run time.
+    */
+    template<typename S, typename... Fields> struct ini_field_list;
+
+    template<typename S> struct ini_field_list<S>
+    {
+        constexpr ini_field_list() {}
+        template<typename R> void bind(R &, const char *, S *, ini_schema_result *) const {}
+        bool has_key(const char *, size_t) const { return false; }
+    };
+
+    template<typename S, typename F, typename... Rest> struct ini_field_list<S, F, Rest...>
+    {
+        constexpr ini_field_list(F first_field, Rest... rest) : head(first_field), tail(rest...) {}
+        template<typename R> void bind(R & reader, const char * section_name, S * config, ini_schema_result * result) const
+        {
+            ini_bind_field(reader, section_name, head, config, result);
+            tail.bind(reader, section_name, config, result);
+        }
+        bool has_key(const char * key, size_t key_len) const
+        {
+            return (strlen(head.key) == key_len && memcmp(head.key, key, key_len) == 0) || tail.has_key(key, key_len);
+        }
+        F head;
+        ini_field_list<S, Rest...> tail;
+    };
+
+    /*!
+    \brief A config section's layout, declared once at compile time, that fills a plain struct in one pass
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Instead of a string lookup and a conversion for every field, spread through a device's init code, list
+    the fields once (key, type, default, optional or required) and bind() the section at boot. Hot code then reads
+    the struct's members directly. bind():
+    - writes every field: the converted value, or the default if the key is missing or not of the field's type
+    - counts (and logs) required fields that are missing and values of the wrong type
+    - counts (and logs) keys in the section that no field reads, so a typo in the file shows up at boot rather than
+      as a default silently taking over
+    Everything is templates over the field types, so each field compiles to one lookup and one typed read, and only
+    the conversions a schema uses are instantiated. R may be ini_reader or ini_blob_reader.
+    The section name defaults to the schema's; pass another to bind() for devices sharing one schema.
+    Usage:
+    struct motor_config { int32_t pin; float max_rpm; uint32_t ramp_ms; bool reversed; std::string name; };
+    static constexpr auto motor_schema = beluga_utils::make_ini_schema<motor_config>("motor",
+        beluga_utils::ini_int_field(&motor_config::pin, "pin", 0, beluga_utils::ini_presence::required),
+        beluga_utils::ini_float_field(&motor_config::max_rpm, "max_rpm", 3000.0f),
+        beluga_utils::ini_duration_field(&motor_config::ramp_ms, "ramp", 250),
+        beluga_utils::ini_bool_field(&motor_config::reversed, "reversed"),
+        beluga_utils::ini_text_field(&motor_config::name, "name", "motor"));
+    motor_config left;
+    if(!motor_schema.bind(ini, &left, "motor_left").ok()) { ...refuse to start... }
+    */
+    template<typename S, typename... Fields>
+    class ini_schema
+    {
+        public:
+            constexpr ini_schema(const char * section_name, Fields... fields) : _section_name(section_name), _fields(fields...) {}
+
+            template<typename R>
+            ini_schema_result bind(R & reader, S * config, const char * section_name = nullptr) const
+            {
+                const char * section = (section_name != nullptr) ? section_name : _section_name;
+                ini_schema_result result = {(uint32_t) sizeof...(Fields), 0, 0, 0, 0};
+                _fields.bind(reader, section, config, &result);
+                unknown_key_counter counter = {this, section, 0};
+                reader.for_each_key(section, count_unknown_key, &counter);
+                result.unknown_keys = counter.count;
+                return result;
+            }
+
+            bool has_key(const char * key, size_t key_len) const { return _fields.has_key(key, key_len); }
+            const char * section_name() const { return _section_name; }
+            static constexpr size_t size() { return sizeof...(Fields); }
+
+        protected:
+            struct unknown_key_counter
+            {
+                const ini_schema * schema;
+                const char * section_name;
+                uint32_t count;
+            };
+            static void count_unknown_key(void * context, ini_view key, ini_view)
+            {
+                unknown_key_counter * counter = (unknown_key_counter *) context;
+                if(!counter->schema->has_key(key.data, key.length))
+                {
+                    counter->count++;
+                    BELUGA_LOG_WARN("ini_schema: [%s] %s is not a known key", counter->section_name, key.data);
+                }
+            }
+            const char * _section_name;
+            ini_field_list<S, Fields...> _fields;
+    };
+
+    /*!
+    \brief Make an ini_schema for struct S, deducing the field types. See ini_schema.
+    */
+    template<typename S, typename... Fields>
+    constexpr ini_schema<S, Fields...> make_ini_schema(const char * section_name, Fields... fields)
+    {
+        return ini_schema<S, Fields...>(section_name, fields...);
+    }
+}
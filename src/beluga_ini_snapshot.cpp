@@ -0,0 +1,308 @@
+#include "beluga_ini_snapshot.h"
+#include <string.h>
+#include <algorithm>
+#if defined(BELUGA_NATIVE)
+#include <thread>
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+namespace beluga_utils
+{
+  /*!
+  \brief True if entry i of the index is the one a lookup of its section-key pair returns.
+  */
+  static bool is_winning_entry(const ini_index & index, uint32_t i)
+  {
+    ini_handle handle = {i};
+    const ini_index_entry & this_entry = index.get_entry(handle);
+    return index.find_own(this_entry.section.data, this_entry.section.length, this_entry.key.data, this_entry.key.length).entry == i;
+  }
+
+  static ini_view copy_view(std::vector<char> * buffer, ini_view source)
+  {
+    ini_view copy = {buffer->data() + buffer->size(), source.length};
+    buffer->insert(buffer->end(), source.data, source.data + source.length);
+    buffer->push_back('\0');
+    return copy;
+  }
+
+  /*!
+  \brief Copy every section-key pair of source into this snapshot.
+  \details Two allocations (the buffer and the index) plus the index slot table. Consecutive entries of the
+  same section share one copy of the section name. Sections that inherit keep inheriting: their parent links are
+  copied, not the keys they inherit.
+  */
+  void ini_snapshot::build(const ini_index & source)
+  {
+    size_t n_bytes = 0;
+    size_t n_entries = 0;
+    const char * last_section = nullptr;
+    for(uint32_t i = 0; i < source.size(); i++)
+    {
+      if(!is_winning_entry(source, i))
+      {
+        continue;
+      }
+      ini_handle handle = {i};
+      const ini_index_entry & this_entry = source.get_entry(handle);
+      if(this_entry.section.data != last_section)
+      {
+        n_bytes += this_entry.section.length + 1;
+        last_section = this_entry.section.data;
+      }
+      n_bytes += this_entry.key.length + 1 + this_entry.value.length + 1;
+      n_entries++;
+    }
+    for(size_t i = 0; i < source.parent_count(); i++)
+    {
+      const ini_section_parent & this_parent = source.get_parent(i);
+      n_bytes += this_parent.section.length + 1 + this_parent.parent.length + 1;
+    }
+    _buffer.clear();
+    _buffer.reserve(n_bytes); //Never grows past this, so the views stay put
+    _index.clear();
+    _index.reserve(n_entries);
+    last_section = nullptr;
+    ini_view section_copy = {nullptr, 0};
+    for(uint32_t i = 0; i < source.size(); i++)
+    {
+      if(!is_winning_entry(source, i))
+      {
+        continue;
+      }
+      ini_handle handle = {i};
+      const ini_index_entry & this_entry = source.get_entry(handle);
+      if(this_entry.section.data != last_section)
+      {
+        section_copy = copy_view(&_buffer, this_entry.section);
+        last_section = this_entry.section.data;
+      }
+      ini_view key_copy = copy_view(&_buffer, this_entry.key);
+      ini_view value_copy = copy_view(&_buffer, this_entry.value);
+      _index.add_entry(section_copy, key_copy, value_copy);
+    }
+    for(size_t i = 0; i < source.parent_count(); i++)
+    {
+      const ini_section_parent & this_parent = source.get_parent(i);
+      ini_view section_name_copy = copy_view(&_buffer, this_parent.section);
+      _index.add_parent(section_name_copy, copy_view(&_buffer, this_parent.parent));
+    }
+    _index.build();
+    _index.split_all_lists(); //Readers on other tasks share this index, so nothing may be split on first read
+  }
+
+  ini_handle ini_snapshot::get_config_handle(const char * section_name, const char * key_name) const
+  {
+    return _index.find(section_name, strlen(section_name), key_name, strlen(key_name));
+  }
+
+  bool ini_snapshot::get_config_value(ini_handle handle, ini_view * return_config_value) const
+  {
+    if(!handle.is_valid() || handle.entry >= _index.size())
+    {
+      return false;
+    }
+    *return_config_value = _index.get_entry(handle).value;
+    return true;
+  }
+
+  /*!
+  \brief Look up a section-key pair.
+  @param return_config_value set to a view into the snapshot, valid while the snapshot is held.
+  \return True if the pair is present.
+  */
+  bool ini_snapshot::get_config_value(const char * section_name, const char * key_name, ini_view * return_config_value) const
+  {
+    return get_config_value(get_config_handle(section_name, key_name), return_config_value);
+  }
+
+  template<typename T>
+  static ini_error read_snapshot_value(const ini_snapshot & snapshot, const char * section_name, const char * key_name, T * return_value, ini_error (*parse)(const char *, const char *, T *))
+  {
+    ini_view this_value;
+    if(!snapshot.get_config_value(section_name, key_name, &this_value))
+    {
+      return ini_error::not_found;
+    }
+    return parse(this_value.data, this_value.data + this_value.length, return_value);
+  }
+
+  /*!
+  \brief Typed reads, as for ini_reader. The text is parsed on every call.
+  */
+  ini_error ini_snapshot::get_config_bool(const char * section_name, const char * key_name, bool * return_value) const
+  {
+    return read_snapshot_value(*this, section_name, key_name, return_value, parse_bool);
+  }
+
+  ini_error ini_snapshot::get_config_int(const char * section_name, const char * key_name, int32_t * return_value) const
+  {
+    return read_snapshot_value(*this, section_name, key_name, return_value, parse_int);
+  }
+
+  ini_error ini_snapshot::get_config_float(const char * section_name, const char * key_name, float * return_value) const
+  {
+    return read_snapshot_value(*this, section_name, key_name, return_value, parse_float);
+  }
+
+  ini_error ini_snapshot::get_config_ipv4(const char * section_name, const char * key_name, ini_ipv4 * return_value) const
+  {
+    return read_snapshot_value(*this, section_name, key_name, return_value, parse_ipv4);
+  }
+
+  ini_error ini_snapshot::get_config_duration_ms(const char * section_name, const char * key_name, uint32_t * return_value) const
+  {
+    return read_snapshot_value(*this, section_name, key_name, return_value, parse_duration_ms);
+  }
+
+  /*!
+  \brief Lists, as for ini_reader. The tokens were split (and ints parsed) when the snapshot was built.
+  */
+  bool ini_snapshot::get_config_list(const char * section_name, const char * key_name, ini_list_view * return_list) const
+  {
+    return _index.get_list(get_config_handle(section_name, key_name), return_list);
+  }
+
+  ini_error ini_snapshot::get_config_int_list(const char * section_name, const char * key_name, ini_int_list_view * return_list) const
+  {
+    return _index.get_int_list(get_config_handle(section_name, key_name), return_list);
+  }
+
+  ini_snapshot_publisher::ini_snapshot_publisher()
+  {
+    _current.store(nullptr);
+    _current_version.store(0);
+    for(size_t i = 0; i < ini_snapshot_max_readers; i++)
+    {
+      _hazards[i].store(nullptr);
+      _slot_claimed[i].store(false);
+    }
+  }
+
+  ini_snapshot_publisher::~ini_snapshot_publisher()
+  {
+    delete _current.load();
+    for(size_t i = 0; i < _retired.size(); i++)
+    {
+      delete _retired[i];
+    }
+  }
+
+  /*!
+  \brief Make snapshot the current one. The publisher takes ownership.
+  \details Guards taken before this call keep reading the old snapshot; it is deleted once they are all gone.
+  */
+  void ini_snapshot_publisher::publish(ini_snapshot * snapshot)
+  {
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    if(snapshot != nullptr)
+    {
+      snapshot->_version = _next_version++;
+    }
+    ini_snapshot * old_snapshot = _current.exchange(snapshot, std::memory_order_seq_cst);
+    _current_version.store(snapshot ? snapshot->_version : 0, std::memory_order_release);
+    if(old_snapshot != nullptr)
+    {
+      _retired.push_back(old_snapshot);
+    }
+    reclaim_locked();
+  }
+
+  /*!
+  \brief Delete retired snapshots that no guard holds. publish() does this too.
+  \return The number deleted.
+  */
+  size_t ini_snapshot_publisher::reclaim()
+  {
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    return reclaim_locked();
+  }
+
+  size_t ini_snapshot_publisher::reclaim_locked()
+  {
+    size_t n_deleted = 0;
+    for(size_t i = 0; i < _retired.size(); )
+    {
+      bool in_use = false;
+      for(size_t j = 0; j < ini_snapshot_max_readers && !in_use; j++)
+      {
+        in_use = (_hazards[j].load(std::memory_order_seq_cst) == _retired[i]);
+      }
+      if(in_use)
+      {
+        i++;
+        continue;
+      }
+      delete _retired[i];
+      _retired[i] = _retired.back();
+      _retired.pop_back();
+      n_deleted++;
+    }
+    return n_deleted;
+  }
+
+  /*!
+  \brief Retired snapshots still held by a guard.
+  */
+  size_t ini_snapshot_publisher::retired_count()
+  {
+    std::lock_guard<std::mutex> lock(_writer_mutex);
+    return _retired.size();
+  }
+
+  /*!
+  \brief Version of the current snapshot, or 0 if none is published. A cheap way to poll for a new config.
+  */
+  uint32_t ini_snapshot_publisher::current_version() const
+  {
+    return _current_version.load(std::memory_order_acquire);
+  }
+
+  /*!
+  \brief Claim a hazard slot and protect the current snapshot with it.
+  \details The pointer is stored in the slot and then re-read: if it is still current, publish() will see the
+  slot before it can delete the snapshot (both sides use sequentially consistent operations). If every slot is
+  held, it sleeps a tick at a time until one is released.
+  */
+  const ini_snapshot * ini_snapshot_publisher::acquire(size_t * slot)
+  {
+    for(;;)
+    {
+      for(size_t i = 0; i < ini_snapshot_max_readers; i++)
+      {
+        bool expected = false;
+        if(_slot_claimed[i].load(std::memory_order_relaxed) || !_slot_claimed[i].compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+          continue;
+        }
+        *slot = i;
+        const ini_snapshot * snapshot = _current.load(std::memory_order_seq_cst);
+        for(;;)
+        {
+          _hazards[i].store(snapshot, std::memory_order_seq_cst);
+          const ini_snapshot * check = _current.load(std::memory_order_seq_cst);
+          if(check == snapshot)
+          {
+            return snapshot;
+          }
+          snapshot = check;
+        }
+      }
+      //Every slot is held. Sleep a tick rather than yield: taskYIELD() only lets tasks of the same priority run, so
+      //a high-priority reader would spin forever over a lower-priority task holding the guard it is waiting for.
+#if defined(BELUGA_NATIVE)
+      std::this_thread::yield();
+#else
+      vTaskDelay(1);
+#endif
+    }
+  }
+
+  void ini_snapshot_publisher::release(size_t slot)
+  {
+    _hazards[slot].store(nullptr, std::memory_order_release);
+    _slot_claimed[slot].store(false, std::memory_order_release);
+  }
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "beluga_ini_index.h"
+#include "beluga_ini_parse.h"
+
+namespace beluga_utils
+{
+    const size_t ini_snapshot_max_readers = 16; //Guards that can be held at the same time, across all tasks
+
+    /*!
+    \brief An immutable copy of the loaded config, safe to read from any task or core without locking
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Holds every section-key pair in one buffer plus its own ini_index. Nothing in it changes after
+    build(), so all the getters are const and there is no typed-value cache (each typed read parses the text; keep
+    the result if you read it in a tight loop). Normally made by ini_reader and read through an ini_snapshot_guard.
+    Where a key is repeated, only the value that wins the lookup is copied.
+    */
+    class ini_snapshot
+    {
+        public:
+            ini_snapshot(){};
+            void build(const ini_index & source);
+            ini_handle get_config_handle(const char * section_name, const char * key_name) const;
+            bool get_config_value(const char * section_name, const char * key_name, ini_view * return_config_value) const;
+            bool get_config_value(ini_handle handle, ini_view * return_config_value) const;
+            ini_error get_config_bool(const char * section_name, const char * key_name, bool * return_value) const;
+            ini_error get_config_int(const char * section_name, const char * key_name, int32_t * return_value) const;
+            ini_error get_config_float(const char * section_name, const char * key_name, float * return_value) const;
+            ini_error get_config_ipv4(const char * section_name, const char * key_name, ini_ipv4 * return_value) const;
+            ini_error get_config_duration_ms(const char * section_name, const char * key_name, uint32_t * return_value) const;
+            bool get_config_list(const char * section_name, const char * key_name, ini_list_view * return_list) const;
+            ini_error get_config_int_list(const char * section_name, const char * key_name, ini_int_list_view * return_list) const;
+            size_t size() const { return _index.size(); }
+            size_t heap_bytes() const { return _buffer.capacity() + _index.heap_bytes(); }
+            uint32_t version() const { return _version; } //Set by ini_snapshot_publisher::publish, counting from 1
+
+        protected:
+            friend class ini_snapshot_publisher;
+            ini_snapshot(const ini_snapshot &);
+            ini_snapshot & operator=(const ini_snapshot &);
+            std::vector<char> _buffer;
+            ini_index _index;
+            uint32_t _version = 0;
+    };
+
+    /*!
+    \brief Publishes ini_snapshots through an atomic pointer and frees old ones once no reader holds them
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Readers (ini_snapshot_guard) never lock: they claim one of ini_snapshot_max_readers hazard slots,
+    store the pointer they are about to read in it, and re-check that it is still current. publish() swaps the new
+    snapshot in and retires the old one; a retired snapshot is deleted by the first publish() or reclaim() that finds
+    it in no hazard slot. So a reader always sees one whole snapshot, old or new, never a mix, and memory is freed
+    without waiting for readers to finish.
+    Writers (publish, reclaim) are serialised with a mutex; they are rare.
+    If all slots are held, a new guard sleeps a tick at a time (vTaskDelay(1), so lower-priority holders get to run
+    and release theirs) until one is released, so keep guards short-lived.
+    The publisher must outlive every guard, and nothing may read through it while it is destroyed.
+    Usage:
+    beluga_utils::ini_snapshot_publisher config_snapshots;
+    ini.set_snapshot_publisher(&config_snapshots); //ini_reader publishes after initialise() and each changed reload()
+    //In any task, on either core:
+    beluga_utils::ini_snapshot_guard config(config_snapshots);
+    int32_t pin;
+    if(config.is_valid() && config->get_config_int("my_device", "pin", &pin) == ini_error::ok) { ... }
+    */
+    class ini_snapshot_publisher
+    {
+        public:
+            ini_snapshot_publisher();
+            ~ini_snapshot_publisher();
+            void publish(ini_snapshot * snapshot);
+            size_t reclaim();
+            size_t retired_count();
+            uint32_t current_version() const;
+
+        protected:
+            friend class ini_snapshot_guard;
+            ini_snapshot_publisher(const ini_snapshot_publisher &);
+            ini_snapshot_publisher & operator=(const ini_snapshot_publisher &);
+            const ini_snapshot * acquire(size_t * slot);
+            void release(size_t slot);
+            size_t reclaim_locked();
+            std::atomic<ini_snapshot *> _current;
+            std::atomic<uint32_t> _current_version;
+            std::atomic<const ini_snapshot *> _hazards[ini_snapshot_max_readers];
+            std::atomic<bool> _slot_claimed[ini_snapshot_max_readers];
+            std::mutex _writer_mutex;
+            std::vector<ini_snapshot *> _retired;
+            uint32_t _next_version = 1;
+    };
+
+    /*!
+    \brief Holds the current snapshot for the guard's lifetime. A later publish() does not affect it.
+    Usage: { ini_snapshot_guard config(publisher); config->get_config_value("wifi", "ssid", &ssid); }
+    */
+    class ini_snapshot_guard
+    {
+        public:
+            ini_snapshot_guard(ini_snapshot_publisher & publisher) : _publisher(publisher) { _snapshot = publisher.acquire(&_slot); }
+            ~ini_snapshot_guard() { _publisher.release(_slot); }
+            bool is_valid() const { return _snapshot != nullptr; } //False until something is published
+            const ini_snapshot * get() const { return _snapshot; }
+            const ini_snapshot * operator->() const { return _snapshot; }
+            const ini_snapshot & operator*() const { return *_snapshot; }
+
+        protected:
+            ini_snapshot_guard(const ini_snapshot_guard &);
+            ini_snapshot_guard & operator=(const ini_snapshot_guard &);
+            ini_snapshot_publisher & _publisher;
+            const ini_snapshot * _snapshot;
+            size_t _slot;
+    };
+}
@@ -0,0 +1,171 @@
+#include "beluga_ini_visitor.h"
+#include "beluga_ini_line_reader.h"
+#include "beluga_constants.h"
+#include <string>
+#include <string.h>
+#include <ctype.h>
+
+namespace beluga_utils
+{
+  static void trim_pointers(const char ** start, const char ** end)
+  {
+    while(*start < *end && isspace((unsigned char) **start))
+    {
+      (*start)++;
+    }
+    while(*end > *start && isspace((unsigned char) *(*end - 1)))
+    {
+      (*end)--;
+    }
+  }
+
+  /*!
+  \brief Classify one line of an .ini file.
+  @param line the line, without its '\n'. A trailing '\r' is treated as whitespace.
+  @param length number of bytes in line.
+  \return The line type, plus trimmed name/value pointers into line for section and key_value lines.
+  \details This is the single definition of the accepted grammar. ini_reader::initialise (both storage modes)
+  and ini_reader::visit all go through here, so they accept exactly the same files:
+  - leading/trailing whitespace is ignored
+  - lines shorter than 3 characters are blank, lines starting with ; are comments
+  - [name] is a section heading. [name : parent] also names the section name inherits from; both are trimmed,
+    so a section name cannot contain ':'
+  - key = value is split on the first '='; key and value are trimmed
+  */
+  ini_line classify_ini_line(const char * line, size_t length)
+  {
+    const char comment_char = ';';
+    ini_line result = {ini_line_type::blank, nullptr, 0, nullptr, 0, nullptr, 0};
+    const char * start = line;
+    const char * end = line + length;
+    trim_pointers(&start, &end);
+    if((end - start) < 3)
+    {
+      return result;
+    }
+    if(*start == comment_char)
+    {
+      result.type = ini_line_type::comment;
+      return result;
+    }
+    if(*start == '[' && *(end - 1) == ']')
+    {
+      const char * name_start = start + 1;
+      const char * name_end = end - 1;
+      const char * colon = (const char *) memchr(name_start, ':', (size_t) (name_end - name_start));
+      if(colon != nullptr)
+      {
+        const char * parent_start = colon + 1;
+        const char * parent_end = name_end;
+        trim_pointers(&parent_start, &parent_end);
+        result.parent = parent_start;
+        result.parent_length = (size_t) (parent_end - parent_start);
+        name_end = colon;
+        trim_pointers(&name_start, &name_end);
+      }
+      result.type = ini_line_type::section;
+      result.name = name_start;
+      result.name_length = (size_t) (name_end - name_start);
+      return result;
+    }
+
+    const char * equals = (const char *) memchr(start, '=', (size_t) (end - start));
+    if(equals == nullptr)
+    {
+      result.type = ini_line_type::invalid;
+      return result;
+    }
+    const char * key_start = start;
+    const char * key_end = equals;
+    const char * value_start = equals + 1;
+    const char * value_end = end;
+    trim_pointers(&key_start, &key_end);
+    trim_pointers(&value_start, &value_end);
+    if(key_start == key_end)
+    {
+      result.type = ini_line_type::invalid;
+      return result;
+    }
+    result.type = ini_line_type::key_value;
+    result.name = key_start;
+    result.name_length = (size_t) (key_end - key_start);
+    result.value = value_start;
+    result.value_length = (size_t) (value_end - value_start);
+    return result;
+  }
+
+  /*!
+  \brief Stream an open .ini file through a visitor, keeping nothing.
+  @param this_file an open, readable file. Reading starts at its current position.
+  @param visitor receives each section heading, key/value pair and invalid line
+  \return True if the whole file was read. False if the file is not open or a callback asked to stop.
+  \details The file is read in ini_read_block_size blocks (see ini_line_reader), so memory use is one block plus
+  the current section name, whatever the file size; only a line longer than a block needs extra room.
+  Key/value pairs before the first heading are reported with an empty section name.
+  */
+  bool ini_visit_file(File & this_file, ini_visitor & visitor)
+  {
+    if(!this_file)
+    {
+      return false;
+    }
+    ini_line_reader reader(this_file);
+    std::string section_name;
+    std::string parent_name;
+    section_name.reserve(beluga_utils::ini_reader_max_line_size);
+    visitor._section_parent.data = "";
+    visitor._section_parent.length = 0;
+    size_t line_number = 0;
+    char * buffer;
+    size_t n_bytes_read;
+
+    while(reader.next_line(&buffer, &n_bytes_read))
+    {
+      visitor._line_offset = reader.line_offset();
+      line_number++;
+      ini_line this_line = classify_ini_line(buffer, n_bytes_read);
+      switch(this_line.type)
+      {
+        case ini_line_type::blank:
+        case ini_line_type::comment:
+          break;
+        case ini_line_type::section:
+        {
+          section_name.assign(this_line.name, this_line.name_length);
+          parent_name.assign(this_line.parent != nullptr ? this_line.parent : "", this_line.parent_length);
+          visitor._section_parent.data = parent_name.c_str();
+          visitor._section_parent.length = parent_name.size();
+          ini_view section_view = {section_name.c_str(), section_name.size()};
+          if(!visitor.on_section(section_view))
+          {
+            return false;
+          }
+          break;
+        }
+        case ini_line_type::key_value:
+        {
+          //Terminate key and value in place. The key is followed by whitespace or '=', the value by whitespace or the line's '\0'.
+          char * key = buffer + (this_line.name - buffer);
+          char * value = buffer + (this_line.value - buffer);
+          key[this_line.name_length] = '\0';
+          value[this_line.value_length] = '\0';
+          ini_view section_view = {section_name.c_str(), section_name.size()};
+          ini_view key_view = {key, this_line.name_length};
+          ini_view value_view = {value, this_line.value_length};
+          if(!visitor.on_key_value(section_view, key_view, value_view))
+          {
+            return false;
+          }
+          break;
+        }
+        case ini_line_type::invalid:
+        {
+          ini_view line_view = {buffer, n_bytes_read};
+          visitor.on_error(line_number, line_view);
+          break;
+        }
+      }
+    }
+    return true;
+  }
+}
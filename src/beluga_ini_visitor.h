@@ -0,0 +1,74 @@
+#pragma once
+#include "FS.h"
+#include "beluga_ini_index.h"
+
+namespace beluga_utils
+{
+    enum class ini_line_type
+    {
+        blank,      //Empty, whitespace or shorter than 3 characters (the shortest useful line is x=1 or [x])
+        comment,    //Starts with ;
+        section,    //[name] or [name : parent]
+        key_value,  //key = value
+        invalid     //Anything else, e.g. no '=' or an empty key
+    };
+
+    /*!
+    \brief One classified .ini line.
+    \details name is the section name (section lines) or the key (key_value lines). parent is the section a heading
+    inherits from ([name : parent]), or null. name, parent and value point into the line that was classified and are
+    already trimmed; they are NOT '\0'-terminated.
+    */
+    struct ini_line
+    {
+        ini_line_type type;
+        const char * name;
+        size_t name_length;
+        const char * value;
+        size_t value_length;
+        const char * parent;
+        size_t parent_length;
+    };
+
+    ini_line classify_ini_line(const char * line, size_t length);
+
+    /*!
+    \brief Callbacks for streaming an .ini file without storing it
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Derive from this and override the callbacks you need, then pass it to ini_reader::visit().
+    All views are '\0'-terminated but only valid for the duration of the callback; copy anything you want to keep.
+    Lines may be any length and may end in \n or \r\n; the last line does not need a newline.
+    Return false from on_section or on_key_value to stop reading early. section_parent() is the parent named in the
+    current section's heading ([name : parent]), empty if none; no inherited keys are reported, only the file's lines.
+    Usage:
+    class my_section_picker : public beluga_utils::ini_visitor
+    {
+        public:
+            bool on_key_value(ini_view section_name, ini_view key, ini_view value)
+            {
+                if(strcmp(section_name.data, "my_device") == 0) { ...keep key/value... }
+                return true;
+            }
+    };
+    my_section_picker picker;
+    ini.visit(picker);
+    */
+    class ini_visitor
+    {
+        public:
+            virtual ~ini_visitor(){};
+            virtual bool on_section(ini_view) { return true; }
+            virtual bool on_key_value(ini_view, ini_view, ini_view) { return true; }
+            virtual void on_error(size_t, ini_view) {}
+            size_t line_offset() const { return _line_offset; } //Byte offset in the file of the line being reported
+            ini_view section_parent() const { return _section_parent; } //Parent of the current section, valid as its name
+
+        protected:
+            friend bool ini_visit_file(File & this_file, ini_visitor & visitor);
+            size_t _line_offset = 0;
+            ini_view _section_parent = {"", 0};
+    };
+
+    bool ini_visit_file(File & this_file, ini_visitor & visitor);
+}
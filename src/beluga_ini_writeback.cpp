@@ -0,0 +1,446 @@
+#include "beluga_ini_writeback.h"
+#include "beluga_ini_line_reader.h"
+#include "beluga_ini_visitor.h"
+#include "beluga_log_file.h" //log_file_crc32
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace beluga_utils
+{
+  static bool has_edge_space(const std::string & text)
+  {
+    return !text.empty() && (isspace((unsigned char) text.front()) || isspace((unsigned char) text.back()));
+  }
+
+  /*!
+  \brief Check a section-key pair and value can be written so that loading the file gives them back unchanged.
+  \return False if:
+  - any of them contains a newline, or has whitespace at either end (the loader trims it)
+  - the section name contains '[', ']' or ':' (':' would make the heading [child : parent])
+  - the key is empty, contains '=', or starts with ';' or '[' (the line would be a comment or a heading)
+  */
+  bool ini_writable_pair(const std::string & section_name, const std::string & key_name, const std::string & value)
+  {
+    if(has_edge_space(section_name) || has_edge_space(key_name) || has_edge_space(value))
+    {
+      return false;
+    }
+    if(section_name.find_first_of("[]:\r\n") != std::string::npos)
+    {
+      return false;
+    }
+    if(key_name.empty() || key_name.find_first_of("=\r\n") != std::string::npos || key_name[0] == ';' || key_name[0] == '[')
+    {
+      return false;
+    }
+    return value.find_first_of("\r\n") == std::string::npos;
+  }
+
+  static size_t append_journal_line(std::string * journal_text, const std::string & body)
+  {
+    char crc_text[12];
+    snprintf(crc_text, sizeof(crc_text), "\n%08x ", (unsigned) log_file_crc32(0, (const uint8_t *) body.data(), body.size()));
+    size_t start = journal_text->size();
+    journal_text->append(crc_text);
+    journal_text->append(body);
+    return journal_text->size() - start;
+  }
+
+  /*!
+  \brief Append one journal record to journal_text. End each commit's records with ini_journal_end_commit.
+  \return Bytes appended.
+  \details A record is one line, "<crc> [section] key = value", where crc is 8 hex digits of the CRC-32 of the text
+  from '[' to the end of the value. It starts with its '\n' rather than ending with one, so a record torn by a
+  power cut is always the last line of the journal and the next record still starts on a line of its own.
+  */
+  size_t ini_journal_record(std::string * journal_text, const std::string & section_name, const std::string & key_name, const std::string & value)
+  {
+    std::string body;
+    body.reserve(section_name.size() + key_name.size() + value.size() + 6);
+    body += '[';
+    body += section_name;
+    body += "] ";
+    body += key_name;
+    body += " = ";
+    body += value;
+    return append_journal_line(journal_text, body);
+  }
+
+  /*!
+  \brief Append the line that closes a commit of n_records records, "<crc> #commit <n_records>".
+  \return Bytes appended.
+  \details ini_journal_replay only reports a commit's records once it reads this line with the right count, so a
+  commit cut off by a power cut is dropped whole rather than replayed in part.
+  */
+  size_t ini_journal_end_commit(std::string * journal_text, size_t n_records)
+  {
+    char body[24];
+    snprintf(body, sizeof(body), "#commit %u", (unsigned) n_records);
+    return append_journal_line(journal_text, body);
+  }
+
+  static bool parse_crc(const char * text, uint32_t * crc)
+  {
+    uint32_t result = 0;
+    for(int i = 0; i < 8; i++)
+    {
+      char c = text[i];
+      uint32_t digit;
+      if(c >= '0' && c <= '9') digit = (uint32_t) (c - '0');
+      else if(c >= 'a' && c <= 'f') digit = (uint32_t) (c - 'a' + 10);
+      else return false;
+      result = (result << 4) | digit;
+    }
+    *crc = result;
+    return true;
+  }
+
+  /*!
+  \brief One record read back, held until its commit's end line is read.
+  */
+  struct journal_pending_record
+  {
+    std::string section;
+    std::string key;
+    std::string value;
+  };
+
+  /*!
+  \brief Read a journal written with ini_journal_record and ini_journal_end_commit, reporting the records of each
+  intact commit in order.
+  @param journal_file an open journal, read from its current position.
+  @param n_records set to the number of records reported. May be null.
+  @param n_damaged set to the number of records and lines dropped: lines whose CRC or layout was wrong (a torn last
+  line after a power cut, or a damaged sector) and the records of any commit they were part of, or that has no
+  end line. May be null.
+  \return False if the file is not open or does not start with ini_journal_header.
+  \details Views are '\0'-terminated and valid only for the duration of the callback. A later record for the same
+  pair should win, as it does for a key repeated in a file.
+  */
+  bool ini_journal_replay(File & journal_file, ini_journal_callback callback, void * context, size_t * n_records, size_t * n_damaged)
+  {
+    size_t records = 0;
+    size_t damaged = 0;
+    if(n_records != nullptr) *n_records = 0;
+    if(n_damaged != nullptr) *n_damaged = 0;
+    if(!journal_file)
+    {
+      return false;
+    }
+    ini_line_reader reader(journal_file);
+    char * line;
+    size_t length;
+    if(!reader.next_line(&line, &length) || length != strlen(ini_journal_header) || memcmp(line, ini_journal_header, length) != 0)
+    {
+      return false;
+    }
+    std::vector<journal_pending_record> commit_records;
+    bool commit_damaged = false;
+    while(reader.next_line(&line, &length))
+    {
+      if(length == 0)
+      {
+        continue;
+      }
+      uint32_t crc;
+      char * body = line + 9;
+      size_t body_length = length > 9 ? length - 9 : 0;
+      if(body_length > 0 && body[0] == '#')
+      {
+        //"<crc> #commit <n>": report the commit's records if all n arrived intact
+        size_t n_expected = 0;
+        bool end_ok = line[8] == ' ' && parse_crc(line, &crc) && log_file_crc32(0, (const uint8_t *) body, body_length) == crc
+          && body_length > 8 && body_length <= 16 && memcmp(body, "#commit ", 8) == 0;
+        for(size_t i = 8; end_ok && i < body_length; i++)
+        {
+          end_ok = isdigit((unsigned char) body[i]) != 0;
+          n_expected = n_expected * 10 + (size_t) (body[i] - '0');
+        }
+        if(end_ok && !commit_damaged && n_expected == commit_records.size())
+        {
+          for(size_t i = 0; i < commit_records.size(); i++)
+          {
+            const journal_pending_record & record = commit_records[i];
+            ini_view section = {record.section.c_str(), record.section.size()};
+            ini_view key = {record.key.c_str(), record.key.size()};
+            ini_view value = {record.value.c_str(), record.value.size()};
+            callback(context, section, key, value);
+          }
+          records += commit_records.size();
+        }else{
+          damaged += commit_records.size() + (end_ok ? 0 : 1);
+        }
+        commit_records.clear();
+        commit_damaged = false;
+        continue;
+      }
+      //"<crc> [section] key = value": the section cannot contain ']' and the key cannot contain '='
+      char * section_end = body_length > 0 ? (char *) memchr(body, ']', body_length) : nullptr;
+      char * equals = section_end != nullptr ? (char *) memchr(section_end, '=', (size_t) (line + length - section_end)) : nullptr;
+      if(equals == nullptr || line[8] != ' ' || body[0] != '[' || !parse_crc(line, &crc)
+        || log_file_crc32(0, (const uint8_t *) body, body_length) != crc
+        || section_end[1] != ' ' || equals - section_end < 3 || equals[-1] != ' ' || equals + 1 >= line + length || equals[1] != ' ')
+      {
+        damaged++;
+        commit_damaged = true;
+        continue;
+      }
+      journal_pending_record record;
+      record.section.assign(body + 1, (size_t) (section_end - body - 1));
+      record.key.assign(section_end + 2, (size_t) (equals - 1 - (section_end + 2)));
+      record.value.assign(equals + 2, (size_t) (line + length - (equals + 2)));
+      commit_records.push_back(record);
+    }
+    damaged += commit_records.size(); //The last commit was cut off before its end line
+    if(n_records != nullptr) *n_records = records;
+    if(n_damaged != nullptr) *n_damaged = damaged;
+    return true;
+  }
+
+  /*!
+  \brief Lines of a file exactly as stored, each with its "\n" or "\r\n" (the last may have neither), so a
+  rewrite can copy the lines it does not change byte for byte.
+  */
+  class raw_line_reader
+  {
+    public:
+      raw_line_reader(File & this_file) : _file(this_file) { _block.resize(ini_read_block_size); }
+      bool next_line(std::string * line)
+      {
+        line->clear();
+        while(true)
+        {
+          if(_block_pos >= _block_len)
+          {
+            _block_pos = 0;
+            _block_len = _file.read((uint8_t *) _block.data(), ini_read_block_size);
+            if(_block_len == 0)
+            {
+              return !line->empty();
+            }
+          }
+          const char * start = _block.data() + _block_pos;
+          const char * newline = (const char *) memchr(start, '\n', _block_len - _block_pos);
+          size_t n = newline != nullptr ? (size_t) (newline - start) + 1 : _block_len - _block_pos;
+          line->append(start, n);
+          _block_pos += n;
+          if(newline != nullptr)
+          {
+            return true;
+          }
+        }
+      }
+
+    protected:
+      File & _file;
+      std::vector<char> _block;
+      size_t _block_pos = 0;
+      size_t _block_len = 0;
+  };
+
+  /*!
+  \brief Output of ini_rewrite_file, written to the file a block at a time.
+  */
+  class block_writer
+  {
+    public:
+      block_writer(File & this_file) : _file(this_file) { _buffer.reserve(ini_read_block_size * 2); }
+      void append(const char * data, size_t length)
+      {
+        _buffer.append(data, length);
+        if(_buffer.size() >= ini_read_block_size)
+        {
+          flush();
+        }
+      }
+      void append(const std::string & text) { append(text.data(), text.size()); }
+      void flush()
+      {
+        if(!_buffer.empty())
+        {
+          size_t n = _file.write((const uint8_t *) _buffer.data(), _buffer.size());
+          _ok = _ok && n == _buffer.size();
+          _written += n;
+          _buffer.clear();
+        }
+      }
+      bool ok() const { return _ok; }
+      size_t written() const { return _written; }
+
+    protected:
+      File & _file;
+      std::string _buffer;
+      size_t _written = 0;
+      bool _ok = true;
+  };
+
+  static void strip_line_ending(const std::string & line, size_t * length)
+  {
+    *length = line.size();
+    if(*length > 0 && line[*length - 1] == '\n') (*length)--;
+    if(*length > 0 && line[*length - 1] == '\r') (*length)--;
+  }
+
+  static void append_new_keys(block_writer & out, const std::map<std::string, std::string> & keys, const std::set<std::string> * present, const std::string & eol)
+  {
+    for(const auto & key_value : keys)
+    {
+      if(present == nullptr || present->count(key_value.first) == 0)
+      {
+        out.append(key_value.first);
+        out.append(" = ", 3);
+        out.append(key_value.second);
+        out.append(eol);
+      }
+    }
+  }
+
+  /*!
+  \brief Copy an .ini file, setting the values in edits, and keeping everything else as it was.
+  @param source an open file, read from the start. It is read twice, so it must be seekable.
+  @param dest an open, empty file for the result.
+  @param edits the values to set. Every pair should pass ini_writable_pair.
+  @param bytes_written set to the bytes written to dest. May be null.
+  \return False if source is not open or a write fell short.
+  \details Only the value of a changed line is replaced; its key, spacing, line ending and every other line
+  (comments, blank lines, ordering, invalid lines) are copied byte for byte. Where a key is repeated, every copy is
+  set, so the file still loads with the new value.
+  - a key new to an existing section goes after the last key of the section's first block, before any comments
+    that lead into the next heading
+  - a new key of the unnamed section goes before the first heading
+  - a new section is appended at the end of the file
+  New lines use the file's line ending ("\r\n" if its first line has one).
+  */
+  bool ini_rewrite_file(File & source, File & dest, const ini_edit_map & edits, size_t * bytes_written)
+  {
+    if(bytes_written != nullptr) *bytes_written = 0;
+    if(!source || !dest)
+    {
+      return false;
+    }
+
+    //Pass 1: which edited sections and keys already exist, so new keys go in only once
+    std::map<std::string, std::set<std::string>> present;
+    std::string line;
+    std::string section_name;
+    std::string eol = "\n";
+    bool first_line = true;
+    size_t length;
+    {
+      raw_line_reader reader(source);
+      while(reader.next_line(&line))
+      {
+        if(first_line && line.size() >= 2 && line[line.size() - 1] == '\n' && line[line.size() - 2] == '\r')
+        {
+          eol = "\r\n";
+        }
+        first_line = false;
+        strip_line_ending(line, &length);
+        ini_line this_line = classify_ini_line(line.data(), length);
+        if(this_line.type == ini_line_type::section)
+        {
+          section_name.assign(this_line.name, this_line.name_length);
+          if(edits.count(section_name) != 0)
+          {
+            present[section_name];
+          }
+        }
+        else if(this_line.type == ini_line_type::key_value && edits.count(section_name) != 0)
+        {
+          present[section_name].insert(std::string(this_line.name, this_line.name_length));
+        }
+      }
+    }
+    present[""];    //The unnamed section always exists: it is the start of the file
+
+    //Pass 2: copy, replacing values and inserting new keys as each section's first block ends
+    source.seek(0);
+    block_writer out(dest);
+    raw_line_reader reader(source);
+    std::set<std::string> finished;
+    std::string held;   //Blank and comment lines since the current section's last key
+    section_name.clear();
+    bool ends_in_newline = true;
+    auto end_block = [&]()
+    {
+      auto edit_iter = edits.find(section_name);
+      if(edit_iter != edits.end() && finished.insert(section_name).second)
+      {
+        append_new_keys(out, edit_iter->second, &present[section_name], eol);
+      }
+      out.append(held);
+      held.clear();
+    };
+
+    while(reader.next_line(&line))
+    {
+      ends_in_newline = line.back() == '\n';
+      strip_line_ending(line, &length);
+      ini_line this_line = classify_ini_line(line.data(), length);
+      switch(this_line.type)
+      {
+        case ini_line_type::blank:
+        case ini_line_type::comment:
+          held += line;
+          break;
+        case ini_line_type::section:
+          end_block();
+          section_name.assign(this_line.name, this_line.name_length);
+          out.append(line);
+          break;
+        case ini_line_type::key_value:
+        {
+          out.append(held);
+          held.clear();
+          auto edit_iter = edits.find(section_name);
+          auto key_iter = edit_iter != edits.end() ? edit_iter->second.find(std::string(this_line.name, this_line.name_length)) : ini_edit_map::mapped_type::const_iterator();
+          if(edit_iter == edits.end() || key_iter == edit_iter->second.end())
+          {
+            out.append(line);
+            break;
+          }
+          size_t value_start = (size_t) (this_line.value - line.data());
+          size_t value_end = value_start + this_line.value_length;
+          out.append(line.data(), value_start);
+          if(this_line.value_length == 0 && value_start > 0 && line[value_start - 1] == '=')
+          {
+            out.append(" ", 1);
+          }
+          out.append(key_iter->second);
+          out.append(line.data() + value_end, line.size() - value_end);
+          break;
+        }
+        default:
+          out.append(line);
+          break;
+      }
+    }
+    if(!ends_in_newline)
+    {
+      //A new key or section must not run on from the file's last line
+      out.append(held);
+      held.clear();
+      out.append(eol);
+    }
+    end_block();
+    for(const auto & section : edits)
+    {
+      if(present.count(section.first) == 0)
+      {
+        out.append(eol);
+        out.append("[", 1);
+        out.append(section.first);
+        out.append("]", 1);
+        out.append(eol);
+        append_new_keys(out, section.second, nullptr, eol);
+      }
+    }
+    out.flush();
+    if(bytes_written != nullptr) *bytes_written = out.written();
+    return out.ok();
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include "FS.h"
+#include "beluga_ini_index.h"
+
+namespace beluga_utils
+{
+    /*!
+    \brief How ini_reader::commit() makes values set at runtime persistent
+    \details journal: append one record per changed key to <config path>.jnl. Only those bytes are written, and the
+    config file itself is untouched until compact(). The journal is replayed over the file by initialise().
+    rewrite: write the whole file again with the new values in place (see ini_rewrite_file), through a temp file
+    and a rename. Every commit costs the file size in flash writes, but there is no journal to replay.
+    */
+    enum class ini_commit_mode
+    {
+        journal,
+        rewrite
+    };
+
+    /*!
+    \brief What one ini_reader::commit() or compact() did.
+    */
+    struct ini_commit_stats
+    {
+        uint32_t records;           //Section-key pairs written
+        uint32_t bytes_written;     //To the journal, or the rewritten file
+        uint32_t elapsed_us;
+        uint32_t journal_bytes;     //Size of the journal afterwards (0 once compacted)
+        bool rewritten;             //The config file was rewritten (rewrite mode, or compact())
+    };
+
+    /*!
+    \brief Values to write, by section then key.
+    */
+    typedef std::map< std::string, std::map< std::string, std::string > > ini_edit_map;
+
+    /*!
+    \brief Callback for ini_journal_replay: one record of an intact commit, in the order written.
+    */
+    typedef void (*ini_journal_callback)(void * context, ini_view section, ini_view key, ini_view value);
+
+    bool ini_writable_pair(const std::string & section_name, const std::string & key_name, const std::string & value);
+    size_t ini_journal_record(std::string * journal_text, const std::string & section_name, const std::string & key_name, const std::string & value);
+    size_t ini_journal_end_commit(std::string * journal_text, size_t n_records);
+    bool ini_journal_replay(File & journal_file, ini_journal_callback callback, void * context, size_t * n_records, size_t * n_damaged);
+    bool ini_rewrite_file(File & source, File & dest, const ini_edit_map & edits, size_t * bytes_written);
+
+    const char ini_journal_header[] = "BJNL2";     //BJNL1 journals had no end-of-commit lines
+}
@@ -0,0 +1,78 @@
+#include <Arduino.h>
+#include <string.h>
+#include "beluga_log_binary.h"
+
+namespace beluga_utils
+{
+    /*!
+    \brief Start a record: sync byte, length placeholder, format id, timestamp, level.
+    */
+    log_record::log_record(log_level level, uint32_t format_id)
+    {
+        _buffer[0] = log_record_sync;
+        _buffer[1] = 0;
+        _length = 2;
+        uint32_t timestamp_us = (uint32_t) micros();
+        uint8_t level_byte = (uint8_t) level;
+        put_bytes(&format_id, 4);
+        put_bytes(&timestamp_us, 4);
+        put_bytes(&level_byte, 1);
+    }
+
+    bool log_record::put_tag(uint8_t tag, size_t value_size)
+    {
+        if(_length - 2 + 1 + value_size > log_record_max_payload)
+        {
+            return false;
+        }
+        _buffer[_length++] = tag;
+        return true;
+    }
+
+    bool log_record::put_bytes(const void * data, size_t length)
+    {
+        memcpy(_buffer + _length, data, length);
+        _length += length;
+        return true;
+    }
+
+    /*!
+    \brief Strings are sent as a 1 byte length and the bytes, cut to fit the record.
+    */
+    void log_record::put(const char * value)
+    {
+        if(value == nullptr)
+        {
+            value = "(null)";
+        }
+        size_t space = log_record_max_payload - (_length - 2);
+        if(space < 2)
+        {
+            return;
+        }
+        size_t length = strlen(value);
+        if(length > space - 2)
+        {
+            length = space - 2;
+        }
+        uint8_t length_byte = (uint8_t) length;
+        put_tag(log_arg_str, 1 + length);
+        put_bytes(&length_byte, 1);
+        put_bytes(value, length);
+    }
+
+    /*!
+    \brief Fill in the length and checksum and write the record out through debug_print_bytes.
+    */
+    void log_record::send()
+    {
+        uint8_t checksum = 0;
+        for(size_t i = 2; i < _length; i++)
+        {
+            checksum += _buffer[i];
+        }
+        _buffer[1] = (uint8_t) (_length - 2);
+        _buffer[_length] = checksum;
+        debug_print_bytes(_buffer, _length + 1);
+    }
+}
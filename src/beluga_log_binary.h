@@ -0,0 +1,123 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+#include "beluga_debug.h"
+
+/*!
+\brief Binary log records: format-string ID, timestamp and raw arguments instead of formatted text
+\author Bryan Clarke
+\date 17/10/2026
+\details Build with -DBELUGA_LOG_BINARY and every BELUGA_LOG_* call sends a record like this instead of a text line:
+  0xB7, payload length (1 byte), payload, checksum (1 byte: sum of the payload bytes)
+  payload = format id (4 bytes LE), micros() (4 bytes LE), level (1 byte), then for each argument a type tag
+  (log_arg_*) and its value, little endian. Strings are a 1 byte length plus up to 255 bytes; doubles are sent
+  as 4 byte floats.
+The format id is a compile-time FNV-1a hash of the format string literal, so there is no snprintf on the device and
+the format strings themselves are not needed in the binary. Text from debug_print can be mixed into the same stream.
+tools/beluga_log_tool.py builds the id -> format string table from the sources and decodes a captured stream:
+python3 tools/beluga_log_tool.py strings src -o log_strings.json
+python3 tools/beluga_log_tool.py decode log_strings.json capture.bin
+Usage (any BELUGA_LOG_* call site, unchanged):
+BELUGA_LOG_INFO("pump %d pressure %f", pump_id, pressure);
+*/
+namespace beluga_utils
+{
+    const uint8_t log_record_sync = 0xB7;
+    const size_t log_record_max_payload = 255;
+
+    const uint8_t log_arg_i32 = 1;
+    const uint8_t log_arg_u32 = 2;
+    const uint8_t log_arg_i64 = 3;
+    const uint8_t log_arg_u64 = 4;
+    const uint8_t log_arg_f32 = 5;
+    const uint8_t log_arg_str = 6;
+    const uint8_t log_arg_char = 7;
+
+    /*!
+    \brief FNV-1a hash of a format string, evaluated by the compiler when given a literal.
+    \details Must match log_format_id() in tools/beluga_log_tool.py.
+    */
+    constexpr uint32_t log_format_id(const char * format, uint32_t hash = 2166136261u)
+    {
+        return (*format == '\0') ? hash : log_format_id(format + 1, (hash ^ (uint8_t) *format) * 16777619u);
+    }
+
+    /*!
+    \brief Builds one record on the stack. Arguments that do not fit are dropped; the record is still sent.
+    */
+    class log_record
+    {
+        public:
+            log_record(log_level level, uint32_t format_id);
+            void put(char value) { put_tag(log_arg_char, 1) && put_bytes(&value, 1); }
+            void put(signed char value) { put_signed(value); }
+            void put(unsigned char value) { put_unsigned(value); }
+            void put(short value) { put_signed(value); }
+            void put(unsigned short value) { put_unsigned(value); }
+            void put(int value) { put_signed(value); }
+            void put(unsigned int value) { put_unsigned(value); }
+            void put(long value) { put_signed(value); }
+            void put(unsigned long value) { put_unsigned(value); }
+            void put(long long value) { put_signed(value); }
+            void put(unsigned long long value) { put_unsigned(value); }
+            void put(bool value) { put_unsigned(value ? 1u : 0u); }
+            void put(float value) { put_tag(log_arg_f32, 4) && put_bytes(&value, 4); }
+            void put(double value) { put((float) value); }
+            void put(const char * value);
+            void put(const void * value) { put_unsigned((unsigned long long) (uintptr_t) value); }
+            void send();
+
+        protected:
+            template<typename T> void put_signed(T value)
+            {
+                if(sizeof(T) <= 4)
+                {
+                    int32_t v = (int32_t) value;
+                    put_tag(log_arg_i32, 4) && put_bytes(&v, 4);
+                }else{
+                    int64_t v = (int64_t) value;
+                    put_tag(log_arg_i64, 8) && put_bytes(&v, 8);
+                }
+            }
+            template<typename T> void put_unsigned(T value)
+            {
+                if(sizeof(T) <= 4)
+                {
+                    uint32_t v = (uint32_t) value;
+                    put_tag(log_arg_u32, 4) && put_bytes(&v, 4);
+                }else{
+                    uint64_t v = (uint64_t) value;
+                    put_tag(log_arg_u64, 8) && put_bytes(&v, 8);
+                }
+            }
+            bool put_tag(uint8_t tag, size_t value_size);
+            bool put_bytes(const void * data, size_t length); //Host and ESP32 are both little endian
+            uint8_t _buffer[2 + log_record_max_payload + 1];
+            size_t _length;
+    };
+
+    inline void log_record_put_all(log_record &)
+    {
+    }
+
+    template<typename T, typename... Rest> void log_record_put_all(log_record & record, T first, Rest... rest)
+    {
+        record.put(first);
+        log_record_put_all(record, rest...);
+    }
+
+    template<typename... Args> void log_binary(log_level level, uint32_t format_id, Args... args)
+    {
+        log_record record(level, format_id);
+        log_record_put_all(record, args...);
+        record.send();
+    }
+}
+
+/*!
+\brief Send a binary record. The format must be a string literal so its id is computed at compile time.
+*/
+#define BELUGA_LOG_BINARY_AT(level, format, ...) do { if(beluga_utils::log_level_enabled(level)) { \
+    beluga_utils::log_binary(level, std::integral_constant<uint32_t, beluga_utils::log_format_id(format)>::value, ##__VA_ARGS__); \
+    } } while(0)
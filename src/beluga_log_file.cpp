@@ -0,0 +1,712 @@
+#include "beluga_log_file.h"
+#include "beluga_debug.h"
+#include <Arduino.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#if defined(BELUGA_NATIVE)
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#endif
+
+namespace beluga_utils
+{
+    const size_t log_file_sector_size = 512;
+    const uint32_t log_file_format_version = 1;
+    const uint32_t commit_task_stack_size = 4096;
+
+    static size_t round_up_to_sector(size_t n)
+    {
+        return ((n + log_file_sector_size - 1) / log_file_sector_size) * log_file_sector_size;
+    }
+
+#if defined(BELUGA_NATIVE)
+    /*!
+    \brief The 256-entry table of the reflected CRC-32 polynomial. A function-local static, so it is built once,
+    thread-safely, on first use.
+    */
+    struct crc32_table
+    {
+        uint32_t entries[256];
+        crc32_table()
+        {
+            for(uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for(int bit = 0; bit < 8; bit++)
+                {
+                    c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+                }
+                entries[n] = c;
+            }
+        }
+    };
+#endif
+
+    /*!
+    \brief CRC-32 (IEEE 802.3, as zlib's crc32), continuing from crc. Start with 0.
+    \details The ESP32 ROM has a table-driven version; the host uses one of its own.
+    */
+    uint32_t log_file_crc32(uint32_t crc, const uint8_t * data, size_t length)
+    {
+#if defined(BELUGA_NATIVE)
+        static const crc32_table table;
+        crc = ~crc;
+        for(size_t i = 0; i < length; i++)
+        {
+            crc = (crc >> 8) ^ table.entries[(crc ^ data[i]) & 0xFF];
+        }
+        return ~crc;
+#else
+        return esp_rom_crc32_le(crc, data, (uint32_t) length);
+#endif
+    }
+
+    static void put_u16(uint8_t * p, uint16_t value)
+    {
+        p[0] = (uint8_t) value;
+        p[1] = (uint8_t) (value >> 8);
+    }
+
+    static void put_u32(uint8_t * p, uint32_t value)
+    {
+        put_u16(p, (uint16_t) value);
+        put_u16(p + 2, (uint16_t) (value >> 16));
+    }
+
+    static uint16_t get_u16(const uint8_t * p)
+    {
+        return (uint16_t) (p[0] | (p[1] << 8));
+    }
+
+    static uint32_t get_u32(const uint8_t * p)
+    {
+        return (uint32_t) get_u16(p) | ((uint32_t) get_u16(p + 2) << 16);
+    }
+
+    /*!
+    \brief CRC of a record: its length and sequence (header bytes 2-7), then the payload.
+    */
+    static uint32_t record_crc(const uint8_t * header, const uint8_t * payload, size_t length)
+    {
+        return log_file_crc32(log_file_crc32(0, header + 2, 6), payload, length);
+    }
+
+    /*!
+    \brief Read and check a segment's header sector.
+    \return False if the segment has never been started (or its header is damaged).
+    */
+    static bool read_segment_header(File & file, uint32_t * first_sequence, uint32_t * segment_bytes)
+    {
+        uint8_t header[20];
+        if(!file.seek(0) || file.read(header, sizeof(header)) != sizeof(header))
+        {
+            return false;
+        }
+        if(get_u32(header) != log_file_segment_magic || get_u32(header + 4) != log_file_format_version
+            || get_u32(header + 16) != log_file_crc32(0, header, 16))
+        {
+            return false;
+        }
+        *first_sequence = get_u32(header + 8);
+        *segment_bytes = get_u32(header + 12);
+        return true;
+    }
+
+    /*!
+    \brief Walk one segment's records from first_sequence on, stopping at the first bad one.
+    @param next_sequence set to the sequence number after the last good record.
+    @param stop_offset if given, set to where the walk stopped: a sector boundary unless a commit was cut off.
+    \return The file offset just after the last good record (or pad).
+    */
+    static size_t scan_segment(File & file, size_t segment_bytes, uint32_t first_sequence, log_file_record_callback callback, void * context, uint32_t * next_sequence, size_t * n_records, size_t * stop_offset = nullptr)
+    {
+        std::vector<uint8_t> payload(log_file_max_record);
+        uint32_t expected = first_sequence;
+        size_t offset = log_file_sector_size;
+        size_t end = offset;
+        while(offset + log_file_header_bytes <= segment_bytes)
+        {
+            uint8_t header[log_file_header_bytes];
+            if(!file.seek(offset) || file.read(header, sizeof(header)) != sizeof(header))
+            {
+                break;
+            }
+            uint16_t magic = get_u16(header);
+            size_t length = get_u16(header + 2);
+            size_t to_sector_end = log_file_sector_size - offset % log_file_sector_size;
+            if(magic == log_file_pad_magic && log_file_header_bytes + length <= to_sector_end)
+            {
+                offset += log_file_header_bytes + length;
+                end = offset;
+                continue;
+            }
+            if(magic != log_file_record_magic && to_sector_end < log_file_header_bytes)
+            {
+                offset += to_sector_end; //Zero fill at the end of a commit: no room for a pad record
+                continue;
+            }
+            if(magic != log_file_record_magic || length > log_file_max_record || get_u32(header + 4) != expected
+                || offset + log_file_header_bytes + length > segment_bytes)
+            {
+                break;
+            }
+            if(file.read(payload.data(), length) != length || get_u32(header + 8) != record_crc(header, payload.data(), length))
+            {
+                break;
+            }
+            if(callback != nullptr)
+            {
+                callback(context, expected, payload.data(), length);
+            }
+            expected++;
+            (*n_records)++;
+            offset += log_file_header_bytes + length;
+            end = offset;
+        }
+        *next_sequence = expected;
+        if(stop_offset != nullptr)
+        {
+            *stop_offset = offset;
+        }
+        return end;
+    }
+
+    struct segment_order
+    {
+        size_t segment;
+        uint32_t first_sequence;
+        bool operator<(const segment_order & other) const { return (int32_t) (first_sequence - other.first_sequence) < 0; }
+    };
+
+    /*!
+    \brief Find the started segments of a log, oldest first.
+    */
+    static std::vector<segment_order> find_segments(storage_backend & backend, const char * path_prefix, size_t n_segments)
+    {
+        std::vector<segment_order> segments;
+        for(size_t i = 0; i < n_segments; i++)
+        {
+            char path[96];
+            snprintf(path, sizeof(path), "%s_%03u.log", path_prefix, (unsigned) i);
+            if(!backend.exists(path))
+            {
+                continue;
+            }
+            File file = backend.open(path, FILE_READ);
+            segment_order this_segment = {i, 0};
+            uint32_t segment_bytes;
+            if(file && read_segment_header(file, &this_segment.first_sequence, &segment_bytes))
+            {
+                segments.push_back(this_segment);
+            }
+        }
+        std::sort(segments.begin(), segments.end());
+        return segments;
+    }
+
+    /*!
+    \brief Read back every intact record of a log, oldest first
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Works on a log that is not open for writing (e.g. after a reset, or a card in a host reader). Each
+    segment ends at its first record with a bad CRC or an unexpected sequence number.
+    @param last_sequence if given, set to the sequence number of the last record (0 if there are none).
+    \return The number of records.
+    Usage:
+    beluga_utils::log_file_scan(sd_card, "/log", 8, print_record, nullptr);
+    */
+    size_t log_file_scan(storage_backend & backend, const char * path_prefix, size_t n_segments, log_file_record_callback callback, void * context, uint32_t * last_sequence)
+    {
+        std::vector<segment_order> segments = find_segments(backend, path_prefix, n_segments);
+        size_t n_records = 0;
+        uint32_t next_sequence = 1;
+        for(size_t i = 0; i < segments.size(); i++)
+        {
+            char path[96];
+            snprintf(path, sizeof(path), "%s_%03u.log", path_prefix, (unsigned) segments[i].segment);
+            File file = backend.open(path, FILE_READ);
+            uint32_t first_sequence;
+            uint32_t segment_bytes;
+            if(file && read_segment_header(file, &first_sequence, &segment_bytes))
+            {
+                uint32_t segment_next;
+                scan_segment(file, segment_bytes, first_sequence, callback, context, &segment_next, &n_records);
+                if(segment_next != first_sequence)
+                {
+                    next_sequence = segment_next;
+                }
+            }
+        }
+        if(last_sequence != nullptr)
+        {
+            *last_sequence = next_sequence - 1;
+        }
+        return n_records;
+    }
+
+    /*!
+    \brief The commit task, and how append() wakes it.
+    */
+    struct log_file_sink::commit_task
+    {
+#if defined(BELUGA_NATIVE)
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake_up;
+        bool signalled = false;
+
+        void notify()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            signalled = true;
+            wake_up.notify_one();
+        }
+
+        void wait(unsigned long timeout_ms)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_up.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return signalled; });
+            signalled = false;
+        }
+#else
+        TaskHandle_t handle = nullptr;
+        std::atomic<bool> stopped{true};
+
+        void notify()
+        {
+            if(handle != nullptr)
+            {
+                xTaskNotifyGive(handle);
+            }
+        }
+
+        void wait(unsigned long timeout_ms)
+        {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+        }
+#endif
+    };
+
+    log_file_sink::~log_file_sink()
+    {
+        end();
+        delete _task;
+    }
+
+    std::string log_file_sink::segment_path(size_t segment) const
+    {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), "_%03u.log", (unsigned) segment);
+        return _path_prefix + suffix;
+    }
+
+    /*!
+    \brief Preallocate the segments, find where the log left off and start the commit task
+    @param backend a mounted filesystem: sd_mmc_backend, or a flash one (LittleFS suits better than SPIFFS).
+    @param path_prefix segments are <path_prefix>_000.log and so on.
+    \return False if the segments or buffers could not be created.
+    The first begin() on a card writes n_segments * segment_bytes, which can take a few seconds.
+    */
+    bool log_file_sink::begin(storage_backend & backend, const char * path_prefix, const log_file_config & config)
+    {
+        end();
+        _backend = &backend;
+        _path_prefix = path_prefix;
+        _config = config;
+        _config.segment_bytes = round_up_to_sector(_config.segment_bytes);
+        if(_config.n_segments == 0 || _config.segment_bytes < 4 * log_file_sector_size)
+        {
+            return false;
+        }
+        //Room for two batches, so appends carry on while the commit task catches up, plus padding to a sector
+        _buffer_size = round_up_to_sector(2 * std::max(_config.batch_bytes, log_file_header_bytes + log_file_max_record)) + log_file_sector_size;
+        _buffer_size = std::min(_buffer_size, _config.segment_bytes - log_file_sector_size);
+        for(size_t i = 0; i < 2; i++)
+        {
+#if defined(BELUGA_NATIVE)
+            _buffers[i] = (uint8_t *) malloc(_buffer_size);
+#else
+            _buffers[i] = (uint8_t *) heap_caps_malloc(_buffer_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+#endif
+        }
+        if(_buffers[0] == nullptr || _buffers[1] == nullptr)
+        {
+            BELUGA_LOG_ERROR("log_file_sink: could not allocate two %u byte buffers", (unsigned) _buffer_size);
+            free_buffers();
+            return false;
+        }
+        if(!open_segments())
+        {
+            free_buffers();
+            return false;
+        }
+        _active = 0;
+        _active_used = 0;
+        _stats = log_file_stats();
+        _stop.store(false, std::memory_order_release);
+        if(_task == nullptr)
+        {
+            _task = new commit_task(); //Kept after end(), so an append() racing with end() can still wake it
+        }
+#if defined(BELUGA_NATIVE)
+        _task->thread = std::thread(run_commit_task, this);
+#else
+        _task->stopped.store(false, std::memory_order_release);
+        if(xTaskCreate(run_commit_task, "log_file", commit_task_stack_size, this, _config.task_priority, &_task->handle) != pdPASS)
+        {
+            _task->handle = nullptr;
+            _task->stopped.store(true, std::memory_order_release);
+            _segment_file.close();
+            free_buffers();
+            return false;
+        }
+#endif
+        _running.store(true, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+    \brief Preallocate missing segments and position the writer after the newest intact record.
+    */
+    bool log_file_sink::open_segments()
+    {
+        for(size_t i = 0; i < _config.n_segments; i++)
+        {
+            std::string path = segment_path(i);
+            File file = _backend->open(path.c_str(), FILE_READ);
+            if(file && file.size() >= _config.segment_bytes)
+            {
+                continue;
+            }
+            file.close();
+            file = _backend->open(path.c_str(), FILE_WRITE);
+            if(!file || !file.seek(_config.segment_bytes - 1) || file.write((uint8_t) 0) != 1)
+            {
+                BELUGA_LOG_ERROR("log_file_sink: could not preallocate %s", path.c_str());
+                return false;
+            }
+            file.close();
+        }
+        std::vector<segment_order> segments = find_segments(*_backend, _path_prefix.c_str(), _config.n_segments);
+        _segment = 0;
+        _segment_offset = 0; //No header yet: the first commit starts the segment
+        _next_sequence = 1;
+        if(!segments.empty())
+        {
+            const segment_order & newest = segments.back();
+            File file = _backend->open(segment_path(newest.segment).c_str(), FILE_READ);
+            uint32_t first_sequence;
+            uint32_t segment_bytes;
+            if(file && read_segment_header(file, &first_sequence, &segment_bytes) && segment_bytes == _config.segment_bytes)
+            {
+                size_t n_records = 0;
+                size_t stop_offset;
+                size_t end = scan_segment(file, segment_bytes, first_sequence, nullptr, nullptr, &_next_sequence, &n_records, &stop_offset);
+                _segment = newest.segment;
+                _segment_offset = round_up_to_sector(end);
+                if(stop_offset % log_file_sector_size != 0)
+                {
+                    //A commit was cut off mid-sector. Its torn bytes stay in front of anything written after them, so
+                    //the scan would stop there: carry on in the next segment instead (the first commit rotates).
+                    BELUGA_LOG_WARN("log_file_sink: %s ends in a torn commit, continuing in the next segment", segment_path(_segment).c_str());
+                    _segment_offset = _config.segment_bytes;
+                }
+            }else{
+                //Written with another segment size: start again from segment 0, after its sequence numbers
+                _next_sequence = newest.first_sequence + 1;
+            }
+        }
+        _segment_file = _backend->open(segment_path(_segment).c_str(), "r+");
+        if(!_segment_file)
+        {
+            BELUGA_LOG_ERROR("log_file_sink: could not open %s", segment_path(_segment).c_str());
+            return false;
+        }
+        BELUGA_LOG_DEBUG("log_file_sink: %s continues at record %lu", segment_path(_segment).c_str(), (unsigned long) _next_sequence);
+        return true;
+    }
+
+    /*!
+    \brief Commit what is waiting, stop the commit task and close the segment.
+    */
+    void log_file_sink::end()
+    {
+        if(!_running.exchange(false, std::memory_order_acq_rel))
+        {
+            return;
+        }
+        _stop.store(true, std::memory_order_release);
+        _task->notify();
+#if defined(BELUGA_NATIVE)
+        _task->thread.join();
+#else
+        while(!_task->stopped.load(std::memory_order_acquire))
+        {
+            _task->notify();
+            delay(1);
+        }
+        _task->handle = nullptr;
+#endif
+        commit_pending(false); //Anything appended while the task was stopping
+        _segment_file.close();
+        std::lock_guard<std::mutex> lock(_append_mutex);
+        free_buffers();
+    }
+
+    void log_file_sink::free_buffers()
+    {
+        for(size_t i = 0; i < 2; i++)
+        {
+#if defined(BELUGA_NATIVE)
+            free(_buffers[i]);
+#else
+            heap_caps_free(_buffers[i]);
+#endif
+            _buffers[i] = nullptr;
+        }
+    }
+
+    /*!
+    \brief Queue one record. Safe from any task (not an ISR); only copies into RAM.
+    \details Records longer than log_file_max_record are cut.
+    \return False if the record was dropped: the sink is not open, or both buffers are full and block_when_full is
+    false.
+    */
+    bool log_file_sink::append(const uint8_t * data, size_t length)
+    {
+        length = std::min(length, log_file_max_record);
+        size_t record_bytes = log_file_header_bytes + length;
+        size_t capacity = _buffer_size - log_file_sector_size; //Leave room to pad the batch to a sector
+        bool wake = false;
+        {
+            std::unique_lock<std::mutex> lock(_append_mutex);
+            if(!_running.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            while(_active_used + record_bytes > capacity)
+            {
+                if(!_config.block_when_full || !_running.load(std::memory_order_acquire))
+                {
+                    _stats.dropped++;
+                    lock.unlock();
+                    _task->notify();
+                    return false;
+                }
+                lock.unlock();
+                _task->notify();
+                delay(1);
+                lock.lock();
+                if(_buffers[0] == nullptr)
+                {
+                    return false; //end() ran while this waited
+                }
+            }
+            if(_active_used == 0)
+            {
+                _active_first_sequence = _next_sequence;
+                _active_first_us = monotonic_time_us();
+            }
+            uint8_t * header = _buffers[_active] + _active_used;
+            put_u16(header, log_file_record_magic);
+            put_u16(header + 2, (uint16_t) length);
+            put_u32(header + 4, _next_sequence);
+            memcpy(header + log_file_header_bytes, data, length);
+            put_u32(header + 8, record_crc(header, header + log_file_header_bytes, length));
+            _active_used += record_bytes;
+            _next_sequence++;
+            _stats.records++;
+            _stats.payload_bytes += length;
+            wake = (_active_used >= _config.batch_bytes);
+        }
+        if(wake)
+        {
+            _task->notify();
+        }
+        return true;
+    }
+
+    /*!
+    \brief Write everything appended so far, now, and wait for it. Safe from any task.
+    \return False if the write failed.
+    */
+    bool log_file_sink::commit()
+    {
+        if(!_running.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        return commit_pending(false);
+    }
+
+    /*!
+    \brief Swap the batch buffers and write the full one.
+    @param only_if_due commit only if the batch has reached batch_bytes or commit_interval_ms.
+    \details Logs nothing itself: a BELUGA_LOG_* here would append to this sink while it commits.
+    */
+    bool log_file_sink::commit_pending(bool only_if_due)
+    {
+        std::lock_guard<std::mutex> commit_lock(_commit_mutex);
+        uint8_t * batch;
+        size_t length;
+        uint32_t first_sequence;
+        {
+            std::lock_guard<std::mutex> lock(_append_mutex);
+            if(_active_used == 0)
+            {
+                return true;
+            }
+            uint64_t age_ms = (monotonic_time_us() - _active_first_us) / 1000;
+            if(only_if_due && _active_used < _config.batch_bytes && age_ms < _config.commit_interval_ms)
+            {
+                return true;
+            }
+            batch = _buffers[_active];
+            length = _active_used;
+            first_sequence = _active_first_sequence;
+            _active ^= 1;
+            _active_used = 0;
+        }
+        //Pad to the sector boundary: with a pad record if it fits, else zeros (log_file_scan skips both)
+        size_t padded = round_up_to_sector(length);
+        memset(batch + length, 0, padded - length);
+        if(padded - length >= log_file_header_bytes)
+        {
+            put_u16(batch + length, log_file_pad_magic);
+            put_u16(batch + length + 2, (uint16_t) (padded - length - log_file_header_bytes));
+        }
+        uint64_t t0 = monotonic_time_us();
+        bool ok = write_batch(batch, padded, first_sequence);
+        _stats.commit_latency.record(monotonic_time_us() - t0);
+        if(ok)
+        {
+            _stats.commits++;
+        }else{
+            _stats.failed_commits++;
+        }
+        return ok;
+    }
+
+    /*!
+    \brief Write a segment's header sector, making it the newest segment.
+    \details Its old records stay on the card but have lower sequence numbers than first_sequence, so the scan
+    stops at them.
+    */
+    bool log_file_sink::start_segment(size_t segment, uint32_t first_sequence)
+    {
+        if(segment != _segment || !_segment_file)
+        {
+            _segment_file.close();
+            _segment_file = _backend->open(segment_path(segment).c_str(), "r+");
+            if(!_segment_file)
+            {
+                return false;
+            }
+            _segment = segment;
+        }
+        uint8_t header[log_file_sector_size];
+        memset(header, 0, sizeof(header));
+        put_u32(header, log_file_segment_magic);
+        put_u32(header + 4, log_file_format_version);
+        put_u32(header + 8, first_sequence);
+        put_u32(header + 12, (uint32_t) _config.segment_bytes);
+        put_u32(header + 16, log_file_crc32(0, header, 16));
+        if(!_segment_file.seek(0) || _segment_file.write(header, sizeof(header)) != sizeof(header))
+        {
+            return false;
+        }
+        _segment_offset = log_file_sector_size;
+        _stats.sectors_written++;
+        return true;
+    }
+
+    /*!
+    \brief Append a padded batch to the current segment, moving to the next one if it does not fit.
+    */
+    bool log_file_sink::write_batch(const uint8_t * batch, size_t length, uint32_t first_sequence)
+    {
+        if(_segment_offset == 0)
+        {
+            if(!start_segment(_segment, first_sequence))
+            {
+                return false;
+            }
+        }else if(_segment_offset + length > _config.segment_bytes){
+            if(!start_segment((_segment + 1) % _config.n_segments, first_sequence))
+            {
+                _segment_offset = 0; //Try this segment's header again next time
+                return false;
+            }
+            _stats.rotations++;
+        }
+        if(!_segment_file.seek(_segment_offset) || _segment_file.write(batch, length) != length)
+        {
+            return false;
+        }
+        _segment_file.flush();
+        _segment_offset += length;
+        _stats.sectors_written += length / log_file_sector_size;
+        return true;
+    }
+
+    void log_file_sink::run_commit_task(void * sink)
+    {
+        ((log_file_sink *) sink)->commit_task_main();
+#if !defined(BELUGA_NATIVE)
+        ((log_file_sink *) sink)->_task->stopped.store(true, std::memory_order_release);
+        vTaskDelete(nullptr);
+#endif
+    }
+
+    /*!
+    \brief Commit when append() says the batch is full, or when the oldest record has waited commit_interval_ms.
+    */
+    void log_file_sink::commit_task_main()
+    {
+        unsigned long poll_ms = std::max(_config.commit_interval_ms / 4, (uint32_t) 1);
+        while(!_stop.load(std::memory_order_acquire))
+        {
+            _task->wait(poll_ms);
+            commit_pending(true);
+        }
+        commit_pending(false);
+    }
+
+    uint32_t log_file_sink::next_sequence()
+    {
+        std::lock_guard<std::mutex> lock(_append_mutex);
+        return _next_sequence;
+    }
+
+    /*!
+    \brief A consistent copy of the counters.
+    */
+    log_file_stats log_file_sink::get_stats()
+    {
+        std::lock_guard<std::mutex> commit_lock(_commit_mutex);
+        std::lock_guard<std::mutex> lock(_append_mutex);
+        return _stats;
+    }
+
+    /*!
+    \brief Print records, commits, sectors written (the wear figure) and commit latency to Serial.
+    */
+    void log_file_sink::print_stats_to_serial()
+    {
+        log_file_stats stats = get_stats();
+        Serial.printf("log_file_sink: %lu records (%lu dropped), %llu payload bytes, %lu commits (%lu failed), %llu sectors written (%.2fx write amplification), %lu rotations, commit p50 %lu us, p99 %lu us, max %lu us\n",
+            (unsigned long) stats.records, (unsigned long) stats.dropped, (unsigned long long) stats.payload_bytes,
+            (unsigned long) stats.commits, (unsigned long) stats.failed_commits, (unsigned long long) stats.sectors_written,
+            stats.write_amplification(), (unsigned long) stats.rotations, (unsigned long) stats.commit_latency.percentile(0.5f),
+            (unsigned long) stats.commit_latency.percentile(0.99f), (unsigned long) stats.commit_latency.max());
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "FS.h"
+#include "beluga_profile.h"
+#include "beluga_storage_backend.h"
+
+namespace beluga_utils
+{
+    const uint32_t log_file_segment_magic = 0x474F4C42;    //"BLOG" little-endian, at the start of each segment
+    const uint16_t log_file_record_magic = 0xB10C;
+    const uint16_t log_file_pad_magic = 0xB1FF;            //Filler up to the next sector boundary after a commit
+    const size_t log_file_header_bytes = 12;                //Record header: magic, length, sequence, CRC-32
+    const size_t log_file_max_record = 1024;                //Longer appends are cut
+
+    struct log_file_config
+    {
+        size_t segment_bytes = 1024 * 1024;     //Each segment file is preallocated to this size
+        size_t n_segments = 8;                  //Segments are reused in turn, overwriting the oldest
+        size_t batch_bytes = 8 * 1024;          //Commit when this much is waiting (rounded to 512-byte sectors)
+        uint32_t commit_interval_ms = 1000;     //...or when the oldest waiting record is this old
+        bool block_when_full = false;           //When both batch buffers are full: wait (true) or drop the record
+        unsigned int task_priority = 1;         //FreeRTOS priority of the commit task
+    };
+
+    /*!
+    \brief Counters of a log_file_sink
+    \details sectors_written counts 512-byte sectors programmed. Every commit writes whole new sectors, so it is
+    the card's (or flash's) write count; payload_bytes / (sectors_written * 512) is how much of that is log text.
+    */
+    struct log_file_stats
+    {
+        uint32_t records;
+        uint32_t dropped;           //Records lost because both buffers were full (block_when_full false)
+        uint32_t commits;
+        uint32_t rotations;         //Moves to the next segment
+        uint32_t failed_commits;
+        uint64_t payload_bytes;
+        uint64_t sectors_written;
+        latency_histogram commit_latency;
+        float write_amplification() const { return payload_bytes ? (float) (sectors_written * 512) / (float) payload_bytes : 0.0f; }
+    };
+
+    /*!
+    \brief Callback for log_file_scan: one record, in sequence order.
+    */
+    typedef void (*log_file_record_callback)(void * context, uint32_t sequence, const uint8_t * data, size_t length);
+
+    size_t log_file_scan(storage_backend & backend, const char * path_prefix, size_t n_segments, log_file_record_callback callback, void * context, uint32_t * last_sequence = nullptr);
+    uint32_t log_file_crc32(uint32_t crc, const uint8_t * data, size_t length);
+
+    /*!
+    \brief Crash-safe log file on the SD card or flash, written in batches (group commit) to preallocated segments
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details append() copies a record into a RAM batch and returns; a commit task writes the batch in one
+    sector-aligned append when it reaches batch_bytes or commit_interval_ms, while appends fill the other of two
+    batch buffers. So loggers never wait on the card unless both buffers are full.
+    - Each record has a 12-byte header with a sequence number and a CRC-32. After a power cut the log ends at the
+      first record whose CRC or sequence is wrong, so at most the batch being committed is lost (plus whatever had
+      not yet been committed).
+    - n_segments files <path_prefix>_000.log ... are preallocated to segment_bytes by begin() and then rewritten in
+      place (opened "r+"), in turn. Their size never changes, so a commit never waits for the FAT to grow, and the
+      directory entry does not have to be rewritten. The oldest segment is overwritten when the last one fills.
+    - Commits are padded to the next 512-byte sector (a pad record), so no sector is ever written twice.
+    begin() carries on after the newest record already on the card (in the next segment if the last commit was cut
+    off mid-sector, so its torn bytes never hide later records); log_file_scan() reads records back.
+    Usage:
+    beluga_utils::sd_mmc_backend sd_card(true);
+    sd_card.begin();
+    beluga_utils::log_file_sink log_file;
+    log_file.begin(sd_card, "/log");
+    beluga_utils::debug_print_set_file_sink(&log_file); //Everything debug_print and BELUGA_LOG_* print
+    ...
+    log_file.commit(); //Before a deliberate restart
+    */
+    class log_file_sink
+    {
+        public:
+            log_file_sink(){};
+            ~log_file_sink();
+            bool begin(storage_backend & backend, const char * path_prefix = "/log", const log_file_config & config = log_file_config());
+            void end();
+            bool append(const uint8_t * data, size_t length);
+            bool commit();
+            bool is_open() const { return _running.load(std::memory_order_acquire); }
+            uint32_t next_sequence();
+            log_file_stats get_stats();
+            void print_stats_to_serial();
+
+        protected:
+            struct commit_task;
+            log_file_sink(const log_file_sink &);
+            log_file_sink & operator=(const log_file_sink &);
+            std::string segment_path(size_t segment) const;
+            bool open_segments();
+            bool start_segment(size_t segment, uint32_t first_sequence);
+            bool write_batch(const uint8_t * batch, size_t length, uint32_t first_sequence);
+            bool commit_pending(bool only_if_due);
+            static void run_commit_task(void * sink);
+            void commit_task_main();
+            void free_buffers();
+            storage_backend * _backend = nullptr;
+            std::string _path_prefix;
+            log_file_config _config;
+            File _segment_file;
+            size_t _segment = 0;
+            size_t _segment_offset = 0;
+            uint8_t * _buffers[2] = {nullptr, nullptr};
+            size_t _buffer_size = 0;
+            size_t _active = 0;                 //Buffer append() writes to
+            size_t _active_used = 0;
+            uint32_t _active_first_sequence = 0;
+            uint64_t _active_first_us = 0;
+            uint32_t _next_sequence = 1;
+            std::mutex _append_mutex;           //Active buffer, _next_sequence and the append counters
+            std::mutex _commit_mutex;           //The segment file; held while a batch is written
+            commit_task * _task = nullptr;
+            std::atomic<bool> _running{false};
+            std::atomic<bool> _stop{false};
+            log_file_stats _stats;
+    };
+}
@@ -0,0 +1,136 @@
+#include "beluga_log_ring.h"
+#include <string.h>
+#include <new>
+
+namespace beluga_utils
+{
+    log_ring::~log_ring()
+    {
+        end();
+    }
+
+    /*!
+    \brief Allocate the slots.
+    @param n_slots rounded up to a power of two (minimum 2).
+    \return False if the allocation failed.
+    */
+    bool log_ring::begin(size_t n_slots)
+    {
+        end();
+        size_t n = 2;
+        while(n < n_slots)
+        {
+            n <<= 1;
+        }
+        _slots = new (std::nothrow) log_ring_slot[n];
+        if(_slots == nullptr)
+        {
+            return false;
+        }
+        for(size_t i = 0; i < n; i++)
+        {
+            _slots[i].sequence.store((uint32_t) i, std::memory_order_relaxed);
+        }
+        _mask = (uint32_t) (n - 1);
+        _enqueue_pos.store(0, std::memory_order_relaxed);
+        _dequeue_pos.store(0, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+    \brief Free the slots. No producer or consumer may be using the ring.
+    */
+    void log_ring::end()
+    {
+        delete[] _slots;
+        _slots = nullptr;
+        _mask = 0;
+    }
+
+    /*!
+    \brief Copy a message into the ring.
+    \details Claims ceil(length / log_ring_text_size) consecutive slots. Because the consumer frees slots in order,
+    the run is free exactly when its last slot is free, so one check and one compare-and-swap claim the whole run.
+    \return False if the ring is full (nothing is written).
+    */
+    bool log_ring::try_push(const char * text, size_t length, bool add_newline)
+    {
+        if(_slots == nullptr)
+        {
+            return false;
+        }
+        size_t n_chunks = (length + log_ring_text_size - 1) / log_ring_text_size;
+        if(n_chunks == 0)
+        {
+            n_chunks = 1;
+        }
+        if(n_chunks > capacity())
+        {
+            n_chunks = capacity();
+            length = n_chunks * log_ring_text_size;
+        }
+
+        uint32_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        while(true)
+        {
+            uint32_t last = pos + (uint32_t) n_chunks - 1;
+            uint32_t sequence = _slots[last & _mask].sequence.load(std::memory_order_acquire);
+            int32_t dif = (int32_t) (sequence - last);
+            if(dif == 0)
+            {
+                if(_enqueue_pos.compare_exchange_weak(pos, pos + (uint32_t) n_chunks, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }else if(dif < 0){
+                return false; //Still holds a message from the previous lap
+            }else{
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        for(size_t i = 0; i < n_chunks; i++)
+        {
+            log_ring_slot & slot = _slots[(pos + i) & _mask];
+            size_t chunk = length - i * log_ring_text_size;
+            if(chunk > log_ring_text_size)
+            {
+                chunk = log_ring_text_size;
+            }
+            memcpy(slot.text, text + i * log_ring_text_size, chunk);
+            slot.length = (uint16_t) chunk;
+            bool last_chunk = (i + 1 == n_chunks);
+            slot.flags = last_chunk ? (uint16_t) (log_ring_flag_last | (add_newline ? log_ring_flag_newline : 0)) : 0;
+            slot.sequence.store(pos + (uint32_t) i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    /*!
+    \brief The oldest written slot, or nullptr if there is none. Consumer only.
+    */
+    const log_ring_slot * log_ring::front() const
+    {
+        if(_slots == nullptr)
+        {
+            return nullptr;
+        }
+        uint32_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        const log_ring_slot & slot = _slots[pos & _mask];
+        if(slot.sequence.load(std::memory_order_acquire) != pos + 1)
+        {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    /*!
+    \brief Release the slot returned by front() for reuse. Consumer only.
+    */
+    void log_ring::pop_front()
+    {
+        uint32_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        _slots[pos & _mask].sequence.store(pos + _mask + 1, std::memory_order_release);
+        _dequeue_pos.store(pos + 1, std::memory_order_release);
+    }
+}
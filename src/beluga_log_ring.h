@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+namespace beluga_utils
+{
+    const size_t log_ring_slot_size = 128; //Bytes per slot, including the header
+    const size_t log_ring_text_size = log_ring_slot_size - sizeof(std::atomic<uint32_t>) - 2 * sizeof(uint16_t);
+
+    struct log_ring_slot
+    {
+        std::atomic<uint32_t> sequence; //Slot state, see log_ring
+        uint16_t length;                //Bytes of text used
+        uint16_t flags;                 //log_ring_flag_*
+        char text[log_ring_text_size];
+    };
+
+    const uint16_t log_ring_flag_last = 1;    //Last slot of a message
+    const uint16_t log_ring_flag_newline = 2; //Print a newline after this slot
+
+    /*!
+    \brief Bounded, lock-free, multi-producer single-consumer queue of text messages
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details All memory is allocated by begin(); try_push never allocates or takes a lock, so it is safe to call
+    from any task (not from an ISR). Each slot carries a sequence number (the bounded queue of D. Vyukov):
+    - sequence == position: free for the producer that claims that position
+    - sequence == position + 1: written, ready for the consumer
+    A message longer than one slot claims a run of consecutive slots with a single compare-and-swap, so its
+    pieces are never interleaved with other producers' messages. Messages longer than the whole ring are cut.
+    Usage:
+    log_ring ring;
+    ring.begin(64);
+    ring.try_push("hello", 5, true);            //Any task
+    const log_ring_slot * slot = ring.front();  //Consumer task only
+    if(slot) { ...write slot->text...; ring.pop_front(); }
+    */
+    class log_ring
+    {
+        public:
+            log_ring(){};
+            ~log_ring();
+            bool begin(size_t n_slots);
+            void end();
+            bool try_push(const char * text, size_t length, bool add_newline);
+            const log_ring_slot * front() const;
+            void pop_front();
+            size_t capacity() const { return _mask + 1; }
+            uint32_t enqueue_position() const { return _enqueue_pos.load(std::memory_order_acquire); }
+            uint32_t dequeue_position() const { return _dequeue_pos.load(std::memory_order_acquire); }
+            bool is_ready() const { return _slots != nullptr; }
+
+        protected:
+            log_ring(const log_ring &);
+            log_ring & operator=(const log_ring &);
+            log_ring_slot * _slots = nullptr;
+            uint32_t _mask = 0;
+            std::atomic<uint32_t> _enqueue_pos{0};
+            std::atomic<uint32_t> _dequeue_pos{0};
+    };
+}
@@ -1,27 +1,254 @@
-
-#if 0
 #include "beluga_microsd.h"
+#include "beluga_debug.h"
 #include <sstream>
+#include <string.h>
+#include <stdlib.h>
+#if !defined(BELUGA_NATIVE)
+#include "esp_heap_caps.h"
+#endif
+
 namespace beluga_utils
 {
-    
+  static const uint32_t microsd_end_of_records = 0xFFFFFFFF;
 
-bool microsd::initialise() {
-  // Start the MicroSD card
- 
-  Serial.println("Mounting MicroSD Card");
-  if (!SD_MMC.begin()) {
-    Serial.println("MicroSD Card Mount Failed");
-    return false;
+  /*!
+  \brief Buffer the SDMMC driver can DMA from directly: internal RAM, 32-byte aligned. Plain aligned memory on the host.
+  */
+  static uint8_t * allocate_dma_buffer(size_t size)
+  {
+#if defined(BELUGA_NATIVE)
+    void * p = nullptr;
+    return (posix_memalign(&p, microsd_sector_size, size) == 0) ? (uint8_t *) p : nullptr;
+#else
+    return (uint8_t *) heap_caps_aligned_alloc(32, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+#endif
+  }
+
+  static void free_dma_buffer(uint8_t * buffer)
+  {
+#if defined(BELUGA_NATIVE)
+    free(buffer);
+#else
+    heap_caps_free(buffer);
+#endif
+  }
+
+  microsd_writer::~microsd_writer()
+  {
+    close();
   }
-  uint8_t cardType = SD_MMC.cardType();
-  if (cardType == CARD_NONE) {
-    Serial.println("No MicroSD Card found");
+
+  /*!
+  \brief Create (or overwrite) a file and preallocate its extent
+  @param backend a mounted filesystem, normally sd_mmc_backend.
+  @param preallocate_bytes extent to allocate now. Size it for the whole session; writing past it still works but
+  allocates clusters as it goes (counted in extent_overflows). 0 for no preallocation.
+  @param buffer_bytes the write chunk size, rounded up to a whole number of 512-byte sectors. 16-64 KiB suits SDMMC.
+  @param sync_interval_bytes how much may be written between directory/FAT updates.
+  \return False if the file or the buffer could not be created.
+  */
+  bool microsd_writer::begin(storage_backend & backend, const char * path, size_t preallocate_bytes, size_t buffer_bytes, size_t sync_interval_bytes)
+  {
+    close();
+    _buffer_size = ((buffer_bytes + microsd_sector_size - 1) / microsd_sector_size) * microsd_sector_size;
+    if(_buffer_size == 0)
+    {
+      _buffer_size = microsd_sector_size;
+    }
+    _buffer = allocate_dma_buffer(_buffer_size);
+    if(_buffer == nullptr)
+    {
+      BELUGA_LOG_ERROR("microsd_writer: could not allocate a %u byte DMA buffer", (unsigned) _buffer_size);
+      return false;
+    }
+    _file = backend.open(path, FILE_WRITE);
+    if(!_file)
+    {
+      BELUGA_LOG_ERROR("microsd_writer: could not open %s", path);
+      free_dma_buffer(_buffer);
+      _buffer = nullptr;
+      return false;
+    }
+    _preallocated = 0;
+    if(preallocate_bytes > 0)
+    {
+      //Seeking past the end and writing one byte makes FAT allocate the whole cluster chain now
+      if(_file.seek(preallocate_bytes - 1) && _file.write((uint8_t) 0) == 1)
+      {
+        _file.flush();
+        _preallocated = preallocate_bytes;
+      }else{
+        BELUGA_LOG_WARN("microsd_writer: could not preallocate %lu bytes", (unsigned long) preallocate_bytes);
+      }
+      _file.seek(0);
+    }
+    _buffer_used = 0;
+    _file_position = 0;
+    _unsynced_bytes = 0;
+    _sync_interval_bytes = sync_interval_bytes;
+    _failed = false;
+    _wrote_records = false;
+    _stats.bytes_written = 0;
+    _stats.chunk_writes = 0;
+    _stats.syncs = 0;
+    _stats.extent_overflows = 0;
+    _stats.elapsed_us = 0;
+    _stats.write_latency.reset();
+    _start_us = monotonic_time_us();
+    return true;
+  }
+
+  /*!
+  \brief Write the first length bytes of the buffer to the card and keep the rest.
+  */
+  bool microsd_writer::write_chunk(size_t length)
+  {
+    if(length == 0)
+    {
+      return true;
+    }
+    uint64_t t0 = monotonic_time_us();
+    size_t n_written = _file.write(_buffer, length);
+    _stats.write_latency.record(monotonic_time_us() - t0);
+    _stats.chunk_writes++;
+    if(_file_position + length > _preallocated)
+    {
+      _stats.extent_overflows++;
+    }
+    if(n_written != length)
+    {
+      BELUGA_LOG_ERROR("microsd_writer: short write (%u of %u bytes), card full or removed?", (unsigned) n_written, (unsigned) length);
+      _failed = true;
+      return false;
+    }
+    _file_position += length;
+    _unsynced_bytes += length;
+    _buffer_used -= length;
+    if(_buffer_used > 0)
+    {
+      memmove(_buffer, _buffer + length, _buffer_used);
+    }
+    return true;
+  }
+
+  /*!
+  \brief Append bytes. Only copies into the buffer until a whole buffer is ready, then writes it.
+  \return False if a write to the card failed; the writer then refuses further data.
+  */
+  bool microsd_writer::write(const uint8_t * data, size_t length)
+  {
+    if(_buffer == nullptr || _failed)
+    {
+      return false;
+    }
+    _stats.bytes_written += length;
+    while(length > 0)
+    {
+      size_t n = _buffer_size - _buffer_used;
+      n = (length < n) ? length : n;
+      memcpy(_buffer + _buffer_used, data, n);
+      _buffer_used += n;
+      data += n;
+      length -= n;
+      if(_buffer_used == _buffer_size)
+      {
+        //Write up to the last sector boundary, so the chunk after a sync() lands back on alignment
+        size_t chunk = (size_t) (((_file_position + _buffer_used) / microsd_sector_size) * microsd_sector_size - _file_position);
+        if(!write_chunk(chunk))
+        {
+          return false;
+        }
+      }
+    }
+    if(_sync_interval_bytes > 0 && _unsynced_bytes >= _sync_interval_bytes)
+    {
+      _file.flush();
+      _stats.syncs++;
+      _unsynced_bytes = 0;
+    }
+    _stats.elapsed_us = monotonic_time_us() - _start_us;
+    return true;
+  }
+
+  /*!
+  \brief Append one record: a 16-byte header (magic, length, timestamp, reserved) then the data.
+  \details tools or a host script can walk the records until the end record that close() writes; the
+  preallocated space after it is not data.
+  */
+  bool microsd_writer::write_record(const uint8_t * data, size_t length, uint32_t timestamp_ms)
+  {
+    uint32_t header[4] = {microsd_record_magic, (uint32_t) length, timestamp_ms, 0};
+    _wrote_records = true;
+    return write((const uint8_t *) header, sizeof(header)) && write(data, length);
+  }
+
+  /*!
+  \brief Write everything buffered and update the directory entry and FAT, so it survives a power cut.
+  \details Leaves the file position off a sector boundary; the next full buffer is shortened to realign.
+  */
+  bool microsd_writer::sync()
+  {
+    if(_buffer == nullptr || _failed)
+    {
+      return false;
+    }
+    if(!write_chunk(_buffer_used))
+    {
+      return false;
+    }
+    _file.flush();
+    _stats.syncs++;
+    _unsynced_bytes = 0;
+    _stats.elapsed_us = monotonic_time_us() - _start_us;
+    return true;
+  }
+
+  /*!
+  \brief Write the end record (if records were written), sync, close the file and free the buffer.
+  \return False if anything could not be written.
+  */
+  bool microsd_writer::close()
+  {
+    if(_buffer == nullptr)
+    {
+      return true;
+    }
+    bool ok = !_failed;
+    if(ok && _wrote_records)
+    {
+      uint32_t header[4] = {microsd_record_magic, microsd_end_of_records, 0, 0};
+      ok = write((const uint8_t *) header, sizeof(header));
+    }
+    ok = ok && sync();
+    _file.close();
+    free_dma_buffer(_buffer);
+    _buffer = nullptr;
+    return ok;
+  }
+
+  /*!
+  \brief Print bytes written, sustained MB/s and chunk write latency (p50, p99, max) to Serial.
+  */
+  void microsd_writer::print_stats_to_serial() const
+  {
+    Serial.printf("microsd_writer: %llu bytes, %.2f MB/s sustained, %lu chunk writes (p50 %lu us, p99 %lu us, max %lu us), %lu syncs, %lu extent overflows\n",
+      (unsigned long long) _stats.bytes_written, _stats.sustained_mb_per_s(), (unsigned long) _stats.chunk_writes,
+      (unsigned long) _stats.write_latency.percentile(0.5f), (unsigned long) _stats.write_latency.percentile(0.99f),
+      (unsigned long) _stats.write_latency.max(), (unsigned long) _stats.syncs, (unsigned long) _stats.extent_overflows);
+  }
+
+bool microsd::initialise(bool mode_1bit) {
+  // Start the MicroSD card
+
+  BELUGA_LOG_INFO("Mounting MicroSD Card");
+  _backend = sd_mmc_backend(mode_1bit);
+  if (!_backend.begin()) {
+    BELUGA_LOG_ERROR("MicroSD Card Mount Failed (or no card found)");
     return false;
   }
   _microsd_found = true;
   return true;
- 
+
 }
 
 
@@ -30,36 +257,42 @@ bool microsd::get_status()
     return _microsd_found;
 }
 
-bool microsd::save_esp32_cam_image_to_microsd(std::string path_to_save, camera_fb_t  * fb)
+/*!
+\brief Save one buffer as its own file, written in sector-aligned chunks from a DMA-capable buffer.
+\details Still one file (so one directory entry and cluster allocation) per call. To stream frames at a high rate,
+keep a microsd_writer open and use write_record instead.
+*/
+bool microsd::save_to_microsd(const std::string & path_to_save, const uint8_t * data, size_t length)
 {
-  std::stringstream ss;
- // Save picture to microSD card
-  fs::FS &fs = SD_MMC;
-  File file = fs.open(path_to_save.c_str(), FILE_WRITE);
-  if (!file) {
-    ss << "Failed to open file " << path_to_save << " in write mode";
-    Serial.println(ss.str().c_str());
+  microsd_writer writer;
+  if(!writer.begin(_backend, path_to_save.c_str(), length))
+  {
+    BELUGA_LOG_ERROR("Failed to open file %s in write mode", path_to_save.c_str());
     return false;
   }
-  else {
-    file.write(fb->buf, fb->len); // payload (image), payload length
-    Serial.printf("Saved file to path: %s\n", path_to_save.c_str());
-  }
-  // Close the file
-    file.close();
+  bool ok = writer.write(data, length);
+  ok = writer.close() && ok;
+  BELUGA_LOG_DEBUG("Saved file to path: %s", path_to_save.c_str());
+  return ok;
+}
 
-    return true;
+#if defined(BELUGA_HAS_ESP_CAMERA)
+bool microsd::save_esp32_cam_image_to_microsd(std::string path_to_save, camera_fb_t  * fb)
+{
+  // Save picture to microSD card
+  return save_to_microsd(path_to_save, fb->buf, fb->len); // payload (image), payload length
 }
+#endif
 
 //Copied from https://randomnerdtutorials.com/esp32-microsd-card-arduino/
-bool readFile(const std::string path){
-  fs::FS &fs = SD_MMC;
+bool microsd::readFile(const std::string path){
+  fs::FS &fs = _backend.filesystem();
 
-  Serial.printf("Reading file: %s\n", path.c_str());
+  BELUGA_LOG_DEBUG("Reading file: %s", path.c_str());
 
   File file = fs.open(path.c_str(), FILE_READ); //ADded file_Read
   if(!file){
-    Serial.println("Failed to open file for reading");
+    BELUGA_LOG_ERROR("Failed to open file for reading");
     return false;
   }
 
@@ -75,5 +308,3 @@ bool readFile(const std::string path){
 }
 
 }
-
-#endif
\ No newline at end of file
@@ -1,39 +1,112 @@
-#if 0
 #pragma once
 
 // MicroSD Libraries
 
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
 #include "FS.h"
-#include "SD_MMC.h"
+#include "beluga_profile.h"
+#include "beluga_storage_backend.h"
+#if defined(__has_include)
+#if __has_include("esp_camera.h")
 #include "esp_camera.h" //For frame buffer save-to-pointer
-
-
-/*
-#define FILE_SIZE_MB 1
-#define FILE_SIZE (1000000UL*FILE_SIZE_MB)
-#define BUF_SIZE 100
-
-uint8_t buf[BUF_SIZE];
-*/
+#define BELUGA_HAS_ESP_CAMERA 1
+#endif
+#endif
 
 //Copying from https://dronebotworkshop.com/esp32-cam-microsd/
 
 namespace beluga_utils
 {
+    const size_t microsd_sector_size = 512;
+    const uint32_t microsd_record_magic = 0x4D524642; //"BFRM" little-endian: the start of every write_record() record
+
+    /*!
+    \brief Throughput and latency of one microsd_writer session.
+    \details write_latency holds the time of each chunk write to the card (not of write() calls that only copy into
+    the buffer), so max() is the worst stall a capture loop will see.
+    */
+    struct microsd_write_stats
+    {
+        uint64_t bytes_written;     //Bytes handed to write()/write_record(), headers included
+        uint32_t chunk_writes;      //Sector-aligned writes to the card
+        uint32_t syncs;             //Directory/FAT updates (flush to the card)
+        uint32_t extent_overflows;  //Chunks written past the preallocated extent (the file grew cluster by cluster)
+        uint64_t elapsed_us;        //From begin() to the last write
+        latency_histogram write_latency;
+        float sustained_mb_per_s() const { return elapsed_us ? (float) bytes_written / (float) elapsed_us : 0.0f; }
+    };
+
+    /*!
+    \brief Buffered, sector-aligned, preallocated writer for streaming data (camera frames, logs) to a microSD card
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details One-file-per-frame with one unbuffered write each is slow because every frame allocates clusters,
+    rewrites the FAT and the directory entry, and the SDMMC driver bounces non-DMA (e.g. PSRAM) data through a
+    512-byte buffer one sector at a time. This writer instead:
+    - preallocates the file's extent once in begin(), so later writes do not allocate clusters
+    - copies data into one reusable DMA-capable buffer and writes it out in multi-sector chunks, always at
+      512-byte-aligned file offsets
+    - only updates the directory entry and FAT (a sync) every sync_interval_bytes, on sync() and on close()
+    The file is left at its preallocated size; use write_record() so a reader knows where the data ends (close()
+    writes an end record). Data written after the last sync can be lost on power failure.
+    On the host the "card" is a POSIX file (see the native SD_MMC stand-in).
+    Usage:
+    beluga_utils::sd_mmc_backend sd_card(true);
+    beluga_utils::microsd_writer writer;
+    writer.begin(sd_card, "/frames_0001.bin", 64UL * 1024 * 1024);
+    writer.write_record(fb->buf, fb->len, millis());
+    writer.close();
+    */
+    class microsd_writer
+    {
+        public:
+            microsd_writer(){};
+            ~microsd_writer();
+            bool begin(storage_backend & backend, const char * path, size_t preallocate_bytes, size_t buffer_bytes = 32 * 1024, size_t sync_interval_bytes = 4 * 1024 * 1024);
+            bool write(const uint8_t * data, size_t length);
+            bool write_record(const uint8_t * data, size_t length, uint32_t timestamp_ms);
+            bool sync();
+            bool close();
+            bool is_open() const { return _buffer != nullptr; }
+            const microsd_write_stats & get_stats() const { return _stats; }
+            void print_stats_to_serial() const;
+
+        protected:
+            microsd_writer(const microsd_writer &);
+            microsd_writer & operator=(const microsd_writer &);
+            bool write_chunk(size_t length);
+            File _file;
+            uint8_t * _buffer = nullptr;
+            size_t _buffer_size = 0;
+            size_t _buffer_used = 0;
+            uint64_t _file_position = 0;    //Bytes written to the card so far
+            uint64_t _preallocated = 0;
+            uint64_t _unsynced_bytes = 0;
+            size_t _sync_interval_bytes = 0;
+            uint64_t _start_us = 0;
+            bool _failed = false;
+            bool _wrote_records = false;
+            microsd_write_stats _stats;
+    };
+
     class microsd
     {
         public:
             microsd(){};
-            bool initialise();
+            bool initialise(bool mode_1bit = false);
             bool get_status();
             bool readFile(const std::string path);
+            bool save_to_microsd(const std::string & path_to_save, const uint8_t * data, size_t length);
+#if defined(BELUGA_HAS_ESP_CAMERA)
             bool save_esp32_cam_image_to_microsd(std::string path_to_save, camera_fb_t  * fb);
+#endif
+            storage_backend & get_storage_backend() { return _backend; }
 
         private:
-
+            sd_mmc_backend _backend;
             bool _microsd_found = false;
 
     };
 }
-
-#endif
\ No newline at end of file
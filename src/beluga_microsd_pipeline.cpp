@@ -0,0 +1,637 @@
+#include "beluga_microsd_pipeline.h"
+#include "beluga_debug.h"
+#include <Arduino.h>
+#include <string.h>
+#include <stdlib.h>
+#include <new>
+#if defined(BELUGA_NATIVE)
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#endif
+
+namespace beluga_utils
+{
+    const unsigned long pipeline_idle_wait_ms = 10; //Longest a stage sleeps without a wake, so stop flags are seen
+
+    frame_index_queue::~frame_index_queue()
+    {
+        end();
+    }
+
+    /*!
+    \brief Allocate the slots.
+    @param n_slots rounded up to a power of two (minimum 2).
+    */
+    bool frame_index_queue::begin(size_t n_slots)
+    {
+        end();
+        size_t n = 2;
+        while(n < n_slots)
+        {
+            n <<= 1;
+        }
+        _slots = new (std::nothrow) slot[n];
+        if(_slots == nullptr)
+        {
+            return false;
+        }
+        for(size_t i = 0; i < n; i++)
+        {
+            _slots[i].sequence.store((uint32_t) i, std::memory_order_relaxed);
+        }
+        _mask = (uint32_t) (n - 1);
+        _enqueue_pos.store(0, std::memory_order_relaxed);
+        _dequeue_pos.store(0, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+    \brief Free the slots. Nothing may be using the queue.
+    */
+    void frame_index_queue::end()
+    {
+        delete[] _slots;
+        _slots = nullptr;
+        _mask = 0;
+    }
+
+    /*!
+    \return False if the queue is full.
+    */
+    bool frame_index_queue::try_push(uint32_t value)
+    {
+        if(_slots == nullptr)
+        {
+            return false;
+        }
+        uint32_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        while(true)
+        {
+            slot & this_slot = _slots[pos & _mask];
+            int32_t dif = (int32_t) (this_slot.sequence.load(std::memory_order_acquire) - pos);
+            if(dif == 0)
+            {
+                if(_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    this_slot.value = value;
+                    this_slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if(dif < 0){
+                return false;
+            }else{
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*!
+    \return False if the queue is empty.
+    */
+    bool frame_index_queue::try_pop(uint32_t * value)
+    {
+        if(_slots == nullptr)
+        {
+            return false;
+        }
+        uint32_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        while(true)
+        {
+            slot & this_slot = _slots[pos & _mask];
+            int32_t dif = (int32_t) (this_slot.sequence.load(std::memory_order_acquire) - (pos + 1));
+            if(dif == 0)
+            {
+                if(_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    *value = this_slot.value;
+                    this_slot.sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }else if(dif < 0){
+                return false;
+            }else{
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*!
+    \brief Entries queued; only a snapshot while other tasks push and pop.
+    */
+    size_t frame_index_queue::size() const
+    {
+        uint32_t dequeued = _dequeue_pos.load(std::memory_order_acquire);
+        uint32_t enqueued = _enqueue_pos.load(std::memory_order_acquire);
+        int32_t n = (int32_t) (enqueued - dequeued);
+        return (n > 0) ? (size_t) n : 0;
+    }
+
+    /*!
+    \brief Sleep until the next frame slot at frames_per_s. A caller that is late waits for the following slot
+    and the missed frames are lost, as with esp_camera's default grab mode (CAMERA_GRAB_WHEN_EMPTY).
+    */
+    void synthetic_frame_source::wait_for_next_frame()
+    {
+        if(_frames_per_s <= 0.0f)
+        {
+            return;
+        }
+        uint64_t period_us = (uint64_t) (1e6f / _frames_per_s);
+        uint64_t now_us = monotonic_time_us();
+        if(_next_frame_us == 0)
+        {
+            _next_frame_us = now_us;
+        }else if(now_us > _next_frame_us){
+            _next_frame_us += ((now_us - _next_frame_us + period_us - 1) / period_us) * period_us;
+        }
+        if(_next_frame_us > now_us)
+        {
+            uint64_t wait_us = _next_frame_us - now_us;
+            if(wait_us >= 1000)
+            {
+                delay((unsigned long) (wait_us / 1000));
+            }
+            now_us = monotonic_time_us();
+            if(_next_frame_us > now_us)
+            {
+                delayMicroseconds((unsigned int) (_next_frame_us - now_us));
+            }
+        }
+        _next_frame_us += period_us;
+    }
+
+    /*!
+    \brief Fill the frame with a byte pattern; the first four bytes hold the sequence number.
+    */
+    bool synthetic_frame_source::capture(frame_buffer * frame)
+    {
+        wait_for_next_frame();
+        size_t length = (_frame_bytes < frame->capacity) ? _frame_bytes : frame->capacity;
+        memset(frame->data, (int) (_sequence & 0xFF), length);
+        if(length >= sizeof(_sequence))
+        {
+            memcpy(frame->data, &_sequence, sizeof(_sequence));
+        }
+        frame->length = length;
+        frame->sequence = _sequence++;
+        frame->timestamp_ms = (uint32_t) millis();
+        return true;
+    }
+
+    void synthetic_frame_source::skip()
+    {
+        wait_for_next_frame();
+        _sequence++;
+    }
+
+#if defined(BELUGA_HAS_ESP_CAMERA)
+    /*!
+    \return False if the camera gave no frame or it does not fit the pool buffer (raise frame_bytes).
+    */
+    bool esp_camera_frame_source::capture(frame_buffer * frame)
+    {
+        camera_fb_t * fb = esp_camera_fb_get();
+        if(fb == nullptr)
+        {
+            return false;
+        }
+        bool fits = (fb->len <= frame->capacity);
+        if(fits)
+        {
+            memcpy(frame->data, fb->buf, fb->len);
+            frame->length = fb->len;
+        }else{
+            BELUGA_LOG_WARN("esp_camera_frame_source: %u byte frame does not fit a %u byte buffer", (unsigned) fb->len, (unsigned) frame->capacity);
+        }
+        esp_camera_fb_return(fb);
+        frame->sequence = _sequence++;
+        frame->timestamp_ms = (uint32_t) millis();
+        return fits;
+    }
+
+    void esp_camera_frame_source::skip()
+    {
+        camera_fb_t * fb = esp_camera_fb_get();
+        if(fb != nullptr)
+        {
+            esp_camera_fb_return(fb);
+        }
+        _sequence++;
+    }
+#endif
+
+    /*!
+    \brief A stage's task, and how other stages wake it.
+    */
+    struct capture_pipeline::stage_task
+    {
+        capture_pipeline * pipeline;
+        void (capture_pipeline::*body)();
+#if defined(BELUGA_NATIVE)
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake_up;
+        bool signalled = false;
+
+        void notify()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            signalled = true;
+            wake_up.notify_one();
+        }
+
+        void wait(unsigned long timeout_ms)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_up.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return signalled; });
+            signalled = false;
+        }
+#else
+        TaskHandle_t handle = nullptr;
+        std::atomic<bool> stopped{true};
+
+        void notify()
+        {
+            if(handle != nullptr)
+            {
+                xTaskNotifyGive(handle);
+            }
+        }
+
+        void wait(unsigned long timeout_ms)
+        {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+        }
+#endif
+    };
+
+    capture_pipeline::~capture_pipeline()
+    {
+        end();
+    }
+
+    /*!
+    \brief Allocate the frame pool and queues and start the stage tasks.
+    @param source used only by the capture task until end().
+    @param writer open; used only by the storage task until end().
+    @param process optional processing stage. Without it no process task is created.
+    \return False if memory or a task could not be had; nothing is left running.
+    */
+    bool capture_pipeline::begin(const capture_pipeline_config & config, frame_source & source, microsd_writer & writer, frame_process_callback process, void * process_context)
+    {
+        end();
+        _config = config;
+        if(_config.n_frames == 0 || _config.frame_bytes == 0)
+        {
+            return false;
+        }
+        _source = &source;
+        _writer = &writer;
+        _process = process;
+        _process_context = process_context;
+        size_t pool_bytes = _config.n_frames * _config.frame_bytes;
+#if defined(BELUGA_NATIVE)
+        _pool_memory = (uint8_t *) malloc(pool_bytes);
+#else
+        _pool_memory = (uint8_t *) heap_caps_malloc(pool_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if(_pool_memory == nullptr)
+        {
+            _pool_memory = (uint8_t *) heap_caps_malloc(pool_bytes, MALLOC_CAP_8BIT);
+        }
+#endif
+        _frames = new (std::nothrow) frame_buffer[_config.n_frames];
+        if(_pool_memory == nullptr || _frames == nullptr
+            || !_free.begin(_config.n_frames) || !_to_process.begin(_config.n_frames) || !_to_store.begin(_config.n_frames))
+        {
+            BELUGA_LOG_ERROR("capture_pipeline: could not allocate %u frames of %u bytes", (unsigned) _config.n_frames, (unsigned) _config.frame_bytes);
+            free_pool();
+            return false;
+        }
+        for(size_t i = 0; i < _config.n_frames; i++)
+        {
+            frame_buffer & frame = _frames[i];
+            frame.data = _pool_memory + i * _config.frame_bytes;
+            frame.capacity = _config.frame_bytes;
+            frame.length = 0;
+            frame.sequence = 0;
+            frame.timestamp_ms = 0;
+            frame.capture_us = 0;
+            _free.try_push((uint32_t) i);
+        }
+        _stats = capture_pipeline_stats();
+        _stop_capture.store(false, std::memory_order_relaxed);
+        _capture_done.store(false, std::memory_order_relaxed);
+        _process_done.store(false, std::memory_order_relaxed);
+        _start_us = monotonic_time_us();
+
+        _capture_task = new stage_task();
+        _capture_task->body = &capture_pipeline::capture_stage;
+        _process_task = (_process != nullptr) ? new stage_task() : nullptr;
+        if(_process_task != nullptr)
+        {
+            _process_task->body = &capture_pipeline::process_stage;
+        }
+        _storage_task = new stage_task();
+        _storage_task->body = &capture_pipeline::storage_stage;
+        //Downstream first, so a stage is running before anything is queued for it
+        bool ok = start_stage(_storage_task, "pipeline_store", _config.storage_core, _config.storage_priority);
+        if(ok && _process_task != nullptr)
+        {
+            ok = start_stage(_process_task, "pipeline_process", _config.process_core, _config.process_priority);
+        }
+        if(ok)
+        {
+            ok = start_stage(_capture_task, "pipeline_capture", _config.capture_core, _config.capture_priority);
+        }
+        _running = true;
+        if(!ok)
+        {
+            BELUGA_LOG_ERROR("capture_pipeline: could not start the stage tasks");
+            end();
+            return false;
+        }
+        return true;
+    }
+
+    /*!
+    \brief Stop capturing, store every frame already captured, stop the tasks and free the pool.
+    */
+    void capture_pipeline::end()
+    {
+        if(!_running)
+        {
+            return;
+        }
+        _stop_capture.store(true, std::memory_order_release);
+        join_stage(_capture_task);
+        //Already set by a stage that ran; set here too so the next stage drains and exits if one never started
+        _capture_done.store(true, std::memory_order_release);
+        join_stage(_process_task);
+        _process_done.store(true, std::memory_order_release);
+        join_stage(_storage_task);
+        delete _capture_task;
+        delete _process_task;
+        delete _storage_task;
+        _capture_task = nullptr;
+        _process_task = nullptr;
+        _storage_task = nullptr;
+        _stats.elapsed_us = monotonic_time_us() - _start_us;
+        free_pool();
+        _running = false;
+    }
+
+    void capture_pipeline::free_pool()
+    {
+        _free.end();
+        _to_process.end();
+        _to_store.end();
+        delete[] _frames;
+        _frames = nullptr;
+#if defined(BELUGA_NATIVE)
+        free(_pool_memory);
+#else
+        heap_caps_free(_pool_memory);
+#endif
+        _pool_memory = nullptr;
+    }
+
+    /*!
+    \brief Frames captured and not yet stored (or dropped).
+    */
+    size_t capture_pipeline::frames_in_flight() const
+    {
+        return _running ? _config.n_frames - _free.size() : 0;
+    }
+
+    void capture_pipeline::run_stage(void * stage)
+    {
+        stage_task * self = (stage_task *) stage;
+        (self->pipeline->*(self->body))();
+#if !defined(BELUGA_NATIVE)
+        self->stopped.store(true, std::memory_order_release);
+        vTaskDelete(nullptr);
+#endif
+    }
+
+    bool capture_pipeline::start_stage(stage_task * stage, const char * name, int core, unsigned int priority)
+    {
+        stage->pipeline = this;
+#if defined(BELUGA_NATIVE)
+        stage->thread = std::thread(run_stage, stage);
+        return true;
+#else
+        BaseType_t core_id = (core >= 0 && core < portNUM_PROCESSORS) ? (BaseType_t) core : tskNO_AFFINITY;
+        stage->stopped.store(false, std::memory_order_release);
+        if(xTaskCreatePinnedToCore(run_stage, name, _config.stack_size, stage, priority, &stage->handle, core_id) != pdPASS)
+        {
+            stage->handle = nullptr;
+            stage->stopped.store(true, std::memory_order_release);
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    void capture_pipeline::join_stage(stage_task * stage)
+    {
+        if(stage == nullptr)
+        {
+            return;
+        }
+#if defined(BELUGA_NATIVE)
+        if(stage->thread.joinable())
+        {
+            stage->notify();
+            stage->thread.join();
+        }
+#else
+        while(!stage->stopped.load(std::memory_order_acquire))
+        {
+            stage->notify();
+            delay(1);
+        }
+        stage->handle = nullptr;
+#endif
+    }
+
+    void capture_pipeline::wake(stage_task * stage)
+    {
+        if(stage != nullptr)
+        {
+            stage->notify();
+        }
+    }
+
+    /*!
+    \brief Get a buffer for the next frame, applying the full policy when the pool is empty.
+    \return False if there is none this time round (the capture loop checks for stop and tries again).
+    */
+    bool capture_pipeline::take_free_frame(uint32_t * index)
+    {
+        if(_free.try_pop(index))
+        {
+            return true;
+        }
+        _stats.capture.waits++;
+        switch(_config.policy)
+        {
+            case pipeline_full_policy::drop_oldest:
+                //Frames waiting for storage are older than those waiting for processing
+                if(_to_store.try_pop(index) || _to_process.try_pop(index))
+                {
+                    _stats.capture.dropped++;
+                    return true;
+                }
+                //Every buffer is being processed or written: nothing queued to give up, so lose the new frame
+                _source->skip();
+                _stats.capture.dropped++;
+                return false;
+            case pipeline_full_policy::drop_newest:
+                _source->skip();
+                _stats.capture.dropped++;
+                return false;
+            default:
+                _capture_task->wait(pipeline_idle_wait_ms);
+                return false;
+        }
+    }
+
+    /*!
+    \brief Pop the next frame for a stage, sleeping while its input is empty.
+    \return False once the stage before has finished and the input is drained: the stage should exit.
+    */
+    bool capture_pipeline::wait_for_input(frame_index_queue & input, const std::atomic<bool> & upstream_done, stage_task * self, pipeline_stage_stats * stats, uint32_t * index)
+    {
+        while(true)
+        {
+            if(input.try_pop(index))
+            {
+                return true;
+            }
+            if(upstream_done.load(std::memory_order_acquire))
+            {
+                return input.try_pop(index); //Anything pushed before done was set is visible now
+            }
+            stats->waits++;
+            self->wait(pipeline_idle_wait_ms);
+        }
+    }
+
+    void capture_pipeline::capture_stage()
+    {
+        frame_index_queue & output = (_process != nullptr) ? _to_process : _to_store;
+        stage_task * next = (_process != nullptr) ? _process_task : _storage_task;
+        while(!_stop_capture.load(std::memory_order_acquire))
+        {
+            uint32_t index;
+            if(!take_free_frame(&index))
+            {
+                continue;
+            }
+            frame_buffer & frame = _frames[index];
+            uint64_t t0 = monotonic_time_us();
+            bool captured = _source->capture(&frame);
+            uint64_t t1 = monotonic_time_us();
+            _stats.capture.latency.record(t1 - t0);
+            _stats.capture.busy_us += t1 - t0;
+            if(!captured)
+            {
+                _stats.capture.dropped++;
+                _free.try_push(index);
+                continue;
+            }
+            frame.capture_us = t1;
+            _stats.capture.frames++;
+            output.try_push(index); //As large as the pool, so never full
+            wake(next);
+        }
+        _capture_done.store(true, std::memory_order_release);
+        wake(next);
+    }
+
+    void capture_pipeline::process_stage()
+    {
+        uint32_t index;
+        while(wait_for_input(_to_process, _capture_done, _process_task, &_stats.process, &index))
+        {
+            frame_buffer & frame = _frames[index];
+            uint64_t t0 = monotonic_time_us();
+            bool keep = _process(_process_context, &frame);
+            uint64_t dt = monotonic_time_us() - t0;
+            _stats.process.latency.record(dt);
+            _stats.process.busy_us += dt;
+            if(keep)
+            {
+                _stats.process.frames++;
+                _to_store.try_push(index);
+                wake(_storage_task);
+            }else{
+                _stats.process.dropped++;
+                _free.try_push(index);
+                wake(_capture_task);
+            }
+        }
+        _process_done.store(true, std::memory_order_release);
+        wake(_storage_task);
+    }
+
+    void capture_pipeline::storage_stage()
+    {
+        const std::atomic<bool> & upstream_done = (_process != nullptr) ? _process_done : _capture_done;
+        uint32_t index;
+        while(wait_for_input(_to_store, upstream_done, _storage_task, &_stats.storage, &index))
+        {
+            frame_buffer & frame = _frames[index];
+            uint64_t t0 = monotonic_time_us();
+            bool stored = !_stats.storage_failed && _writer->write_record(frame.data, frame.length, frame.timestamp_ms);
+            uint64_t t1 = monotonic_time_us();
+            _stats.storage.latency.record(t1 - t0);
+            _stats.storage.busy_us += t1 - t0;
+            if(stored)
+            {
+                _stats.storage.frames++;
+                _stats.bytes_stored += frame.length;
+                _stats.end_to_end.record(t1 - frame.capture_us);
+            }else{
+                if(!_stats.storage_failed)
+                {
+                    BELUGA_LOG_ERROR("capture_pipeline: storage failed, frames are now dropped");
+                }
+                _stats.storage_failed = true;
+                _stats.storage.dropped++;
+            }
+            _free.try_push(index);
+            wake(_capture_task);
+        }
+    }
+
+    static void print_stage_stats(const char * name, const pipeline_stage_stats & stats, uint64_t elapsed_us)
+    {
+        Serial.printf("%s: %lu frames (%.1f fps), %lu dropped, %lu waits, busy %.0f%%, p50 %lu us, p99 %lu us, max %lu us\n",
+            name, (unsigned long) stats.frames, stats.frames_per_s(elapsed_us), (unsigned long) stats.dropped, (unsigned long) stats.waits,
+            elapsed_us ? 100.0 * (double) stats.busy_us / (double) elapsed_us : 0.0,
+            (unsigned long) stats.latency.percentile(0.5f), (unsigned long) stats.latency.percentile(0.99f), (unsigned long) stats.latency.max());
+    }
+
+    /*!
+    \brief Print each stage's throughput, drops and latency, and the end-to-end latency, to Serial. After end().
+    */
+    void capture_pipeline::print_stats_to_serial() const
+    {
+        print_stage_stats("capture", _stats.capture, _stats.elapsed_us);
+        if(_process != nullptr)
+        {
+            print_stage_stats("process", _stats.process, _stats.elapsed_us);
+        }
+        print_stage_stats("storage", _stats.storage, _stats.elapsed_us);
+        Serial.printf("end to end: p50 %lu us, p99 %lu us, max %lu us, %llu bytes stored%s\n",
+            (unsigned long) _stats.end_to_end.percentile(0.5f), (unsigned long) _stats.end_to_end.percentile(0.99f),
+            (unsigned long) _stats.end_to_end.max(), (unsigned long long) _stats.bytes_stored, _stats.storage_failed ? ", storage failed" : "");
+    }
+}
@@ -0,0 +1,235 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "beluga_profile.h"
+#include "beluga_microsd.h"
+
+namespace beluga_utils
+{
+    /*!
+    \brief One buffer of the capture pipeline's frame pool.
+    */
+    struct frame_buffer
+    {
+        uint8_t * data;         //capacity bytes, owned by the pool
+        size_t capacity;
+        size_t length;          //Bytes used by the current frame
+        uint32_t sequence;      //Set by the frame source; gaps show frames the pipeline dropped
+        uint32_t timestamp_ms;  //millis() at capture, stored in the record header
+        uint64_t capture_us;    //monotonic_time_us() at capture, for end-to-end latency
+    };
+
+    /*!
+    \brief Bounded, lock-free, multi-producer multi-consumer queue of frame pool indices
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details The bounded queue of D. Vyukov, as log_ring, with one uint32_t per slot. Any task may push or pop, so a
+    producer applying drop-oldest can take back the oldest frame while the consumer is popping.
+    */
+    class frame_index_queue
+    {
+        public:
+            frame_index_queue(){};
+            ~frame_index_queue();
+            bool begin(size_t n_slots);
+            void end();
+            bool try_push(uint32_t value);
+            bool try_pop(uint32_t * value);
+            size_t capacity() const { return _mask + 1; }
+            size_t size() const;
+
+        protected:
+            frame_index_queue(const frame_index_queue &);
+            frame_index_queue & operator=(const frame_index_queue &);
+            struct slot
+            {
+                std::atomic<uint32_t> sequence;
+                uint32_t value;
+            };
+            slot * _slots = nullptr;
+            uint32_t _mask = 0;
+            std::atomic<uint32_t> _enqueue_pos{0};
+            std::atomic<uint32_t> _dequeue_pos{0};
+    };
+
+    /*!
+    \brief Where the capture stage gets frames from
+    \details capture() fills frame->data (up to frame->capacity), length, sequence and timestamp_ms, waiting for
+    the next frame if need be. skip() takes the next frame and throws it away, so a source that produces frames at
+    its own rate (a camera) is not stalled while the pipeline is dropping. Called from the capture task only.
+    */
+    class frame_source
+    {
+        public:
+            virtual ~frame_source(){};
+            virtual bool capture(frame_buffer * frame) = 0;
+            virtual void skip() = 0;
+    };
+
+    /*!
+    \brief Generated frames of a fixed size at a fixed rate, for load-testing the pipeline (and the card) without a
+    camera. The host build uses it in the benchmark.
+    @param frames_per_s 0 for as fast as the pipeline takes them.
+    */
+    class synthetic_frame_source : public frame_source
+    {
+        public:
+            synthetic_frame_source(size_t frame_bytes, float frames_per_s = 0.0f) : _frame_bytes(frame_bytes), _frames_per_s(frames_per_s) {};
+            bool capture(frame_buffer * frame);
+            void skip();
+
+        protected:
+            void wait_for_next_frame();
+            size_t _frame_bytes;
+            float _frames_per_s;
+            uint32_t _sequence = 0;
+            uint64_t _next_frame_us = 0;
+    };
+
+#if defined(BELUGA_HAS_ESP_CAMERA)
+    /*!
+    \brief Frames from esp_camera (already initialised). Each frame is copied into the pool and the camera's buffer
+    returned straight away, so the camera driver never waits on the SD card.
+    */
+    class esp_camera_frame_source : public frame_source
+    {
+        public:
+            esp_camera_frame_source(){};
+            bool capture(frame_buffer * frame);
+            void skip();
+
+        protected:
+            uint32_t _sequence = 0;
+    };
+#endif
+
+    enum class pipeline_full_policy
+    {
+        block = 0,      //Capture waits for a free buffer (backpressure: the source slows down or drops on its own)
+        drop_newest,    //Take the new frame and throw it away
+        drop_oldest     //Take back the oldest frame not yet stored and reuse its buffer
+    };
+
+    /*!
+    \brief Frame processing stage callback (compression, overlay, filtering). Runs on its own task.
+    May change frame->data and frame->length (up to frame->capacity).
+    \return False to drop the frame.
+    */
+    typedef bool (*frame_process_callback)(void * context, frame_buffer * frame);
+
+    struct capture_pipeline_config
+    {
+        size_t n_frames = 4;                    //Frame pool size; also bounds the frames in flight
+        size_t frame_bytes = 64 * 1024;         //Capacity of each pool buffer
+        pipeline_full_policy policy = pipeline_full_policy::block;
+        int capture_core = 1;                   //The Arduino loop core; the camera driver's DMA interrupt is on it too
+        int process_core = 1;
+        int storage_core = 0;                   //The SDMMC driver task and WiFi share core 0
+        unsigned int capture_priority = 5;
+        unsigned int process_priority = 4;
+        unsigned int storage_priority = 5;
+        uint32_t stack_size = 4096;
+    };
+
+    /*!
+    \brief Counters of one pipeline stage
+    \details frames left the stage; latency is the time the stage spent on each frame (capture includes waiting for
+    the source, storage the card write). Updated by the stage's own task: read them after end().
+    */
+    struct pipeline_stage_stats
+    {
+        uint32_t frames;
+        uint32_t dropped;
+        uint32_t waits;         //Times the stage found its input (or, for capture, the pool) empty
+        uint64_t busy_us;
+        latency_histogram latency;
+        float frames_per_s(uint64_t elapsed_us) const { return elapsed_us ? (float) frames * 1e6f / (float) elapsed_us : 0.0f; }
+    };
+
+    struct capture_pipeline_stats
+    {
+        pipeline_stage_stats capture;
+        pipeline_stage_stats process;
+        pipeline_stage_stats storage;
+        latency_histogram end_to_end;   //From capture to written into the microsd_writer
+        uint64_t elapsed_us;            //From begin() to the last stage finishing
+        uint64_t bytes_stored;
+        bool storage_failed;
+    };
+
+    /*!
+    \brief Camera capture, optional processing and SD card storage as separate tasks, linked by lock-free queues
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Capturing and saving in series on one task caps the frame rate at 1 / (capture + write). Here each stage
+    is its own FreeRTOS task pinned to a core (a std::thread on the host), so capture of frame n+1 overlaps the write
+    of frame n and the rate is set by the slowest stage alone.
+    - Frames live in a fixed pool allocated by begin() (PSRAM if there is any); nothing is allocated per frame.
+    - Pool indices flow capture -> process -> storage -> back to capture through frame_index_queues, each as large as
+      the pool, so pushes never fail and a full pipeline shows up as an empty free list.
+    - When capture finds no free buffer the policy decides: block (backpressure), drop_newest or drop_oldest.
+    - Storage appends each frame with microsd_writer::write_record; the writer must be open and is only touched by
+      the storage task until end().
+    end() stops capture, lets the other stages store what is queued, and joins the tasks. If the card fails, storage
+    keeps recycling frames (counted as dropped) so capture never deadlocks.
+    Usage:
+    beluga_utils::microsd_writer writer;
+    writer.begin(sd_card, "/frames.bin", 256UL * 1024 * 1024);
+    beluga_utils::esp_camera_frame_source camera;
+    beluga_utils::capture_pipeline pipeline;
+    beluga_utils::capture_pipeline_config config;
+    config.policy = beluga_utils::pipeline_full_policy::drop_oldest;
+    pipeline.begin(config, camera, writer);
+    ...
+    pipeline.end();
+    writer.close();
+    pipeline.print_stats_to_serial();
+    */
+    class capture_pipeline
+    {
+        public:
+            capture_pipeline(){};
+            ~capture_pipeline();
+            bool begin(const capture_pipeline_config & config, frame_source & source, microsd_writer & writer, frame_process_callback process = nullptr, void * process_context = nullptr);
+            void end();
+            bool is_running() const { return _running; }
+            size_t frames_in_flight() const;
+            const capture_pipeline_stats & get_stats() const { return _stats; }
+            void print_stats_to_serial() const;
+
+        protected:
+            struct stage_task;
+            capture_pipeline(const capture_pipeline &);
+            capture_pipeline & operator=(const capture_pipeline &);
+            void capture_stage();
+            void process_stage();
+            void storage_stage();
+            bool take_free_frame(uint32_t * index);
+            bool wait_for_input(frame_index_queue & input, const std::atomic<bool> & upstream_done, stage_task * self, pipeline_stage_stats * stats, uint32_t * index);
+            static void run_stage(void * stage);
+            bool start_stage(stage_task * stage, const char * name, int core, unsigned int priority);
+            void join_stage(stage_task * stage);
+            static void wake(stage_task * stage);
+            void free_pool();
+            capture_pipeline_config _config;
+            frame_source * _source = nullptr;
+            microsd_writer * _writer = nullptr;
+            frame_process_callback _process = nullptr;
+            void * _process_context = nullptr;
+            uint8_t * _pool_memory = nullptr;
+            frame_buffer * _frames = nullptr;
+            frame_index_queue _free;
+            frame_index_queue _to_process;
+            frame_index_queue _to_store;
+            stage_task * _capture_task = nullptr;
+            stage_task * _process_task = nullptr;
+            stage_task * _storage_task = nullptr;
+            std::atomic<bool> _stop_capture{false};
+            std::atomic<bool> _capture_done{false};
+            std::atomic<bool> _process_done{false};
+            bool _running = false;
+            uint64_t _start_us = 0;
+            capture_pipeline_stats _stats;
+    };
+}
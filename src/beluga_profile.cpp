@@ -0,0 +1,242 @@
+#include <Arduino.h>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include "beluga_profile.h"
+
+namespace beluga_utils
+{
+    static profile_region profile_regions[profile_max_regions];
+    static size_t profile_region_count = 0;
+    static std::mutex profile_regions_mutex;
+
+    void latency_histogram::reset()
+    {
+        memset(_buckets, 0, sizeof(_buckets));
+        _count = 0;
+        _min = UINT32_MAX;
+        _max = 0;
+        _sum = 0;
+        _running_mean = 0.0f;
+        _m2 = 0.0f;
+    }
+
+    /*!
+    \brief Bucket for a value: exact below 8, then 4 buckets per power of two.
+    */
+    size_t latency_histogram::bucket_index(uint32_t value_us)
+    {
+        if(value_us < 8)
+        {
+            return value_us;
+        }
+        size_t msb = 31 - __builtin_clz(value_us);
+        size_t sub = (value_us >> (msb - 2)) & 3;
+        return (msb - 1) * 4 + sub;
+    }
+
+    /*!
+    \brief Largest value that falls in a bucket.
+    */
+    uint32_t latency_histogram::bucket_upper_bound(size_t index)
+    {
+        if(index < 8)
+        {
+            return (uint32_t) index;
+        }
+        size_t msb = index / 4 + 1;
+        size_t sub = index % 4;
+        uint64_t lower = (uint64_t) (4 + sub) << (msb - 2);
+        uint64_t upper = lower + ((uint64_t) 1 << (msb - 2)) - 1;
+        return upper > UINT32_MAX ? UINT32_MAX : (uint32_t) upper;
+    }
+
+    /*!
+    \brief Add one sample. Values above 2^32 us (~71 minutes) are clamped.
+    \details Not thread safe: concurrent records into the same histogram from different tasks may lose a count.
+    */
+    void latency_histogram::record(uint64_t value_us)
+    {
+        uint32_t value = value_us > UINT32_MAX ? UINT32_MAX : (uint32_t) value_us;
+        _buckets[bucket_index(value)]++;
+        _count++;
+        _sum += value;
+        //Welford's update: stable in float, unlike a sum of squares
+        float delta = (float) value - _running_mean;
+        _running_mean += delta / (float) _count;
+        _m2 += delta * ((float) value - _running_mean);
+        if(value < _min)
+        {
+            _min = value;
+        }
+        if(value > _max)
+        {
+            _max = value;
+        }
+    }
+
+    float latency_histogram::mean() const
+    {
+        return _count ? (float) _sum / (float) _count : 0.0f;
+    }
+
+    /*!
+    \brief Standard deviation of the recorded values, in us.
+    */
+    float latency_histogram::jitter() const
+    {
+        if(_count < 2)
+        {
+            return 0.0f;
+        }
+        float variance = _m2 / (float) _count;
+        return variance > 0.0f ? sqrtf(variance) : 0.0f;
+    }
+
+    /*!
+    \brief Value below which the given fraction of samples fall, e.g. 0.99f for p99.
+    \return The upper bound of the bucket holding that sample, capped at max().
+    */
+    uint32_t latency_histogram::percentile(float fraction) const
+    {
+        if(_count == 0)
+        {
+            return 0;
+        }
+        uint32_t rank = (uint32_t) ceilf(fraction * (float) _count);
+        if(rank < 1)
+        {
+            rank = 1;
+        }
+        uint32_t seen = 0;
+        for(size_t i = 0; i < latency_histogram_buckets; i++)
+        {
+            seen += _buckets[i];
+            if(seen >= rank)
+            {
+                uint32_t upper = bucket_upper_bound(i);
+                return upper < _max ? upper : _max;
+            }
+        }
+        return _max;
+    }
+
+    /*!
+    \brief Find a named region, creating it on first use
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Regions live in a fixed table of profile_max_regions. Looked up once per call site by the
+    BELUGA_PROFILE_* macros, so the mutex and string compares are not on the timed path.
+    \return nullptr if the table is full.
+    */
+    profile_region * get_profile_region(const char * name)
+    {
+        std::lock_guard<std::mutex> lock(profile_regions_mutex);
+        for(size_t i = 0; i < profile_region_count; i++)
+        {
+            if(strcmp(profile_regions[i].name, name) == 0)
+            {
+                return &profile_regions[i];
+            }
+        }
+        if(profile_region_count >= profile_max_regions)
+        {
+            return nullptr;
+        }
+        profile_region * region = &profile_regions[profile_region_count++];
+        region->name = name;
+        region->histogram.reset();
+        region->last_mark_us = 0;
+        return region;
+    }
+
+    /*!
+    \brief Record the time since the previous mark (nothing on the first mark).
+    */
+    void profile_mark(profile_region * region)
+    {
+        if(region == nullptr)
+        {
+            return;
+        }
+        uint64_t now_us = monotonic_time_us();
+        if(region->last_mark_us != 0)
+        {
+            region->histogram.record(now_us - region->last_mark_us);
+        }
+        region->last_mark_us = now_us;
+    }
+
+    /*!
+    \brief Clear every region's samples. The regions themselves stay registered.
+    */
+    void reset_profile()
+    {
+        std::lock_guard<std::mutex> lock(profile_regions_mutex);
+        for(size_t i = 0; i < profile_region_count; i++)
+        {
+            profile_regions[i].histogram.reset();
+            profile_regions[i].last_mark_us = 0;
+        }
+    }
+
+    /*!
+    \brief One CSV line: name,count,min_us,p50_us,p99_us,max_us,mean_us,jitter_us
+    \return The length written (as snprintf).
+    */
+    size_t format_profile_region(const profile_region & region, char * buffer, size_t size)
+    {
+        const latency_histogram & h = region.histogram;
+        int n = snprintf(buffer, size, "%s,%lu,%lu,%lu,%lu,%lu,%.1f,%.1f\n", region.name, (unsigned long) h.count(),
+            (unsigned long) h.min(), (unsigned long) h.percentile(0.5f), (unsigned long) h.percentile(0.99f),
+            (unsigned long) h.max(), (double) h.mean(), (double) h.jitter());
+        if(n < 0)
+        {
+            return 0;
+        }
+        return ((size_t) n < size) ? (size_t) n : size - 1;
+    }
+
+    static const char * profile_header = "region,count,min_us,p50_us,p99_us,max_us,mean_us,jitter_us\n";
+
+    /*!
+    \brief Print every region as CSV, with a header line.
+    Usage: beluga_utils::print_profile_to_serial();
+    */
+    void print_profile_to_serial()
+    {
+        std::lock_guard<std::mutex> lock(profile_regions_mutex);
+        char line[128];
+        Serial.print(profile_header);
+        for(size_t i = 0; i < profile_region_count; i++)
+        {
+            format_profile_region(profile_regions[i], line, sizeof(line));
+            Serial.print(line);
+        }
+    }
+
+    /*!
+    \brief Write every region as CSV to a file (overwritten).
+    \return False if the file could not be opened.
+    Usage: beluga_utils::save_profile(SPIFFS, "/profile.csv");
+    */
+    bool save_profile(fs::FS & fs, const char * path)
+    {
+        File profile_file = fs.open(path, FILE_WRITE);
+        if(!profile_file)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(profile_regions_mutex);
+        char line[128];
+        profile_file.write((const uint8_t *) profile_header, strlen(profile_header));
+        for(size_t i = 0; i < profile_region_count; i++)
+        {
+            size_t n = format_profile_region(profile_regions[i], line, sizeof(line));
+            profile_file.write((const uint8_t *) line, n);
+        }
+        profile_file.close();
+        return true;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "FS.h"
+#include "beluga_arduino_time.h"
+
+namespace beluga_utils
+{
+    const size_t latency_histogram_buckets = 124; //4 per power of two, 0 us to 2^32 us
+    const size_t profile_max_regions = 32;
+
+    /*!
+    \brief Fixed-memory latency histogram with logarithmic buckets
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Values below 8 us get a bucket each; above that each power of two is split into 4 buckets, so a
+    percentile is reported to within 25% (and never above max). ~550 bytes, no allocation, record() is a few
+    integer operations plus a few float operations for the jitter.
+    Jitter is the standard deviation of the recorded values.
+    Usage:
+    latency_histogram h;
+    h.record(dt_us);
+    uint32_t p99_us = h.percentile(0.99f);
+    */
+    class latency_histogram
+    {
+        public:
+            latency_histogram() { reset(); }
+            void reset();
+            void record(uint64_t value_us);
+            uint32_t count() const { return _count; }
+            uint32_t min() const { return _count ? _min : 0; }
+            uint32_t max() const { return _max; }
+            float mean() const;
+            float jitter() const;
+            uint32_t percentile(float fraction) const;
+            static size_t bucket_index(uint32_t value_us);
+            static uint32_t bucket_upper_bound(size_t index);
+
+        protected:
+            uint32_t _buckets[latency_histogram_buckets];
+            uint32_t _count;
+            uint32_t _min;
+            uint32_t _max;
+            uint64_t _sum;
+            float _running_mean;
+            float _m2;
+    };
+
+    struct profile_region
+    {
+        const char * name; //Must outlive the region; normally a string literal
+        latency_histogram histogram;
+        uint64_t last_mark_us; //Used by profile_mark
+    };
+
+    profile_region * get_profile_region(const char * name);
+    void profile_mark(profile_region * region);
+    void reset_profile();
+    size_t format_profile_region(const profile_region & region, char * buffer, size_t size);
+    void print_profile_to_serial();
+    bool save_profile(fs::FS & fs, const char * path);
+
+    /*!
+    \brief RAII timer: records the time from construction to destruction into a histogram.
+    Usage: { beluga_utils::scoped_timer t(&my_histogram); ...work... }
+    */
+    class scoped_timer
+    {
+        public:
+            scoped_timer(latency_histogram * histogram) : _histogram(histogram), _start_us(monotonic_time_us()) {};
+            ~scoped_timer() { if(_histogram) { _histogram->record(monotonic_time_us() - _start_us); } }
+
+        protected:
+            scoped_timer(const scoped_timer &);
+            scoped_timer & operator=(const scoped_timer &);
+            latency_histogram * _histogram;
+            uint64_t _start_us;
+    };
+}
+
+#define BELUGA_PROFILE_CONCAT_INNER(a, b) a##b
+#define BELUGA_PROFILE_CONCAT(a, b) BELUGA_PROFILE_CONCAT_INNER(a, b)
+
+/*!
+\brief Time the rest of the enclosing scope into the named region. The region is looked up once per call site.
+Usage: void read_sensors() { BELUGA_PROFILE_SCOPE("read_sensors"); ... }
+*/
+#define BELUGA_PROFILE_SCOPE(name) \
+    static beluga_utils::profile_region * BELUGA_PROFILE_CONCAT(beluga_profile_region_, __LINE__) = beluga_utils::get_profile_region(name); \
+    beluga_utils::scoped_timer BELUGA_PROFILE_CONCAT(beluga_profile_timer_, __LINE__)(BELUGA_PROFILE_CONCAT(beluga_profile_region_, __LINE__) ? &BELUGA_PROFILE_CONCAT(beluga_profile_region_, __LINE__)->histogram : nullptr)
+
+/*!
+\brief Record the time since the previous mark of the named region, e.g. the loop() period.
+Usage: void loop() { BELUGA_PROFILE_MARK("loop"); ... }
+*/
+#define BELUGA_PROFILE_MARK(name) do { \
+    static beluga_utils::profile_region * beluga_profile_mark_region = beluga_utils::get_profile_region(name); \
+    beluga_utils::profile_mark(beluga_profile_mark_region); \
+    } while(0)
@@ -0,0 +1,486 @@
+#include <Arduino.h>
+#include <string.h>
+#include "beluga_scheduler.h"
+#include "beluga_arduino_time.h"
+#include "beluga_trace.h"
+
+namespace beluga_utils
+{
+    static const uint64_t scheduler_slot_mask = scheduler_wheel_slots - 1;
+    static const uint64_t scheduler_max_delta = (uint64_t) 1 << (scheduler_wheel_bits * scheduler_wheel_levels);
+
+    /*!
+    \brief Index of the first set bit at or after position start, wrapping around; the distance is returned.
+    */
+    static size_t next_set_bit_distance(uint64_t mask, size_t start)
+    {
+        uint64_t rotated = (start == 0) ? mask : ((mask >> start) | (mask << (scheduler_wheel_slots - start)));
+        return (size_t) __builtin_ctzll(rotated);
+    }
+
+    /*!
+    \brief Create an empty scheduler with room for max_tasks tasks. The clock starts now.
+    */
+    scheduler::scheduler(size_t max_tasks)
+    {
+        _tasks.resize(max_tasks);
+        _ready.reserve(max_tasks);
+        for(size_t i = 0; i < max_tasks; i++)
+        {
+            _tasks[i].active = false;
+            _tasks[i].next = (i + 1 < max_tasks) ? &_tasks[i + 1] : nullptr;
+        }
+        _free = max_tasks ? &_tasks[0] : nullptr;
+        memset(_wheel, 0, sizeof(_wheel));
+        memset(_occupied, 0, sizeof(_occupied));
+        _start_us = monotonic_time_us();
+    }
+
+    uint64_t scheduler::now_tick() const
+    {
+        return (monotonic_time_us() - _start_us) / scheduler_tick_us;
+    }
+
+    /*!
+    \brief Register a periodic task
+    @param period_ms time between releases. Deadlines are start + n * period, whatever the execution time.
+    @param priority tasks due at the same time run highest priority first.
+    @param first_delay_ms time to the first release; 0 means one period from now.
+    \return The task id, or -1 if max_tasks tasks are already registered (or period_ms is 0).
+    Usage: int id = sched.add_periodic("log_status", 1000, log_status, nullptr, 1);
+    */
+    int scheduler::add_periodic(const char * name, uint32_t period_ms, scheduler_callback callback, void * context, uint8_t priority, uint32_t first_delay_ms)
+    {
+        if(period_ms == 0)
+        {
+            return -1;
+        }
+        return add_task(name, period_ms, first_delay_ms ? first_delay_ms : period_ms, callback, context, priority);
+    }
+
+    /*!
+    \brief Register a task that runs once, delay_ms from now. Its id is released after it runs.
+    \return The task id, or -1 if max_tasks tasks are already registered.
+    */
+    int scheduler::add_one_shot(const char * name, uint32_t delay_ms, scheduler_callback callback, void * context, uint8_t priority)
+    {
+        return add_task(name, 0, delay_ms, callback, context, priority);
+    }
+
+    int scheduler::add_task(const char * name, uint32_t period_ms, uint32_t delay_ms, scheduler_callback callback, void * context, uint8_t priority)
+    {
+        if(_free == nullptr || callback == nullptr)
+        {
+            return -1;
+        }
+        task * t = _free;
+        _free = t->next;
+        memset(&t->stats, 0, sizeof(t->stats));
+        t->stats.execution_min_us = UINT32_MAX;
+        t->name = name;
+        t->callback = callback;
+        t->context = context;
+        t->period_ticks = period_ms * (1000 / scheduler_tick_us);
+        t->priority = priority;
+        t->active = true;
+        t->in_wheel = false;
+        //Count from the present, not from the last tick the wheel processed
+        uint64_t now = now_tick();
+        uint64_t base = (now > _current_tick) ? now : _current_tick;
+        t->expires = base + (delay_ms ? delay_ms * (1000 / scheduler_tick_us) : 1);
+        insert(t);
+        _task_count++;
+        return (int) (t - &_tasks[0]);
+    }
+
+    /*!
+    \brief Remove a task. Safe to call from inside a callback, including the task's own.
+    \return False if the id is not a registered task.
+    */
+    bool scheduler::cancel(int task_id)
+    {
+        if(task_id < 0 || (size_t) task_id >= _tasks.size() || !_tasks[task_id].active)
+        {
+            return false;
+        }
+        task * t = &_tasks[task_id];
+        if(t->in_wheel)
+        {
+            unlink(t);
+        }
+        release(t);
+        return true;
+    }
+
+    /*!
+    \brief Deactivate a task and return its slot to the free list.
+    \details During run_pending() the slot may still be in _ready, or be the task being dispatched, so it is held
+    on _released until run_pending() finishes; reusing it earlier would run the new task at once and link it into
+    the wheel twice.
+    */
+    void scheduler::release(task * t)
+    {
+        t->active = false;
+        _task_count--;
+        if(_dispatching)
+        {
+            t->next = _released;
+            _released = t;
+            return;
+        }
+        t->next = _free;
+        _free = t;
+    }
+
+    /*!
+    \brief File a task in the wheel by how far away its expiry is.
+    \details Level L holds expiries 64^L to 64^(L+1) ticks ahead, in the slot for bits [6L, 6L+6) of the expiry
+    tick. That slot is cascaded (its tasks re-filed one level down) when the wheel reaches the start of it.
+    Expiries beyond the top level go in the farthest top-level slot and are re-filed on each lap.
+    */
+    void scheduler::insert(task * t)
+    {
+        if(t->expires < _current_tick)
+        {
+            t->expires = _current_tick; //Only a cascade files a task for the current tick, just before it expires
+        }
+        uint64_t delta = t->expires - _current_tick;
+        size_t level = 0;
+        size_t slot;
+        if(delta >= scheduler_max_delta)
+        {
+            level = scheduler_wheel_levels - 1;
+            slot = (size_t) (((_current_tick >> (scheduler_wheel_bits * level)) + scheduler_slot_mask) & scheduler_slot_mask);
+        }else{
+            while(delta >= ((uint64_t) 1 << (scheduler_wheel_bits * (level + 1))))
+            {
+                level++;
+            }
+            slot = (size_t) ((t->expires >> (scheduler_wheel_bits * level)) & scheduler_slot_mask);
+        }
+        t->level = (uint8_t) level;
+        t->slot = (uint8_t) slot;
+        t->prev = nullptr;
+        t->next = _wheel[level][slot];
+        if(t->next)
+        {
+            t->next->prev = t;
+        }
+        _wheel[level][slot] = t;
+        _occupied[level] |= (uint64_t) 1 << slot;
+        t->in_wheel = true;
+    }
+
+    void scheduler::unlink(task * t)
+    {
+        if(t->prev)
+        {
+            t->prev->next = t->next;
+        }else{
+            _wheel[t->level][t->slot] = t->next;
+        }
+        if(t->next)
+        {
+            t->next->prev = t->prev;
+        }
+        if(_wheel[t->level][t->slot] == nullptr)
+        {
+            _occupied[t->level] &= ~((uint64_t) 1 << t->slot);
+        }
+        t->in_wheel = false;
+        t->prev = nullptr;
+        t->next = nullptr;
+    }
+
+    /*!
+    \brief Re-file every task in the current slot of a level; they land in lower levels.
+    */
+    void scheduler::cascade(size_t level)
+    {
+        size_t slot = (size_t) ((_current_tick >> (scheduler_wheel_bits * level)) & scheduler_slot_mask);
+        task * t = _wheel[level][slot];
+        _wheel[level][slot] = nullptr;
+        _occupied[level] &= ~((uint64_t) 1 << slot);
+        while(t)
+        {
+            task * next = t->next;
+            t->in_wheel = false;
+            insert(t);
+            t = next;
+        }
+    }
+
+    /*!
+    \brief Turn the wheel to tick, moving expired tasks to _ready.
+    \details Jumps straight to the next occupied level 0 slot or the next level 0 wrap (where higher levels
+    cascade), whichever is first, so the cost is per event and per 64 ticks, not per tick.
+    */
+    void scheduler::advance_to(uint64_t tick)
+    {
+        while(_current_tick < tick)
+        {
+            if((_occupied[0] | _occupied[1] | _occupied[2] | _occupied[3]) == 0)
+            {
+                _current_tick = tick;
+                break;
+            }
+            uint64_t step_to = ((_current_tick >> scheduler_wheel_bits) + 1) << scheduler_wheel_bits;
+            if(_occupied[0])
+            {
+                size_t distance = next_set_bit_distance(_occupied[0], (size_t) ((_current_tick + 1) & scheduler_slot_mask));
+                uint64_t event = _current_tick + 1 + distance;
+                if(event < step_to)
+                {
+                    step_to = event;
+                }
+            }
+            if(step_to > tick)
+            {
+                step_to = tick;
+            }
+            _current_tick = step_to;
+
+            if((_current_tick & scheduler_slot_mask) == 0)
+            {
+                //Highest level whose slot boundary this is, cascaded top down
+                size_t top = 1;
+                while(top + 1 < scheduler_wheel_levels && ((_current_tick >> (scheduler_wheel_bits * top)) & scheduler_slot_mask) == 0)
+                {
+                    top++;
+                }
+                for(size_t level = top; level >= 1; level--)
+                {
+                    cascade(level);
+                }
+            }
+
+            size_t slot = (size_t) (_current_tick & scheduler_slot_mask);
+            task * t = _wheel[0][slot];
+            while(t)
+            {
+                task * next = t->next;
+                if(t->expires <= _current_tick)
+                {
+                    unlink(t);
+                    _ready.push_back(t);
+                }
+                t = next;
+            }
+        }
+    }
+
+    /*!
+    \brief Tick of the next wheel event: an expiry in level 0, or the cascade of an occupied higher slot.
+    \details A cascade may only re-file tasks, so the result is never later than the next real deadline.
+    \return UINT64_MAX if there are no tasks.
+    */
+    uint64_t scheduler::next_event_tick() const
+    {
+        uint64_t best = UINT64_MAX;
+        if(_occupied[0])
+        {
+            best = _current_tick + 1 + next_set_bit_distance(_occupied[0], (size_t) ((_current_tick + 1) & scheduler_slot_mask));
+        }
+        for(size_t level = 1; level < scheduler_wheel_levels; level++)
+        {
+            if(_occupied[level] == 0)
+            {
+                continue;
+            }
+            size_t shift = scheduler_wheel_bits * level;
+            uint64_t position = _current_tick >> shift;
+            size_t distance = next_set_bit_distance(_occupied[level], (size_t) ((position + 1) & scheduler_slot_mask));
+            uint64_t event = (position + 1 + distance) << shift;
+            if(event < best)
+            {
+                best = event;
+            }
+        }
+        return best;
+    }
+
+    /*!
+    \brief Run one released task and work out its next release.
+    */
+    void scheduler::dispatch(task * t, uint64_t now_us)
+    {
+        uint64_t deadline_us = _start_us + t->expires * scheduler_tick_us;
+        uint64_t lateness_us = (now_us > deadline_us) ? now_us - deadline_us : 0;
+        {
+            BELUGA_TRACE_SCOPE(t->name ? t->name : "scheduler_task");
+            t->callback(t->context);
+        }
+        uint64_t end_us = monotonic_time_us();
+        uint32_t execution_us = (uint32_t) (end_us - now_us);
+
+        scheduler_task_stats & stats = t->stats;
+        stats.runs++;
+        stats.execution_total_us += execution_us;
+        stats.execution_min_us = (execution_us < stats.execution_min_us) ? execution_us : stats.execution_min_us;
+        stats.execution_max_us = (execution_us > stats.execution_max_us) ? execution_us : stats.execution_max_us;
+        if(lateness_us > stats.lateness_max_us)
+        {
+            stats.lateness_max_us = (uint32_t) lateness_us;
+        }
+        if(!t->active)
+        {
+            return; //Cancelled itself
+        }
+        if(t->period_ticks == 0)
+        {
+            release(t);
+            return;
+        }
+        if(execution_us > t->period_ticks * scheduler_tick_us)
+        {
+            stats.overruns++;
+        }
+        //Fixed rate: stay on the grid, skipping (and counting) any releases already in the past
+        uint64_t now = (end_us - _start_us) / scheduler_tick_us;
+        uint64_t next = t->expires + t->period_ticks;
+        if(next <= now)
+        {
+            uint64_t missed = (now - t->expires) / t->period_ticks;
+            stats.deadline_misses += (uint32_t) missed;
+            next = t->expires + (missed + 1) * t->period_ticks;
+        }
+        t->expires = next;
+        insert(t);
+    }
+
+    /*!
+    \brief Run every task whose deadline has passed, highest priority first.
+    \return The number of tasks run.
+    */
+    size_t scheduler::run_pending()
+    {
+        advance_to(now_tick());
+        if(_ready.empty())
+        {
+            return 0;
+        }
+        //Insertion sort: stable (earlier deadline first within a priority), and the list is short
+        for(size_t i = 1; i < _ready.size(); i++)
+        {
+            task * t = _ready[i];
+            size_t j = i;
+            while(j > 0 && _ready[j - 1]->priority < t->priority)
+            {
+                _ready[j] = _ready[j - 1];
+                j--;
+            }
+            _ready[j] = t;
+        }
+        size_t n_run = 0;
+        _dispatching = true;
+        for(size_t i = 0; i < _ready.size(); i++)
+        {
+            task * t = _ready[i];
+            if(!t->active)
+            {
+                continue; //Cancelled by an earlier callback
+            }
+            dispatch(t, monotonic_time_us());
+            n_run++;
+        }
+        _dispatching = false;
+        _ready.clear();
+        while(_released)
+        {
+            task * t = _released;
+            _released = t->next;
+            t->next = _free;
+            _free = t;
+        }
+        return n_run;
+    }
+
+    /*!
+    \brief Microseconds until the next wheel event (0 if one is due), or UINT64_MAX with no tasks.
+    */
+    uint64_t scheduler::time_to_next_deadline_us()
+    {
+        uint64_t event = next_event_tick();
+        if(event == UINT64_MAX)
+        {
+            return UINT64_MAX;
+        }
+        uint64_t event_us = _start_us + event * scheduler_tick_us;
+        uint64_t now_us = monotonic_time_us();
+        return (event_us > now_us) ? event_us - now_us : 0;
+    }
+
+    /*!
+    \brief Sleep until the next wheel event, or at most max_sleep_ms.
+    \details delay() yields to other FreeRTOS tasks for the whole milliseconds; the sub-millisecond remainder
+    is waited with delayMicroseconds.
+    */
+    void scheduler::sleep_until_next_deadline(uint32_t max_sleep_ms)
+    {
+        uint64_t wait_us = time_to_next_deadline_us();
+        uint64_t max_us = (uint64_t) max_sleep_ms * 1000;
+        if(wait_us > max_us)
+        {
+            wait_us = max_us;
+        }
+        if(wait_us >= 1000)
+        {
+            delay((unsigned long) (wait_us / 1000));
+        }
+        if(wait_us % 1000)
+        {
+            delayMicroseconds((unsigned int) (wait_us % 1000));
+        }
+    }
+
+    /*!
+    \brief run_pending then sleep_until_next_deadline: the whole body of loop().
+    \return The number of tasks run.
+    */
+    size_t scheduler::run_once(uint32_t max_sleep_ms)
+    {
+        size_t n_run = run_pending();
+        sleep_until_next_deadline(max_sleep_ms);
+        return n_run;
+    }
+
+    const scheduler_task_stats * scheduler::get_task_stats(int task_id) const
+    {
+        if(task_id < 0 || (size_t) task_id >= _tasks.size() || !_tasks[task_id].active)
+        {
+            return nullptr;
+        }
+        return &_tasks[task_id].stats;
+    }
+
+    const char * scheduler::get_task_name(int task_id) const
+    {
+        if(task_id < 0 || (size_t) task_id >= _tasks.size() || !_tasks[task_id].active)
+        {
+            return nullptr;
+        }
+        return _tasks[task_id].name;
+    }
+
+    /*!
+    \brief One CSV line per registered task: id,name,period_ms,runs,deadline_misses,overruns,exec min/mean/max, worst lateness
+    */
+    void scheduler::print_stats_to_serial() const
+    {
+        Serial.println("task,name,period_ms,runs,deadline_misses,overruns,exec_min_us,exec_mean_us,exec_max_us,lateness_max_us");
+        for(size_t i = 0; i < _tasks.size(); i++)
+        {
+            const task & t = _tasks[i];
+            if(!t.active)
+            {
+                continue;
+            }
+            const scheduler_task_stats & s = t.stats;
+            Serial.printf("%u,%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", (unsigned int) i, t.name ? t.name : "",
+                (unsigned long) (t.period_ticks * scheduler_tick_us / 1000), (unsigned long) s.runs,
+                (unsigned long) s.deadline_misses, (unsigned long) s.overruns,
+                (unsigned long) (s.runs ? s.execution_min_us : 0), (unsigned long) (s.runs ? s.execution_total_us / s.runs : 0),
+                (unsigned long) s.execution_max_us, (unsigned long) s.lateness_max_us);
+        }
+    }
+}
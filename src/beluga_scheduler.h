@@ -0,0 +1,101 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace beluga_utils
+{
+    typedef void (*scheduler_callback)(void * context);
+
+    const size_t scheduler_wheel_levels = 4;
+    const size_t scheduler_wheel_bits = 6;
+    const size_t scheduler_wheel_slots = 1 << scheduler_wheel_bits; //64: one occupancy bit per slot in a uint64_t
+    const uint32_t scheduler_tick_us = 1000;
+
+    struct scheduler_task_stats
+    {
+        uint32_t runs;
+        uint32_t deadline_misses;    //Releases skipped because the task started a whole period (or more) late
+        uint32_t overruns;           //Runs that took longer than the period
+        uint32_t lateness_max_us;    //Worst start time after the deadline
+        uint32_t execution_min_us;
+        uint32_t execution_max_us;
+        uint64_t execution_total_us;
+    };
+
+    /*!
+    \brief Cooperative fixed-rate scheduler on a hierarchical timer wheel
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Replaces a loop() full of calculate_time_dt_ms checks and delay() calls.
+    - Tasks are periodic (fixed rate: deadlines stay on the period grid, they do not drift with execution time)
+      or one-shot, with a priority that orders tasks due at the same time (higher first).
+    - Timers live in 4 wheels of 64 slots (1 ms, 64 ms, ~4 s, ~4.4 min per slot; ~4.7 h span; longer timers
+      are re-filed as the wheel turns). Insert and cancel are O(1) list operations; expiry visits only
+      occupied slots and wheel boundaries (found with a 64-bit occupancy mask), never every timer.
+    - sleep_until_next_deadline() sleeps until the next wheel event instead of polling.
+    - All task memory is allocated by the constructor. Callbacks run in the caller's task and may add or
+      cancel tasks. A task cancelled (or a one-shot finished) during run_pending() keeps its slot until
+      run_pending() returns, so a task added by a later callback never reuses a slot that is still queued to run.
+    Usage:
+    beluga_utils::scheduler sched(16);
+    void blink(void * context) { ... }
+    sched.add_periodic("blink", 500, blink);
+    void loop() { sched.run_once(); }
+    */
+    class scheduler
+    {
+        public:
+            scheduler(size_t max_tasks = 32);
+            int add_periodic(const char * name, uint32_t period_ms, scheduler_callback callback, void * context = nullptr, uint8_t priority = 0, uint32_t first_delay_ms = 0);
+            int add_one_shot(const char * name, uint32_t delay_ms, scheduler_callback callback, void * context = nullptr, uint8_t priority = 0);
+            bool cancel(int task_id);
+            size_t run_pending();
+            uint64_t time_to_next_deadline_us();
+            void sleep_until_next_deadline(uint32_t max_sleep_ms = 1000);
+            size_t run_once(uint32_t max_sleep_ms = 1000);
+            const scheduler_task_stats * get_task_stats(int task_id) const;
+            const char * get_task_name(int task_id) const;
+            size_t task_count() const { return _task_count; }
+            void print_stats_to_serial() const;
+
+        protected:
+            struct task
+            {
+                const char * name;
+                scheduler_callback callback;
+                void * context;
+                uint64_t expires;     //Absolute tick of the next release
+                uint32_t period_ticks; //0 for one-shot
+                uint8_t priority;
+                bool active;
+                bool in_wheel;
+                uint8_t level;
+                uint8_t slot;
+                task * prev;
+                task * next;
+                scheduler_task_stats stats;
+            };
+
+            int add_task(const char * name, uint32_t period_ms, uint32_t delay_ms, scheduler_callback callback, void * context, uint8_t priority);
+            void insert(task * t);
+            void unlink(task * t);
+            void cascade(size_t level);
+            void advance_to(uint64_t tick);
+            uint64_t next_event_tick() const;
+            uint64_t now_tick() const;
+            void release(task * t);
+            void dispatch(task * t, uint64_t now_us);
+
+            std::vector<task> _tasks;
+            std::vector<task *> _ready;
+            task * _free = nullptr;
+            task * _released = nullptr; //Released during run_pending(), returned to _free when it finishes
+            bool _dispatching = false;
+            task * _wheel[scheduler_wheel_levels][scheduler_wheel_slots];
+            uint64_t _occupied[scheduler_wheel_levels];
+            uint64_t _current_tick = 0;
+            uint64_t _start_us = 0;
+            size_t _task_count = 0;
+    };
+}
@@ -0,0 +1,158 @@
+#include "beluga_storage_backend.h"
+#include "beluga_debug.h"
+#include "SPIFFS.h"
+#include "LittleFS.h"
+#include <sys/stat.h>
+#if defined(BELUGA_NATIVE)
+#include "SD_MMC.h"
+#define BELUGA_HAS_SD_MMC 1
+#else
+#include "soc/soc_caps.h"
+#include "vfs_api.h"
+#if SOC_SDMMC_HOST_SUPPORTED
+#include "SD_MMC.h"
+#define BELUGA_HAS_SD_MMC 1
+#endif
+#endif
+
+namespace beluga_utils
+{
+    bool spiffs_backend::begin()
+    {
+        if(!_mounted)
+        {
+            _mounted = SPIFFS.begin(_format_on_fail);
+        }
+        return _mounted;
+    }
+
+    void spiffs_backend::end()
+    {
+        SPIFFS.end();
+        _mounted = false;
+    }
+
+    fs::FS & spiffs_backend::filesystem()
+    {
+        return SPIFFS;
+    }
+
+    bool littlefs_backend::begin()
+    {
+        if(!_mounted)
+        {
+            _mounted = LittleFS.begin(_format_on_fail, "/littlefs", 10, _partition_label);
+        }
+        return _mounted;
+    }
+
+    void littlefs_backend::end()
+    {
+        LittleFS.end();
+        _mounted = false;
+    }
+
+    fs::FS & littlefs_backend::filesystem()
+    {
+        return LittleFS;
+    }
+
+#if defined(BELUGA_HAS_SD_MMC)
+    bool sd_mmc_backend::begin()
+    {
+        if(!_mounted)
+        {
+            _mounted = SD_MMC.begin("/sdcard", _mode_1bit) && SD_MMC.cardType() != CARD_NONE;
+        }
+        return _mounted;
+    }
+
+    void sd_mmc_backend::end()
+    {
+        SD_MMC.end();
+        _mounted = false;
+    }
+
+    fs::FS & sd_mmc_backend::filesystem()
+    {
+        return SD_MMC;
+    }
+#else
+    //No SDMMC peripheral on this chip (e.g. ESP32-C3): never mounts
+    bool sd_mmc_backend::begin()
+    {
+        return false;
+    }
+
+    void sd_mmc_backend::end()
+    {
+    }
+
+    fs::FS & sd_mmc_backend::filesystem()
+    {
+        return SPIFFS;
+    }
+#endif
+
+#if !defined(BELUGA_NATIVE)
+    /*!
+    \brief fs::FS over POSIX calls at an ESP-IDF VFS mount point, the same VFSImpl that SPIFFSFS and LittleFSFS wrap.
+    */
+    class vfs_filesystem : public fs::FS
+    {
+        public:
+            vfs_filesystem(const char * mount_point) : fs::FS(fs::FSImplPtr(new VFSImpl())) { _impl->mountpoint(mount_point); }
+    };
+#endif
+
+    posix_backend::posix_backend(const char * root) : _root(root)
+    {
+#if defined(BELUGA_NATIVE)
+        _filesystem = new fs::FS();
+        _filesystem->set_root(_root.c_str());
+#else
+        _filesystem = new vfs_filesystem(_root.c_str()); //Keeps the pointer, so _root must outlive it
+#endif
+    }
+
+    posix_backend::~posix_backend()
+    {
+        delete _filesystem;
+    }
+
+    /*!
+    \brief Nothing to mount: the directory must exist (on the device, its filesystem must already be mounted).
+    \return False if the root is missing or not a directory.
+    */
+    bool posix_backend::begin()
+    {
+        struct stat root_stat;
+        if(stat(_root.c_str(), &root_stat) != 0 || !S_ISDIR(root_stat.st_mode))
+        {
+            BELUGA_LOG_ERROR("posix_backend: %s is not a directory", _root.c_str());
+            _mounted = false;
+            return false;
+        }
+        _mounted = true;
+        return true;
+    }
+
+    void posix_backend::end()
+    {
+        _mounted = false;
+    }
+
+    fs::FS & posix_backend::filesystem()
+    {
+        return *_filesystem;
+    }
+
+    /*!
+    \brief The SPIFFS backend ini_reader uses unless told otherwise.
+    */
+    storage_backend & default_storage_backend()
+    {
+        static spiffs_backend spiffs;
+        return spiffs;
+    }
+}
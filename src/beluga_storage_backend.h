@@ -0,0 +1,118 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include "FS.h"
+
+namespace beluga_utils
+{
+    /*!
+    \brief A filesystem that config (and other) files can be read from
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details All the Arduino-ESP32 filesystems are an fs::FS handing out fs::File, so a backend only adds what
+    differs between them: how to mount it, and its name for logs and benchmarks. ini_reader reads through one
+    (set_storage_backend); the default is SPIFFS.
+    begin() is cheap to call again once mounted.
+    Usage:
+    beluga_utils::littlefs_backend littlefs;
+    ini_reader ini("/config.ini");
+    ini.set_storage_backend(&littlefs);
+    ini.initialise();
+    */
+    class storage_backend
+    {
+        public:
+            virtual ~storage_backend(){};
+            virtual const char * name() const = 0;
+            virtual bool begin() = 0;
+            virtual void end() = 0;
+            virtual fs::FS & filesystem() = 0;
+            bool is_mounted() const { return _mounted; }
+            File open(const char * path, const char * mode = FILE_READ) { return filesystem().open(path, mode); }
+            bool exists(const char * path) { return filesystem().exists(path); }
+            bool remove(const char * path) { return filesystem().remove(path); }
+            bool rename(const char * path_from, const char * path_to) { return filesystem().rename(path_from, path_to); }
+
+        protected:
+            bool _mounted = false;
+    };
+
+    /*!
+    \brief The "spiffs" data partition. Slow to open and seek as it fills, but what pio uploadfs writes by default.
+    */
+    class spiffs_backend : public storage_backend
+    {
+        public:
+            spiffs_backend(bool format_on_fail = false) : _format_on_fail(format_on_fail) {};
+            const char * name() const { return "spiffs"; }
+            bool begin();
+            void end();
+            fs::FS & filesystem();
+
+        protected:
+            bool _format_on_fail;
+    };
+
+    /*!
+    \brief LittleFS on the data partition (board_build.filesystem = littlefs). Opens and seeks in roughly constant
+    time however full the partition is.
+    \details The partition label is "spiffs" unless the partition table names it differently. It cannot hold a
+    SPIFFS image: with format_on_fail a SPIFFS partition is erased and reformatted.
+    */
+    class littlefs_backend : public storage_backend
+    {
+        public:
+            littlefs_backend(bool format_on_fail = false, const char * partition_label = "spiffs") : _format_on_fail(format_on_fail), _partition_label(partition_label) {};
+            const char * name() const { return "littlefs"; }
+            bool begin();
+            void end();
+            fs::FS & filesystem();
+
+        protected:
+            bool _format_on_fail;
+            const char * _partition_label;
+    };
+
+    /*!
+    \brief FAT on an SD card over the SDMMC peripheral, mounted at /sdcard (the card beluga_microsd writes to).
+    @param mode_1bit use only the D0 line, as on boards (e.g. ESP32-CAM) that share D1-D3 with other pins.
+    */
+    class sd_mmc_backend : public storage_backend
+    {
+        public:
+            sd_mmc_backend(bool mode_1bit = false) : _mode_1bit(mode_1bit) {};
+            const char * name() const { return "sd_mmc"; }
+            bool begin();
+            void end();
+            fs::FS & filesystem();
+
+        protected:
+            bool _mode_1bit;
+    };
+
+    /*!
+    \brief Plain POSIX file access under a directory.
+    \details On the device the directory is any ESP-IDF VFS mount point (e.g. a FAT partition mounted with
+    esp_vfs_fat_spiflash_mount, or "/spiffs"), read through POSIX open/read/lseek. The filesystem must already be
+    mounted; begin() mounts nothing. On the host it is any directory.
+    */
+    class posix_backend : public storage_backend
+    {
+        public:
+            posix_backend(const char * root);
+            ~posix_backend();
+            const char * name() const { return "posix"; }
+            bool begin();
+            void end();
+            fs::FS & filesystem();
+
+        protected:
+            posix_backend(const posix_backend &);
+            posix_backend & operator=(const posix_backend &);
+            std::string _root;
+            fs::FS * _filesystem;
+    };
+
+    storage_backend & default_storage_backend();
+}
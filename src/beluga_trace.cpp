@@ -0,0 +1,168 @@
+#include "beluga_trace.h"
+
+#if defined(BELUGA_TRACE)
+#include <Arduino.h>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include "beluga_arduino_time.h"
+#if defined(BELUGA_NATIVE)
+#include <functional>
+#include <thread>
+#else
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
+namespace beluga_utils
+{
+    static trace_event trace_ring[BELUGA_TRACE_EVENTS];
+    static std::atomic<uint32_t> trace_next(0);
+    static std::atomic<bool> trace_enabled(true);
+
+    static uint32_t trace_thread_id()
+    {
+#if defined(BELUGA_NATIVE)
+        return (uint32_t) std::hash<std::thread::id>()(std::this_thread::get_id());
+#else
+        return (uint32_t) (uintptr_t) xTaskGetCurrentTaskHandle();
+#endif
+    }
+
+    /*!
+    \brief Append one event, overwriting the oldest when the ring is full.
+    */
+    void trace_record(trace_phase phase, const char * name)
+    {
+        if(!trace_enabled.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        uint32_t index = trace_next.fetch_add(1, std::memory_order_relaxed);
+        trace_event & event = trace_ring[index % BELUGA_TRACE_EVENTS];
+        event.timestamp_us = monotonic_time_us();
+        event.name = name;
+        event.thread_id = trace_thread_id();
+        event.phase = phase;
+    }
+
+    void trace_clear()
+    {
+        trace_next.store(0, std::memory_order_relaxed);
+    }
+
+    /*!
+    \brief Pause (false) or resume (true) recording. Export pauses recording by itself.
+    */
+    void trace_set_enabled(bool enabled)
+    {
+        trace_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    /*!
+    \brief Number of events held (at most BELUGA_TRACE_EVENTS).
+    */
+    size_t trace_event_count()
+    {
+        uint32_t n = trace_next.load(std::memory_order_relaxed);
+        return n < BELUGA_TRACE_EVENTS ? n : BELUGA_TRACE_EVENTS;
+    }
+
+    /*!
+    \brief Write name as a JSON string body (quotes, backslashes and control characters escaped).
+    */
+    static size_t json_escape(const char * name, char * buffer, size_t size)
+    {
+        size_t n = 0;
+        for(const char * p = name ? name : "?"; *p != '\0' && n + 7 < size; p++)
+        {
+            unsigned char c = (unsigned char) *p;
+            if(c == '"' || c == '\\')
+            {
+                buffer[n++] = '\\';
+                buffer[n++] = (char) c;
+            }else if(c < 0x20){
+                n += snprintf(buffer + n, size - n, "\\u%04x", c);
+            }else{
+                buffer[n++] = (char) c;
+            }
+        }
+        buffer[n] = '\0';
+        return n;
+    }
+
+    /*!
+    \brief Write the ring, oldest first, as Chrome trace_event JSON
+    \author Bryan Clarke
+    \date 17/10/2026
+    \details Recording is paused for the duration. Timestamps are microseconds since boot. If the ring has wrapped,
+    the oldest events (possibly the begin of a scope whose end is kept) are gone; the viewers ignore the
+    unmatched ends.
+    @param write called with each piece of text.
+    \return The number of events written.
+    */
+    size_t trace_export(trace_write_function write, void * context)
+    {
+        bool was_enabled = trace_enabled.exchange(false, std::memory_order_acq_rel);
+        uint32_t total = trace_next.load(std::memory_order_acquire);
+        uint32_t first = (total > BELUGA_TRACE_EVENTS) ? total - BELUGA_TRACE_EVENTS : 0;
+        const char * header = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        write(context, header, strlen(header));
+        char name[96];
+        char line[192];
+        for(uint32_t i = first; i < total; i++)
+        {
+            const trace_event & event = trace_ring[i % BELUGA_TRACE_EVENTS];
+            json_escape(event.name, name, sizeof(name));
+            int n = snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%lu%s}",
+                (i == first) ? "" : ",\n", name, (char) event.phase, (unsigned long long) event.timestamp_us,
+                (unsigned long) event.thread_id, (event.phase == trace_phase::instant) ? ",\"s\":\"t\"" : "");
+            if(n > 0)
+            {
+                write(context, line, ((size_t) n < sizeof(line)) ? (size_t) n : sizeof(line) - 1);
+            }
+        }
+        const char * footer = "\n]}\n";
+        write(context, footer, strlen(footer));
+        trace_enabled.store(was_enabled, std::memory_order_release);
+        return total - first;
+    }
+
+    static void write_to_serial(void * context, const char * text, size_t length)
+    {
+        Serial.write((const uint8_t *) text, length);
+    }
+
+    static void write_to_file(void * context, const char * text, size_t length)
+    {
+        ((File *) context)->write((const uint8_t *) text, length);
+    }
+
+    /*!
+    \brief Print the trace JSON to Serial between "BEGIN TRACE" and "END TRACE" lines.
+    */
+    void trace_print_to_serial()
+    {
+        Serial.println("BEGIN TRACE");
+        trace_export(write_to_serial, nullptr);
+        Serial.println("END TRACE");
+    }
+
+    /*!
+    \brief Save the trace JSON to a file (overwritten).
+    \return False if the file could not be opened.
+    Usage: beluga_utils::trace_save(SPIFFS, "/trace.json");
+    */
+    bool trace_save(fs::FS & fs, const char * path)
+    {
+        File trace_file = fs.open(path, FILE_WRITE);
+        if(!trace_file)
+        {
+            return false;
+        }
+        trace_export(write_to_file, &trace_file);
+        trace_file.close();
+        return true;
+    }
+}
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "FS.h"
+
+/*!
+\brief Boot and runtime event tracer with Chrome trace_event export
+\author Bryan Clarke
+\date 17/10/2026
+\details Build with -DBELUGA_TRACE to record begin/end/instant events, with microsecond timestamps from
+monotonic_time_us(), into a fixed ring of BELUGA_TRACE_EVENTS events (default 512, 24 bytes each). The ring is a
+static array, so events are captured from the first constructor that runs, before setup(). When the ring is full
+the oldest events are overwritten. Recording is one atomic increment and a few stores; it is safe from any task
+(not from an ISR).
+Without the flag the BELUGA_TRACE_* macros expand to nothing and beluga_trace.cpp compiles to an empty object.
+Pre-instrumented: the filesystem mount, open and parse in ini_reader::initialise, lazy section loads, and every
+scheduler task run.
+Export as Chrome trace_event JSON and open the file in https://ui.perfetto.dev or chrome://tracing:
+beluga_utils::trace_print_to_serial();            //Copy the text between the BEGIN/END TRACE lines
+beluga_utils::trace_save(SPIFFS, "/trace.json");
+Event names must be string literals (or otherwise outlive the export): only the pointer is stored.
+Usage:
+void read_sensors() { BELUGA_TRACE_SCOPE("read_sensors"); ... }
+BELUGA_TRACE_INSTANT("wifi_connected");
+*/
+
+#ifndef BELUGA_TRACE_EVENTS
+#define BELUGA_TRACE_EVENTS 512
+#endif
+
+namespace beluga_utils
+{
+    enum class trace_phase : uint8_t
+    {
+        begin = 'B',
+        end = 'E',
+        instant = 'i'
+    };
+
+    struct trace_event
+    {
+        uint64_t timestamp_us;
+        const char * name;
+        uint32_t thread_id; //FreeRTOS task (or host thread) that recorded the event
+        trace_phase phase;
+    };
+
+    typedef void (*trace_write_function)(void * context, const char * text, size_t length);
+
+#if defined(BELUGA_TRACE)
+    void trace_record(trace_phase phase, const char * name);
+    void trace_clear();
+    void trace_set_enabled(bool enabled);
+    size_t trace_event_count();
+    size_t trace_export(trace_write_function write, void * context);
+    void trace_print_to_serial();
+    bool trace_save(fs::FS & fs, const char * path);
+
+    /*!
+    \brief Records a begin event now and the matching end event when it goes out of scope.
+    */
+    class trace_scope
+    {
+        public:
+            trace_scope(const char * name) : _name(name) { trace_record(trace_phase::begin, name); }
+            ~trace_scope() { trace_record(trace_phase::end, _name); }
+
+        protected:
+            trace_scope(const trace_scope &);
+            trace_scope & operator=(const trace_scope &);
+            const char * _name;
+    };
+#endif
+}
+
+#if defined(BELUGA_TRACE)
+#define BELUGA_TRACE_CONCAT_INNER(a, b) a##b
+#define BELUGA_TRACE_CONCAT(a, b) BELUGA_TRACE_CONCAT_INNER(a, b)
+#define BELUGA_TRACE_SCOPE(name) beluga_utils::trace_scope BELUGA_TRACE_CONCAT(beluga_trace_scope_, __LINE__)(name)
+#define BELUGA_TRACE_BEGIN(name) beluga_utils::trace_record(beluga_utils::trace_phase::begin, name)
+#define BELUGA_TRACE_END(name) beluga_utils::trace_record(beluga_utils::trace_phase::end, name)
+#define BELUGA_TRACE_INSTANT(name) beluga_utils::trace_record(beluga_utils::trace_phase::instant, name)
+#else
+#define BELUGA_TRACE_SCOPE(name) do {} while(0)
+#define BELUGA_TRACE_BEGIN(name) do {} while(0)
+#define BELUGA_TRACE_END(name) do {} while(0)
+#define BELUGA_TRACE_INSTANT(name) do {} while(0)
+#endif
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""Build the format string table for binary logs, and decode a captured binary log stream.
+
+Usage:
+  python3 beluga_log_tool.py strings SRC_DIR [SRC_DIR ...] -o log_strings.json
+  python3 beluga_log_tool.py decode log_strings.json capture.bin     (or - for stdin)
+
+The device side is src/beluga_log_binary.h (build with -DBELUGA_LOG_BINARY). Bytes that are not part of a valid
+record (e.g. text from debug_print) are passed through unchanged.
+"""
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xB7
+LEVEL_LETTERS = "-EWIDT"
+SOURCE_EXTENSIONS = (".c", ".cpp", ".cc", ".h", ".hpp", ".ino")
+
+# BELUGA_LOG_WARN("..." "...", ...) / BELUGA_LOG_AT(level, "...") / BELUGA_LOG_BINARY_AT(level, "...")
+CALL_RE = re.compile(
+    r'BELUGA_LOG_(?:(?P<level>ERROR|WARN|INFO|DEBUG|TRACE)\s*\(|(?:BINARY_)?AT\s*\([^,]*,)\s*'
+    r'(?P<literals>(?:"(?:[^"\\\n]|\\.)*"\s*)+)')
+LITERAL_RE = re.compile(r'"((?:[^"\\\n]|\\.)*)"')
+CONVERSION_RE = re.compile(
+    r'%(?P<flags>[-+ #0]*)(?P<width>\*|\d+)?(?:\.(?P<precision>\*|\d+))?(?:hh|h|ll|l|L|z|j|t)?(?P<conv>[diouxXeEfFgGcsp%])')
+
+
+def log_format_id(text):
+    """FNV-1a, matching beluga_utils::log_format_id."""
+    h = 2166136261
+    for b in text.encode("utf-8"):
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape_c(literal):
+    return literal.encode("latin-1", "backslashreplace").decode("unicode_escape")
+
+
+def scan_strings(paths):
+    table = {}
+    for root in paths:
+        files = [root] if os.path.isfile(root) else [
+            os.path.join(d, f) for d, _, names in os.walk(root) for f in names if f.endswith(SOURCE_EXTENSIONS)]
+        for path in sorted(files):
+            with open(path, encoding="utf-8", errors="replace") as f:
+                source = f.read()
+            for m in CALL_RE.finditer(source):
+                text = "".join(unescape_c(s) for s in LITERAL_RE.findall(m.group("literals")))
+                key = "%08x" % log_format_id(text)
+                line = source.count("\n", 0, m.start()) + 1
+                if key in table and table[key]["format"] != text:
+                    sys.exit("format id collision %s: %r (%s) and %r" % (key, text, path, table[key]["format"]))
+                table.setdefault(key, {"format": text, "file": path, "line": line})
+    return table
+
+
+def format_record(fmt, args):
+    """printf-style formatting of the decoded arguments, one conversion at a time."""
+    out = []
+    pos = 0
+    args = list(args)
+    for m in CONVERSION_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        conv = m.group("conv")
+        if conv == "%":
+            out.append("%")
+            continue
+        width = m.group("width")
+        precision = m.group("precision")
+        if width == "*":
+            width = str(args.pop(0)) if args else ""
+        if precision == "*":
+            precision = str(args.pop(0)) if args else ""
+        if not args:
+            out.append("<missing>")
+            continue
+        value = args.pop(0)
+        spec = "%" + m.group("flags") + (width or "") + ("." + precision if precision is not None else "")
+        try:
+            if conv in "diu":
+                out.append((spec + "d") % int(value))
+            elif conv == "c":
+                out.append((spec + "s") % (chr(value) if isinstance(value, int) else value))
+            elif conv == "p":
+                out.append((spec + "s") % hex(value))
+            elif conv == "s":
+                out.append((spec + "s") % value)
+            else:
+                out.append((spec + conv) % value)
+        except (TypeError, ValueError):
+            out.append(repr(value))
+    out.append(fmt[pos:])
+    if args:
+        out.append(" <extra args %r>" % (args,))
+    return "".join(out)
+
+
+def decode_args(payload):
+    args = []
+    i = 0
+    while i < len(payload):
+        tag = payload[i]
+        i += 1
+        if tag == 1:
+            args.append(struct.unpack_from("<i", payload, i)[0]); i += 4
+        elif tag == 2:
+            args.append(struct.unpack_from("<I", payload, i)[0]); i += 4
+        elif tag == 3:
+            args.append(struct.unpack_from("<q", payload, i)[0]); i += 8
+        elif tag == 4:
+            args.append(struct.unpack_from("<Q", payload, i)[0]); i += 8
+        elif tag == 5:
+            args.append(struct.unpack_from("<f", payload, i)[0]); i += 4
+        elif tag == 6:
+            n = payload[i]
+            args.append(payload[i + 1:i + 1 + n].decode("utf-8", "replace")); i += 1 + n
+        elif tag == 7:
+            args.append(chr(payload[i])); i += 1
+        else:
+            raise ValueError("unknown argument tag %d" % tag)
+    return args
+
+
+def decode_stream(data, table, out):
+    """Write decoded records (and any passthrough text) to out. Returns (records, bad records)."""
+    i = 0
+    records = 0
+    timestamp_high = 0
+    last_timestamp = None
+    text = bytearray()
+    while i < len(data):
+        if data[i] == SYNC and i + 2 < len(data):
+            n = data[i + 1]
+            end = i + 2 + n
+            if n >= 9 and end < len(data) and (sum(data[i + 2:end]) & 0xFF) == data[end]:
+                payload = data[i + 2:end]
+                format_id, timestamp, level = struct.unpack_from("<IIB", payload, 0)
+                try:
+                    args = decode_args(payload[9:])
+                except (ValueError, struct.error, IndexError):
+                    args = None
+                if args is not None:
+                    if text:
+                        out.write(text.decode("utf-8", "replace"))
+                        text = bytearray()
+                    if last_timestamp is not None and timestamp < last_timestamp:
+                        timestamp_high += 1 << 32  # micros() wrapped
+                    last_timestamp = timestamp
+                    entry = table.get("%08x" % format_id)
+                    message = format_record(entry["format"], args) if entry else \
+                        "<unknown format %08x> %r" % (format_id, args)
+                    letter = LEVEL_LETTERS[level] if level < len(LEVEL_LETTERS) else "?"
+                    out.write("%12.6f [%s] %s\n" % ((timestamp_high + timestamp) / 1e6, letter, message))
+                    records += 1
+                    i = end + 1
+                    continue
+        text.append(data[i])
+        i += 1
+    if text:
+        out.write(text.decode("utf-8", "replace"))
+    return records
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command")
+    strings = sub.add_parser("strings", help="scan sources for BELUGA_LOG_* format strings")
+    strings.add_argument("paths", nargs="+")
+    strings.add_argument("-o", "--output", default="-")
+    decode = sub.add_parser("decode", help="decode a captured stream")
+    decode.add_argument("table")
+    decode.add_argument("capture", help="file of raw Serial bytes, or - for stdin")
+    args = parser.parse_args()
+
+    if args.command == "strings":
+        table = scan_strings(args.paths)
+        text = json.dumps(table, indent=1, sort_keys=True) + "\n"
+        if args.output == "-":
+            sys.stdout.write(text)
+        else:
+            with open(args.output, "w") as f:
+                f.write(text)
+    elif args.command == "decode":
+        with open(args.table) as f:
+            table = json.load(f)
+        if args.capture == "-":
+            data = sys.stdin.buffer.read()
+        else:
+            with open(args.capture, "rb") as f:
+                data = f.read()
+        decode_stream(data, table, sys.stdout)
+    else:
+        parser.print_help()
+        return 2
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
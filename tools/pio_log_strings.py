@@ -0,0 +1,27 @@
+"""PlatformIO pre-build script: write the binary log string table to <build dir>/log_strings.json.
+
+platformio.ini:
+  build_flags = -DBELUGA_LOG_BINARY
+  extra_scripts = pre:<path to beluga_arduino_utils>/tools/pio_log_strings.py
+Then: python3 beluga_log_tool.py decode .pio/build/<env>/log_strings.json capture.bin
+"""
+import inspect
+import json
+import os
+import sys
+
+Import("env")  # noqa: F821 (provided by SCons)
+
+# SCons runs this file without __file__
+tools_dir = os.path.dirname(os.path.abspath(inspect.getframeinfo(inspect.currentframe()).filename))
+sys.path.insert(0, tools_dir)
+import beluga_log_tool  # noqa: E402
+
+source_dirs = [env.subst("$PROJECT_SRC_DIR"), os.path.join(os.path.dirname(tools_dir), "src")]  # noqa: F821
+table = beluga_log_tool.scan_strings([d for d in source_dirs if os.path.isdir(d)])
+build_dir = env.subst("$BUILD_DIR")  # noqa: F821
+if not os.path.isdir(build_dir):
+    os.makedirs(build_dir)
+with open(os.path.join(build_dir, "log_strings.json"), "w") as f:
+    json.dump(table, f, indent=1, sort_keys=True)
+print("beluga_log_tool: %d format strings -> %s" % (len(table), os.path.join(build_dir, "log_strings.json")))